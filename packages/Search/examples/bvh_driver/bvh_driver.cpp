@@ -8,6 +8,7 @@
  ****************************************************************************/
 #include <Teuchos_CommandLineProcessor.hpp>
 #include <Teuchos_StandardCatchMacros.hpp>
+#include <Teuchos_Time.hpp>
 
 #include <Kokkos_DefaultNode.hpp>
 
@@ -17,7 +18,9 @@
 
 #include <cmath>
 #include <functional>
+#include <iostream>
 #include <random>
+#include <vector>
 
 namespace details = DataTransferKit::Details;
 
@@ -72,6 +75,7 @@ int main_( Teuchos::CommandLineProcessor &clp, int argc, char *argv[] )
     int nz = 11;
     int n_points = 100;
     std::string mode = "radius";
+    std::string curve = "morton";
 
     clp.setOption( "nx", &nx, "source mesh points in x-direction." );
     clp.setOption( "ny", &ny, "source mesh points in y-direction." );
@@ -79,6 +83,9 @@ int main_( Teuchos::CommandLineProcessor &clp, int argc, char *argv[] )
     clp.setOption( "N", &n_points,
                    "number of target mesh points (distributed randomly)." );
     clp.setOption( "mode", &mode, "mode: (knn | radius)" );
+    clp.setOption( "curve", &curve,
+                   "space-filling curve used to order the leaves: "
+                   "(morton | hilbert | both)" );
 
     clp.recogniseAllOptions( true );
     switch ( clp.parse( argc, argv ) )
@@ -112,7 +119,16 @@ int main_( Teuchos::CommandLineProcessor &clp, int argc, char *argv[] )
     }
     Kokkos::deep_copy( bounding_boxes, bounding_boxes_host );
 
-    DataTransferKit::BVH<DeviceType> bvh( bounding_boxes );
+    std::vector<std::pair<std::string, DataTransferKit::SpaceFillingCurve>>
+        curves;
+    if ( curve == "morton" || curve == "both" )
+        curves.emplace_back( "morton",
+                             DataTransferKit::SpaceFillingCurve::Morton );
+    if ( curve == "hilbert" || curve == "both" )
+        curves.emplace_back( "hilbert",
+                             DataTransferKit::SpaceFillingCurve::Hilbert );
+    if ( curves.empty() )
+        throw std::runtime_error( "Unrecognized space-filling curve" );
 
     // random points for radius search and kNN queries
     auto queries = make_random_cloud( Lx, Ly, Lz, n_points );
@@ -159,9 +175,29 @@ int main_( Teuchos::CommandLineProcessor &clp, int argc, char *argv[] )
         Kokkos::fence();
 
         // do the search
-        Kokkos::View<int *, DeviceType> offset_nearest( "offset_nearest" );
-        Kokkos::View<int *, DeviceType> indices_nearest( "indices_nearest" );
-        bvh.query( nearest_queries, indices_nearest, offset_nearest );
+        for ( auto const &c : curves )
+        {
+            Teuchos::Time construction_timer( "construction" );
+            construction_timer.start( true );
+            DataTransferKit::BVH<DeviceType> bvh(
+                bounding_boxes,
+                DataTransferKit::BVH<
+                    DeviceType>::default_brute_force_threshold,
+                c.second );
+            double const construction_time = construction_timer.stop();
+
+            Kokkos::View<int *, DeviceType> offset_nearest( "offset_nearest" );
+            Kokkos::View<int *, DeviceType> indices_nearest(
+                "indices_nearest" );
+            Teuchos::Time query_timer( "query" );
+            query_timer.start( true );
+            bvh.query( nearest_queries, indices_nearest, offset_nearest );
+            double const query_time = query_timer.stop();
+
+            std::cout << c.first << ": construction " << construction_time
+                      << " s, knn search " << query_time << " s, SAH cost "
+                      << bvh.sahCost() << "\n";
+        }
     }
     else if ( mode == "radius" )
     {
@@ -195,9 +231,28 @@ int main_( Teuchos::CommandLineProcessor &clp, int argc, char *argv[] )
             } );
         Kokkos::fence();
 
-        Kokkos::View<int *, DeviceType> offset_within( "offset_within" );
-        Kokkos::View<int *, DeviceType> indices_within( "indices_within" );
-        bvh.query( within_queries, indices_within, offset_within );
+        for ( auto const &c : curves )
+        {
+            Teuchos::Time construction_timer( "construction" );
+            construction_timer.start( true );
+            DataTransferKit::BVH<DeviceType> bvh(
+                bounding_boxes,
+                DataTransferKit::BVH<
+                    DeviceType>::default_brute_force_threshold,
+                c.second );
+            double const construction_time = construction_timer.stop();
+
+            Kokkos::View<int *, DeviceType> offset_within( "offset_within" );
+            Kokkos::View<int *, DeviceType> indices_within( "indices_within" );
+            Teuchos::Time query_timer( "query" );
+            query_timer.start( true );
+            bvh.query( within_queries, indices_within, offset_within );
+            double const query_time = query_timer.stop();
+
+            std::cout << c.first << ": construction " << construction_time
+                      << " s, radius search " << query_time << " s, SAH cost "
+                      << bvh.sahCost() << "\n";
+        }
     }
 
     return 0;
@@ -0,0 +1,190 @@
+/****************************************************************************
+ * Copyright (c) 2012-2017 by the DataTransferKit authors                   *
+ * All rights reserved.                                                     *
+ *                                                                          *
+ * This file is part of the DataTransferKit library. DataTransferKit is     *
+ * distributed under a BSD 3-clause license. For the licensing terms see    *
+ * the LICENSE file in the top-level directory.                             *
+ ****************************************************************************/
+
+#ifndef DTK_ADAPTIVE_SEARCH_TREE_DECL_HPP
+#define DTK_ADAPTIVE_SEARCH_TREE_DECL_HPP
+
+#include <Kokkos_View.hpp>
+
+#include <Teuchos_Time.hpp>
+
+#include <DTK_DBC.hpp>
+#include <DTK_DetailsBox.hpp>
+#include <DTK_DetailsPredicate.hpp>
+#include <DTK_DetailsSearchStrategy.hpp>
+#include <DTK_KdTree.hpp>
+#include <DTK_LinearBVH.hpp>
+#include <DTK_UniformGrid.hpp>
+
+#include "DTK_ConfigDefs.hpp"
+
+#include <array>
+#include <memory>
+
+namespace DataTransferKit
+{
+
+/**
+ * Front end to the search structures (brute force, BVH, uniform grid, and
+ * kd-tree) that picks one of them based on the number of objects, how they
+ * are spread, the variance of their sizes, and the number of queries.  The
+ * structure is built upon the first call to query() when the number of
+ * queries is known.
+ *
+ * Every call to query() is timed.  The measured time per query calibrates
+ * the cost model, and when another strategy is expected to be faster by
+ * more than what it costs to build it, the next call switches to it.
+ * Structures that have been built are kept so that switching back is free.
+ *
+ * Objects do not hold tags, so predicates that carry a mask are rejected.
+ */
+template <typename DeviceType>
+class AdaptiveSearchTree
+{
+  public:
+    /** \brief Timings recorded for one strategy (in seconds).
+     */
+    struct Timings
+    {
+        double construction = 0.;
+        double query = 0.;
+        int n_queries = 0;
+    };
+
+    /** \brief Gathers statistics about the objects.
+     *
+     *  \note The bounding boxes are copied since structures may be built
+     *  later on.
+     */
+    AdaptiveSearchTree( Kokkos::View<Box const *, DeviceType> bounding_boxes );
+
+    // Views are passed by reference here because internally Kokkos::realloc()
+    // is called.
+    template <typename Query>
+    void query( Kokkos::View<Query *, DeviceType> queries,
+                Kokkos::View<int *, DeviceType> &indices,
+                Kokkos::View<int *, DeviceType> &offset );
+    template <typename Query>
+    typename std::enable_if<
+        std::is_same<typename Query::Tag, Details::NearestPredicateTag>::value,
+        void>::type
+    query( Kokkos::View<Query *, DeviceType> queries,
+           Kokkos::View<int *, DeviceType> &indices,
+           Kokkos::View<int *, DeviceType> &offset,
+           Kokkos::View<double *, DeviceType> &distances );
+
+    /** \brief Strategy used by the next call to query().
+     */
+    SearchStrategy strategy() const { return _strategy; }
+
+    /** \brief Timings accumulated so far for the given strategy.
+     */
+    Timings const &timings( SearchStrategy strategy ) const
+    {
+        return _timings[static_cast<int>( strategy )];
+    }
+
+    Details::SceneStatistics const &sceneStatistics() const { return _scene; }
+
+    Box bounds() const { return _bounds; }
+
+    using SizeType = typename Kokkos::View<int *, DeviceType>::size_type;
+    SizeType size() const { return _bounding_boxes.extent( 0 ); }
+
+    bool empty() const { return size() == 0; }
+
+  private:
+    // Picks the strategy on the first call and builds the corresponding
+    // structure if needed.
+    void prepare( int n_queries );
+    bool isBuilt( SearchStrategy strategy ) const;
+    // Records the time spent in a query and reconsiders the strategy.
+    void update( int n_queries, double elapsed_time );
+
+    template <typename Query, typename... Distances>
+    void dispatch( Kokkos::View<Query *, DeviceType> queries,
+                   Kokkos::View<int *, DeviceType> &indices,
+                   Kokkos::View<int *, DeviceType> &offset,
+                   Distances &... distances ) const;
+
+    Kokkos::View<Box *, DeviceType> _bounding_boxes;
+    Box _bounds;
+    Details::SceneStatistics _scene;
+    bool _selected = false;
+    SearchStrategy _strategy = SearchStrategy::BoundingVolumeHierarchy;
+    std::array<Timings, 4> _timings;
+    std::shared_ptr<BVH<DeviceType>> _brute_force;
+    std::shared_ptr<BVH<DeviceType>> _bvh;
+    std::shared_ptr<UniformGrid<DeviceType>> _grid;
+    std::shared_ptr<KdTree<DeviceType>> _kd_tree;
+};
+
+template <typename DeviceType>
+template <typename Query, typename... Distances>
+void AdaptiveSearchTree<DeviceType>::dispatch(
+    Kokkos::View<Query *, DeviceType> queries,
+    Kokkos::View<int *, DeviceType> &indices,
+    Kokkos::View<int *, DeviceType> &offset, Distances &... distances ) const
+{
+    switch ( _strategy )
+    {
+    case SearchStrategy::BruteForce:
+        _brute_force->query( queries, indices, offset, distances... );
+        break;
+    case SearchStrategy::BoundingVolumeHierarchy:
+        _bvh->query( queries, indices, offset, distances... );
+        break;
+    case SearchStrategy::UniformGrid:
+        _grid->query( queries, indices, offset, distances... );
+        break;
+    case SearchStrategy::KdTree:
+        _kd_tree->query( queries, indices, offset, distances... );
+        break;
+    }
+}
+
+template <typename DeviceType>
+template <typename Query>
+void AdaptiveSearchTree<DeviceType>::query(
+    Kokkos::View<Query *, DeviceType> queries,
+    Kokkos::View<int *, DeviceType> &indices,
+    Kokkos::View<int *, DeviceType> &offset )
+{
+    DTK_INSIST( Details::countMaskedQueries( queries ) == 0 );
+    int const n_queries = queries.extent( 0 );
+    prepare( n_queries );
+    Teuchos::Time timer( "adaptive_search_tree_query" );
+    timer.start( true );
+    dispatch( queries, indices, offset );
+    update( n_queries, timer.stop() );
+}
+
+template <typename DeviceType>
+template <typename Query>
+typename std::enable_if<
+    std::is_same<typename Query::Tag, Details::NearestPredicateTag>::value,
+    void>::type
+AdaptiveSearchTree<DeviceType>::query(
+    Kokkos::View<Query *, DeviceType> queries,
+    Kokkos::View<int *, DeviceType> &indices,
+    Kokkos::View<int *, DeviceType> &offset,
+    Kokkos::View<double *, DeviceType> &distances )
+{
+    DTK_INSIST( Details::countMaskedQueries( queries ) == 0 );
+    int const n_queries = queries.extent( 0 );
+    prepare( n_queries );
+    Teuchos::Time timer( "adaptive_search_tree_query" );
+    timer.start( true );
+    dispatch( queries, indices, offset, distances );
+    update( n_queries, timer.stop() );
+}
+
+} // end namespace DataTransferKit
+
+#endif
@@ -0,0 +1,158 @@
+/****************************************************************************
+ * Copyright (c) 2012-2017 by the DataTransferKit authors                   *
+ * All rights reserved.                                                     *
+ *                                                                          *
+ * This file is part of the DataTransferKit library. DataTransferKit is     *
+ * distributed under a BSD 3-clause license. For the licensing terms see    *
+ * the LICENSE file in the top-level directory.                             *
+ ****************************************************************************/
+
+#ifndef DTK_ADAPTIVE_SEARCH_TREE_DEF_HPP
+#define DTK_ADAPTIVE_SEARCH_TREE_DEF_HPP
+
+#include "DTK_ConfigDefs.hpp"
+
+#include <DTK_DetailsAlgorithms.hpp>
+#include <DTK_DetailsSearchStrategy.hpp>
+#include <DTK_DetailsTreeConstruction.hpp>
+
+namespace DataTransferKit
+{
+
+template <typename DeviceType>
+AdaptiveSearchTree<DeviceType>::AdaptiveSearchTree(
+    Kokkos::View<Box const *, DeviceType> bounding_boxes )
+    : _bounding_boxes( "bounding_boxes", bounding_boxes.extent( 0 ) )
+{
+    Kokkos::deep_copy( _bounding_boxes, bounding_boxes );
+    if ( !empty() )
+        Details::TreeConstruction<DeviceType>::calculateBoundingBoxOfTheScene(
+            bounding_boxes, _bounds );
+    _scene = Details::SearchStrategySelection<DeviceType>::sceneStatistics(
+        bounding_boxes );
+}
+
+template <typename DeviceType>
+void AdaptiveSearchTree<DeviceType>::prepare( int n_queries )
+{
+    using ExecutionSpace = typename DeviceType::execution_space;
+    using Selection = Details::SearchStrategySelection<DeviceType>;
+
+    if ( !_selected )
+    {
+        _strategy = Selection::select( _scene, n_queries );
+        _selected = true;
+    }
+
+    if ( isBuilt( _strategy ) )
+        return;
+
+    Teuchos::Time timer( "adaptive_search_tree_construction" );
+    timer.start( true );
+    switch ( _strategy )
+    {
+    case SearchStrategy::BruteForce:
+        _brute_force = std::make_shared<BVH<DeviceType>>( _bounding_boxes,
+                                                          size() );
+        break;
+    case SearchStrategy::BoundingVolumeHierarchy:
+        _bvh = std::make_shared<BVH<DeviceType>>( _bounding_boxes, 0 );
+        break;
+    case SearchStrategy::UniformGrid:
+        _grid = std::make_shared<UniformGrid<DeviceType>>( _bounding_boxes );
+        break;
+    case SearchStrategy::KdTree:
+    {
+        DTK_REQUIRE( _scene.points );
+        int const n = size();
+        Kokkos::View<Box *, DeviceType> bounding_boxes = _bounding_boxes;
+        Kokkos::View<Point *, DeviceType> points( "points", n );
+        Kokkos::parallel_for( REGION_NAME( "extract_points" ),
+                              Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
+                              KOKKOS_LAMBDA( int i ) {
+                                  Details::centroid( bounding_boxes( i ),
+                                                     points( i ) );
+                              } );
+        Kokkos::fence();
+        _kd_tree = std::make_shared<KdTree<DeviceType>>( points );
+        break;
+    }
+    }
+    _timings[static_cast<int>( _strategy )].construction += timer.stop();
+}
+
+template <typename DeviceType>
+bool AdaptiveSearchTree<DeviceType>::isBuilt( SearchStrategy strategy ) const
+{
+    switch ( strategy )
+    {
+    case SearchStrategy::BruteForce:
+        return static_cast<bool>( _brute_force );
+    case SearchStrategy::BoundingVolumeHierarchy:
+        return static_cast<bool>( _bvh );
+    case SearchStrategy::UniformGrid:
+        return static_cast<bool>( _grid );
+    case SearchStrategy::KdTree:
+        return static_cast<bool>( _kd_tree );
+    }
+    return false;
+}
+
+template <typename DeviceType>
+void AdaptiveSearchTree<DeviceType>::update( int n_queries,
+                                             double elapsed_time )
+{
+    using Selection = Details::SearchStrategySelection<DeviceType>;
+
+    Timings &current = _timings[static_cast<int>( _strategy )];
+    current.query += elapsed_time;
+    current.n_queries += n_queries;
+    if ( n_queries == 0 || current.n_queries == 0 )
+        return;
+
+    // Convert the cost model into seconds using the strategy that was just
+    // measured.  Strategies that have already been used are judged on their
+    // own measurements rather than on the model.
+    double const measured = current.query / current.n_queries;
+    double const model = Selection::queryCost( _scene, _strategy );
+    if ( !( model > 0. ) || !( measured > 0. ) )
+        return;
+    double const seconds_per_unit = measured / model;
+
+    SearchStrategy best = _strategy;
+    double best_gain = 0.;
+    for ( SearchStrategy strategy :
+          {SearchStrategy::BruteForce, SearchStrategy::BoundingVolumeHierarchy,
+           SearchStrategy::UniformGrid, SearchStrategy::KdTree} )
+    {
+        if ( strategy == _strategy ||
+             !Selection::isApplicable( _scene, strategy ) )
+            continue;
+        Timings const &other = _timings[static_cast<int>( strategy )];
+        double const estimate =
+            other.n_queries > 0
+                ? other.query / other.n_queries
+                : Selection::queryCost( _scene, strategy ) * seconds_per_unit;
+        double const construction =
+            isBuilt( strategy )
+                ? 0.
+                : Selection::constructionCost( _scene, strategy ) *
+                      seconds_per_unit;
+        // switch only if it pays off over a batch of the same size
+        double const gain = ( measured - estimate ) * n_queries - construction;
+        if ( gain > best_gain )
+        {
+            best = strategy;
+            best_gain = gain;
+        }
+    }
+    _strategy = best;
+}
+
+} // end namespace DataTransferKit
+
+// Explicit instantiation macro
+#define DTK_ADAPTIVE_SEARCH_TREE_INSTANT( NODE )                               \
+    template class AdaptiveSearchTree<typename NODE::device_type>;
+
+#endif
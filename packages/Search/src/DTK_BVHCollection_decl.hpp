@@ -0,0 +1,314 @@
+/****************************************************************************
+ * Copyright (c) 2012-2017 by the DataTransferKit authors                   *
+ * All rights reserved.                                                     *
+ *                                                                          *
+ * This file is part of the DataTransferKit library. DataTransferKit is     *
+ * distributed under a BSD 3-clause license. For the licensing terms see    *
+ * the LICENSE file in the top-level directory.                             *
+ ****************************************************************************/
+
+#ifndef DTK_BVH_COLLECTION_DECL_HPP
+#define DTK_BVH_COLLECTION_DECL_HPP
+
+#include <Kokkos_ArithTraits.hpp>
+#include <Kokkos_View.hpp>
+
+#include <DTK_DetailsAlgorithms.hpp>
+#include <DTK_DetailsPredicate.hpp>
+#include <DTK_DetailsTreeTraversal.hpp>
+#include <DTK_DetailsUtils.hpp>
+#include <DTK_LinearBVH.hpp>
+
+#include "DTK_ConfigDefs.hpp"
+
+#include <vector>
+
+namespace DataTransferKit
+{
+
+/**
+ * Collection of BVHs (e.g. one per source block) that are searched together.
+ * A batch of queries is processed against all the trees at once so that the
+ * queries are read and the results allocated a single time instead of once
+ * per tree.  Results are tagged with the position of the tree in the
+ * collection.
+ */
+template <typename DeviceType>
+class BVHCollection
+{
+  public:
+    /** \brief Gathers the trees.
+     *
+     *  \note The trees are not copied, the collection only holds references
+     *  to their data.
+     */
+    BVHCollection( std::vector<BVH<DeviceType>> const &trees );
+
+    /** \brief Finds the objects satisfying the predicates in any of the
+     *  trees.
+     *
+     *  \c tree_ids(j) is the tree that holds object \c indices(j).  Results
+     *  of a query are ordered by tree.
+     */
+    // Views are passed by reference here because internally Kokkos::realloc()
+    // is called.
+    template <typename Query>
+    void query( Kokkos::View<Query *, DeviceType> queries,
+                Kokkos::View<int *, DeviceType> &indices,
+                Kokkos::View<int *, DeviceType> &offset,
+                Kokkos::View<int *, DeviceType> &tree_ids ) const;
+
+    /** \brief Finds the k nearest objects among all the trees.
+     *
+     *  Results are sorted by increasing distance and unused slots are padded
+     *  with -1 in both \c indices and \c tree_ids.
+     */
+    template <typename Query>
+    typename std::enable_if<
+        std::is_same<typename Query::Tag, Details::NearestPredicateTag>::value,
+        void>::type
+    query( Kokkos::View<Query *, DeviceType> queries,
+           Kokkos::View<int *, DeviceType> &indices,
+           Kokkos::View<int *, DeviceType> &offset,
+           Kokkos::View<int *, DeviceType> &tree_ids,
+           Kokkos::View<double *, DeviceType> &distances ) const;
+
+    /** \brief Number of trees in the collection.
+     */
+    int size() const { return _trees.size(); }
+
+    bool empty() const { return size() == 0; }
+
+  private:
+    template <typename Query>
+    void queryDispatch( Kokkos::View<Query *, DeviceType> queries,
+                        Kokkos::View<int *, DeviceType> &indices,
+                        Kokkos::View<int *, DeviceType> &offset,
+                        Kokkos::View<int *, DeviceType> &tree_ids,
+                        Details::SpatialPredicateTag ) const;
+    template <typename Query>
+    void queryDispatch( Kokkos::View<Query *, DeviceType> queries,
+                        Kokkos::View<int *, DeviceType> &indices,
+                        Kokkos::View<int *, DeviceType> &offset,
+                        Kokkos::View<int *, DeviceType> &tree_ids,
+                        Details::NearestPredicateTag,
+                        Kokkos::View<double *, DeviceType> *distances_ptr =
+                            nullptr ) const;
+    template <typename Query, typename Traversal>
+    void performNearestQueries( Kokkos::View<Query *, DeviceType> queries,
+                                Kokkos::View<int *, DeviceType> indices,
+                                Kokkos::View<int *, DeviceType> offset,
+                                Kokkos::View<int *, DeviceType> tree_ids,
+                                Kokkos::View<double *, DeviceType> distances,
+                                Traversal ) const;
+
+    // Keep the data of the trees alive.
+    std::vector<BVH<DeviceType>> _trees;
+    // Copies of the trees that do not own their data so that they can be
+    // stored in device memory and accessed from the kernels.
+    Kokkos::View<BVH<DeviceType> *, DeviceType> _device_trees;
+};
+
+template <typename DeviceType>
+template <typename Query>
+void BVHCollection<DeviceType>::queryDispatch(
+    Kokkos::View<Query *, DeviceType> queries,
+    Kokkos::View<int *, DeviceType> &indices,
+    Kokkos::View<int *, DeviceType> &offset,
+    Kokkos::View<int *, DeviceType> &tree_ids,
+    Details::SpatialPredicateTag ) const
+{
+    using ExecutionSpace = typename DeviceType::execution_space;
+
+    int const n_queries = queries.extent( 0 );
+    int const n_trees = size();
+    Kokkos::View<BVH<DeviceType> *, DeviceType> trees = _device_trees;
+
+    Kokkos::realloc( offset, n_queries + 1 );
+    fill( offset, 0 );
+
+    // Trees whose bounds do not satisfy the predicate are skipped altogether.
+    Kokkos::parallel_for(
+        REGION_NAME( "first_pass_at_the_collection_search_count" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
+        KOKKOS_LAMBDA( int i ) {
+            Query const predicate = queries( i );
+            int count = 0;
+            for ( int t = 0; t < n_trees; ++t )
+            {
+                BVH<DeviceType> const &tree = trees( t );
+                if ( tree.empty() || !predicate( tree.bounds() ) )
+                    continue;
+                count += Details::TreeTraversal<DeviceType>::query(
+                    tree, predicate, []( int index ) {} );
+            }
+            offset( i ) = count;
+        } );
+    Kokkos::fence();
+
+    exclusivePrefixSum( offset );
+    int const n_results = lastElement( offset );
+
+    Kokkos::realloc( indices, n_results );
+    Kokkos::realloc( tree_ids, n_results );
+    Kokkos::parallel_for(
+        REGION_NAME( "second_pass_of_the_collection_search" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
+        KOKKOS_LAMBDA( int i ) {
+            Query const predicate = queries( i );
+            int count = 0;
+            for ( int t = 0; t < n_trees; ++t )
+            {
+                BVH<DeviceType> const &tree = trees( t );
+                if ( tree.empty() || !predicate( tree.bounds() ) )
+                    continue;
+                Details::TreeTraversal<DeviceType>::query(
+                    tree, predicate,
+                    [indices, offset, tree_ids, i, t, &count]( int index ) {
+                        indices( offset( i ) + count ) = index;
+                        tree_ids( offset( i ) + count ) = t;
+                        count++;
+                    } );
+            }
+        } );
+    Kokkos::fence();
+}
+
+// The trees are searched one after the other and the k nearest neighbors
+// found so far are kept sorted in the output views.  The distance to the k-th
+// one bounds the search in the remaining trees.
+template <typename DeviceType>
+template <typename Query, typename Traversal>
+void BVHCollection<DeviceType>::performNearestQueries(
+    Kokkos::View<Query *, DeviceType> queries,
+    Kokkos::View<int *, DeviceType> indices,
+    Kokkos::View<int *, DeviceType> offset,
+    Kokkos::View<int *, DeviceType> tree_ids,
+    Kokkos::View<double *, DeviceType> distances, Traversal ) const
+{
+    using ExecutionSpace = typename DeviceType::execution_space;
+
+    int const n_queries = queries.extent( 0 );
+    int const n_trees = size();
+    Kokkos::View<BVH<DeviceType> *, DeviceType> trees = _device_trees;
+    double const infinity = Kokkos::ArithTraits<double>::max();
+
+    Kokkos::parallel_for(
+        REGION_NAME( "perform_nearest_queries_on_the_collection" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
+        KOKKOS_LAMBDA( int i ) {
+            int const first = offset( i );
+            Point const query_point = queries( i )._query_point;
+            int const k = queries( i )._k;
+            int count = 0;
+            for ( int t = 0; t < n_trees; ++t )
+            {
+                BVH<DeviceType> const &tree = trees( t );
+                double const radius =
+                    ( count == k ? distances( first + k - 1 ) : infinity );
+                if ( tree.empty() ||
+                     Details::distance( query_point, tree.bounds() ) > radius )
+                    continue;
+                Details::NullStatistics stats;
+                Details::nearestQuery(
+                    tree, query_point, k,
+                    [indices, tree_ids, distances, first, k, t,
+                     &count]( int index, double distance ) {
+                        insertSorted( indices, tree_ids, distances, first, k,
+                                      count, index, t, distance );
+                    },
+                    radius, stats, Details::BoundingBoxDistance{},
+                    queries( i )._mask, Traversal{} );
+            }
+        } );
+    Kokkos::fence();
+}
+
+template <typename DeviceType>
+template <typename Query>
+void BVHCollection<DeviceType>::queryDispatch(
+    Kokkos::View<Query *, DeviceType> queries,
+    Kokkos::View<int *, DeviceType> &indices,
+    Kokkos::View<int *, DeviceType> &offset,
+    Kokkos::View<int *, DeviceType> &tree_ids, Details::NearestPredicateTag,
+    Kokkos::View<double *, DeviceType> *distances_ptr ) const
+{
+    using ExecutionSpace = typename DeviceType::execution_space;
+
+    int const n_queries = queries.extent( 0 );
+    double const infinity = Kokkos::ArithTraits<double>::max();
+
+    Kokkos::realloc( offset, n_queries + 1 );
+    fill( offset, 0 );
+
+    Kokkos::parallel_for(
+        REGION_NAME( "scan_queries_for_numbers_of_nearest_neighbors" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
+        KOKKOS_LAMBDA( int i ) { offset( i ) = queries( i )._k; } );
+    Kokkos::fence();
+
+    exclusivePrefixSum( offset );
+    int const n_results = lastElement( offset );
+
+    Kokkos::realloc( indices, n_results );
+    fill( indices, -1 );
+    Kokkos::realloc( tree_ids, n_results );
+    fill( tree_ids, -1 );
+    // distances are needed to merge the results from the different trees
+    Kokkos::View<double *, DeviceType> distances( "distances" );
+    if ( distances_ptr )
+        distances = *distances_ptr;
+    Kokkos::realloc( distances, n_results );
+    fill( distances, infinity );
+
+    // The kernel only decides for every tree whether to scan its leaves when
+    // the collection mixes both kinds of trees.
+    int n_brute_force = 0;
+    for ( auto const &tree : _trees )
+        if ( Details::TreeTraversal<DeviceType>::isBruteForce( tree ) )
+            ++n_brute_force;
+    if ( n_brute_force == 0 )
+        performNearestQueries( queries, indices, offset, tree_ids, distances,
+                               Details::HierarchicalTraversal{} );
+    else if ( n_brute_force == size() )
+        performNearestQueries( queries, indices, offset, tree_ids, distances,
+                               Details::BruteForceTraversal{} );
+    else
+        performNearestQueries( queries, indices, offset, tree_ids, distances,
+                               Details::AnyTraversal{} );
+
+    if ( distances_ptr )
+        *distances_ptr = distances;
+}
+
+template <typename DeviceType>
+template <typename Query>
+void BVHCollection<DeviceType>::query(
+    Kokkos::View<Query *, DeviceType> queries,
+    Kokkos::View<int *, DeviceType> &indices,
+    Kokkos::View<int *, DeviceType> &offset,
+    Kokkos::View<int *, DeviceType> &tree_ids ) const
+{
+    using Tag = typename Query::Tag;
+    queryDispatch( queries, indices, offset, tree_ids, Tag{} );
+}
+
+template <typename DeviceType>
+template <typename Query>
+typename std::enable_if<
+    std::is_same<typename Query::Tag, Details::NearestPredicateTag>::value,
+    void>::type
+BVHCollection<DeviceType>::query(
+    Kokkos::View<Query *, DeviceType> queries,
+    Kokkos::View<int *, DeviceType> &indices,
+    Kokkos::View<int *, DeviceType> &offset,
+    Kokkos::View<int *, DeviceType> &tree_ids,
+    Kokkos::View<double *, DeviceType> &distances ) const
+{
+    using Tag = typename Query::Tag;
+    queryDispatch( queries, indices, offset, tree_ids, Tag{}, &distances );
+}
+
+} // end namespace DataTransferKit
+
+#endif
@@ -0,0 +1,51 @@
+/****************************************************************************
+ * Copyright (c) 2012-2017 by the DataTransferKit authors                   *
+ * All rights reserved.                                                     *
+ *                                                                          *
+ * This file is part of the DataTransferKit library. DataTransferKit is     *
+ * distributed under a BSD 3-clause license. For the licensing terms see    *
+ * the LICENSE file in the top-level directory.                             *
+ ****************************************************************************/
+
+#ifndef DTK_BVH_COLLECTION_DEF_HPP
+#define DTK_BVH_COLLECTION_DEF_HPP
+
+#include "DTK_ConfigDefs.hpp"
+
+namespace DataTransferKit
+{
+
+template <typename DeviceType>
+BVHCollection<DeviceType>::BVHCollection(
+    std::vector<BVH<DeviceType>> const &trees )
+    : _trees( trees )
+    , _device_trees( "trees", trees.size() )
+{
+    // Views constructed from raw pointers are not reference counted, which
+    // is required to copy them to device memory.  _trees keeps the data
+    // alive.
+    auto device_trees_host = Kokkos::create_mirror_view( _device_trees );
+    for ( int t = 0; t < size(); ++t )
+    {
+        BVH<DeviceType> const &tree = _trees[t];
+        BVH<DeviceType> &view = device_trees_host( t );
+        view._brute_force = tree._brute_force;
+        view._leaf_nodes = Kokkos::View<Node *, DeviceType>(
+            tree._leaf_nodes.data(), tree._leaf_nodes.extent( 0 ) );
+        view._internal_nodes = Kokkos::View<Node *, DeviceType>(
+            tree._internal_nodes.data(), tree._internal_nodes.extent( 0 ) );
+        view._indices = Kokkos::View<int *, DeviceType>(
+            tree._indices.data(), tree._indices.extent( 0 ) );
+        view._tags = Kokkos::View<unsigned int *, DeviceType>(
+            tree._tags.data(), tree._tags.extent( 0 ) );
+    }
+    Kokkos::deep_copy( _device_trees, device_trees_host );
+}
+
+} // end namespace DataTransferKit
+
+// Explicit instantiation macro
+#define DTK_BVH_COLLECTION_INSTANT( NODE )                                     \
+    template class BVHCollection<typename NODE::device_type>;
+
+#endif
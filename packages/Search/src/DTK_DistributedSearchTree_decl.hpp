@@ -21,16 +21,154 @@
 
 #include "DTK_ConfigDefs.hpp"
 
+#include <map>
+#include <memory>
+#include <set>
+#include <utility>
+#include <vector>
+
 namespace DataTransferKit
 {
 
+/**
+ * Communication plan of a batch of queries that can be reused for subsequent
+ * batches as long as every query is sent to the same processes, e.g. when the
+ * same target points search a DistributedSearchTree at every time step.
+ *
+ * The first query performed with the plan sets it up.  The following ones
+ * only check whether it is still valid, which takes a local search and one
+ * reduction, and skip setting up the communication.  If the queries need to
+ * go elsewhere on any of the processes, the plan is set up again.  Nearest
+ * neighbors queries are forwarded in two rounds and the plan keeps the
+ * communication of each of them.
+ *
+ * The plan can also balance the local searches when the queries concentrate
+ * on a few processes.  The processes that received the most queries then
+ * hand some of them over to the ones that received the fewest, together with
+ * a copy of their local tree.  The copies are kept with the plan so that the
+ * following batches do not send the trees again, and so is the communication
+ * that hands the queries over as long as the hand-overs do not change.  The
+ * results are returned as if the queries had been performed by the process
+ * that owns the objects.
+ *
+ * At large process counts, the messages can also be aggregated by node: the
+ * queries and the results go through the process with the lowest rank on
+ * the node of their source and on the node of their destination.  Every
+ * process then exchanges messages with a number of processes that scales
+ * with the number of nodes rather than with the number of processes.
+ *
+ * \note The plan must be passed on all processes, and a given plan must only
+ * be used with a single tree.
+ */
+template <typename DeviceType>
+class DistributedQueryPlan
+{
+  public:
+    /** \brief Creates an empty plan.
+     *
+     *  \param[in] max_imbalance When positive, the number of queries every
+     *  process performs on its local tree is measured, and the queries are
+     *  handed over to other processes if the largest number exceeds
+     *  max_imbalance times the average (e.g. 1.5).  Pass a large value to
+     *  only measure the loads.
+     *  \param[in] aggregate_by_node Whether the messages are aggregated by
+     *  shared-memory node.  The nodes are detected with
+     *  MPI_Comm_split_type().
+     */
+    explicit DistributedQueryPlan( double max_imbalance = 0.,
+                                   bool aggregate_by_node = false )
+        : _max_imbalance( max_imbalance )
+        , _aggregate_by_node( aggregate_by_node )
+    {
+    }
+
+    /** \brief Number of times the communication was set up, counting the
+     *  rounds and the hand-overs separately.
+     */
+    int numberOfSetups() const { return _n_setups; }
+
+    /** \brief Number of queries each process performed on its local tree
+     *  during the last batch, before any were handed over, counting both
+     *  rounds of the nearest neighbors queries.  Only measured when the
+     *  plan balances the loads.
+     */
+    std::vector<int> const &queryLoads() const { return _query_loads; }
+
+    /** \brief Number of copies of the local trees of other processes that
+     *  the calling process holds.
+     */
+    int numberOfReplicas() const { return _replicas.size(); }
+
+  private:
+    friend struct DistributedSearchTreeImpl<DeviceType>;
+
+    struct Round
+    {
+        std::shared_ptr<Details::HierarchicalDistributor> distributor;
+        // Processes the queries were sent to when the plan was set up, in the
+        // same format as the results of the search.
+        Kokkos::View<int *, DeviceType> indices;
+        Kokkos::View<int *, DeviceType> offset;
+        // Queries handed over during the round when the communication that
+        // hands them over was set up.
+        std::shared_ptr<Details::HierarchicalDistributor> hand_over_distributor;
+        std::vector<Details::HandOver> hand_overs;
+    };
+    std::vector<Round> _rounds;
+    int _n_setups = 0;
+
+    double _max_imbalance;
+    std::vector<int> _query_loads;
+    // Copies of the local trees of other processes, by rank.
+    std::map<int, BVH<DeviceType>> _replicas;
+    // Pairs (owner, holder) of the copies of the local trees, the same on all
+    // the processes.
+    std::set<std::pair<int, int>> _replicated;
+
+    bool _aggregate_by_node;
+    // Lowest rank on the node of every process, detected when the
+    // communication is first set up.
+    std::vector<int> _node_leaders;
+};
+
+/** \brief Distribution of the objects of a DistributedSearchTree among the
+ *  processes.
+ *
+ *  With ZOrderCurve, the objects are moved to the processes that own their
+ *  part of the Z-order curve, with about as many objects on every process,
+ *  before the trees are built.  This helps when the bounds of the processes
+ *  overlap a lot (e.g. the decomposition suits the solver but not the
+ *  search), since the queries are then sent to fewer processes.  The results
+ *  still refer to the process that owns the object and the index given to
+ *  the constructor.  The processes that find the objects look these up
+ *  before sending the results back.
+ */
+enum class Partitioning
+{
+    AsGiven,
+    ZOrderCurve
+};
+
 template <typename DeviceType>
 class DistributedSearchTree
 {
   public:
+    /** \brief Builds the local trees and the tree of the process bounds.
+     *
+     *  \param[in] n_boxes_per_rank Number of boxes that summarize the objects
+     *  of each process in the top-level tree.  With more than one box, the
+     *  objects are split into clusters that are consecutive along the Z-order
+     *  curve and every cluster gets its own box.  These fit partitions that
+     *  are not convex (e.g. L-shaped) more tightly, and fewer queries are sent
+     *  to processes that have nothing to return.
+     *  \param[in] partitioning Whether the objects stay on the processes
+     *  that passed them or are repartitioned before building the trees.
+     */
     DistributedSearchTree(
         Teuchos::RCP<Teuchos::Comm<int> const> comm,
-        Kokkos::View<Box const *, DeviceType> bounding_boxes );
+        Kokkos::View<Box const *, DeviceType> bounding_boxes,
+        int n_boxes_per_rank = 1,
+        Partitioning partitioning = Partitioning::AsGiven );
 
     /** \brief Finds object satisfying the passed predicates (e.g. nearest to
      *  some point or overlaping with some box)
@@ -74,10 +212,40 @@ class DistributedSearchTree
            Kokkos::View<int *, DeviceType> &ranks,
            Kokkos::View<double *, DeviceType> &distances ) const;
 
+    /** \brief Same as above but reuses the communication plan of a previous
+     *  batch of queries when possible.
+     *
+     *  \param[in,out] plan Plan that was used by the previous calls.  It is
+     *  updated if the queries need to be sent to other processes.
+     */
+    template <typename Query>
+    void query( Kokkos::View<Query *, DeviceType> queries,
+                Kokkos::View<int *, DeviceType> &indices,
+                Kokkos::View<int *, DeviceType> &offset,
+                Kokkos::View<int *, DeviceType> &ranks,
+                DistributedQueryPlan<DeviceType> &plan ) const;
+
+    template <typename Query>
+    typename std::enable_if<
+        std::is_same<typename Query::Tag, Details::NearestPredicateTag>::value,
+        void>::type
+    query( Kokkos::View<Query *, DeviceType> queries,
+           Kokkos::View<int *, DeviceType> &indices,
+           Kokkos::View<int *, DeviceType> &offset,
+           Kokkos::View<int *, DeviceType> &ranks,
+           Kokkos::View<double *, DeviceType> &distances,
+           DistributedQueryPlan<DeviceType> &plan ) const;
+
   private:
     Teuchos::RCP<Teuchos::Comm<int> const> _comm;
     BVH<DeviceType> _local_tree;
     std::shared_ptr<BVH<DeviceType>> _distributed_tree;
+    // Rank of the process each leaf of the distributed tree belongs to.
+    Kokkos::View<int *, DeviceType> _box_ranks;
+    // Where the objects of the local tree come from when they were moved.
+    bool _repartitioned;
+    Kokkos::View<int *, DeviceType> _original_ranks;
+    Kokkos::View<int *, DeviceType> _original_indices;
 };
 
 template <typename DeviceType>
@@ -90,8 +258,8 @@ void DistributedSearchTree<DeviceType>::query(
 {
     using Tag = typename Query::Tag;
     DistributedSearchTreeImpl<DeviceType>::queryDispatch(
-        _comm, *_distributed_tree, _local_tree, queries, indices, offset, ranks,
-        Tag{} );
+        _comm, *_distributed_tree, _box_ranks, _local_tree, _original_ranks,
+        _original_indices, queries, indices, offset, ranks, Tag{} );
 }
 
 template <typename DeviceType>
@@ -108,8 +276,44 @@ DistributedSearchTree<DeviceType>::query(
 {
     using Tag = typename Query::Tag;
     DistributedSearchTreeImpl<DeviceType>::queryDispatch(
-        _comm, *_distributed_tree, _local_tree, queries, indices, offset, ranks,
-        Tag{}, &distances );
+        _comm, *_distributed_tree, _box_ranks, _local_tree, _original_ranks,
+        _original_indices, queries, indices, offset, ranks, Tag{},
+        nullptr, &distances );
+}
+
+template <typename DeviceType>
+template <typename Query>
+void DistributedSearchTree<DeviceType>::query(
+    Kokkos::View<Query *, DeviceType> queries,
+    Kokkos::View<int *, DeviceType> &indices,
+    Kokkos::View<int *, DeviceType> &offset,
+    Kokkos::View<int *, DeviceType> &ranks,
+    DistributedQueryPlan<DeviceType> &plan ) const
+{
+    using Tag = typename Query::Tag;
+    DistributedSearchTreeImpl<DeviceType>::queryDispatch(
+        _comm, *_distributed_tree, _box_ranks, _local_tree, _original_ranks,
+        _original_indices, queries, indices, offset, ranks, Tag{}, &plan );
+}
+
+template <typename DeviceType>
+template <typename Query>
+typename std::enable_if<
+    std::is_same<typename Query::Tag, Details::NearestPredicateTag>::value,
+    void>::type
+DistributedSearchTree<DeviceType>::query(
+    Kokkos::View<Query *, DeviceType> queries,
+    Kokkos::View<int *, DeviceType> &indices,
+    Kokkos::View<int *, DeviceType> &offset,
+    Kokkos::View<int *, DeviceType> &ranks,
+    Kokkos::View<double *, DeviceType> &distances,
+    DistributedQueryPlan<DeviceType> &plan ) const
+{
+    using Tag = typename Query::Tag;
+    DistributedSearchTreeImpl<DeviceType>::queryDispatch(
+        _comm, *_distributed_tree, _box_ranks, _local_tree, _original_ranks,
+        _original_indices, queries, indices, offset, ranks, Tag{},
+        &plan, &distances );
 }
 
 } // end namespace DataTransferKit
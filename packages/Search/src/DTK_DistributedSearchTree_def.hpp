@@ -10,39 +10,123 @@
 #ifndef DTK_DISTRIBUTED_SEARCH_TREE_DEF_HPP
 #define DTK_DISTRIBUTED_SEARCH_TREE_DEF_HPP
 
+#include <DTK_DetailsTreeConstruction.hpp>
+#include <details/DTK_DetailsAlgorithms.hpp>
 #include <details/DTK_DetailsBox.hpp>
 
 #include <Teuchos_Array.hpp>
 #include <Teuchos_CommHelpers.hpp>
 
+#include <algorithm>
+#include <vector>
+
 namespace DataTransferKit
 {
 
 template <typename DeviceType>
 DistributedSearchTree<DeviceType>::DistributedSearchTree(
     Teuchos::RCP<Teuchos::Comm<int> const> comm,
-    Kokkos::View<Box const *, DeviceType> bounding_boxes )
+    Kokkos::View<Box const *, DeviceType> bounding_boxes, int n_boxes_per_rank,
+    Partitioning partitioning )
     : _comm( comm )
-    , _local_tree( bounding_boxes )
+    , _repartitioned( partitioning == Partitioning::ZOrderCurve )
+    , _original_ranks( "original_ranks" )
+    , _original_indices( "original_indices" )
 {
-    int const comm_rank = _comm->getRank();
+    using ExecutionSpace = typename DeviceType::execution_space;
+
+    DTK_REQUIRE( n_boxes_per_rank > 0 );
     int const comm_size = _comm->getSize();
+    int const m = n_boxes_per_rank;
+
+    Kokkos::View<Box const *, DeviceType> owned_boxes = bounding_boxes;
+    if ( _repartitioned )
+        owned_boxes = DistributedSearchTreeImpl<DeviceType>::repartition(
+            _comm, bounding_boxes, _original_ranks, _original_indices );
+    _local_tree = BVH<DeviceType>( owned_boxes );
+
+    // Boxes that are not needed are left empty.
+    Kokkos::View<Box *, DeviceType> local_boxes( "local_boxes", m );
+    int const n = owned_boxes.extent( 0 );
+    int const n_clusters = std::min( m, n );
+    if ( n_clusters == 1 )
+    {
+        auto local_boxes_host = Kokkos::create_mirror_view( local_boxes );
+        local_boxes_host( 0 ) = _local_tree.bounds();
+        Kokkos::deep_copy( local_boxes, local_boxes_host );
+    }
+    else if ( n_clusters > 1 )
+    {
+        // Clusters are made of objects that are consecutive along the Z-order
+        // curve.
+        Box scene_bounding_box;
+        Details::TreeConstruction<DeviceType>::calculateBoundingBoxOfTheScene(
+            owned_boxes, scene_bounding_box );
+        Kokkos::View<unsigned int *, DeviceType> morton_codes( "morton", n );
+        Kokkos::View<int *, DeviceType> permutation( "permutation", n );
+        Kokkos::parallel_for(
+            REGION_NAME( "set_permutation" ),
+            Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
+            KOKKOS_LAMBDA( int i ) { permutation( i ) = i; } );
+        Kokkos::fence();
+        if ( !Details::TreeConstruction<DeviceType>::assignMortonCodes(
+                 owned_boxes, morton_codes, scene_bounding_box ) )
+            Details::TreeConstruction<DeviceType>::sortObjects( morton_codes,
+                                                                permutation );
+
+        Kokkos::parallel_for(
+            REGION_NAME( "bound_clusters" ),
+            Kokkos::RangePolicy<ExecutionSpace>( 0, n_clusters ),
+            KOKKOS_LAMBDA( int c ) {
+                int const first = static_cast<long>( c ) * n / n_clusters;
+                int const last = static_cast<long>( c + 1 ) * n / n_clusters;
+                for ( int i = first; i < last; ++i )
+                    Details::expand( local_boxes( c ),
+                                     owned_boxes( permutation( i ) ) );
+            } );
+        Kokkos::fence();
+    }
 
-    Kokkos::View<Box *, DeviceType> boxes( "rank_bounding_boxes", comm_size );
     // FIXME: I am not sure how to do the MPI allgather with Teuchos for data
     // living on the device so I copied to the host.
-    auto boxes_host = Kokkos::create_mirror_view( boxes );
-    boxes_host( comm_rank ) = _local_tree.bounds();
-
-    Teuchos::Array<double> bounds( 6 * comm_size );
-    Teuchos::gatherAll( *_comm, 6,
-                        reinterpret_cast<double *>( &boxes_host( comm_rank ) ),
-                        6 * comm_size, bounds.getRawPtr() );
-    for ( int i = 0; i < comm_size; ++i )
-        boxes_host( i ) = Box( &( bounds[6 * i] ) );
-    Kokkos::deep_copy( boxes, boxes_host );
-
-    _distributed_tree = std::make_shared<BVH<DeviceType>>( boxes );
+    auto local_boxes_host = Kokkos::create_mirror_view( local_boxes );
+    Kokkos::deep_copy( local_boxes_host, local_boxes );
+    Teuchos::Array<double> bounds( 6 * m * comm_size );
+    Teuchos::gatherAll( *_comm, 6 * m,
+                        reinterpret_cast<double *>( local_boxes_host.data() ),
+                        6 * m * comm_size, bounds.getRawPtr() );
+
+    // Empty boxes (processes without objects or with fewer objects than boxes)
+    // are left out of the distributed tree.
+    std::vector<Box> boxes;
+    std::vector<int> box_ranks;
+    for ( int i = 0; i < m * comm_size; ++i )
+    {
+        Box const box( &( bounds[6 * i] ) );
+        if ( box[0] <= box[1] )
+        {
+            boxes.push_back( box );
+            box_ranks.push_back( i / m );
+        }
+    }
+
+    int const n_boxes = boxes.size();
+    Kokkos::View<Box *, DeviceType> boxes_view( "rank_bounding_boxes",
+                                                n_boxes );
+    auto boxes_host = Kokkos::create_mirror_view( boxes_view );
+    _box_ranks = Kokkos::View<int *, DeviceType>( "box_ranks", n_boxes );
+    auto box_ranks_host = Kokkos::create_mirror_view( _box_ranks );
+    for ( int i = 0; i < n_boxes; ++i )
+    {
+        boxes_host( i ) = boxes[i];
+        box_ranks_host( i ) = box_ranks[i];
+    }
+    Kokkos::deep_copy( boxes_view, boxes_host );
+    Kokkos::deep_copy( _box_ranks, box_ranks_host );
+
+    // The hierarchy is always built since every query searches the top-level
+    // tree, even when there are few processes.
+    _distributed_tree = std::make_shared<BVH<DeviceType>>( boxes_view, 0 );
 }
 
 } // end namespace DataTransferKit
@@ -0,0 +1,196 @@
+/****************************************************************************
+ * Copyright (c) 2012-2017 by the DataTransferKit authors                   *
+ * All rights reserved.                                                     *
+ *                                                                          *
+ * This file is part of the DataTransferKit library. DataTransferKit is     *
+ * distributed under a BSD 3-clause license. For the licensing terms see    *
+ * the LICENSE file in the top-level directory.                             *
+ ****************************************************************************/
+
+#ifndef DTK_DYNAMIC_BVH_DECL_HPP
+#define DTK_DYNAMIC_BVH_DECL_HPP
+
+#include <Kokkos_View.hpp>
+
+#include <DTK_DetailsBox.hpp>
+#include <DTK_DetailsNode.hpp>
+#include <DTK_DetailsPredicate.hpp>
+#include <DTK_LinearBVH.hpp>
+
+#include "DTK_ConfigDefs.hpp"
+
+#include <vector>
+
+namespace DataTransferKit
+{
+
+/**
+ * Bounding volume hierarchy that supports inserting and removing objects
+ * without rebuilding it from scratch (e.g. particles entering and leaving a
+ * subdomain, or elements created by adaptive refinement).
+ *
+ * New leaves are attached next to the sibling that minimizes the increase of
+ * the surface area of the hierarchy, and tree rotations are applied on the way
+ * back to the root.  Removing a leaf collapses its parent.  The hierarchy is
+ * rebuilt from scratch with the Morton codes once its SAH cost exceeds a given
+ * factor times its cost after the last rebuild.
+ *
+ * Objects are identified by ids that do not change across updates.  Ids of
+ * removed objects are reused.
+ *
+ * \note The updates are applied serially on the host and only the nodes that
+ * were modified are copied to the device.
+ */
+template <typename DeviceType>
+class DynamicBVH
+{
+  public:
+    /** \brief Default ratio of the SAH cost over its value after the last
+     *  rebuild beyond which the hierarchy is rebuilt.
+     */
+    static double constexpr default_rebuild_factor = 1.5;
+
+    /** \brief Builds the hierarchy over the bounding boxes of the objects.
+     *
+     *  Object \c i gets id \c i.
+     */
+    DynamicBVH( Kokkos::View<Box const *, DeviceType> bounding_boxes,
+                double rebuild_factor = default_rebuild_factor );
+
+    /** \brief Adds objects to the hierarchy.
+     *
+     *  \param[in] bounding_boxes Bounding boxes of the new objects.
+     *  \param[out] ids Ids assigned to the new objects.
+     */
+    // Views are passed by reference here because internally Kokkos::realloc()
+    // is called.
+    void insert( Kokkos::View<Box const *, DeviceType> bounding_boxes,
+                 Kokkos::View<int *, DeviceType> &ids );
+
+    /** \brief Removes objects from the hierarchy.
+     *
+     *  \param[in] ids Ids of the objects to remove.  They must be distinct.
+     *  An exception is thrown, and nothing is removed, if one of them does
+     *  not refer to an object in the hierarchy.
+     */
+    void remove( Kokkos::View<int const *, DeviceType> ids );
+
+    /** \brief Same as BVH::query().  Results refer to object ids.
+     */
+    template <typename Query>
+    void query( Kokkos::View<Query *, DeviceType> queries,
+                Kokkos::View<int *, DeviceType> &indices,
+                Kokkos::View<int *, DeviceType> &offset ) const
+    {
+        _bvh.query( queries, indices, offset );
+    }
+
+    template <typename Query>
+    typename std::enable_if<
+        std::is_same<typename Query::Tag, Details::NearestPredicateTag>::value,
+        void>::type
+    query( Kokkos::View<Query *, DeviceType> queries,
+           Kokkos::View<int *, DeviceType> &indices,
+           Kokkos::View<int *, DeviceType> &offset,
+           Kokkos::View<double *, DeviceType> &distances ) const
+    {
+        _bvh.query( queries, indices, offset, distances );
+    }
+
+    /** \brief Number of objects in the hierarchy.
+     */
+    int size() const { return _n; }
+
+    bool empty() const { return size() == 0; }
+
+    Box bounds() const;
+
+    /** \brief Same as BVH::sahCost() but maintained as the hierarchy is
+     *  updated.
+     */
+    double sahCost() const;
+
+    /** \brief Number of times the hierarchy was built from scratch, including
+     *  the construction unless there were no objects.
+     */
+    int numberOfRebuilds() const { return _n_rebuilds; }
+
+    /** \brief Hierarchy over the current objects.
+     *
+     *  \note The returned object does not own its data and is invalidated by
+     *  the next update.
+     */
+    BVH<DeviceType> const &bvh() const { return _bvh; }
+
+  private:
+    using HostNodes = typename Kokkos::View<Node *, DeviceType>::HostMirror;
+    using HostIndices = typename Kokkos::View<int *, DeviceType>::HostMirror;
+
+    // Builds a new hierarchy over the current objects and the new ones, and
+    // copies it into arrays that can hold up to capacity leaves.
+    void rebuild( int capacity, std::vector<Box> const &new_boxes = {},
+                  std::vector<int> const &new_ids = {} );
+    void rebuildIfDegraded();
+    // Copies the modified nodes to the device and updates the views of _bvh.
+    void upload();
+    // Copies the positions [range[0], range[1]) of src into dst and resets the
+    // range.
+    template <typename DstView, typename SrcView>
+    static void copyRange( DstView dst, SrcView src, int *range );
+
+    void insertLeaf( Box const &box, int id );
+    void removeLeaf( int id );
+    // Recomputes the bounding boxes and applies rotations from node up to the
+    // root.
+    void refit( Node *node );
+    void rotate( Node *node );
+    void moveInternalNode( int from, int to );
+    void moveLeafNode( int from, int to );
+
+    // The nodes are identified by their address in device memory and their
+    // host copies are accessed through the following helpers.
+    Node *leafNode( int i ) const { return _leaf_nodes.data() + i; }
+    Node *internalNode( int i ) const { return _internal_nodes.data() + i; }
+    bool isLeaf( Node const *node ) const
+    {
+        return node >= _leaf_nodes.data() &&
+               node < _leaf_nodes.data() + _leaf_nodes.extent( 0 );
+    }
+    Node &host( Node const *node );
+    Node const &host( Node const *node ) const;
+    Node *root() const;
+    void replaceChild( Node *parent, Node *old_child, Node *new_child );
+    void setBoundingBox( Node *node, Box const &box );
+    void touch( Node const *node );
+
+    double _rebuild_factor;
+    int _n;
+    int _n_rebuilds;
+    // Sum of the surface areas of all the nodes and SAH cost right after the
+    // last rebuild.
+    double _area_sum;
+    double _reference_cost;
+
+    // Node arrays allocated for the capacity.  The first _n leaves and _n - 1
+    // internal nodes are in use, the root being the first internal node.
+    Kokkos::View<Node *, DeviceType> _leaf_nodes;
+    Kokkos::View<Node *, DeviceType> _internal_nodes;
+    Kokkos::View<int *, DeviceType> _indices;
+    HostNodes _leaf_nodes_host;
+    HostNodes _internal_nodes_host;
+    HostIndices _indices_host;
+    // Ranges of positions [first, last) modified since the last upload.
+    int _dirty_leaves[2];
+    int _dirty_internal_nodes[2];
+
+    // Position of the leaf of each object id, -1 when the id is not in use.
+    std::vector<int> _leaf_positions;
+    std::vector<int> _free_ids;
+
+    // Views of the arrays above restricted to the nodes in use.
+    BVH<DeviceType> _bvh;
+};
+
+} // end namespace DataTransferKit
+
+#endif
@@ -0,0 +1,575 @@
+/****************************************************************************
+ * Copyright (c) 2012-2017 by the DataTransferKit authors                   *
+ * All rights reserved.                                                     *
+ *                                                                          *
+ * This file is part of the DataTransferKit library. DataTransferKit is     *
+ * distributed under a BSD 3-clause license. For the licensing terms see    *
+ * the LICENSE file in the top-level directory.                             *
+ ****************************************************************************/
+
+#ifndef DTK_DYNAMIC_BVH_DEF_HPP
+#define DTK_DYNAMIC_BVH_DEF_HPP
+
+#include "DTK_ConfigDefs.hpp"
+
+#include <DTK_DBC.hpp>
+#include <DTK_DetailsAlgorithms.hpp>
+#include <DTK_DetailsTreeSerialization.hpp>
+
+#include <algorithm>
+#include <vector>
+
+namespace DataTransferKit
+{
+
+template <typename DeviceType>
+DynamicBVH<DeviceType>::DynamicBVH(
+    Kokkos::View<Box const *, DeviceType> bounding_boxes,
+    double rebuild_factor )
+    : _rebuild_factor( rebuild_factor )
+    , _n( 0 )
+    , _n_rebuilds( 0 )
+    , _area_sum( 0. )
+    , _reference_cost( 0. )
+    , _dirty_leaves{0, 0}
+    , _dirty_internal_nodes{0, 0}
+{
+    DTK_REQUIRE( rebuild_factor >= 1. );
+    Kokkos::View<int *, DeviceType> ids( "ids" );
+    insert( bounding_boxes, ids );
+}
+
+template <typename DeviceType>
+Node &DynamicBVH<DeviceType>::host( Node const *node )
+{
+    if ( isLeaf( node ) )
+        return _leaf_nodes_host( node - _leaf_nodes.data() );
+    return _internal_nodes_host( node - _internal_nodes.data() );
+}
+
+template <typename DeviceType>
+Node const &DynamicBVH<DeviceType>::host( Node const *node ) const
+{
+    if ( isLeaf( node ) )
+        return _leaf_nodes_host( node - _leaf_nodes.data() );
+    return _internal_nodes_host( node - _internal_nodes.data() );
+}
+
+template <typename DeviceType>
+Node *DynamicBVH<DeviceType>::root() const
+{
+    if ( _n == 0 )
+        return nullptr;
+    return _n > 1 ? internalNode( 0 ) : leafNode( 0 );
+}
+
+template <typename DeviceType>
+Box DynamicBVH<DeviceType>::bounds() const
+{
+    if ( empty() )
+        return Box();
+    return host( root() ).bounding_box;
+}
+
+template <typename DeviceType>
+double DynamicBVH<DeviceType>::sahCost() const
+{
+    if ( empty() )
+        return 0.;
+    double const root_area = Details::surfaceArea( bounds() );
+    if ( root_area == 0. )
+        return 2 * _n - 1;
+    return _area_sum / root_area;
+}
+
+template <typename DeviceType>
+void DynamicBVH<DeviceType>::touch( Node const *node )
+{
+    int *range = _dirty_internal_nodes;
+    int position = node - _internal_nodes.data();
+    if ( isLeaf( node ) )
+    {
+        range = _dirty_leaves;
+        position = node - _leaf_nodes.data();
+    }
+    if ( range[0] == range[1] )
+    {
+        range[0] = position;
+        range[1] = position + 1;
+    }
+    else
+    {
+        range[0] = std::min( range[0], position );
+        range[1] = std::max( range[1], position + 1 );
+    }
+}
+
+template <typename DeviceType>
+void DynamicBVH<DeviceType>::setBoundingBox( Node *node, Box const &box )
+{
+    Node &node_host = host( node );
+    _area_sum += Details::surfaceArea( box ) -
+                 Details::surfaceArea( node_host.bounding_box );
+    node_host.bounding_box = box;
+    touch( node );
+}
+
+template <typename DeviceType>
+void DynamicBVH<DeviceType>::replaceChild( Node *parent, Node *old_child,
+                                           Node *new_child )
+{
+    Node &parent_host = host( parent );
+    if ( parent_host.children.first == old_child )
+        parent_host.children.first = new_child;
+    else
+        parent_host.children.second = new_child;
+    touch( parent );
+}
+
+template <typename DeviceType>
+void DynamicBVH<DeviceType>::moveInternalNode( int from, int to )
+{
+    Node *node = internalNode( to );
+    Node &node_host = _internal_nodes_host( to );
+    node_host = _internal_nodes_host( from );
+    if ( node_host.parent != nullptr )
+        replaceChild( node_host.parent, internalNode( from ), node );
+    host( node_host.children.first ).parent = node;
+    host( node_host.children.second ).parent = node;
+    touch( node );
+    touch( node_host.children.first );
+    touch( node_host.children.second );
+}
+
+template <typename DeviceType>
+void DynamicBVH<DeviceType>::moveLeafNode( int from, int to )
+{
+    Node *node = leafNode( to );
+    Node &node_host = _leaf_nodes_host( to );
+    node_host = _leaf_nodes_host( from );
+    if ( node_host.parent != nullptr )
+        replaceChild( node_host.parent, leafNode( from ), node );
+    _indices_host( to ) = _indices_host( from );
+    _leaf_positions[_indices_host( to )] = to;
+    touch( node );
+}
+
+// Swaps a child of the node with a child of its other child when this
+// reduces the surface area of the latter.  The bounding box of the node
+// itself does not change.
+template <typename DeviceType>
+void DynamicBVH<DeviceType>::rotate( Node *node )
+{
+    Node const &node_host = host( node );
+    Node *children[2] = {node_host.children.first, node_host.children.second};
+    double best_gain = 0.;
+    Node *x = nullptr;
+    Node *y = nullptr;
+    for ( int i = 0; i < 2; ++i )
+    {
+        Node *child = children[i];
+        Node *other = children[1 - i];
+        if ( isLeaf( other ) )
+            continue;
+        Node const &other_host = host( other );
+        double const area = Details::surfaceArea( other_host.bounding_box );
+        Node *grandchildren[2] = {other_host.children.first,
+                                  other_host.children.second};
+        for ( int j = 0; j < 2; ++j )
+        {
+            // child takes the place of grandchildren[j]
+            Box box = host( child ).bounding_box;
+            Details::expand( box, host( grandchildren[1 - j] ).bounding_box );
+            double const gain = area - Details::surfaceArea( box );
+            if ( gain > best_gain )
+            {
+                best_gain = gain;
+                x = child;
+                y = grandchildren[j];
+            }
+        }
+    }
+    if ( x == nullptr )
+        return;
+
+    Node *z = host( y ).parent;
+    replaceChild( node, x, y );
+    replaceChild( z, y, x );
+    host( x ).parent = z;
+    host( y ).parent = node;
+    touch( x );
+    touch( y );
+    Node const &z_host = host( z );
+    Box box = host( z_host.children.first ).bounding_box;
+    Details::expand( box, host( z_host.children.second ).bounding_box );
+    setBoundingBox( z, box );
+}
+
+template <typename DeviceType>
+void DynamicBVH<DeviceType>::refit( Node *node )
+{
+    while ( node != nullptr )
+    {
+        Node const &node_host = host( node );
+        Box box = host( node_host.children.first ).bounding_box;
+        Details::expand( box, host( node_host.children.second ).bounding_box );
+        setBoundingBox( node, box );
+        rotate( node );
+        node = node_host.parent;
+    }
+}
+
+template <typename DeviceType>
+void DynamicBVH<DeviceType>::insertLeaf( Box const &box, int id )
+{
+    int const n_internal_nodes = std::max( _n - 1, 0 );
+    Node *sibling = root();
+
+    Node *leaf = leafNode( _n );
+    Node &leaf_host = _leaf_nodes_host( _n );
+    leaf_host = Node();
+    setBoundingBox( leaf, box );
+    _indices_host( _n ) = id;
+    _leaf_positions[id] = _n;
+    ++_n;
+    if ( sibling == nullptr )
+        return;
+
+    // Descend towards the sibling that minimizes the increase of the surface
+    // area of the hierarchy.  Making a node the sibling of the new leaf costs
+    // the area of their union, and all its ancestors grow to contain the
+    // leaf.
+    double const leaf_area = Details::surfaceArea( box );
+    double inherited_cost = 0.;
+    while ( !isLeaf( sibling ) )
+    {
+        Node const &sibling_host = host( sibling );
+        Box combined = sibling_host.bounding_box;
+        Details::expand( combined, box );
+        double const combined_area = Details::surfaceArea( combined );
+        double const cost = inherited_cost + combined_area;
+        inherited_cost +=
+            combined_area - Details::surfaceArea( sibling_host.bounding_box );
+
+        Node *children[2] = {sibling_host.children.first,
+                             sibling_host.children.second};
+        double child_costs[2];
+        for ( int i = 0; i < 2; ++i )
+        {
+            Box const &child_box = host( children[i] ).bounding_box;
+            Box child_combined = child_box;
+            Details::expand( child_combined, box );
+            child_costs[i] = inherited_cost +
+                             Details::surfaceArea( child_combined ) +
+                             ( isLeaf( children[i] )
+                                   ? 0.
+                                   : -Details::surfaceArea( child_box ) );
+            // lower bound for the subtrees below
+            if ( !isLeaf( children[i] ) )
+                child_costs[i] += leaf_area;
+        }
+        if ( cost <= child_costs[0] && cost <= child_costs[1] )
+            break;
+        sibling = children[child_costs[0] <= child_costs[1] ? 0 : 1];
+    }
+
+    // The root must remain the first internal node.
+    Node *parent = host( sibling ).parent;
+    Node *new_node = internalNode( n_internal_nodes );
+    if ( parent == nullptr )
+    {
+        if ( !isLeaf( sibling ) )
+        {
+            moveInternalNode( 0, n_internal_nodes );
+            sibling = internalNode( n_internal_nodes );
+        }
+        new_node = internalNode( 0 );
+    }
+    Node &new_node_host = host( new_node );
+    new_node_host = Node();
+    new_node_host.parent = parent;
+    new_node_host.children.first = sibling;
+    new_node_host.children.second = leaf;
+    Box combined = host( sibling ).bounding_box;
+    Details::expand( combined, box );
+    setBoundingBox( new_node, combined );
+    if ( parent != nullptr )
+        replaceChild( parent, sibling, new_node );
+    host( sibling ).parent = new_node;
+    leaf_host.parent = new_node;
+    touch( sibling );
+    touch( leaf );
+
+    refit( parent );
+}
+
+template <typename DeviceType>
+void DynamicBVH<DeviceType>::removeLeaf( int id )
+{
+    DTK_REQUIRE( id >= 0 && id < static_cast<int>( _leaf_positions.size() ) &&
+                 _leaf_positions[id] != -1 );
+    int const position = _leaf_positions[id];
+    Node *leaf = leafNode( position );
+    _area_sum -= Details::surfaceArea( host( leaf ).bounding_box );
+    _leaf_positions[id] = -1;
+    _free_ids.push_back( id );
+
+    if ( _n > 1 )
+    {
+        Node *parent = host( leaf ).parent;
+        Node const &parent_host = host( parent );
+        Node *sibling = ( parent_host.children.first == leaf
+                              ? parent_host.children.second
+                              : parent_host.children.first );
+        Node *grandparent = parent_host.parent;
+        _area_sum -= Details::surfaceArea( parent_host.bounding_box );
+
+        // The sibling takes the place of the parent.
+        int freed_position = parent - _internal_nodes.data();
+        host( sibling ).parent = grandparent;
+        touch( sibling );
+        if ( grandparent == nullptr )
+        {
+            if ( !isLeaf( sibling ) )
+            {
+                freed_position = sibling - _internal_nodes.data();
+                moveInternalNode( freed_position, 0 );
+            }
+        }
+        else
+        {
+            replaceChild( grandparent, parent, sibling );
+            refit( grandparent );
+        }
+
+        int const last_internal_node = _n - 2;
+        if ( freed_position != last_internal_node )
+            moveInternalNode( last_internal_node, freed_position );
+    }
+
+    int const last_leaf = _n - 1;
+    if ( position != last_leaf )
+        moveLeafNode( last_leaf, position );
+    --_n;
+}
+
+template <typename DeviceType>
+void DynamicBVH<DeviceType>::rebuild( int capacity,
+                                      std::vector<Box> const &new_boxes,
+                                      std::vector<int> const &new_ids )
+{
+    using ExecutionSpace = typename DeviceType::execution_space;
+
+    // Keep room for the root even when there is a single leaf.
+    capacity = std::max( capacity, 2 );
+    int const n = _n + new_boxes.size();
+    DTK_REQUIRE( n <= capacity );
+
+    Kokkos::View<Box *, DeviceType> bounding_boxes( "bounding_boxes", n );
+    Kokkos::View<int *, DeviceType> ids( "ids", n );
+    auto bounding_boxes_host = Kokkos::create_mirror_view( bounding_boxes );
+    auto ids_host = Kokkos::create_mirror_view( ids );
+    for ( int i = 0; i < _n; ++i )
+    {
+        bounding_boxes_host( i ) = _leaf_nodes_host( i ).bounding_box;
+        ids_host( i ) = _indices_host( i );
+    }
+    for ( int i = _n; i < n; ++i )
+    {
+        bounding_boxes_host( i ) = new_boxes[i - _n];
+        ids_host( i ) = new_ids[i - _n];
+    }
+    Kokkos::deep_copy( bounding_boxes, bounding_boxes_host );
+    Kokkos::deep_copy( ids, ids_host );
+
+    // Always build the hierarchy, the updates need one.
+    BVH<DeviceType> bvh( bounding_boxes, 0 );
+
+    if ( capacity != static_cast<int>( _leaf_nodes.extent( 0 ) ) )
+    {
+        _leaf_nodes =
+            Kokkos::View<Node *, DeviceType>( "leaf_nodes", capacity );
+        _internal_nodes = Kokkos::View<Node *, DeviceType>( "internal_nodes",
+                                                            capacity - 1 );
+        _indices = Kokkos::View<int *, DeviceType>( "ids", capacity );
+        _leaf_nodes_host = Kokkos::create_mirror_view( _leaf_nodes );
+        _internal_nodes_host = Kokkos::create_mirror_view( _internal_nodes );
+        _indices_host = Kokkos::create_mirror_view( _indices );
+    }
+
+    // The nodes keep their positions, only the pointers are rebased.
+    using TreeSerialization = Details::TreeSerialization<DeviceType>;
+    Kokkos::View<Node *, DeviceType> leaf_nodes = _leaf_nodes;
+    Kokkos::View<Node *, DeviceType> internal_nodes = _internal_nodes;
+    Kokkos::View<int *, DeviceType> indices = _indices;
+    Kokkos::View<Node *, DeviceType> bvh_leaf_nodes = bvh._leaf_nodes;
+    Kokkos::View<Node *, DeviceType> bvh_internal_nodes = bvh._internal_nodes;
+    Kokkos::View<int *, DeviceType> bvh_indices = bvh._indices;
+    int const n_internal_nodes = bvh_internal_nodes.extent( 0 );
+    Kokkos::parallel_for(
+        REGION_NAME( "copy_rebuilt_hierarchy" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_internal_nodes + n ),
+        KOKKOS_LAMBDA( int i ) {
+            bool const is_leaf = ( i >= n_internal_nodes );
+            Node const &node =
+                ( is_leaf ? bvh_leaf_nodes( i - n_internal_nodes )
+                          : bvh_internal_nodes( i ) );
+            Node &copy = ( is_leaf ? leaf_nodes( i - n_internal_nodes )
+                                   : internal_nodes( i ) );
+            Node *const links[3] = {node.parent, node.children.first,
+                                    node.children.second};
+            Node *rebased_links[3];
+            for ( int j = 0; j < 3; ++j )
+                rebased_links[j] = TreeSerialization::decode(
+                    TreeSerialization::encode(
+                        links[j], bvh_internal_nodes.data(), n_internal_nodes,
+                        bvh_leaf_nodes.data() ),
+                    internal_nodes.data(), n_internal_nodes,
+                    leaf_nodes.data() );
+            copy.bounding_box = node.bounding_box;
+            copy.parent = rebased_links[0];
+            copy.children.first = rebased_links[1];
+            copy.children.second = rebased_links[2];
+            if ( is_leaf )
+                indices( i - n_internal_nodes ) =
+                    ids( bvh_indices( i - n_internal_nodes ) );
+        } );
+    Kokkos::fence();
+
+    Kokkos::deep_copy( _leaf_nodes_host, _leaf_nodes );
+    Kokkos::deep_copy( _internal_nodes_host, _internal_nodes );
+    Kokkos::deep_copy( _indices_host, _indices );
+    _dirty_leaves[0] = _dirty_leaves[1] = 0;
+    _dirty_internal_nodes[0] = _dirty_internal_nodes[1] = 0;
+
+    _n = n;
+    _area_sum = 0.;
+    for ( int i = 0; i < n; ++i )
+    {
+        _leaf_positions[_indices_host( i )] = i;
+        _area_sum += Details::surfaceArea( _leaf_nodes_host( i ).bounding_box );
+    }
+    for ( int i = 0; i < n_internal_nodes; ++i )
+        _area_sum +=
+            Details::surfaceArea( _internal_nodes_host( i ).bounding_box );
+    _reference_cost = sahCost();
+    ++_n_rebuilds;
+}
+
+template <typename DeviceType>
+void DynamicBVH<DeviceType>::rebuildIfDegraded()
+{
+    if ( sahCost() > _rebuild_factor * _reference_cost )
+        rebuild( _leaf_nodes.extent( 0 ) );
+}
+
+template <typename DeviceType>
+template <typename DstView, typename SrcView>
+void DynamicBVH<DeviceType>::copyRange( DstView dst, SrcView src, int *range )
+{
+    if ( range[0] == range[1] )
+        return;
+    auto const r = Kokkos::make_pair( range[0], range[1] );
+    Kokkos::deep_copy( Kokkos::subview( dst, r ), Kokkos::subview( src, r ) );
+    range[0] = range[1] = 0;
+}
+
+template <typename DeviceType>
+void DynamicBVH<DeviceType>::upload()
+{
+    int dirty_indices[2] = {_dirty_leaves[0], _dirty_leaves[1]};
+    copyRange( _leaf_nodes, _leaf_nodes_host, _dirty_leaves );
+    copyRange( _indices, _indices_host, dirty_indices );
+    copyRange( _internal_nodes, _internal_nodes_host, _dirty_internal_nodes );
+
+    // Views constructed from raw pointers do not own the data.
+    _bvh._brute_force = false;
+    _bvh._leaf_nodes =
+        Kokkos::View<Node *, DeviceType>( _leaf_nodes.data(), _n );
+    _bvh._internal_nodes = Kokkos::View<Node *, DeviceType>(
+        _internal_nodes.data(), std::max( _n - 1, 0 ) );
+    _bvh._indices = Kokkos::View<int *, DeviceType>( _indices.data(), _n );
+    _bvh._leaf_positions = Kokkos::View<int *, DeviceType>();
+}
+
+template <typename DeviceType>
+void DynamicBVH<DeviceType>::insert(
+    Kokkos::View<Box const *, DeviceType> bounding_boxes,
+    Kokkos::View<int *, DeviceType> &ids )
+{
+    int const n = bounding_boxes.extent( 0 );
+    // The mirror of a view of const data cannot be written to.
+    typename Kokkos::View<Box *, DeviceType>::HostMirror bounding_boxes_host(
+        "bounding_boxes", n );
+    Kokkos::deep_copy( bounding_boxes_host, bounding_boxes );
+
+    Kokkos::realloc( ids, n );
+    auto ids_host = Kokkos::create_mirror_view( ids );
+    for ( int i = 0; i < n; ++i )
+    {
+        if ( _free_ids.empty() )
+        {
+            ids_host( i ) = _leaf_positions.size();
+            _leaf_positions.push_back( -1 );
+        }
+        else
+        {
+            ids_host( i ) = _free_ids.back();
+            _free_ids.pop_back();
+        }
+    }
+    Kokkos::deep_copy( ids, ids_host );
+
+    // Inserting a batch larger than the hierarchy one object at a time is
+    // not worth it, the hierarchy is rebuilt over all the objects instead.
+    // The capacity grows geometrically.
+    int const capacity = _leaf_nodes.extent( 0 );
+    if ( n > _n )
+    {
+        std::vector<Box> new_boxes( bounding_boxes_host.data(),
+                                    bounding_boxes_host.data() + n );
+        std::vector<int> new_ids( ids_host.data(), ids_host.data() + n );
+        rebuild( std::max( capacity, 2 * ( _n + n ) ), new_boxes, new_ids );
+    }
+    else
+    {
+        if ( _n + n > capacity )
+            rebuild( 2 * ( _n + n ) );
+        for ( int i = 0; i < n; ++i )
+            insertLeaf( bounding_boxes_host( i ), ids_host( i ) );
+        rebuildIfDegraded();
+    }
+    upload();
+}
+
+template <typename DeviceType>
+void DynamicBVH<DeviceType>::remove( Kokkos::View<int const *, DeviceType> ids )
+{
+    int const n = ids.extent( 0 );
+    HostIndices ids_host( "ids", n );
+    Kokkos::deep_copy( ids_host, ids );
+    // The ids are all checked before anything is removed so that the
+    // hierarchy is left untouched when one of them is invalid.
+    int const n_ids = _leaf_positions.size();
+    std::vector<bool> removed( n_ids, false );
+    for ( int i = 0; i < n; ++i )
+    {
+        int const id = ids_host( i );
+        DTK_INSIST( id >= 0 && id < n_ids && _leaf_positions[id] != -1 &&
+                    !removed[id] );
+        removed[id] = true;
+    }
+    for ( int i = 0; i < n; ++i )
+        removeLeaf( ids_host( i ) );
+    if ( !empty() )
+        rebuildIfDegraded();
+    upload();
+}
+
+} // end namespace DataTransferKit
+
+// Explicit instantiation macro
+#define DTK_DYNAMIC_BVH_INSTANT( NODE )                                        \
+    template class DynamicBVH<typename NODE::device_type>;
+
+#endif
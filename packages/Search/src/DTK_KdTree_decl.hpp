@@ -0,0 +1,110 @@
+/****************************************************************************
+ * Copyright (c) 2012-2017 by the DataTransferKit authors                   *
+ * All rights reserved.                                                     *
+ *                                                                          *
+ * This file is part of the DataTransferKit library. DataTransferKit is     *
+ * distributed under a BSD 3-clause license. For the licensing terms see    *
+ * the LICENSE file in the top-level directory.                             *
+ ****************************************************************************/
+
+#ifndef DTK_KDTREE_DECL_HPP
+#define DTK_KDTREE_DECL_HPP
+
+#include <Kokkos_View.hpp>
+
+#include <DTK_DetailsBox.hpp>
+#include <DTK_DetailsKdTreeTraversal.hpp>
+#include <DTK_DetailsPoint.hpp>
+#include <DTK_DetailsPredicate.hpp>
+#include <DTK_DetailsQueryDispatch.hpp>
+
+#include "DTK_ConfigDefs.hpp"
+
+namespace DataTransferKit
+{
+
+/**
+ * Kd-tree for point clouds.  Unlike the BVH, which stores a bounding box for
+ * every leaf and internal node, the tree is implicit: the coordinates of the
+ * points are stored in structure-of-arrays form, permuted so that each point
+ * is the median of its subtree along the split dimension.  It provides the
+ * same query interface as BVH, except that points do not hold tags and
+ * predicates that carry a mask are rejected.
+ *
+ * The tree is built on the device, one level at a time.  The points are
+ * sorted along every dimension once, and all the subtrees of a level are
+ * then split in parallel, for O(n log n) operations overall.
+ */
+template <typename DeviceType>
+class KdTree
+{
+  public:
+    KdTree( Kokkos::View<Point const *, DeviceType> points );
+
+    // Views are passed by reference here because internally Kokkos::realloc()
+    // is called.
+    template <typename Query>
+    void query( Kokkos::View<Query *, DeviceType> queries,
+                Kokkos::View<int *, DeviceType> &indices,
+                Kokkos::View<int *, DeviceType> &offset ) const;
+    template <typename Query>
+    typename std::enable_if<
+        std::is_same<typename Query::Tag, Details::NearestPredicateTag>::value,
+        void>::type
+    query( Kokkos::View<Query *, DeviceType> queries,
+           Kokkos::View<int *, DeviceType> &indices,
+           Kokkos::View<int *, DeviceType> &offset,
+           Kokkos::View<double *, DeviceType> &distances ) const;
+
+    KOKKOS_INLINE_FUNCTION
+    Box bounds() const { return _bounds; }
+
+    using SizeType = typename Kokkos::View<int *, DeviceType>::size_type;
+    KOKKOS_INLINE_FUNCTION
+    SizeType size() const { return _indices.extent( 0 ); }
+
+    KOKKOS_INLINE_FUNCTION
+    bool empty() const { return size() == 0; }
+
+  private:
+    friend struct Details::KdTreeTraversal<DeviceType>;
+
+    Box _bounds;
+    Kokkos::View<double * [3], Kokkos::LayoutLeft, DeviceType> _coordinates;
+    /**
+     * Original indices of the points and dimension along which the subtree
+     * rooted at each point is split.
+     */
+    Kokkos::View<int *, DeviceType> _indices;
+    Kokkos::View<unsigned char *, DeviceType> _split_dimensions;
+};
+
+template <typename DeviceType>
+template <typename Query>
+void KdTree<DeviceType>::query( Kokkos::View<Query *, DeviceType> queries,
+                                Kokkos::View<int *, DeviceType> &indices,
+                                Kokkos::View<int *, DeviceType> &offset ) const
+{
+    using Tag = typename Query::Tag;
+    Details::queryDispatch<Details::KdTreeTraversal<DeviceType>>(
+        *this, queries, indices, offset, Tag{} );
+}
+
+template <typename DeviceType>
+template <typename Query>
+typename std::enable_if<
+    std::is_same<typename Query::Tag, Details::NearestPredicateTag>::value,
+    void>::type
+KdTree<DeviceType>::query( Kokkos::View<Query *, DeviceType> queries,
+                           Kokkos::View<int *, DeviceType> &indices,
+                           Kokkos::View<int *, DeviceType> &offset,
+                           Kokkos::View<double *, DeviceType> &distances ) const
+{
+    using Tag = typename Query::Tag;
+    Details::queryDispatch<Details::KdTreeTraversal<DeviceType>>(
+        *this, queries, indices, offset, Tag{}, &distances );
+}
+
+} // end namespace DataTransferKit
+
+#endif
@@ -0,0 +1,280 @@
+/****************************************************************************
+ * Copyright (c) 2012-2017 by the DataTransferKit authors                   *
+ * All rights reserved.                                                     *
+ *                                                                          *
+ * This file is part of the DataTransferKit library. DataTransferKit is     *
+ * distributed under a BSD 3-clause license. For the licensing terms see    *
+ * the LICENSE file in the top-level directory.                             *
+ ****************************************************************************/
+
+#ifndef DTK_KDTREE_DEF_HPP
+#define DTK_KDTREE_DEF_HPP
+
+#include "DTK_ConfigDefs.hpp"
+
+#include <DTK_DetailsUtils.hpp>
+
+#include <Kokkos_Sort.hpp>
+
+#include <utility>
+
+namespace DataTransferKit
+{
+
+namespace Details
+{
+// The tree is built on the device, one level at a time.  The points are first
+// sorted along every dimension.  The positions of the points of a range
+// [begin, end) in each of the three orders are then the same range, so that
+// its extent along a dimension is given by the first and the last of its
+// points in that order, and its median along the split dimension is the point
+// at mid = (begin + end) / 2.  All the ranges of a level are split at once by
+// partitioning each order stably around the medians, which keeps both halves
+// sorted.  This amounts to O(n) work per level.
+template <typename DeviceType>
+struct KdTreeConstruction
+{
+    using ExecutionSpace = typename DeviceType::execution_space;
+
+    // order(p, d) is the point at position p along dimension d and
+    // position(i, d) is the position of the point i along dimension d.
+    // Returns the bounds of the points.
+    static Box sortPoints( Kokkos::View<Point const *, DeviceType> points,
+                           Kokkos::View<int * [3], DeviceType> order,
+                           Kokkos::View<int * [3], DeviceType> position );
+
+    static void
+    splitRanges( Kokkos::View<Point const *, DeviceType> points,
+                 Kokkos::View<int * [3], DeviceType> &order,
+                 Kokkos::View<int * [3], DeviceType> position,
+                 Kokkos::View<unsigned char *, DeviceType> split_dimensions );
+
+    static void
+    permutePoints( Kokkos::View<Point const *, DeviceType> points,
+                   Kokkos::View<int * [3], DeviceType> order,
+                   Kokkos::View<double * [3], Kokkos::LayoutLeft, DeviceType>
+                       coordinates,
+                   Kokkos::View<int *, DeviceType> indices );
+};
+
+template <typename DeviceType>
+Box KdTreeConstruction<DeviceType>::sortPoints(
+    Kokkos::View<Point const *, DeviceType> points,
+    Kokkos::View<int * [3], DeviceType> order,
+    Kokkos::View<int * [3], DeviceType> position )
+{
+    int const n = points.extent( 0 );
+    Box bounds;
+    Kokkos::View<double *, DeviceType> keys( "keys", n );
+    Kokkos::View<int *, DeviceType> ids( "ids", n );
+    using CompType = Kokkos::BinOp1D<Kokkos::View<double *, DeviceType>>;
+    for ( int d = 0; d < 3; ++d )
+    {
+        Kokkos::parallel_for( REGION_NAME( "set_keys" ),
+                              Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
+                              KOKKOS_LAMBDA( int i ) {
+                                  keys( i ) = points( i )[d];
+                                  ids( i ) = i;
+                              } );
+        Kokkos::fence();
+
+        Kokkos::Experimental::MinMaxScalar<double> result;
+        Kokkos::Experimental::MinMax<double> reducer( result );
+        Kokkos::parallel_reduce(
+            Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
+            Kokkos::Impl::min_max_functor<Kokkos::View<double *, DeviceType>>(
+                keys ),
+            reducer );
+        bounds[2 * d + 0] = result.min_val;
+        bounds[2 * d + 1] = result.max_val;
+        if ( result.min_val != result.max_val )
+        {
+            Kokkos::BinSort<Kokkos::View<double *, DeviceType>, CompType>
+                bin_sort( keys,
+                          CompType( n / 2, result.min_val, result.max_val ),
+                          true );
+            bin_sort.create_permute_vector();
+            bin_sort.sort( ids );
+        }
+
+        Kokkos::parallel_for( REGION_NAME( "set_orders" ),
+                              Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
+                              KOKKOS_LAMBDA( int p ) {
+                                  order( p, d ) = ids( p );
+                                  position( ids( p ), d ) = p;
+                              } );
+        Kokkos::fence();
+    }
+    return bounds;
+}
+
+template <typename DeviceType>
+void KdTreeConstruction<DeviceType>::splitRanges(
+    Kokkos::View<Point const *, DeviceType> points,
+    Kokkos::View<int * [3], DeviceType> &order,
+    Kokkos::View<int * [3], DeviceType> position,
+    Kokkos::View<unsigned char *, DeviceType> split_dimensions )
+{
+    int const n = points.extent( 0 );
+    // Range of the points each position belongs to.  The range is emptied
+    // once the point at that position is the root of a subtree.
+    Kokkos::View<int *, DeviceType> range_begin( "range_begin", n );
+    Kokkos::View<int *, DeviceType> range_end( "range_end", n );
+    fill( range_end, n );
+    // Side of the median of its range each point goes to: -1 for the left
+    // subtree, 1 for the right one and 0 for the median itself.
+    Kokkos::View<int *, DeviceType> sides( "sides", n );
+    Kokkos::View<int *, DeviceType> n_left( "n_left", n + 1 );
+    Kokkos::View<int *, DeviceType> n_right( "n_right", n + 1 );
+    Kokkos::View<int * [3], DeviceType> new_order( "order", n );
+    // The subtrees of a range of size s have at most s / 2 points.
+    for ( int max_size = n; max_size > 1; max_size /= 2 )
+    {
+        Kokkos::parallel_for(
+            REGION_NAME( "choose_split_dimensions" ),
+            Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
+            KOKKOS_LAMBDA( int p ) {
+                int const begin = range_begin( p );
+                int const end = range_end( p );
+                if ( p != ( begin + end ) / 2 || begin == end )
+                    return;
+                int split_dimension = 0;
+                double largest_extent = -1.;
+                for ( int d = 0; d < 3; ++d )
+                {
+                    double const extent = points( order( end - 1, d ) )[d] -
+                                          points( order( begin, d ) )[d];
+                    if ( extent > largest_extent )
+                    {
+                        split_dimension = d;
+                        largest_extent = extent;
+                    }
+                }
+                split_dimensions( p ) = split_dimension;
+            } );
+        Kokkos::fence();
+
+        Kokkos::parallel_for(
+            REGION_NAME( "find_sides_of_medians" ),
+            Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
+            KOKKOS_LAMBDA( int p ) {
+                int const begin = range_begin( p );
+                int const end = range_end( p );
+                if ( begin == end )
+                    return;
+                int const mid = ( begin + end ) / 2;
+                int const i = order( p, 0 );
+                int const q = position( i, split_dimensions( mid ) );
+                sides( i ) = ( q < mid ? -1 : ( q > mid ? 1 : 0 ) );
+            } );
+        Kokkos::fence();
+
+        for ( int d = 0; d < 3; ++d )
+        {
+            Kokkos::parallel_for(
+                REGION_NAME( "count_sides" ),
+                Kokkos::RangePolicy<ExecutionSpace>( 0, n + 1 ),
+                KOKKOS_LAMBDA( int p ) {
+                    n_left( p ) = 0;
+                    n_right( p ) = 0;
+                    if ( p == n || range_begin( p ) == range_end( p ) )
+                        return;
+                    int const side = sides( order( p, d ) );
+                    n_left( p ) = ( side < 0 ? 1 : 0 );
+                    n_right( p ) = ( side > 0 ? 1 : 0 );
+                } );
+            Kokkos::fence();
+            exclusivePrefixSum( n_left );
+            exclusivePrefixSum( n_right );
+
+            Kokkos::parallel_for(
+                REGION_NAME( "partition_around_medians" ),
+                Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
+                KOKKOS_LAMBDA( int p ) {
+                    int const begin = range_begin( p );
+                    int const end = range_end( p );
+                    int const i = order( p, d );
+                    int q = p;
+                    if ( begin != end )
+                    {
+                        int const mid = ( begin + end ) / 2;
+                        int const side = sides( i );
+                        if ( side < 0 )
+                            q = begin + n_left( p ) - n_left( begin );
+                        else if ( side > 0 )
+                            q = mid + 1 + n_right( p ) - n_right( begin );
+                        else
+                            q = mid;
+                    }
+                    new_order( q, d ) = i;
+                    position( i, d ) = q;
+                } );
+            Kokkos::fence();
+        }
+        std::swap( order, new_order );
+
+        Kokkos::parallel_for( REGION_NAME( "split_ranges" ),
+                              Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
+                              KOKKOS_LAMBDA( int p ) {
+                                  int const begin = range_begin( p );
+                                  int const end = range_end( p );
+                                  int const mid = ( begin + end ) / 2;
+                                  if ( begin == end )
+                                      return;
+                                  if ( p < mid )
+                                      range_end( p ) = mid;
+                                  else if ( p > mid )
+                                      range_begin( p ) = mid + 1;
+                                  else
+                                      range_begin( p ) = range_end( p );
+                              } );
+        Kokkos::fence();
+    }
+}
+
+template <typename DeviceType>
+void KdTreeConstruction<DeviceType>::permutePoints(
+    Kokkos::View<Point const *, DeviceType> points,
+    Kokkos::View<int * [3], DeviceType> order,
+    Kokkos::View<double * [3], Kokkos::LayoutLeft, DeviceType> coordinates,
+    Kokkos::View<int *, DeviceType> indices )
+{
+    // Every point is now at its final position in all three orders.
+    int const n = points.extent( 0 );
+    Kokkos::parallel_for( REGION_NAME( "set_coordinates" ),
+                          Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
+                          KOKKOS_LAMBDA( int p ) {
+                              int const i = order( p, 0 );
+                              indices( p ) = i;
+                              for ( int d = 0; d < 3; ++d )
+                                  coordinates( p, d ) = points( i )[d];
+                          } );
+    Kokkos::fence();
+}
+} // end namespace Details
+
+template <typename DeviceType>
+KdTree<DeviceType>::KdTree( Kokkos::View<Point const *, DeviceType> points )
+    : _coordinates( "coordinates", points.extent( 0 ) )
+    , _indices( "sorted_indices", points.extent( 0 ) )
+    , _split_dimensions( "split_dimensions", points.extent( 0 ) )
+{
+    int const n = points.extent( 0 );
+    if ( empty() )
+        return;
+
+    using Construction = Details::KdTreeConstruction<DeviceType>;
+    Kokkos::View<int * [3], DeviceType> order( "order", n );
+    Kokkos::View<int * [3], DeviceType> position( "position", n );
+    _bounds = Construction::sortPoints( points, order, position );
+    Construction::splitRanges( points, order, position, _split_dimensions );
+    Construction::permutePoints( points, order, _coordinates, _indices );
+}
+
+} // end namespace DataTransferKit
+
+// Explicit instantiation macro
+#define DTK_KDTREE_INSTANT( NODE )                                             \
+    template class KdTree<typename NODE::device_type>;
+
+#endif
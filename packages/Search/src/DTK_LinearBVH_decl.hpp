@@ -17,15 +17,40 @@
 #include <DTK_DetailsAlgorithms.hpp>
 #include <DTK_DetailsBox.hpp>
 #include <DTK_DetailsNode.hpp>
+#include <DTK_DetailsPeriodicity.hpp>
 #include <DTK_DetailsPredicate.hpp>
+#include <DTK_DetailsTreeQuality.hpp>
+#include <DTK_DetailsTreeSerialization.hpp>
 #include <DTK_DetailsTreeTraversal.hpp>
 #include <DTK_DetailsUtils.hpp>
 
 #include "DTK_ConfigDefs.hpp"
+#include "DataTransferKitSearch_config.h"
+
+#include <iosfwd>
+#include <string>
 
 namespace DataTransferKit
 {
 
+template <typename DeviceType>
+class BVHCollection;
+template <typename DeviceType>
+class DynamicBVH;
+
+/** \brief Space-filling curve along which the leaves of a BVH are ordered.
+ *
+ *  Hilbert keys take slightly longer to compute than Morton codes but
+ *  consecutive cells along the Hilbert curve always share a face, whereas the
+ *  Z-order curve makes large jumps.  Leaves that are stored next to each other
+ *  are therefore closer in space and the subtrees are more compact.
+ */
+enum class SpaceFillingCurve
+{
+    Morton,
+    Hilbert
+};
+
 /**
  * Bounding Volume Hierarchy.
  */
@@ -33,7 +58,45 @@ template <typename DeviceType>
 class BVH
 {
   public:
-    BVH( Kokkos::View<Box const *, DeviceType> bounding_boxes );
+    /** \brief Default number of objects below which no hierarchy is built.
+     *  Pass a threshold of zero to always build it.
+     */
+    static int constexpr default_brute_force_threshold = 128;
+
+    /** \brief Builds the hierarchy over the bounding boxes of the objects.
+     *
+     *  \param[in] bounding_boxes Bounding boxes of the objects.
+     *  \param[in] brute_force_threshold When there are no more objects than
+     *  this, the construction of the hierarchy is skipped altogether and the
+     *  queries scan all the leaves instead of traversing the tree.  Results
+     *  are the same in both cases.
+     *  \param[in] curve Space-filling curve used to order the leaves.
+     */
+    BVH( Kokkos::View<Box const *, DeviceType> bounding_boxes,
+         int brute_force_threshold = default_brute_force_threshold,
+         SpaceFillingCurve curve = SpaceFillingCurve::Morton );
+
+    /** \brief Same as above but also attaches tags to the objects.
+     *
+     *  \param[in] tags Bits attached to each object (e.g. material ids,
+     *  active cells, or side sets).  Queries whose predicate mask has no bit
+     *  in common with the tags of an object skip that object.  Internal nodes
+     *  hold the union of the tags of their children so that whole subtrees
+     *  are pruned.  Objects default to Node::all_tags when \c tags is empty,
+     *  in which case no storage is used for the tags.
+     */
+    BVH( Kokkos::View<Box const *, DeviceType> bounding_boxes,
+         Kokkos::View<unsigned int const *, DeviceType> tags,
+         int brute_force_threshold = default_brute_force_threshold,
+         SpaceFillingCurve curve = SpaceFillingCurve::Morton );
+
+    /** \brief Empty hierarchy.
+     */
+    KOKKOS_INLINE_FUNCTION
+    BVH()
+        : _brute_force( false )
+    {
+    }
 
     // Views are passed by reference here because internally Kokkos::realloc()
     // is called.
@@ -50,6 +113,110 @@ class BVH
            Kokkos::View<int *, DeviceType> &offset,
            Kokkos::View<double *, DeviceType> &distances ) const;
 
+    /** \brief Finds the k nearest objects according to their exact distance
+     *  to the query point rather than the distance to their bounding box.
+     *
+     *  \c geometry(index, point) is called on the device and returns the
+     *  distance from \c point to the object \c index (e.g. a triangle or a
+     *  segment).  That distance may not be smaller than the distance to the
+     *  bounding box of the object.  Bounding boxes are still used to prune the
+     *  traversal, and the geometry is only evaluated for leaves that reach
+     *  the top of the priority queue.
+     */
+    template <typename Query, typename Geometry>
+    typename std::enable_if<
+        std::is_same<typename Query::Tag, Details::NearestPredicateTag>::value,
+        void>::type
+    query( Kokkos::View<Query *, DeviceType> queries,
+           Kokkos::View<int *, DeviceType> &indices,
+           Kokkos::View<int *, DeviceType> &offset,
+           Kokkos::View<double *, DeviceType> &distances,
+           Geometry const &geometry ) const;
+
+    /** \brief Finds the k nearest neighbors using the results of a previous
+     *  search as a first guess.
+     *
+     *  \c previous_indices and \c previous_offset hold the output of an
+     *  earlier search with the same number of queries (e.g. at the previous
+     *  time step when the query points move only slightly).  For each query,
+     *  the largest distance to the first \c k objects found previously bounds
+     *  the distance to the k-th nearest neighbor and every subtree further
+     *  away than that is pruned from the traversal.  Results are the same as
+     *  the ones obtained without warm start.
+     *
+     *  \note \c indices and \c offset may be the same views as \c
+     *  previous_indices and \c previous_offset.
+     */
+    template <typename Query>
+    typename std::enable_if<
+        std::is_same<typename Query::Tag, Details::NearestPredicateTag>::value,
+        void>::type
+    query( Kokkos::View<Query *, DeviceType> queries,
+           Kokkos::View<int *, DeviceType> &indices,
+           Kokkos::View<int *, DeviceType> &offset,
+           Kokkos::View<int const *, DeviceType> previous_indices,
+           Kokkos::View<int const *, DeviceType> previous_offset ) const;
+    template <typename Query>
+    typename std::enable_if<
+        std::is_same<typename Query::Tag, Details::NearestPredicateTag>::value,
+        void>::type
+    query( Kokkos::View<Query *, DeviceType> queries,
+           Kokkos::View<int *, DeviceType> &indices,
+           Kokkos::View<int *, DeviceType> &offset,
+           Kokkos::View<double *, DeviceType> &distances,
+           Kokkos::View<int const *, DeviceType> previous_indices,
+           Kokkos::View<int const *, DeviceType> previous_offset ) const;
+
+    /** \brief Finds objects satisfying the predicates in a periodic
+     *  domain.
+     *
+     *  Objects are considered together with their periodic images (see
+     *  Periodicity) without duplicating them in the hierarchy.  Instead the
+     *  query is shifted by the opposite amount during the traversal.  \c
+     *  images(j) holds the periodic image of the object \c indices(j) that
+     *  satisfies the predicate, the object has to be shifted by \c
+     *  periodicity.shift(images(j)) to meet it.  An object may appear once
+     *  per image.
+     *
+     *  Unused slots of nearest queries are padded with -1 in both \c
+     *  indices and \c images.
+     *
+     *  \note Only images shifted by at most one period are considered so the
+     *  objects must lie within one period of each other and the search radius
+     *  must not exceed the period.
+     */
+    template <typename Query>
+    void query( Kokkos::View<Query *, DeviceType> queries,
+                Periodicity const &periodicity,
+                Kokkos::View<int *, DeviceType> &indices,
+                Kokkos::View<int *, DeviceType> &offset,
+                Kokkos::View<int *, DeviceType> &images ) const;
+    template <typename Query>
+    typename std::enable_if<
+        std::is_same<typename Query::Tag, Details::NearestPredicateTag>::value,
+        void>::type
+    query( Kokkos::View<Query *, DeviceType> queries,
+           Periodicity const &periodicity,
+           Kokkos::View<int *, DeviceType> &indices,
+           Kokkos::View<int *, DeviceType> &offset,
+           Kokkos::View<int *, DeviceType> &images,
+           Kokkos::View<double *, DeviceType> &distances ) const;
+
+#if HAVE_DTK_TRAVERSAL_STATISTICS
+    /** \brief Same as above but also reports how much work the traversal of
+     *  the hierarchy required for each query (number of nodes visited, number
+     *  of leaves tested and maximum size of the stack or priority queue).
+     *
+     *  \note The counters are gathered in an extra pass over the queries so
+     *  the timings are not representative of a regular search.
+     */
+    template <typename Query>
+    void query( Kokkos::View<Query *, DeviceType> queries,
+                Kokkos::View<int *, DeviceType> &indices,
+                Kokkos::View<int *, DeviceType> &offset,
+                Details::TraversalStatistics &statistics ) const;
+#endif
+
     KOKKOS_INLINE_FUNCTION
     Box bounds() const
     {
@@ -65,9 +232,63 @@ class BVH
     KOKKOS_INLINE_FUNCTION
     bool empty() const { return size() == 0; }
 
+    /** \brief Cost of the hierarchy according to the surface area heuristic
+     *  (SAH), normalized by the surface area of the root.
+     *
+     *  Visiting an internal node and testing a leaf are both assigned a unit
+     *  cost.  Lower is better.
+     *
+     *  \note When the hierarchy was not built (see the constructor), every
+     *  leaf is tested, all the leaves are at depth one, and siblings are
+     *  deemed not to overlap.
+     */
+    double sahCost() const;
+
+    /** \brief Minimum, maximum, and average depth of the leaves (the root is
+     *  at depth zero).
+     */
+    Details::LeafDepth leafDepth() const;
+
+    /** \brief Total volume of the intersections between the bounding boxes of
+     *  sibling nodes.
+     */
+    double siblingOverlapVolume() const;
+
+    /** \brief Number of bytes allocated for the leaf nodes, the internal
+     *  nodes, the permutation indices (and their inverse once a
+     *  warm-started search computed it), and the tags if any.
+     */
+    std::size_t memoryUsage() const;
+
+    /** \brief Writes the hierarchy in a versioned binary format so that it
+     *  does not need to be rebuilt (e.g. for static geometry upon restart).
+     *
+     *  The nodes refer to each other by position rather than by address.
+     *  See Details::SerializedTreeHeader for the layout.
+     */
+    void save( std::ostream &os ) const;
+    void save( std::string const &filename ) const;
+
+    /** \brief Reads back a hierarchy written by save().
+     *
+     *  \param[in] buffer Content of the file, e.g. a memory-mapped file.
+     *  Loading amounts to copying the arrays and restoring the pointers
+     *  between the nodes, nothing is parsed.
+     *  \param[in] size Number of bytes in the buffer.
+     */
+    static BVH load( char const *buffer, std::size_t size );
+    static BVH load( std::string const &filename );
+
   private:
     friend struct Details::TreeTraversal<DeviceType>;
+    friend struct Details::TreeSerialization<DeviceType>;
+    friend class BVHCollection<DeviceType>;
+    friend class DynamicBVH<DeviceType>;
 
+    // Declared first since the number of internal nodes depends on it.  When
+    // true, the leaves are stored in the original order of the objects and
+    // the only internal node holds the bounding box of the scene.
+    bool _brute_force;
     Kokkos::View<Node *, DeviceType> _leaf_nodes;
     Kokkos::View<Node *, DeviceType> _internal_nodes;
     /**
@@ -76,51 +297,59 @@ class BVH
      * meet a predicate.
      */
     Kokkos::View<int *, DeviceType> _indices;
+    /**
+     * Tags of the nodes, the internal nodes first and then the leaves.  Only
+     * allocated when tags are attached to the objects, every node matches
+     * every mask otherwise.
+     */
+    Kokkos::View<unsigned int *, DeviceType> _tags;
+
+    // Inverse permutation of _indices, i.e. the position of every object
+    // among the sorted leaves.  Only the warm-started searches need it so it
+    // is computed the first time one of them is performed and kept for the
+    // next ones.
+    Kokkos::View<int const *, DeviceType> leafPositions() const;
+    mutable Kokkos::View<int *, DeviceType> _leaf_positions;
 };
 
-template <typename DeviceType, typename Query>
-void queryDispatch(
-    BVH<DeviceType> const bvh, Kokkos::View<Query *, DeviceType> queries,
-    Kokkos::View<int *, DeviceType> &indices,
-    Kokkos::View<int *, DeviceType> &offset, Details::NearestPredicateTag,
-    Kokkos::View<double *, DeviceType> *distances_ptr = nullptr )
+// Performs the nearest queries with the given traversal of the tree.  The
+// slots of the results must have been allocated and filled with -1 (resp.
+// +infty for the distances).
+template <typename DeviceType, typename Query, typename Geometry,
+          typename Traversal>
+void performNearestQueries( BVH<DeviceType> const bvh,
+                            Kokkos::View<Query *, DeviceType> queries,
+                            Kokkos::View<int *, DeviceType> indices,
+                            Kokkos::View<int *, DeviceType> offset,
+                            Kokkos::View<double *, DeviceType> *distances_ptr,
+                            Kokkos::View<double *, DeviceType> radii,
+                            Geometry const &geometry, Traversal )
 {
     using ExecutionSpace = typename DeviceType::execution_space;
 
     int const n_queries = queries.extent( 0 );
+    bool const use_radii = ( radii.extent_int( 0 ) == n_queries );
+    double const infinity = Kokkos::ArithTraits<double>::max();
 
-    Kokkos::realloc( offset, n_queries + 1 );
-    fill( offset, 0 );
-
-    Kokkos::parallel_for(
-        REGION_NAME( "scan_queries_for_numbers_of_nearest_neighbors" ),
-        Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
-        KOKKOS_LAMBDA( int i ) { offset( i ) = queries( i )._k; } );
-    Kokkos::fence();
-
-    exclusivePrefixSum( offset );
-    int const n_results = lastElement( offset );
-
-    Kokkos::realloc( indices, n_results );
-    fill( indices, -1 );
     if ( distances_ptr )
     {
-        Kokkos::View<double *, DeviceType> &distances = *distances_ptr;
-        Kokkos::realloc( distances, n_results );
-        fill( distances, Kokkos::ArithTraits<double>::max() );
-
+        Kokkos::View<double *, DeviceType> distances = *distances_ptr;
         Kokkos::parallel_for(
             REGION_NAME( "perform_nearest_queries_and_return_distances" ),
             Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
             KOKKOS_LAMBDA( int i ) {
                 int count = 0;
-                Details::TreeTraversal<DeviceType>::query(
-                    bvh, queries( i ), [indices, offset, distances, i,
-                                        &count]( int index, double distance ) {
+                Details::NullStatistics stats;
+                Details::nearestQuery(
+                    bvh, queries( i )._query_point, queries( i )._k,
+                    [indices, offset, distances, i,
+                     &count]( int index, double distance ) {
                         indices( offset( i ) + count ) = index;
                         distances( offset( i ) + count ) = distance;
                         count++;
-                    } );
+                    },
+                    use_radii ? radii( i ) : infinity, stats, geometry,
+                    queries( i )._mask, Traversal{} );
             } );
         Kokkos::fence();
     }
@@ -131,18 +360,127 @@ void queryDispatch(
             Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
             KOKKOS_LAMBDA( int i ) {
                 int count = 0;
-                Details::TreeTraversal<DeviceType>::query(
-                    bvh, queries( i ),
+                Details::NullStatistics stats;
+                Details::nearestQuery(
+                    bvh, queries( i )._query_point, queries( i )._k,
                     [indices, offset, i, &count]( int index, double distance ) {
                         indices( offset( i ) + count++ ) = index;
-                    } );
+                    },
+                    use_radii ? radii( i ) : infinity, stats, geometry,
+                    queries( i )._mask, Traversal{} );
             } );
         Kokkos::fence();
     }
+}
+
+// When radii is not empty, radii(i) bounds the distance to the k-th nearest
+// neighbor of the i-th query and is used to prune the search.
+template <typename DeviceType, typename Query,
+          typename Geometry = Details::BoundingBoxDistance>
+void queryDispatch(
+    BVH<DeviceType> const bvh, Kokkos::View<Query *, DeviceType> queries,
+    Kokkos::View<int *, DeviceType> &indices,
+    Kokkos::View<int *, DeviceType> &offset, Details::NearestPredicateTag,
+    Kokkos::View<double *, DeviceType> *distances_ptr = nullptr,
+    Kokkos::View<double *, DeviceType> radii =
+        Kokkos::View<double *, DeviceType>(),
+    Geometry const &geometry = Geometry() )
+{
+    using ExecutionSpace = typename DeviceType::execution_space;
+
+    int const n_queries = queries.extent( 0 );
+
+    Kokkos::realloc( offset, n_queries + 1 );
+    fill( offset, 0 );
+
+    Kokkos::parallel_for(
+        REGION_NAME( "scan_queries_for_numbers_of_nearest_neighbors" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
+        KOKKOS_LAMBDA( int i ) { offset( i ) = queries( i )._k; } );
+    Kokkos::fence();
+
+    exclusivePrefixSum( offset );
+    int const n_results = lastElement( offset );
+
+    Kokkos::realloc( indices, n_results );
+    fill( indices, -1 );
+    if ( distances_ptr )
+    {
+        Kokkos::realloc( *distances_ptr, n_results );
+        fill( *distances_ptr, Kokkos::ArithTraits<double>::max() );
+    }
+
+    if ( Details::TreeTraversal<DeviceType>::isBruteForce( bvh ) )
+        performNearestQueries( bvh, queries, indices, offset, distances_ptr,
+                               radii, geometry,
+                               Details::BruteForceTraversal{} );
+    else
+        performNearestQueries( bvh, queries, indices, offset, distances_ptr,
+                               radii, geometry,
+                               Details::HierarchicalTraversal{} );
     // NOTE: possible improvement is to find out if they are any -1 in indices
     // (resp. +infty in distances) and truncate if necessary
 }
 
+// leaf_positions(index) gives the position of the object index among the
+// sorted leaves, or -1 if it has none (see BVH::leafPositions()).
+template <typename DeviceType, typename Query>
+void warmStartQueryDispatch(
+    BVH<DeviceType> const bvh, Kokkos::View<Query *, DeviceType> queries,
+    Kokkos::View<int const *, DeviceType> previous_indices,
+    Kokkos::View<int const *, DeviceType> previous_offset,
+    Kokkos::View<int const *, DeviceType> leaf_positions,
+    Kokkos::View<int *, DeviceType> &indices,
+    Kokkos::View<int *, DeviceType> &offset,
+    Kokkos::View<double *, DeviceType> *distances_ptr = nullptr )
+{
+    using ExecutionSpace = typename DeviceType::execution_space;
+    using TreeTraversal = Details::TreeTraversal<DeviceType>;
+
+    int const n_queries = queries.extent( 0 );
+    DTK_REQUIRE( previous_offset.extent_int( 0 ) == n_queries + 1 );
+    int const n = leaf_positions.extent( 0 );
+
+    // Any k objects give an upper bound on the distance to the k-th nearest
+    // neighbor.  Objects from the previous search are likely to still be
+    // close so the bound is tight.  Invalid indices (e.g. -1 when fewer than
+    // k objects were found) and objects that do not match the mask of the
+    // query are ignored and no pruning is done if less than k valid objects
+    // remain.
+    double const infinity = Kokkos::ArithTraits<double>::max();
+    Kokkos::View<double *, DeviceType> radii( "radii", n_queries );
+    Kokkos::parallel_for(
+        REGION_NAME( "compute_pruning_radii" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
+        KOKKOS_LAMBDA( int i ) {
+            Point const &query_point = queries( i )._query_point;
+            int const k = queries( i )._k;
+            int count = 0;
+            double radius = 0.;
+            for ( int j = previous_offset( i );
+                  j < previous_offset( i + 1 ) && count < k; ++j )
+            {
+                int const index = previous_indices( j );
+                if ( index < 0 || index >= n || leaf_positions( index ) < 0 )
+                    continue;
+                Node const *leaf =
+                    TreeTraversal::getLeaf( bvh, leaf_positions( index ) );
+                if ( ( TreeTraversal::getTags( bvh, leaf ) &
+                       queries( i )._mask ) == 0 )
+                    continue;
+                radius = KokkosHelpers::max(
+                    radius, Details::distance( query_point,
+                                               leaf->bounding_box ) );
+                count++;
+            }
+            radii( i ) = ( count == k ? radius : infinity );
+        } );
+    Kokkos::fence();
+
+    queryDispatch( bvh, queries, indices, offset,
+                   Details::NearestPredicateTag{}, distances_ptr, radii );
+}
+
 template <typename DeviceType, typename Query>
 void queryDispatch( BVH<DeviceType> const bvh,
                     Kokkos::View<Query *, DeviceType> queries,
@@ -204,6 +542,236 @@ void queryDispatch( BVH<DeviceType> const bvh,
     Kokkos::fence();
 }
 
+template <typename DeviceType, typename Query>
+void periodicQueryDispatch( BVH<DeviceType> const bvh,
+                            Kokkos::View<Query *, DeviceType> queries,
+                            Periodicity const periodicity,
+                            Kokkos::View<int *, DeviceType> &indices,
+                            Kokkos::View<int *, DeviceType> &offset,
+                            Kokkos::View<int *, DeviceType> &images,
+                            Details::SpatialPredicateTag )
+{
+    using ExecutionSpace = typename DeviceType::execution_space;
+
+    int const n_queries = queries.extent( 0 );
+    Box const bounds = bvh.bounds();
+
+    Kokkos::realloc( offset, n_queries + 1 );
+    fill( offset, 0 );
+
+    // An object shifted by periodicity.shift(image) satisfies the predicate if
+    // and only if the object itself satisfies the predicate shifted the
+    // opposite way, that is by periodicity.shift(n_images - 1 - image).
+    Kokkos::parallel_for(
+        REGION_NAME( "first_pass_at_the_periodic_search_count" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
+        KOKKOS_LAMBDA( int i ) {
+            int count = 0;
+            for ( int image = 0; image < Periodicity::n_images; ++image )
+            {
+                if ( !periodicity.isActive( image ) )
+                    continue;
+                auto const predicate = queries( i ).translated(
+                    periodicity.shift( Periodicity::n_images - 1 - image ) );
+                if ( bvh.empty() || !predicate( bounds ) )
+                    continue;
+                count += Details::TreeTraversal<DeviceType>::query(
+                    bvh, predicate, []( int index ) {} );
+            }
+            offset( i ) = count;
+        } );
+    Kokkos::fence();
+
+    exclusivePrefixSum( offset );
+    int const n_results = lastElement( offset );
+
+    Kokkos::realloc( indices, n_results );
+    Kokkos::realloc( images, n_results );
+    Kokkos::parallel_for(
+        REGION_NAME( "second_pass_of_the_periodic_search" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
+        KOKKOS_LAMBDA( int i ) {
+            int count = 0;
+            for ( int image = 0; image < Periodicity::n_images; ++image )
+            {
+                if ( !periodicity.isActive( image ) )
+                    continue;
+                auto const predicate = queries( i ).translated(
+                    periodicity.shift( Periodicity::n_images - 1 - image ) );
+                if ( bvh.empty() || !predicate( bounds ) )
+                    continue;
+                Details::TreeTraversal<DeviceType>::query(
+                    bvh, predicate,
+                    [indices, offset, images, i, image, &count]( int index ) {
+                        indices( offset( i ) + count ) = index;
+                        images( offset( i ) + count ) = image;
+                        count++;
+                    } );
+            }
+        } );
+    Kokkos::fence();
+}
+
+// Inserts a result among the k slots starting at first that hold the results
+// found so far sorted by increasing distance.  When all the slots are taken,
+// the furthest result is dropped.  labels identifies where the object was
+// found (e.g. the periodic image).
+template <typename DeviceType>
+KOKKOS_INLINE_FUNCTION void
+insertSorted( Kokkos::View<int *, DeviceType> indices,
+              Kokkos::View<int *, DeviceType> labels,
+              Kokkos::View<double *, DeviceType> distances, int first, int k,
+              int &count, int index, int label, double distance )
+{
+    if ( count == k && !( distance < distances( first + k - 1 ) ) )
+        return;
+    // insertion sort, the last one is dropped when full
+    int pos = ( count < k ? count++ : k - 1 );
+    while ( pos > 0 && distances( first + pos - 1 ) > distance )
+    {
+        indices( first + pos ) = indices( first + pos - 1 );
+        labels( first + pos ) = labels( first + pos - 1 );
+        distances( first + pos ) = distances( first + pos - 1 );
+        --pos;
+    }
+    indices( first + pos ) = index;
+    labels( first + pos ) = label;
+    distances( first + pos ) = distance;
+}
+
+// The images are searched one after the other, starting with the object
+// itself, and the k nearest neighbors found so far are kept sorted in the
+// output views.  The distance to the k-th one bounds the search in the
+// remaining images.
+template <typename DeviceType, typename Query, typename Traversal>
+void performPeriodicNearestQueries(
+    BVH<DeviceType> const bvh, Kokkos::View<Query *, DeviceType> queries,
+    Periodicity const periodicity, Kokkos::View<int *, DeviceType> indices,
+    Kokkos::View<int *, DeviceType> offset,
+    Kokkos::View<int *, DeviceType> images,
+    Kokkos::View<double *, DeviceType> distances, Traversal )
+{
+    using ExecutionSpace = typename DeviceType::execution_space;
+
+    int const n_queries = queries.extent( 0 );
+    Box const bounds = bvh.bounds();
+    double const infinity = Kokkos::ArithTraits<double>::max();
+
+    Kokkos::parallel_for(
+        REGION_NAME( "perform_periodic_nearest_queries" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
+        KOKKOS_LAMBDA( int i ) {
+            int const first = offset( i );
+            int const k = queries( i )._k;
+            int count = 0;
+            for ( int j = 0; j < Periodicity::n_images; ++j )
+            {
+                int const image =
+                    ( Periodicity::identity + j ) % Periodicity::n_images;
+                if ( bvh.empty() || !periodicity.isActive( image ) )
+                    continue;
+                Point const query_point =
+                    queries( i )
+                        .translated( periodicity.shift(
+                            Periodicity::n_images - 1 - image ) )
+                        ._query_point;
+                double const radius =
+                    ( count == k ? distances( first + k - 1 ) : infinity );
+                if ( Details::distance( query_point, bounds ) > radius )
+                    continue;
+                Details::NullStatistics stats;
+                Details::nearestQuery(
+                    bvh, query_point, k,
+                    [indices, images, distances, first, k, image,
+                     &count]( int index, double distance ) {
+                        insertSorted( indices, images, distances, first, k,
+                                      count, index, image, distance );
+                    },
+                    radius, stats, Details::BoundingBoxDistance{},
+                    queries( i )._mask, Traversal{} );
+            }
+        } );
+    Kokkos::fence();
+}
+
+template <typename DeviceType, typename Query>
+void periodicQueryDispatch(
+    BVH<DeviceType> const bvh, Kokkos::View<Query *, DeviceType> queries,
+    Periodicity const periodicity, Kokkos::View<int *, DeviceType> &indices,
+    Kokkos::View<int *, DeviceType> &offset,
+    Kokkos::View<int *, DeviceType> &images, Details::NearestPredicateTag,
+    Kokkos::View<double *, DeviceType> *distances_ptr = nullptr )
+{
+    using ExecutionSpace = typename DeviceType::execution_space;
+
+    int const n_queries = queries.extent( 0 );
+    double const infinity = Kokkos::ArithTraits<double>::max();
+
+    Kokkos::realloc( offset, n_queries + 1 );
+    fill( offset, 0 );
+
+    Kokkos::parallel_for(
+        REGION_NAME( "scan_queries_for_numbers_of_nearest_neighbors" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
+        KOKKOS_LAMBDA( int i ) { offset( i ) = queries( i )._k; } );
+    Kokkos::fence();
+
+    exclusivePrefixSum( offset );
+    int const n_results = lastElement( offset );
+
+    Kokkos::realloc( indices, n_results );
+    fill( indices, -1 );
+    Kokkos::realloc( images, n_results );
+    fill( images, -1 );
+    // distances are needed to merge the results from the different images
+    Kokkos::View<double *, DeviceType> distances( "distances" );
+    if ( distances_ptr )
+        distances = *distances_ptr;
+    Kokkos::realloc( distances, n_results );
+    fill( distances, infinity );
+
+    if ( Details::TreeTraversal<DeviceType>::isBruteForce( bvh ) )
+        performPeriodicNearestQueries( bvh, queries, periodicity, indices,
+                                       offset, images, distances,
+                                       Details::BruteForceTraversal{} );
+    else
+        performPeriodicNearestQueries( bvh, queries, periodicity, indices,
+                                       offset, images, distances,
+                                       Details::HierarchicalTraversal{} );
+
+    if ( distances_ptr )
+        *distances_ptr = distances;
+}
+
+#if HAVE_DTK_TRAVERSAL_STATISTICS
+// Discards the results of both spatial and nearest queries.
+struct DiscardResults
+{
+    KOKKOS_INLINE_FUNCTION void operator()( int ) const {}
+    KOKKOS_INLINE_FUNCTION void operator()( int, double ) const {}
+};
+
+template <typename DeviceType, typename Query>
+void traversalStatistics(
+    BVH<DeviceType> const bvh, Kokkos::View<Query *, DeviceType> queries,
+    Kokkos::View<Details::QueryStatistics *, DeviceType> stats )
+{
+    using ExecutionSpace = typename DeviceType::execution_space;
+
+    int const n_queries = queries.extent( 0 );
+    Kokkos::parallel_for(
+        REGION_NAME( "collect_traversal_statistics" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
+        KOKKOS_LAMBDA( int i ) {
+            Details::QueryStatistics query_stats;
+            Details::TreeTraversal<DeviceType>::query(
+                bvh, queries( i ), DiscardResults(), query_stats );
+            stats( i ) = query_stats;
+        } );
+    Kokkos::fence();
+}
+#endif
+
 template <typename DeviceType>
 template <typename Query>
 void BVH<DeviceType>::query( Kokkos::View<Query *, DeviceType> queries,
@@ -228,6 +796,102 @@ BVH<DeviceType>::query( Kokkos::View<Query *, DeviceType> queries,
     queryDispatch( *this, queries, indices, offset, Tag{}, &distances );
 }
 
+template <typename DeviceType>
+template <typename Query, typename Geometry>
+typename std::enable_if<
+    std::is_same<typename Query::Tag, Details::NearestPredicateTag>::value,
+    void>::type
+BVH<DeviceType>::query( Kokkos::View<Query *, DeviceType> queries,
+                        Kokkos::View<int *, DeviceType> &indices,
+                        Kokkos::View<int *, DeviceType> &offset,
+                        Kokkos::View<double *, DeviceType> &distances,
+                        Geometry const &geometry ) const
+{
+    using Tag = typename Query::Tag;
+    queryDispatch( *this, queries, indices, offset, Tag{}, &distances,
+                   Kokkos::View<double *, DeviceType>(), geometry );
+}
+
+template <typename DeviceType>
+template <typename Query>
+typename std::enable_if<
+    std::is_same<typename Query::Tag, Details::NearestPredicateTag>::value,
+    void>::type
+BVH<DeviceType>::query(
+    Kokkos::View<Query *, DeviceType> queries,
+    Kokkos::View<int *, DeviceType> &indices,
+    Kokkos::View<int *, DeviceType> &offset,
+    Kokkos::View<int const *, DeviceType> previous_indices,
+    Kokkos::View<int const *, DeviceType> previous_offset ) const
+{
+    warmStartQueryDispatch( *this, queries, previous_indices, previous_offset,
+                            leafPositions(), indices, offset );
+}
+
+template <typename DeviceType>
+template <typename Query>
+typename std::enable_if<
+    std::is_same<typename Query::Tag, Details::NearestPredicateTag>::value,
+    void>::type
+BVH<DeviceType>::query(
+    Kokkos::View<Query *, DeviceType> queries,
+    Kokkos::View<int *, DeviceType> &indices,
+    Kokkos::View<int *, DeviceType> &offset,
+    Kokkos::View<double *, DeviceType> &distances,
+    Kokkos::View<int const *, DeviceType> previous_indices,
+    Kokkos::View<int const *, DeviceType> previous_offset ) const
+{
+    warmStartQueryDispatch( *this, queries, previous_indices, previous_offset,
+                            leafPositions(), indices, offset, &distances );
+}
+
+template <typename DeviceType>
+template <typename Query>
+void BVH<DeviceType>::query( Kokkos::View<Query *, DeviceType> queries,
+                             Periodicity const &periodicity,
+                             Kokkos::View<int *, DeviceType> &indices,
+                             Kokkos::View<int *, DeviceType> &offset,
+                             Kokkos::View<int *, DeviceType> &images ) const
+{
+    using Tag = typename Query::Tag;
+    periodicQueryDispatch( *this, queries, periodicity, indices, offset,
+                           images, Tag{} );
+}
+
+template <typename DeviceType>
+template <typename Query>
+typename std::enable_if<
+    std::is_same<typename Query::Tag, Details::NearestPredicateTag>::value,
+    void>::type
+BVH<DeviceType>::query( Kokkos::View<Query *, DeviceType> queries,
+                        Periodicity const &periodicity,
+                        Kokkos::View<int *, DeviceType> &indices,
+                        Kokkos::View<int *, DeviceType> &offset,
+                        Kokkos::View<int *, DeviceType> &images,
+                        Kokkos::View<double *, DeviceType> &distances ) const
+{
+    using Tag = typename Query::Tag;
+    periodicQueryDispatch( *this, queries, periodicity, indices, offset,
+                           images, Tag{}, &distances );
+}
+
+#if HAVE_DTK_TRAVERSAL_STATISTICS
+template <typename DeviceType>
+template <typename Query>
+void BVH<DeviceType>::query( Kokkos::View<Query *, DeviceType> queries,
+                             Kokkos::View<int *, DeviceType> &indices,
+                             Kokkos::View<int *, DeviceType> &offset,
+                             Details::TraversalStatistics &statistics ) const
+{
+    query( queries, indices, offset );
+
+    Kokkos::View<Details::QueryStatistics *, DeviceType> stats(
+        "traversal_statistics", queries.extent( 0 ) );
+    traversalStatistics( *this, queries, stats );
+    statistics.summarize( stats );
+}
+#endif
+
 } // end namespace DataTransferKit
 
 #endif
@@ -12,12 +12,19 @@
 
 #include "DTK_ConfigDefs.hpp"
 
+#include <DTK_DBC.hpp>
 #include <DTK_DetailsAlgorithms.hpp>
 #include <DTK_DetailsTreeConstruction.hpp>
+#include <DTK_DetailsTreeQuality.hpp>
+#include <DTK_DetailsTreeSerialization.hpp>
 #include <DTK_KokkosHelpers.hpp>
 
 #include <Kokkos_ArithTraits.hpp>
 
+#include <fstream>
+#include <iterator>
+#include <vector>
+
 namespace DataTransferKit
 {
 template <typename DeviceType>
@@ -29,10 +36,14 @@ class SetBoundingBoxesFunctor
     SetBoundingBoxesFunctor(
         Kokkos::View<Node *, DeviceType> leaf_nodes,
         Kokkos::View<int *, DeviceType> indices,
-        Kokkos::View<Box const *, DeviceType> bounding_boxes )
+        Kokkos::View<Box const *, DeviceType> bounding_boxes,
+        Kokkos::View<unsigned int const *, DeviceType> tags,
+        Kokkos::View<unsigned int *, DeviceType> leaf_tags )
         : _leaf_nodes( leaf_nodes )
         , _indices( indices )
         , _bounding_boxes( bounding_boxes )
+        , _tags( tags )
+        , _leaf_tags( leaf_tags )
     {
     }
 
@@ -40,24 +51,58 @@ class SetBoundingBoxesFunctor
     void operator()( int const i ) const
     {
         _leaf_nodes[i].bounding_box = _bounding_boxes[_indices[i]];
+        if ( _tags.extent( 0 ) > 0 )
+            _leaf_tags[i] = _tags[_indices[i]];
     }
 
   private:
     Kokkos::View<Node *, DeviceType> _leaf_nodes;
     Kokkos::View<int *, DeviceType> _indices;
     Kokkos::View<Box const *, DeviceType> _bounding_boxes;
+    Kokkos::View<unsigned int const *, DeviceType> _tags;
+    Kokkos::View<unsigned int *, DeviceType> _leaf_tags;
 };
 
 template <typename DeviceType>
-BVH<DeviceType>::BVH( Kokkos::View<Box const *, DeviceType> bounding_boxes )
-    : _leaf_nodes( "leaf_nodes", bounding_boxes.extent( 0 ) )
+BVH<DeviceType>::BVH( Kokkos::View<Box const *, DeviceType> bounding_boxes,
+                      int brute_force_threshold, SpaceFillingCurve curve )
+    : BVH( bounding_boxes, Kokkos::View<unsigned int const *, DeviceType>(),
+           brute_force_threshold, curve )
+{
+}
+
+template <typename DeviceType>
+BVH<DeviceType>::BVH( Kokkos::View<Box const *, DeviceType> bounding_boxes,
+                      Kokkos::View<unsigned int const *, DeviceType> tags,
+                      int brute_force_threshold, SpaceFillingCurve curve )
+    : _brute_force( bounding_boxes.extent_int( 0 ) > 1 &&
+                    bounding_boxes.extent_int( 0 ) <= brute_force_threshold )
+    , _leaf_nodes( "leaf_nodes", bounding_boxes.extent( 0 ) )
     , _internal_nodes(
           "internal_nodes",
-          bounding_boxes.extent( 0 ) > 0 ? bounding_boxes.extent( 0 ) - 1 : 0 )
+          _brute_force ? 1
+                       : ( bounding_boxes.extent( 0 ) > 0
+                               ? bounding_boxes.extent( 0 ) - 1
+                               : 0 ) )
     , _indices( "sorted_indices", bounding_boxes.extent( 0 ) )
 {
     using ExecutionSpace = typename DeviceType::execution_space;
 
+    DTK_REQUIRE( tags.extent( 0 ) == 0 ||
+                 tags.extent( 0 ) == bounding_boxes.extent( 0 ) );
+    bool const use_tags = ( tags.extent( 0 ) > 0 );
+
+    // the tags of the leaves come after those of the internal nodes
+    Kokkos::View<unsigned int *, DeviceType> leaf_tags;
+    if ( use_tags )
+    {
+        int const n_internal_nodes = _internal_nodes.extent( 0 );
+        int const n_nodes = n_internal_nodes + _leaf_nodes.extent_int( 0 );
+        _tags = Kokkos::View<unsigned int *, DeviceType>( "tags", n_nodes );
+        leaf_tags = Kokkos::subview(
+            _tags, Kokkos::make_pair( n_internal_nodes, n_nodes ) );
+    }
+
     if ( empty() )
     {
         return;
@@ -72,6 +117,8 @@ BVH<DeviceType>::BVH( Kokkos::View<Box const *, DeviceType> bounding_boxes )
         leaf_nodes_host( 0 ) = Node();
         leaf_nodes_host( 0 ).bounding_box = bounding_boxes( 0 );
         Kokkos::deep_copy( _leaf_nodes, leaf_nodes_host );
+        if ( use_tags )
+            Kokkos::deep_copy( leaf_tags, tags );
         return;
     }
 
@@ -79,24 +126,52 @@ BVH<DeviceType>::BVH( Kokkos::View<Box const *, DeviceType> bounding_boxes )
     Details::TreeConstruction<DeviceType>::calculateBoundingBoxOfTheScene(
         bounding_boxes, _internal_nodes[0].bounding_box );
 
-    // calculate morton code of all objects
+    // for small numbers of objects, the leaves are simply copied in their
+    // original order and the queries scan all of them
     int const n = bounding_boxes.extent( 0 );
+    if ( _brute_force )
+    {
+        Kokkos::View<Node *, DeviceType> leaf_nodes = _leaf_nodes;
+        Kokkos::View<int *, DeviceType> indices = _indices;
+        Kokkos::parallel_for(
+            REGION_NAME( "set_leaves_in_original_order" ),
+            Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
+            KOKKOS_LAMBDA( int i ) {
+                indices( i ) = i;
+                leaf_nodes( i ).bounding_box = bounding_boxes( i );
+                if ( use_tags )
+                    leaf_tags( i ) = tags( i );
+            } );
+        Kokkos::fence();
+        return;
+    }
+
+    // calculate morton code (or Hilbert key) of all objects
     Kokkos::View<unsigned int *, DeviceType> morton_indices( "morton", n );
-    Details::TreeConstruction<DeviceType>::assignMortonCodes(
-        bounding_boxes, morton_indices, _internal_nodes[0].bounding_box );
+    bool const already_sorted =
+        ( curve == SpaceFillingCurve::Hilbert
+              ? Details::TreeConstruction<DeviceType>::assignMortonCodes(
+                    bounding_boxes, morton_indices,
+                    _internal_nodes[0].bounding_box, Details::HilbertCurve{} )
+              : Details::TreeConstruction<DeviceType>::assignMortonCodes(
+                    bounding_boxes, morton_indices,
+                    _internal_nodes[0].bounding_box ) );
 
-    // sort them along the Z-order space-filling curve
+    // sort them along the space-filling curve, unless the objects already
+    // come in that order (e.g. cells from a mesh generator or a partitioner
+    // that uses space-filling curves)
     Iota<DeviceType> iota_functor( _indices );
     Kokkos::parallel_for( REGION_NAME( "set_indices" ),
                           Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
                           iota_functor );
     Kokkos::fence();
-    Details::TreeConstruction<DeviceType>::sortObjects( morton_indices,
-                                                        _indices );
+    if ( !already_sorted )
+        Details::TreeConstruction<DeviceType>::sortObjects( morton_indices,
+                                                            _indices );
 
     // generate bounding volume hierarchy
     SetBoundingBoxesFunctor<DeviceType> set_bounding_boxes_functor(
-        _leaf_nodes, _indices, bounding_boxes );
+        _leaf_nodes, _indices, bounding_boxes, tags, leaf_tags );
     Kokkos::parallel_for( REGION_NAME( "set_bounding_boxes" ),
                           Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
                           set_bounding_boxes_functor );
@@ -104,10 +179,106 @@ BVH<DeviceType>::BVH( Kokkos::View<Box const *, DeviceType> bounding_boxes )
     Details::TreeConstruction<DeviceType>::generateHierarchy(
         morton_indices, _leaf_nodes, _internal_nodes );
 
-    // calculate bounding box for each internal node by walking the hierarchy
-    // toward the root
+    // calculate bounding box and tags for each internal node by walking the
+    // hierarchy toward the root
     Details::TreeConstruction<DeviceType>::calculateBoundingBoxes(
-        _leaf_nodes, _internal_nodes );
+        _leaf_nodes, _internal_nodes, _tags );
+}
+
+template <typename DeviceType>
+double BVH<DeviceType>::sahCost() const
+{
+    if ( _brute_force )
+        return size();
+    return Details::TreeQuality<DeviceType>::sahCost( _leaf_nodes,
+                                                      _internal_nodes );
+}
+
+template <typename DeviceType>
+Details::LeafDepth BVH<DeviceType>::leafDepth() const
+{
+    if ( _brute_force )
+    {
+        Details::LeafDepth depth;
+        depth.min_depth = 1;
+        depth.max_depth = 1;
+        depth.average_depth = 1.;
+        return depth;
+    }
+    return Details::TreeQuality<DeviceType>::leafDepth( _leaf_nodes );
+}
+
+template <typename DeviceType>
+double BVH<DeviceType>::siblingOverlapVolume() const
+{
+    if ( _brute_force )
+        return 0.;
+    return Details::TreeQuality<DeviceType>::siblingOverlapVolume(
+        _internal_nodes );
+}
+
+template <typename DeviceType>
+std::size_t BVH<DeviceType>::memoryUsage() const
+{
+    return _leaf_nodes.extent( 0 ) * sizeof( Node ) +
+           _internal_nodes.extent( 0 ) * sizeof( Node ) +
+           ( _indices.extent( 0 ) + _leaf_positions.extent( 0 ) ) *
+               sizeof( int ) +
+           _tags.extent( 0 ) * sizeof( unsigned int );
+}
+
+template <typename DeviceType>
+Kokkos::View<int const *, DeviceType> BVH<DeviceType>::leafPositions() const
+{
+    int const n = size();
+    if ( _leaf_positions.extent_int( 0 ) == n )
+        return _leaf_positions;
+
+    // The objects of a DynamicBVH may have ids that are not smaller than the
+    // number of objects.  These are left out and get no position.
+    using ExecutionSpace = typename DeviceType::execution_space;
+    Kokkos::View<int *, DeviceType> leaf_positions( "leaf_positions", n );
+    fill( leaf_positions, -1 );
+    Kokkos::View<int *, DeviceType> indices = _indices;
+    Kokkos::parallel_for( REGION_NAME( "compute_leaf_positions" ),
+                          Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
+                          KOKKOS_LAMBDA( int i ) {
+                              if ( indices( i ) < n )
+                                  leaf_positions( indices( i ) ) = i;
+                          } );
+    Kokkos::fence();
+    _leaf_positions = leaf_positions;
+    return _leaf_positions;
+}
+
+template <typename DeviceType>
+void BVH<DeviceType>::save( std::ostream &os ) const
+{
+    Details::TreeSerialization<DeviceType>::save( *this, os );
+}
+
+template <typename DeviceType>
+void BVH<DeviceType>::save( std::string const &filename ) const
+{
+    std::ofstream os( filename, std::ios::binary );
+    DTK_INSIST( os.is_open() );
+    save( os );
+}
+
+template <typename DeviceType>
+BVH<DeviceType> BVH<DeviceType>::load( char const *buffer, std::size_t size )
+{
+    return Details::TreeSerialization<DeviceType>::load( buffer, size );
+}
+
+template <typename DeviceType>
+BVH<DeviceType> BVH<DeviceType>::load( std::string const &filename )
+{
+    std::ifstream is( filename, std::ios::binary );
+    DTK_INSIST( is.is_open() );
+    std::vector<char> buffer( ( std::istreambuf_iterator<char>( is ) ),
+                              std::istreambuf_iterator<char>() );
+    return load( buffer.data(), buffer.size() );
 }
 
 } // end namespace DataTransferKit
@@ -0,0 +1,120 @@
+/****************************************************************************
+ * Copyright (c) 2012-2017 by the DataTransferKit authors                   *
+ * All rights reserved.                                                     *
+ *                                                                          *
+ * This file is part of the DataTransferKit library. DataTransferKit is     *
+ * distributed under a BSD 3-clause license. For the licensing terms see    *
+ * the LICENSE file in the top-level directory.                             *
+ ****************************************************************************/
+
+#ifndef DTK_UNIFORMGRID_DECL_HPP
+#define DTK_UNIFORMGRID_DECL_HPP
+
+#include <Kokkos_View.hpp>
+
+#include <DTK_DetailsBox.hpp>
+#include <DTK_DetailsGridTraversal.hpp>
+#include <DTK_DetailsPredicate.hpp>
+#include <DTK_DetailsQueryDispatch.hpp>
+
+#include "DTK_ConfigDefs.hpp"
+
+namespace DataTransferKit
+{
+
+/**
+ * Uniform grid of cells with lists of the objects they contain.  Objects are
+ * binned according to the centroid of their bounding box.  The grid is
+ * cheaper to build than a BVH and is well suited for quasi-uniform
+ * distributions of objects of similar sizes.  It provides the same query
+ * interface as BVH, except that objects do not hold tags and predicates that
+ * carry a mask are rejected.
+ */
+template <typename DeviceType>
+class UniformGrid
+{
+  public:
+    /** \brief Bins the objects in a grid that covers their bounding boxes.
+     *
+     *  \param[in] bounding_boxes Bounding boxes of the objects.
+     *  \param[in] cell_size Length of the sides of the cells.  When it is not
+     *  positive, it is chosen so that there is about one object per cell.
+     */
+    UniformGrid( Kokkos::View<Box const *, DeviceType> bounding_boxes,
+                 double cell_size = 0. );
+
+    // Views are passed by reference here because internally Kokkos::realloc()
+    // is called.
+    template <typename Query>
+    void query( Kokkos::View<Query *, DeviceType> queries,
+                Kokkos::View<int *, DeviceType> &indices,
+                Kokkos::View<int *, DeviceType> &offset ) const;
+    template <typename Query>
+    typename std::enable_if<
+        std::is_same<typename Query::Tag, Details::NearestPredicateTag>::value,
+        void>::type
+    query( Kokkos::View<Query *, DeviceType> queries,
+           Kokkos::View<int *, DeviceType> &indices,
+           Kokkos::View<int *, DeviceType> &offset,
+           Kokkos::View<double *, DeviceType> &distances ) const;
+
+    KOKKOS_INLINE_FUNCTION
+    Box bounds() const { return _bounds; }
+
+    using SizeType = typename Kokkos::View<int *, DeviceType>::size_type;
+    KOKKOS_INLINE_FUNCTION
+    SizeType size() const { return _indices.extent( 0 ); }
+
+    KOKKOS_INLINE_FUNCTION
+    bool empty() const { return size() == 0; }
+
+  private:
+    friend struct Details::GridTraversal<DeviceType>;
+
+    Box _bounds;
+    int _n_cells[3];
+    double _cell_size[3];
+    // Largest half-extent of the objects along each dimension.  An object is
+    // contained within that distance of the cell that holds its centroid.
+    double _half_extent[3];
+    /**
+     * Bounding boxes of the objects sorted by cell and their original
+     * indices.  The objects in cell \c c are stored in the range
+     * [_cell_offset(c), _cell_offset(c+1)).
+     */
+    Kokkos::View<Box *, DeviceType> _boxes;
+    Kokkos::View<int *, DeviceType> _indices;
+    Kokkos::View<int *, DeviceType> _cell_offset;
+};
+
+template <typename DeviceType>
+template <typename Query>
+void UniformGrid<DeviceType>::query(
+    Kokkos::View<Query *, DeviceType> queries,
+    Kokkos::View<int *, DeviceType> &indices,
+    Kokkos::View<int *, DeviceType> &offset ) const
+{
+    using Tag = typename Query::Tag;
+    Details::queryDispatch<Details::GridTraversal<DeviceType>>(
+        *this, queries, indices, offset, Tag{} );
+}
+
+template <typename DeviceType>
+template <typename Query>
+typename std::enable_if<
+    std::is_same<typename Query::Tag, Details::NearestPredicateTag>::value,
+    void>::type
+UniformGrid<DeviceType>::query(
+    Kokkos::View<Query *, DeviceType> queries,
+    Kokkos::View<int *, DeviceType> &indices,
+    Kokkos::View<int *, DeviceType> &offset,
+    Kokkos::View<double *, DeviceType> &distances ) const
+{
+    using Tag = typename Query::Tag;
+    Details::queryDispatch<Details::GridTraversal<DeviceType>>(
+        *this, queries, indices, offset, Tag{}, &distances );
+}
+
+} // end namespace DataTransferKit
+
+#endif
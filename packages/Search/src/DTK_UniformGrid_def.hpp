@@ -0,0 +1,156 @@
+/****************************************************************************
+ * Copyright (c) 2012-2017 by the DataTransferKit authors                   *
+ * All rights reserved.                                                     *
+ *                                                                          *
+ * This file is part of the DataTransferKit library. DataTransferKit is     *
+ * distributed under a BSD 3-clause license. For the licensing terms see    *
+ * the LICENSE file in the top-level directory.                             *
+ ****************************************************************************/
+
+#ifndef DTK_UNIFORMGRID_DEF_HPP
+#define DTK_UNIFORMGRID_DEF_HPP
+
+#include "DTK_ConfigDefs.hpp"
+
+#include <DTK_DBC.hpp>
+#include <DTK_DetailsAlgorithms.hpp>
+#include <DTK_DetailsTreeConstruction.hpp>
+#include <DTK_DetailsUtils.hpp>
+#include <DTK_KokkosHelpers.hpp>
+
+#include <Kokkos_Atomic.hpp>
+
+#include <cmath>
+#include <limits>
+
+namespace DataTransferKit
+{
+
+template <typename DeviceType>
+UniformGrid<DeviceType>::UniformGrid(
+    Kokkos::View<Box const *, DeviceType> bounding_boxes, double cell_size )
+    : _boxes( "sorted_boxes", bounding_boxes.extent( 0 ) )
+    , _indices( "sorted_indices", bounding_boxes.extent( 0 ) )
+{
+    using ExecutionSpace = typename DeviceType::execution_space;
+
+    int const n = bounding_boxes.extent( 0 );
+
+    for ( int d = 0; d < 3; ++d )
+    {
+        _n_cells[d] = 1;
+        _cell_size[d] = 1.;
+        _half_extent[d] = 0.;
+    }
+
+    if ( empty() )
+    {
+        Kokkos::realloc( _cell_offset, 2 );
+        fill( _cell_offset, 0 );
+        return;
+    }
+
+    // determine the bounding box of the scene
+    Details::TreeConstruction<DeviceType>::calculateBoundingBoxOfTheScene(
+        bounding_boxes, _bounds );
+
+    // The largest half-extent of the objects is obtained by centering all
+    // the boxes at the origin and taking the bounding box of the result.
+    Kokkos::View<Box *, DeviceType> centered_boxes( "centered_boxes", n );
+    Kokkos::parallel_for( REGION_NAME( "center_bounding_boxes" ),
+                          Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
+                          KOKKOS_LAMBDA( int i ) {
+                              Point c;
+                              Details::centroid( bounding_boxes( i ), c );
+                              for ( int d = 0; d < 3; ++d )
+                              {
+                                  centered_boxes( i )[2 * d + 0] =
+                                      bounding_boxes( i )[2 * d + 0] - c[d];
+                                  centered_boxes( i )[2 * d + 1] =
+                                      bounding_boxes( i )[2 * d + 1] - c[d];
+                              }
+                          } );
+    Kokkos::fence();
+    Box centered_bounds;
+    Details::TreeConstruction<DeviceType>::calculateBoundingBoxOfTheScene(
+        centered_boxes, centered_bounds );
+    for ( int d = 0; d < 3; ++d )
+        _half_extent[d] = centered_bounds[2 * d + 1];
+
+    // When the size of the cells is not provided, choose it so that the
+    // number of cells is about the number of objects.
+    double extent[3];
+    for ( int d = 0; d < 3; ++d )
+        extent[d] = _bounds[2 * d + 1] - _bounds[2 * d + 0];
+    if ( !( cell_size > 0. ) )
+    {
+        int n_dimensions;
+        cell_size = Details::defaultCellSize( _bounds, n, n_dimensions );
+    }
+
+    double n_cells = 1.;
+    for ( int d = 0; d < 3; ++d )
+        if ( extent[d] > 0. && cell_size > 0. )
+        {
+            _n_cells[d] = static_cast<int>( KokkosHelpers::min(
+                std::ceil( extent[d] / cell_size ),
+                static_cast<double>( std::numeric_limits<int>::max() ) ) );
+            _n_cells[d] = KokkosHelpers::max( _n_cells[d], 1 );
+            _cell_size[d] = extent[d] / _n_cells[d];
+            n_cells *= _n_cells[d];
+        }
+    DTK_INSIST( n_cells < std::numeric_limits<int>::max() );
+
+    // counting sort of the objects by cell
+    UniformGrid<DeviceType> const grid = *this;
+    int const n_cells_total = static_cast<int>( n_cells );
+    Kokkos::View<int *, DeviceType> cell_indices( "cell_indices", n );
+    Kokkos::realloc( _cell_offset, n_cells_total + 1 );
+    fill( _cell_offset, 0 );
+    Kokkos::View<int *, DeviceType> cell_offset = _cell_offset;
+    Kokkos::parallel_for(
+        REGION_NAME( "count_objects_per_cell" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n ), KOKKOS_LAMBDA( int i ) {
+            Point c;
+            Details::centroid( bounding_boxes( i ), c );
+            int const cell =
+                Details::GridTraversal<DeviceType>::flattenCellIndex(
+                    grid,
+                    Details::GridTraversal<DeviceType>::cellIndex( grid, c[0],
+                                                                   0 ),
+                    Details::GridTraversal<DeviceType>::cellIndex( grid, c[1],
+                                                                   1 ),
+                    Details::GridTraversal<DeviceType>::cellIndex( grid, c[2],
+                                                                   2 ) );
+            cell_indices( i ) = cell;
+            Kokkos::atomic_increment( &cell_offset( cell ) );
+        } );
+    Kokkos::fence();
+
+    exclusivePrefixSum( _cell_offset );
+
+    Kokkos::View<int *, DeviceType> cell_cursor( "cell_cursor",
+                                                 n_cells_total );
+    Kokkos::deep_copy(
+        cell_cursor,
+        Kokkos::subview( _cell_offset, std::make_pair( 0, n_cells_total ) ) );
+    Kokkos::View<Box *, DeviceType> boxes = _boxes;
+    Kokkos::View<int *, DeviceType> indices = _indices;
+    Kokkos::parallel_for(
+        REGION_NAME( "sort_objects_by_cell" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n ), KOKKOS_LAMBDA( int i ) {
+            int const pos = Kokkos::atomic_fetch_add(
+                &cell_cursor( cell_indices( i ) ), 1 );
+            boxes( pos ) = bounding_boxes( i );
+            indices( pos ) = i;
+        } );
+    Kokkos::fence();
+}
+
+} // end namespace DataTransferKit
+
+// Explicit instantiation macro
+#define DTK_UNIFORMGRID_INSTANT( NODE )                                        \
+    template class UniformGrid<typename NODE::device_type>;
+
+#endif
@@ -26,5 +26,41 @@ void expand( Box &box, Point const &point )
     }
 }
 
+double defaultCellSize( Box const &bounds, int n_objects, int &n_dimensions )
+{
+    // Dimensions along which the box is thinner than a cell only get one
+    // layer of cells and are left out of the volume.  Leaving one out makes
+    // the cells larger, which may in turn make another one thinner than a
+    // cell, hence the loop.
+    double extent[3];
+    bool flat[3];
+    for ( int d = 0; d < 3; ++d )
+    {
+        extent[d] = bounds[2 * d + 1] - bounds[2 * d + 0];
+        flat[d] = !( extent[d] > 0. );
+    }
+    while ( true )
+    {
+        double volume = 1.;
+        n_dimensions = 0;
+        for ( int d = 0; d < 3; ++d )
+            if ( !flat[d] )
+            {
+                volume *= extent[d];
+                ++n_dimensions;
+            }
+        if ( n_dimensions == 0 || n_objects <= 0 )
+            return 0.;
+        double const cell_size =
+            std::pow( volume / n_objects, 1. / n_dimensions );
+        bool thin = false;
+        for ( int d = 0; d < 3; ++d )
+            if ( !flat[d] && extent[d] < cell_size )
+                flat[d] = thin = true;
+        if ( !thin )
+            return cell_size;
+    }
+}
+
 } // end namespace Details
 } // end namespace DataTransferKit
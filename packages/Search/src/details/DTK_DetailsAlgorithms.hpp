@@ -49,9 +49,29 @@ double distance( Point const &point, Box const &box )
     return distance( point, projected_point );
 }
 
+// distance from a point to the furthest point of a box
+KOKKOS_INLINE_FUNCTION
+double maxDistance( Point const &point, Box const &box )
+{
+    Point furthest_point;
+    for ( int d = 0; d < 3; ++d )
+    {
+        if ( point[d] - box[2 * d + 0] > box[2 * d + 1] - point[d] )
+            furthest_point[d] = box[2 * d + 0];
+        else
+            furthest_point[d] = box[2 * d + 1];
+    }
+    return distance( point, furthest_point );
+}
+
 // expand an axis-aligned bounding box to include a point
 void expand( Box &box, Point const &point );
 
+// size of the cells of a uniform grid over the box with about one cell per
+// object, and number of dimensions along which the grid has more than one
+// layer of cells
+double defaultCellSize( Box const &bounds, int n_objects, int &n_dimensions );
+
 // expand an axis-aligned bounding box to include another box
 KOKKOS_INLINE_FUNCTION
 void expand( Box &box, Box const &other )
@@ -84,6 +104,38 @@ void centroid( Box const &box, Point &c )
         c[d] = 0.5 * ( box[2 * d + 0] + box[2 * d + 1] );
 }
 
+// calculate the surface area of a box (zero if the box is empty)
+KOKKOS_INLINE_FUNCTION
+double surfaceArea( Box const &box )
+{
+    double extent[3];
+    for ( int d = 0; d < 3; ++d )
+    {
+        extent[d] = box[2 * d + 1] - box[2 * d + 0];
+        if ( extent[d] < 0. )
+            return 0.;
+    }
+    return 2. * ( extent[0] * extent[1] + extent[1] * extent[2] +
+                  extent[2] * extent[0] );
+}
+
+// calculate the volume of the intersection of two boxes
+KOKKOS_INLINE_FUNCTION
+double overlapVolume( Box const &box, Box const &other )
+{
+    double volume = 1.;
+    for ( int d = 0; d < 3; ++d )
+    {
+        double const extent =
+            KokkosHelpers::min( box[2 * d + 1], other[2 * d + 1] ) -
+            KokkosHelpers::max( box[2 * d + 0], other[2 * d + 0] );
+        if ( extent <= 0. )
+            return 0.;
+        volume *= extent;
+    }
+    return volume;
+}
+
 template <typename DeviceType>
 class ExpandBoxWithBoxFunctor
 {
@@ -9,16 +9,133 @@
 #ifndef DTK_DETAILS_DISTRIBUTED_SEARCH_TREE_IMPL_HPP
 #define DTK_DETAILS_DISTRIBUTED_SEARCH_TREE_IMPL_HPP
 
+#include <DTK_DetailsHierarchicalDistributor.hpp>
+#include <DTK_DetailsTreeConstruction.hpp>
 #include <DTK_LinearBVH.hpp>
 #include <details/DTK_DetailsPredicate.hpp>
-#include <details/DTK_DetailsPriorityQueue.hpp>
 #include <details/DTK_DetailsUtils.hpp>
 
 #include <Kokkos_Atomic.hpp>
 #include <Kokkos_Sort.hpp>
+#include <Teuchos_ArrayRCP.hpp>
+#include <Teuchos_CommHelpers.hpp>
 #include <Teuchos_SerializationTraits.hpp>
 #include <Tpetra_Distributor.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace DataTransferKit
+{
+namespace Details
+{
+// Payloads exchanged between processes.  Everything that is sent for an item
+// is packed into a single struct so that each direction takes one round of
+// communication.  The rank of the sender is not part of the payload since it
+// can be recovered from the communication plan.  The results carry the rank
+// of the process that owns the object found instead, which differs from the
+// sender when the objects were repartitioned.
+template <typename Query>
+struct ForwardedQuery
+{
+    Query query;
+    int query_id;
+};
+
+struct ForwardedResult
+{
+    int index;
+    int rank;
+    int query_id;
+};
+
+struct ForwardedNearestResult
+{
+    int index;
+    int rank;
+    int query_id;
+    double distance;
+};
+
+// Object moved to another process when repartitioning.
+struct ForwardedBox
+{
+    Box box;
+    int index;
+};
+
+// Nearest neighbors query with a bound on the distance to its k-th nearest
+// neighbor that is used to prune the search.
+template <typename Query>
+struct BoundedQuery
+{
+    Query query;
+    double radius;
+};
+
+// Queries that a process hands over to a less loaded one.
+struct HandOver
+{
+    int donor;
+    int helper;
+    int n_queries;
+};
+
+inline bool operator==( HandOver const &l, HandOver const &r )
+{
+    return l.donor == r.donor && l.helper == r.helper &&
+           l.n_queries == r.n_queries;
+}
+
+// Max-heap of positions in the array of distances, ordered by the distances
+// they point to.  The heap is stored in heap(first), ..., heap(first+size-1).
+template <typename DeviceType>
+KOKKOS_INLINE_FUNCTION void
+siftUp( Kokkos::View<int *, DeviceType> heap, int first, int i,
+        Kokkos::View<double *, DeviceType> distances )
+{
+    while ( i > 0 )
+    {
+        int const parent = ( i - 1 ) / 2;
+        if ( !( distances( heap( first + parent ) ) <
+                distances( heap( first + i ) ) ) )
+            return;
+        int const tmp = heap( first + parent );
+        heap( first + parent ) = heap( first + i );
+        heap( first + i ) = tmp;
+        i = parent;
+    }
+}
+
+template <typename DeviceType>
+KOKKOS_INLINE_FUNCTION void
+siftDown( Kokkos::View<int *, DeviceType> heap, int first, int size, int i,
+          Kokkos::View<double *, DeviceType> distances )
+{
+    while ( true )
+    {
+        int largest = i;
+        for ( int child = 2 * i + 1; child <= 2 * i + 2 && child < size;
+              ++child )
+            if ( distances( heap( first + largest ) ) <
+                 distances( heap( first + child ) ) )
+                largest = child;
+        if ( largest == i )
+            return;
+        int const tmp = heap( first + largest );
+        heap( first + largest ) = heap( first + i );
+        heap( first + i ) = tmp;
+        i = largest;
+    }
+}
+} // end namespace Details
+} // end namespace DataTransferKit
+
 namespace Teuchos
 {
 
@@ -35,11 +152,41 @@ class SerializationTraits<Ordinal, DataTransferKit::Details::Nearest>
 {
 };
 
+template <typename Ordinal, typename Query>
+class SerializationTraits<Ordinal,
+                          DataTransferKit::Details::ForwardedQuery<Query>>
+    : public DirectSerializationTraits<
+          Ordinal, DataTransferKit::Details::ForwardedQuery<Query>>
+{
+};
+template <typename Ordinal>
+class SerializationTraits<Ordinal, DataTransferKit::Details::ForwardedBox>
+    : public DirectSerializationTraits<Ordinal,
+                                       DataTransferKit::Details::ForwardedBox>
+{
+};
+template <typename Ordinal>
+class SerializationTraits<Ordinal, DataTransferKit::Details::ForwardedResult>
+    : public DirectSerializationTraits<
+          Ordinal, DataTransferKit::Details::ForwardedResult>
+{
+};
+template <typename Ordinal>
+class SerializationTraits<Ordinal,
+                          DataTransferKit::Details::ForwardedNearestResult>
+    : public DirectSerializationTraits<
+          Ordinal, DataTransferKit::Details::ForwardedNearestResult>
+{
+};
+
 } // end namespace Teuchos
 
 namespace DataTransferKit
 {
 
+template <typename DeviceType>
+class DistributedQueryPlan;
+
 template <typename DeviceType>
 struct DistributedSearchTreeImpl
 {
@@ -47,54 +194,238 @@ struct DistributedSearchTreeImpl
 
     // spatial queries
     template <typename Query>
-    static void queryDispatch( Teuchos::RCP<Teuchos::Comm<int> const> comm,
-                               BVH<DeviceType> const &distributed_tree,
-                               BVH<DeviceType> const &local_tree,
-                               Kokkos::View<Query *, DeviceType> queries,
-                               Kokkos::View<int *, DeviceType> &indices,
-                               Kokkos::View<int *, DeviceType> &offset,
-                               Kokkos::View<int *, DeviceType> &ranks,
-                               Details::SpatialPredicateTag );
+    static void
+    queryDispatch( Teuchos::RCP<Teuchos::Comm<int> const> comm,
+                   BVH<DeviceType> const &distributed_tree,
+                   Kokkos::View<int *, DeviceType> box_ranks,
+                   BVH<DeviceType> const &local_tree,
+                   Kokkos::View<int *, DeviceType> original_ranks,
+                   Kokkos::View<int *, DeviceType> original_indices,
+                   Kokkos::View<Query *, DeviceType> queries,
+                   Kokkos::View<int *, DeviceType> &indices,
+                   Kokkos::View<int *, DeviceType> &offset,
+                   Kokkos::View<int *, DeviceType> &ranks,
+                   Details::SpatialPredicateTag,
+                   DistributedQueryPlan<DeviceType> *plan_ptr = nullptr );
 
     // nearest neighbors queries
     template <typename Query>
     static void queryDispatch(
         Teuchos::RCP<Teuchos::Comm<int> const> comm,
         BVH<DeviceType> const &distributed_tree,
+        Kokkos::View<int *, DeviceType> box_ranks,
         BVH<DeviceType> const &local_tree,
+        Kokkos::View<int *, DeviceType> original_ranks,
+        Kokkos::View<int *, DeviceType> original_indices,
         Kokkos::View<Query *, DeviceType> queries,
         Kokkos::View<int *, DeviceType> &indices,
         Kokkos::View<int *, DeviceType> &offset,
         Kokkos::View<int *, DeviceType> &ranks, Details::NearestPredicateTag,
+        DistributedQueryPlan<DeviceType> *plan_ptr = nullptr,
         Kokkos::View<double *, DeviceType> *distances_ptr = nullptr );
 
+    // Forwards the nearest neighbors queries to the processes given by
+    // indices and offset and searches the local tree.  The results are
+    // grouped by the process that found them in increasing order and ids
+    // gives the query each of them belongs to.
     template <typename Query>
-    static void deviseStrategy( Point epsilon,
-                                Kokkos::View<Query *, DeviceType> queries,
-                                BVH<DeviceType> const &bvh,
-                                Kokkos::View<int *, DeviceType> &indices,
-                                Kokkos::View<int *, DeviceType> &offset );
+    static void forwardNearestQueries(
+        Teuchos::RCP<Teuchos::Comm<int> const> comm,
+        BVH<DeviceType> const &local_tree,
+        Kokkos::View<int *, DeviceType> original_ranks,
+        Kokkos::View<int *, DeviceType> original_indices,
+        Kokkos::View<Details::BoundedQuery<Query> *, DeviceType> queries,
+        Kokkos::View<int *, DeviceType> indices,
+        Kokkos::View<int *, DeviceType> offset,
+        Kokkos::View<int *, DeviceType> &ids,
+        Kokkos::View<int *, DeviceType> &results,
+        Kokkos::View<int *, DeviceType> &ranks,
+        Kokkos::View<double *, DeviceType> &distances,
+        DistributedQueryPlan<DeviceType> *plan_ptr, int round );
+
+    template <typename Query>
+    static void searchLocalTree(
+        BVH<DeviceType> const &local_tree,
+        Kokkos::View<Details::BoundedQuery<Query> *, DeviceType> queries,
+        Kokkos::View<int *, DeviceType> &indices,
+        Kokkos::View<int *, DeviceType> &offset,
+        Kokkos::View<double *, DeviceType> &distances );
+
+    // Bounding boxes of the objects of the tree, by index.
+    static Kokkos::View<Box *, DeviceType>
+    boundingBoxes( BVH<DeviceType> const &tree );
+
+    // Removes the results with a negative index, i.e. the slots left empty
+    // when fewer than k nearest neighbors were found.
+    static void discardInvalidResults(
+        Kokkos::View<int *, DeviceType> &indices,
+        Kokkos::View<int *, DeviceType> &offset,
+        Kokkos::View<double *, DeviceType> *distances_ptr = nullptr );
 
+    // Merges the results of the second round of the nearest neighbors
+    // queries into the ones of the first round.  The results of each query
+    // are kept in increasing order of the ranks, unless the objects were
+    // repartitioned.
+    static void
+    mergeRounds( Kokkos::View<int *, DeviceType> more_indices,
+                 Kokkos::View<int *, DeviceType> more_offset,
+                 Kokkos::View<int *, DeviceType> more_ranks,
+                 Kokkos::View<double *, DeviceType> more_distances,
+                 Kokkos::View<int *, DeviceType> &indices,
+                 Kokkos::View<int *, DeviceType> &offset,
+                 Kokkos::View<int *, DeviceType> &ranks,
+                 Kokkos::View<double *, DeviceType> &distances );
+
+    // Removes from the processes given by indices and offset the ones that
+    // were already searched, given in the same format.
+    static void
+    removeSearchedRanks( Kokkos::View<int *, DeviceType> searched_indices,
+                         Kokkos::View<int *, DeviceType> searched_offset,
+                         Kokkos::View<int *, DeviceType> &indices,
+                         Kokkos::View<int *, DeviceType> &offset );
+
+    // Moves the objects so that every process owns about as many objects,
+    // and these are consecutive along the Z-order curve.  Returns the
+    // bounding boxes of the objects that end up on the calling process, and
+    // the rank and index of each of them before it was moved.
+    static Kokkos::View<Box *, DeviceType>
+    repartition( Teuchos::RCP<Teuchos::Comm<int> const> comm,
+                 Kokkos::View<Box const *, DeviceType> bounding_boxes,
+                 Kokkos::View<int *, DeviceType> &original_ranks,
+                 Kokkos::View<int *, DeviceType> &original_indices );
+
+    // Sets the ranks of the objects of the local tree found by the calling
+    // process to the ones of their owners.  When the objects were
+    // repartitioned, their indices are also replaced by the ones they had
+    // before.  Otherwise original_ranks is empty and the calling process owns
+    // them.
+    static void
+    mapResultsToOwners( int comm_rank,
+                        Kokkos::View<int *, DeviceType> original_ranks,
+                        Kokkos::View<int *, DeviceType> original_indices,
+                        Kokkos::View<int *, DeviceType> indices,
+                        Kokkos::View<int *, DeviceType> &ranks );
+
+    // Replaces the leaves of the distributed tree found for each query by the
+    // ranks of the processes they belong to, without duplicates.
+    static void mapBoxesToRanks( Kokkos::View<int *, DeviceType> box_ranks,
+                                 Kokkos::View<int *, DeviceType> &indices,
+                                 Kokkos::View<int *, DeviceType> &offset );
+
+    // Removes the pairs (query, process) given by indices and offset where the
+    // process is the calling one and extracts these queries so that they can
+    // be performed directly on the local tree.
     template <typename Query>
-    static void forwardQueries( Teuchos::RCP<Teuchos::Comm<int> const> comm,
+    static void splitQueries( int comm_rank,
+                              Kokkos::View<Query *, DeviceType> queries,
+                              Kokkos::View<int *, DeviceType> &indices,
+                              Kokkos::View<int *, DeviceType> &offset,
+                              Kokkos::View<Query *, DeviceType> &local_queries,
+                              Kokkos::View<int *, DeviceType> &local_ids );
+
+    // Adds the results of the queries performed on the local tree to the ones
+    // received from the other processes.
+    static void mergeLocalResults(
+        int comm_rank, Kokkos::View<int *, DeviceType> local_ids,
+        Kokkos::View<int *, DeviceType> local_indices,
+        Kokkos::View<int *, DeviceType> local_offset,
+        Kokkos::View<int *, DeviceType> local_ranks,
+        Kokkos::View<double *, DeviceType> local_distances,
+        Kokkos::View<int *, DeviceType> &ids,
+        Kokkos::View<int *, DeviceType> &indices,
+        Kokkos::View<int *, DeviceType> &ranks,
+        Kokkos::View<double *, DeviceType> *distances_ptr = nullptr );
+
+    // Sets up the plan to forward the queries to the processes given by
+    // indices and offset, or returns the cached one when none of the
+    // processes sends its queries elsewhere than when it was set up.
+    static std::shared_ptr<Details::HierarchicalDistributor>
+    setupCommunicationPlan( Teuchos::RCP<Teuchos::Comm<int> const> comm,
+                            Kokkos::View<int *, DeviceType> indices,
+                            Kokkos::View<int *, DeviceType> offset,
+                            DistributedQueryPlan<DeviceType> *plan_ptr,
+                            int round = 0 );
+
+    // Sets up the plan to hand the queries over to the processes given by
+    // indices and offset, or returns the cached one when the hand-overs are
+    // the same as when it was set up.
+    static std::shared_ptr<Details::HierarchicalDistributor>
+    setupCommunicationPlan( Teuchos::RCP<Teuchos::Comm<int> const> comm,
+                            std::vector<Details::HandOver> const &hand_overs,
+                            Kokkos::View<int *, DeviceType> indices,
+                            Kokkos::View<int *, DeviceType> offset,
+                            DistributedQueryPlan<DeviceType> &plan,
+                            int round );
+
+    // Sends the items given by indices and offset, through the node leaders
+    // if the plan aggregates the messages by node.
+    static std::shared_ptr<Details::HierarchicalDistributor>
+    createDistributor( Teuchos::RCP<Teuchos::Comm<int> const> comm,
+                       Kokkos::View<int *, DeviceType> indices,
+                       Kokkos::View<int *, DeviceType> offset,
+                       DistributedQueryPlan<DeviceType> *plan_ptr );
+
+    // overlapped_work() is called while the queries are in flight.
+    template <typename Distributor, typename Query, typename Function>
+    static void forwardQueries( Distributor &distributor,
                                 Kokkos::View<Query *, DeviceType> queries,
                                 Kokkos::View<int *, DeviceType> indices,
                                 Kokkos::View<int *, DeviceType> offset,
                                 Kokkos::View<Query *, DeviceType> &fwd_queries,
                                 Kokkos::View<int *, DeviceType> &fwd_ids,
-                                Kokkos::View<int *, DeviceType> &fwd_ranks );
-
-    static void communicateResultsBack(
+                                Kokkos::View<int *, DeviceType> &fwd_ranks,
+                                Function const &overlapped_work );
+
+    // Performs the queries received from the other processes.  When the plan
+    // balances the loads, the queries that are handed over are searched with
+    // the copy of the local tree of the calling process held by the helper
+    // and their results are returned to the calling process.  search(tree,
+    // queries, indices, offset, distances_ptr) searches a tree.
+    template <typename Query, typename Search>
+    static void performForwardedQueries(
         Teuchos::RCP<Teuchos::Comm<int> const> comm,
+        BVH<DeviceType> const &local_tree,
+        Kokkos::View<Query *, DeviceType> fwd_queries, int n_local_queries,
+        Kokkos::View<int *, DeviceType> &indices,
+        Kokkos::View<int *, DeviceType> &offset,
+        Kokkos::View<double *, DeviceType> *distances_ptr,
+        DistributedQueryPlan<DeviceType> *plan_ptr, int round,
+        Search const &search );
+
+    // Decides how many queries the processes hand over to which others,
+    // given the number of queries each of them performs and how many of these
+    // were received from other processes.  The most loaded processes hand
+    // queries over first, to the least loaded ones, and every process helps
+    // at most one other.
+    static std::vector<Details::HandOver>
+    balanceLoads( std::vector<int> const &loads,
+                  std::vector<int> const &n_movable, double max_imbalance );
+
+    // Sends a copy of the local tree to the processes that help the calling
+    // one and do not hold one yet.
+    static void
+    replicateLocalTrees( Teuchos::RCP<Teuchos::Comm<int> const> comm,
+                         BVH<DeviceType> const &local_tree,
+                         std::vector<Details::HandOver> const &hand_overs,
+                         DistributedQueryPlan<DeviceType> &plan );
+
+    // Sends the results back along the reverse of the communication plan
+    // that was used to forward the queries.  ranks gives the owners of the
+    // objects found and is replaced by the ones of the results received.
+    template <typename Distributor>
+    static void communicateResultsBack(
+        Distributor &distributor,
         Kokkos::View<int *, DeviceType> &indices,
         Kokkos::View<int *, DeviceType> offset,
         Kokkos::View<int *, DeviceType> &ranks,
         Kokkos::View<int *, DeviceType> &ids,
         Kokkos::View<double *, DeviceType> *distances_ptr = nullptr );
 
+    // Keeps the k nearest results of every query, sorted by increasing
+    // distance.  There may be any number of candidates per query.
     template <typename Query>
     static void filterResults( Kokkos::View<Query *, DeviceType> queries,
-                               Kokkos::View<double *, DeviceType> distances,
+                               Kokkos::View<double *, DeviceType> &distances,
                                Kokkos::View<int *, DeviceType> &indices,
                                Kokkos::View<int *, DeviceType> &offset,
                                Kokkos::View<int *, DeviceType> &ranks );
@@ -104,6 +435,12 @@ struct DistributedSearchTreeImpl
                  Kokkos::View<int *, DeviceType> ranks,
                  Kokkos::View<double *, DeviceType> *distances_ptr = nullptr );
 
+    // Ranks of the processes that sent the items received with the
+    // distributor, in the order they are received.
+    template <typename Distributor>
+    static void getImportRanks( Distributor const &distributor,
+                                Kokkos::View<int *, DeviceType> &ranks );
+
     static void countResults( int n_queries,
                               Kokkos::View<int *, DeviceType> query_ids,
                               Kokkos::View<int *, DeviceType> &offset );
@@ -112,24 +449,34 @@ struct DistributedSearchTreeImpl
     // unfortunately the methods for executing the communication plan (e.g.
     // doPostsAndWaits() in this case) are not declared with the const
     // qualifier in Tpetra.
-    template <typename T>
-    static void sendAcrossNetwork( Tpetra::Distributor &distributor,
+    template <typename Distributor, typename T>
+    static void sendAcrossNetwork( Distributor &distributor,
                                    Kokkos::View<T *, DeviceType> exports,
                                    Kokkos::View<T *, DeviceType> imports );
 
-    static double epsilon;
-};
+    // Same as above but calls overlapped_work() after posting the messages
+    // and before waiting for them to complete.
+    template <typename Distributor, typename T, typename Function>
+    static void sendAcrossNetwork( Distributor &distributor,
+                                   Kokkos::View<T *, DeviceType> exports,
+                                   Kokkos::View<T *, DeviceType> imports,
+                                   Function const &overlapped_work );
 
-// Default value for epsilon matches the inclusion tolerance in DTK-2.0 which
-// is arbitrary and might need adjustement in client code.  See
-// https://github.com/ORNL-CEES/DataTransferKit/blob/dtk-2.0/packages/Operators/src/Search/DTK_CoarseGlobalSearch.cpp#L61
-template <typename DeviceType>
-double DistributedSearchTreeImpl<DeviceType>::epsilon = 1.0e-6;
+    // Same as above in the reverse direction, with a variable number of
+    // packets per item.
+    template <typename Distributor, typename T>
+    static void
+    sendBackAcrossNetwork( Distributor &distributor,
+                           Kokkos::View<T *, DeviceType> exports,
+                           Teuchos::ArrayView<std::size_t const> n_exports,
+                           Kokkos::View<T *, DeviceType> imports,
+                           Teuchos::ArrayView<std::size_t const> n_imports );
+};
 
 template <typename DeviceType>
-template <typename T>
+template <typename Distributor, typename T>
 void DistributedSearchTreeImpl<DeviceType>::sendAcrossNetwork(
-    Tpetra::Distributor &distributor, Kokkos::View<T *, DeviceType> exports,
+    Distributor &distributor, Kokkos::View<T *, DeviceType> exports,
     Kokkos::View<T *, DeviceType> imports )
 {
     // NOTE: this function encapsulates the communication from and to views
@@ -149,121 +496,371 @@ void DistributedSearchTreeImpl<DeviceType>::sendAcrossNetwork(
 }
 
 template <typename DeviceType>
-template <typename Query>
-void DistributedSearchTreeImpl<DeviceType>::deviseStrategy(
-    Point epsilon, Kokkos::View<Query *, DeviceType> queries,
-    BVH<DeviceType> const &bvh, Kokkos::View<int *, DeviceType> &indices,
-    Kokkos::View<int *, DeviceType> &offset )
+template <typename Distributor, typename T, typename Function>
+void DistributedSearchTreeImpl<DeviceType>::sendAcrossNetwork(
+    Distributor &distributor, Kokkos::View<T *, DeviceType> exports,
+    Kokkos::View<T *, DeviceType> imports, Function const &overlapped_work )
 {
-    int const n_queries = queries.extent( 0 );
-    Kokkos::View<Details::Overlap *, DeviceType> overlap_queries(
-        "overlap_queries", n_queries );
-
-    Kokkos::parallel_for( REGION_NAME( "fill_overlap_queries" ),
-                          Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
-                          KOKKOS_LAMBDA( int q ) {
-                              Point point = queries( q )._query_point;
-                              Box box( {
-                                  point[0] - epsilon[0], point[0] + epsilon[0],
-                                  point[1] - epsilon[1], point[1] + epsilon[1],
-                                  point[2] - epsilon[2], point[2] + epsilon[2],
-                              } );
-                              overlap_queries( q ) = Details::Overlap( box );
-                          } );
-    Kokkos::fence();
+    // The host buffers must outlive the communication.
+    auto exports_host = Kokkos::create_mirror_view( exports );
+    Kokkos::deep_copy( exports_host, exports );
+    auto imports_host = Kokkos::create_mirror_view( imports );
+    distributor.doPosts(
+        Teuchos::arcp<T const>( exports_host.data(), 0,
+                                exports_host.extent( 0 ), false ),
+        1, Teuchos::arcp<T>( imports_host.data(), 0, imports_host.extent( 0 ),
+                             false ) );
+    overlapped_work();
+    distributor.doWaits();
+    Kokkos::deep_copy( imports, imports_host );
+}
 
-    bvh.query( overlap_queries, indices, offset );
+template <typename DeviceType>
+template <typename Distributor, typename T>
+void DistributedSearchTreeImpl<DeviceType>::sendBackAcrossNetwork(
+    Distributor &distributor, Kokkos::View<T *, DeviceType> exports,
+    Teuchos::ArrayView<std::size_t const> n_exports,
+    Kokkos::View<T *, DeviceType> imports,
+    Teuchos::ArrayView<std::size_t const> n_imports )
+{
+    auto exports_host = Kokkos::create_mirror_view( exports );
+    Kokkos::deep_copy( exports_host, exports );
+    auto imports_host = Kokkos::create_mirror_view( imports );
+    distributor.doReversePostsAndWaits(
+        Teuchos::ArrayView<T const>( exports_host.data(),
+                                     exports_host.extent( 0 ) ),
+        n_exports,
+        Teuchos::ArrayView<T>( imports_host.data(), imports_host.extent( 0 ) ),
+        n_imports );
+    Kokkos::deep_copy( imports, imports_host );
 }
 
 template <typename DeviceType>
 template <typename Query>
 void DistributedSearchTreeImpl<DeviceType>::queryDispatch(
     Teuchos::RCP<Teuchos::Comm<int> const> comm,
-    BVH<DeviceType> const &distributed_tree, BVH<DeviceType> const &local_tree,
+    BVH<DeviceType> const &distributed_tree,
+    Kokkos::View<int *, DeviceType> box_ranks,
+    BVH<DeviceType> const &local_tree,
+    Kokkos::View<int *, DeviceType> original_ranks,
+    Kokkos::View<int *, DeviceType> original_indices,
     Kokkos::View<Query *, DeviceType> queries,
     Kokkos::View<int *, DeviceType> &indices,
     Kokkos::View<int *, DeviceType> &offset,
     Kokkos::View<int *, DeviceType> &ranks, Details::NearestPredicateTag,
+    DistributedQueryPlan<DeviceType> *plan_ptr,
     Kokkos::View<double *, DeviceType> *distances_ptr )
 {
-    // Determine what ranks have local trees that the objects associated with
-    // the nearest neighbors queries oroverlap with when expanded in all
-    // direction by epsilon.
-    // NOTE: epsilon is a static member for now which is far from ideal.
-    deviseStrategy( {{epsilon, epsilon, epsilon}}, queries, distributed_tree,
-                    indices, offset );
+    // The search takes two rounds.  Each query is first sent to the process
+    // that owns the closest box of the distributed tree.  The distance to the
+    // k-th nearest neighbor found there bounds the distance to the actual
+    // k-th nearest neighbor, and the query is then only sent to the other
+    // processes that own a box within that distance.  The bound is passed
+    // along to prune the search on these processes and they only send back
+    // the objects that are within it.
+    int const n_queries = queries.extent_int( 0 );
+    double const infinity = Kokkos::ArithTraits<double>::max();
 
     ////////////////////////////////////////////////////////////////////////////
-    // Forward queries
+    // First round
     ////////////////////////////////////////////////////////////////////////////
+    Kokkos::View<Details::Nearest *, DeviceType> closest_box_queries(
+        "closest_box_queries", n_queries );
+    Kokkos::View<Details::BoundedQuery<Query> *, DeviceType> bounded_queries(
+        "bounded_queries", n_queries );
+    Kokkos::parallel_for(
+        REGION_NAME( "fill_first_round_queries" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
+        KOKKOS_LAMBDA( int q ) {
+            closest_box_queries( q ) =
+                Details::nearest( queries( q )._query_point, 1 );
+            bounded_queries( q ).query = queries( q );
+            bounded_queries( q ).radius = infinity;
+        } );
+    Kokkos::fence();
+
+    Kokkos::View<int *, DeviceType> first_ranks( "first_round_ranks" );
+    Kokkos::View<int *, DeviceType> first_offset( "first_round_offset" );
+    distributed_tree.query( closest_box_queries, first_ranks, first_offset );
+    discardInvalidResults( first_ranks, first_offset );
+    mapBoxesToRanks( box_ranks, first_ranks, first_offset );
+
     Kokkos::View<int *, DeviceType> ids( "query_ids" );
-    Kokkos::View<Query *, DeviceType> fwd_queries( "fwd_queries" );
-    forwardQueries( comm, queries, indices, offset, fwd_queries, ids, ranks );
+    Kokkos::View<double *, DeviceType> distances( "distances" );
+    forwardNearestQueries( comm, local_tree, original_ranks, original_indices,
+                           bounded_queries, first_ranks, first_offset, ids,
+                           indices, ranks, distances, plan_ptr, 0 );
+    countResults( n_queries, ids, offset );
+    sortResults( ids, indices, ranks, &distances );
+
+    // When fewer than k objects were found, the bound comes from the k
+    // nearest boxes of the distributed tree instead.  Each of them holds at
+    // least one object, so the k-th nearest neighbor is not further than the
+    // furthest point of these boxes.  Objects may not match the mask of the
+    // query though, and there is no bound in that case.  Queries that found
+    // k objects look for no boxes.
+    Kokkos::View<Details::Nearest *, DeviceType> nearest_box_queries(
+        "nearest_box_queries", n_queries );
+    Kokkos::parallel_for(
+        REGION_NAME( "fill_nearest_box_queries" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
+        KOKKOS_LAMBDA( int q ) {
+            int const k = queries( q )._k;
+            nearest_box_queries( q ) = Details::nearest(
+                queries( q )._query_point,
+                offset( q + 1 ) - offset( q ) < k ? k : 0 );
+        } );
+    Kokkos::fence();
+    Kokkos::View<int *, DeviceType> box_indices( "nearest_box_indices" );
+    Kokkos::View<int *, DeviceType> box_offset( "nearest_box_offset" );
+    distributed_tree.query( nearest_box_queries, box_indices, box_offset );
+    discardInvalidResults( box_indices, box_offset );
+    Kokkos::View<Box *, DeviceType> boxes = boundingBoxes( distributed_tree );
+
+    Kokkos::View<Details::Within *, DeviceType> within_queries(
+        "within_queries", n_queries );
+    Kokkos::parallel_for(
+        REGION_NAME( "compute_search_bounds" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
+        KOKKOS_LAMBDA( int q ) {
+            Point const &query_point = queries( q )._query_point;
+            int const k = queries( q )._k;
+            double radius = 0.;
+            if ( offset( q + 1 ) - offset( q ) >= k )
+                for ( int i = offset( q ); i < offset( q + 1 ); ++i )
+                    radius = KokkosHelpers::max( radius, distances( i ) );
+            else if ( box_offset( q + 1 ) - box_offset( q ) == k &&
+                      queries( q )._mask == Node::all_tags )
+                for ( int i = box_offset( q ); i < box_offset( q + 1 ); ++i )
+                    radius = KokkosHelpers::max(
+                        radius, Details::maxDistance(
+                                    query_point, boxes( box_indices( i ) ) ) );
+            else
+                radius = infinity;
+            bounded_queries( q ).radius = radius;
+            within_queries( q ) = Details::within( query_point, radius );
+        } );
+    Kokkos::fence();
     ////////////////////////////////////////////////////////////////////////////
 
     ////////////////////////////////////////////////////////////////////////////
-    // Perform queries that have been received
+    // Second round
     ////////////////////////////////////////////////////////////////////////////
-    Kokkos::View<double *, DeviceType> distances( "distances" );
+    Kokkos::View<int *, DeviceType> second_ranks( "second_round_ranks" );
+    Kokkos::View<int *, DeviceType> second_offset( "second_round_offset" );
+    distributed_tree.query( within_queries, second_ranks, second_offset );
+    mapBoxesToRanks( box_ranks, second_ranks, second_offset );
+    removeSearchedRanks( first_ranks, first_offset, second_ranks,
+                         second_offset );
+
+    Kokkos::View<int *, DeviceType> more_ids( "query_ids" );
+    Kokkos::View<int *, DeviceType> more_indices( "indices" );
+    Kokkos::View<int *, DeviceType> more_offset( "offset" );
+    Kokkos::View<int *, DeviceType> more_ranks( "ranks" );
+    Kokkos::View<double *, DeviceType> more_distances( "distances" );
+    forwardNearestQueries( comm, local_tree, original_ranks, original_indices,
+                           bounded_queries, second_ranks, second_offset,
+                           more_ids, more_indices, more_ranks, more_distances,
+                           plan_ptr, 1 );
+    countResults( n_queries, more_ids, more_offset );
+    sortResults( more_ids, more_indices, more_ranks, &more_distances );
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Merge results
+    ////////////////////////////////////////////////////////////////////////////
+    mergeRounds( more_indices, more_offset, more_ranks, more_distances,
+                 indices, offset, ranks, distances );
+    filterResults( queries, distances, indices, offset, ranks );
     if ( distances_ptr )
-        distances = *distances_ptr;
-    local_tree.query( fwd_queries, indices, offset, distances );
+        *distances_ptr = distances;
+    ////////////////////////////////////////////////////////////////////////////
+}
+
+template <typename DeviceType>
+template <typename Query>
+void DistributedSearchTreeImpl<DeviceType>::forwardNearestQueries(
+    Teuchos::RCP<Teuchos::Comm<int> const> comm,
+    BVH<DeviceType> const &local_tree,
+    Kokkos::View<int *, DeviceType> original_ranks,
+    Kokkos::View<int *, DeviceType> original_indices,
+    Kokkos::View<Details::BoundedQuery<Query> *, DeviceType> queries,
+    Kokkos::View<int *, DeviceType> indices,
+    Kokkos::View<int *, DeviceType> offset,
+    Kokkos::View<int *, DeviceType> &ids,
+    Kokkos::View<int *, DeviceType> &results,
+    Kokkos::View<int *, DeviceType> &ranks,
+    Kokkos::View<double *, DeviceType> &distances,
+    DistributedQueryPlan<DeviceType> *plan_ptr, int round )
+{
+    ////////////////////////////////////////////////////////////////////////////
+    // Forward queries and perform the ones that target the local tree while
+    // the others are in flight
+    ////////////////////////////////////////////////////////////////////////////
+    int const comm_rank = comm->getRank();
+    Kokkos::View<Details::BoundedQuery<Query> *, DeviceType> local_queries(
+        "local_queries" );
+    Kokkos::View<int *, DeviceType> local_ids( "local_query_ids" );
+    splitQueries( comm_rank, queries, indices, offset, local_queries,
+                  local_ids );
+    Kokkos::View<int *, DeviceType> local_indices( "local_indices" );
+    Kokkos::View<int *, DeviceType> local_offset( "local_offset" );
+    Kokkos::View<double *, DeviceType> local_distances( "local_distances" );
+
+    Kokkos::View<Details::BoundedQuery<Query> *, DeviceType> fwd_queries(
+        "fwd_queries" );
+    auto distributor =
+        setupCommunicationPlan( comm, indices, offset, plan_ptr, round );
+    forwardQueries( *distributor, queries, indices, offset, fwd_queries, ids,
+                    ranks, [&]() {
+                        searchLocalTree( local_tree, local_queries,
+                                         local_indices, local_offset,
+                                         local_distances );
+                    } );
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Perform queries that have been received
+    ////////////////////////////////////////////////////////////////////////////
+    Kokkos::View<int *, DeviceType> fwd_offset( "fwd_offset" );
+    performForwardedQueries(
+        comm, local_tree, fwd_queries, local_queries.extent_int( 0 ), results,
+        fwd_offset, &distances, plan_ptr, round,
+        []( BVH<DeviceType> const &tree,
+            Kokkos::View<Details::BoundedQuery<Query> *, DeviceType>
+                tree_queries,
+            Kokkos::View<int *, DeviceType> &tree_indices,
+            Kokkos::View<int *, DeviceType> &tree_offset,
+            Kokkos::View<double *, DeviceType> *tree_distances ) {
+            searchLocalTree( tree, tree_queries, tree_indices, tree_offset,
+                             *tree_distances );
+        } );
     ////////////////////////////////////////////////////////////////////////////
 
     ////////////////////////////////////////////////////////////////////////////
     // Communicate results back
     ////////////////////////////////////////////////////////////////////////////
-    communicateResultsBack( comm, indices, offset, ranks, ids, &distances );
+    mapResultsToOwners( comm_rank, original_ranks, original_indices, results,
+                        ranks );
+    communicateResultsBack( *distributor, results, fwd_offset, ranks, ids,
+                            &distances );
     ////////////////////////////////////////////////////////////////////////////
 
     ////////////////////////////////////////////////////////////////////////////
     // Merge results
     ////////////////////////////////////////////////////////////////////////////
-    int const n_queries = queries.extent_int( 0 );
-    countResults( n_queries, ids, offset );
-    sortResults( ids, indices, ranks, &distances );
-    filterResults( queries, distances, indices, offset, ranks );
+    Kokkos::View<int *, DeviceType> local_ranks( "local_ranks" );
+    mapResultsToOwners( comm_rank, original_ranks, original_indices,
+                        local_indices, local_ranks );
+    mergeLocalResults( comm_rank, local_ids, local_indices, local_offset,
+                       local_ranks, local_distances, ids, results, ranks,
+                       &distances );
     ////////////////////////////////////////////////////////////////////////////
 }
 
+template <typename DeviceType>
+template <typename Query>
+void DistributedSearchTreeImpl<DeviceType>::searchLocalTree(
+    BVH<DeviceType> const &local_tree,
+    Kokkos::View<Details::BoundedQuery<Query> *, DeviceType> queries,
+    Kokkos::View<int *, DeviceType> &indices,
+    Kokkos::View<int *, DeviceType> &offset,
+    Kokkos::View<double *, DeviceType> &distances )
+{
+    int const n_queries = queries.extent_int( 0 );
+    Kokkos::View<Query *, DeviceType> nearest_queries( "nearest_queries",
+                                                       n_queries );
+    Kokkos::View<double *, DeviceType> radii( "radii", n_queries );
+    Kokkos::parallel_for( REGION_NAME( "unpack_bounded_queries" ),
+                          Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
+                          KOKKOS_LAMBDA( int q ) {
+                              nearest_queries( q ) = queries( q ).query;
+                              radii( q ) = queries( q ).radius;
+                          } );
+    Kokkos::fence();
+
+    DataTransferKit::queryDispatch( local_tree, nearest_queries, indices,
+                                    offset, Details::NearestPredicateTag{},
+                                    &distances, radii );
+    discardInvalidResults( indices, offset, &distances );
+}
+
 template <typename DeviceType>
 template <typename Query>
 void DistributedSearchTreeImpl<DeviceType>::queryDispatch(
     Teuchos::RCP<Teuchos::Comm<int> const> comm,
-    BVH<DeviceType> const &distributed_tree, BVH<DeviceType> const &local_tree,
+    BVH<DeviceType> const &distributed_tree,
+    Kokkos::View<int *, DeviceType> box_ranks,
+    BVH<DeviceType> const &local_tree,
+    Kokkos::View<int *, DeviceType> original_ranks,
+    Kokkos::View<int *, DeviceType> original_indices,
     Kokkos::View<Query *, DeviceType> queries,
     Kokkos::View<int *, DeviceType> &indices,
     Kokkos::View<int *, DeviceType> &offset,
-    Kokkos::View<int *, DeviceType> &ranks, Details::SpatialPredicateTag )
+    Kokkos::View<int *, DeviceType> &ranks, Details::SpatialPredicateTag,
+    DistributedQueryPlan<DeviceType> *plan_ptr )
 {
     ////////////////////////////////////////////////////////////////////////////
     ////////////////////////////////////////////////////////////////////////////
     distributed_tree.query( queries, indices, offset );
+    mapBoxesToRanks( box_ranks, indices, offset );
     ////////////////////////////////////////////////////////////////////////////
 
     ////////////////////////////////////////////////////////////////////////////
-    // Forward queries
+    // Forward queries and perform the ones that target the local tree while
+    // the others are in flight
     ////////////////////////////////////////////////////////////////////////////
+    int const comm_rank = comm->getRank();
+    Kokkos::View<Query *, DeviceType> local_queries( "local_queries" );
+    Kokkos::View<int *, DeviceType> local_ids( "local_query_ids" );
+    splitQueries( comm_rank, queries, indices, offset, local_queries,
+                  local_ids );
+    Kokkos::View<int *, DeviceType> local_indices( "local_indices" );
+    Kokkos::View<int *, DeviceType> local_offset( "local_offset" );
+
     Kokkos::View<int *, DeviceType> ids( "query_ids" );
     Kokkos::View<Query *, DeviceType> fwd_queries( "fwd_queries" );
-    forwardQueries( comm, queries, indices, offset, fwd_queries, ids, ranks );
+    auto distributor =
+        setupCommunicationPlan( comm, indices, offset, plan_ptr );
+    forwardQueries( *distributor, queries, indices, offset, fwd_queries, ids,
+                    ranks, [&]() {
+                        local_tree.query( local_queries, local_indices,
+                                          local_offset );
+                    } );
     ////////////////////////////////////////////////////////////////////////////
 
     ////////////////////////////////////////////////////////////////////////////
     // Perform queries that have been received
     ////////////////////////////////////////////////////////////////////////////
-    local_tree.query( fwd_queries, indices, offset );
+    performForwardedQueries(
+        comm, local_tree, fwd_queries, local_queries.extent_int( 0 ), indices,
+        offset, nullptr, plan_ptr, 0,
+        []( BVH<DeviceType> const &tree,
+            Kokkos::View<Query *, DeviceType> tree_queries,
+            Kokkos::View<int *, DeviceType> &tree_indices,
+            Kokkos::View<int *, DeviceType> &tree_offset,
+            Kokkos::View<double *, DeviceType> * ) {
+            tree.query( tree_queries, tree_indices, tree_offset );
+        } );
     ////////////////////////////////////////////////////////////////////////////
 
     ////////////////////////////////////////////////////////////////////////////
     // Communicate results back
     ////////////////////////////////////////////////////////////////////////////
-    communicateResultsBack( comm, indices, offset, ranks, ids );
+    mapResultsToOwners( comm_rank, original_ranks, original_indices, indices,
+                        ranks );
+    communicateResultsBack( *distributor, indices, offset, ranks, ids );
     ////////////////////////////////////////////////////////////////////////////
 
     ////////////////////////////////////////////////////////////////////////////
     // Merge results
     ////////////////////////////////////////////////////////////////////////////
+    Kokkos::View<int *, DeviceType> local_ranks( "local_ranks" );
+    mapResultsToOwners( comm_rank, original_ranks, original_indices,
+                        local_indices, local_ranks );
+    mergeLocalResults( comm_rank, local_ids, local_indices, local_offset,
+                       local_ranks, Kokkos::View<double *, DeviceType>(), ids,
+                       indices, ranks );
     int const n_queries = queries.extent_int( 0 );
     countResults( n_queries, ids, offset );
     sortResults( ids, indices, ranks );
@@ -326,140 +923,1089 @@ void DistributedSearchTreeImpl<DeviceType>::countResults(
 }
 
 template <typename DeviceType>
-template <typename Query>
-void DistributedSearchTreeImpl<DeviceType>::forwardQueries(
+Kokkos::View<Box *, DeviceType>
+DistributedSearchTreeImpl<DeviceType>::repartition(
     Teuchos::RCP<Teuchos::Comm<int> const> comm,
-    Kokkos::View<Query *, DeviceType> queries,
-    Kokkos::View<int *, DeviceType> indices,
-    Kokkos::View<int *, DeviceType> offset,
-    Kokkos::View<Query *, DeviceType> &fwd_queries,
-    Kokkos::View<int *, DeviceType> &fwd_ids,
-    Kokkos::View<int *, DeviceType> &fwd_ranks )
+    Kokkos::View<Box const *, DeviceType> bounding_boxes,
+    Kokkos::View<int *, DeviceType> &original_ranks,
+    Kokkos::View<int *, DeviceType> &original_indices )
 {
-    int const comm_rank = comm->getRank();
+    int const comm_size = comm->getSize();
+    int const n = bounding_boxes.extent_int( 0 );
+
+    // The Morton codes are computed relative to the bounding box of all the
+    // objects, the maxima are negated to get it with a single reduction.
+    Box local_scene_box;
+    Details::TreeConstruction<DeviceType>::calculateBoundingBoxOfTheScene(
+        bounding_boxes, local_scene_box );
+    double local_bounds[6];
+    double global_bounds[6];
+    for ( int d = 0; d < 3; ++d )
+    {
+        local_bounds[d] = local_scene_box[2 * d];
+        local_bounds[d + 3] = -local_scene_box[2 * d + 1];
+    }
+    Teuchos::reduceAll( *comm, Teuchos::REDUCE_MIN, 6, local_bounds,
+                        global_bounds );
+    Box scene_box;
+    for ( int d = 0; d < 3; ++d )
+    {
+        scene_box[2 * d] = global_bounds[d];
+        scene_box[2 * d + 1] = -global_bounds[d + 3];
+    }
+    Kokkos::View<unsigned int *, DeviceType> morton_codes( "morton", n );
+    Details::TreeConstruction<DeviceType>::assignMortonCodes(
+        bounding_boxes, morton_codes, scene_box );
+
+    // The curve is cut into buckets given by the leading bits of the 30-bit
+    // codes and the global histogram of the buckets decides where each of
+    // them goes.  There are about 64 buckets per process so the number of
+    // objects per process is within a few percent of the average unless
+    // many of them fall in the same bucket.
+    int n_bits = 6;
+    while ( ( 1 << ( n_bits - 6 ) ) < comm_size && n_bits < 30 )
+        ++n_bits;
+    int const shift = 30 - n_bits;
+    int const n_buckets = 1 << n_bits;
+    Kokkos::View<int *, DeviceType> bucket_counts( "bucket_counts",
+                                                   n_buckets );
+    Kokkos::parallel_for( REGION_NAME( "count_objects_per_bucket" ),
+                          Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
+                          KOKKOS_LAMBDA( int i ) {
+                              Kokkos::atomic_increment( &bucket_counts(
+                                  morton_codes( i ) >> shift ) );
+                          } );
+    Kokkos::fence();
+    auto bucket_counts_host = Kokkos::create_mirror_view( bucket_counts );
+    Kokkos::deep_copy( bucket_counts_host, bucket_counts );
+    std::vector<int> global_counts( n_buckets );
+    Teuchos::reduceAll( *comm, Teuchos::REDUCE_SUM, n_buckets,
+                        bucket_counts_host.data(), global_counts.data() );
+
+    long n_total = 0;
+    for ( int count : global_counts )
+        n_total += count;
+    Kokkos::View<int *, DeviceType> bucket_ranks( "bucket_ranks", n_buckets );
+    auto bucket_ranks_host = Kokkos::create_mirror_view( bucket_ranks );
+    long n_before = 0;
+    for ( int b = 0; b < n_buckets; ++b )
+    {
+        bucket_ranks_host( b ) =
+            ( n_total > 0 ? n_before * comm_size / n_total : 0 );
+        n_before += global_counts[b];
+    }
+    Kokkos::deep_copy( bucket_ranks, bucket_ranks_host );
+
+    Kokkos::View<int *, DeviceType> destinations( "destinations", n );
+    Kokkos::View<Details::ForwardedBox *, DeviceType> exports( "exports", n );
+    Kokkos::parallel_for( REGION_NAME( "repartition_fill_buffer" ),
+                          Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
+                          KOKKOS_LAMBDA( int i ) {
+                              destinations( i ) =
+                                  bucket_ranks( morton_codes( i ) >> shift );
+                              exports( i ).box = bounding_boxes( i );
+                              exports( i ).index = i;
+                          } );
+    Kokkos::fence();
 
+    auto destinations_host = Kokkos::create_mirror_view( destinations );
+    Kokkos::deep_copy( destinations_host, destinations );
     Tpetra::Distributor distributor( comm );
-
-    int const n_queries = queries.extent( 0 );
-    int const n_exports = offset( n_queries );
     int const n_imports = distributor.createFromSends(
-        Teuchos::ArrayView<int>( indices.data(), n_exports ) );
+        Teuchos::ArrayView<int>( destinations_host.data(), n ) );
+    Kokkos::View<Details::ForwardedBox *, DeviceType> imports( "imports",
+                                                               n_imports );
+    sendAcrossNetwork( distributor, exports, imports );
 
-    Kokkos::View<Query *, DeviceType> exports( queries.label(), n_exports );
-    Kokkos::parallel_for( REGION_NAME( "forward_queries_fill_buffer" ),
+    Kokkos::View<Box *, DeviceType> boxes( "repartitioned_boxes", n_imports );
+    Kokkos::realloc( original_indices, n_imports );
+    Kokkos::parallel_for( REGION_NAME( "repartition_unpack_buffer" ),
+                          Kokkos::RangePolicy<ExecutionSpace>( 0, n_imports ),
+                          KOKKOS_LAMBDA( int i ) {
+                              boxes( i ) = imports( i ).box;
+                              original_indices( i ) = imports( i ).index;
+                          } );
+    Kokkos::fence();
+    getImportRanks( distributor, original_ranks );
+
+    return boxes;
+}
+
+template <typename DeviceType>
+void DistributedSearchTreeImpl<DeviceType>::mapResultsToOwners(
+    int comm_rank, Kokkos::View<int *, DeviceType> original_ranks,
+    Kokkos::View<int *, DeviceType> original_indices,
+    Kokkos::View<int *, DeviceType> indices,
+    Kokkos::View<int *, DeviceType> &ranks )
+{
+    int const n = indices.extent_int( 0 );
+    bool const repartitioned = ( original_ranks.extent( 0 ) > 0 );
+    Kokkos::realloc( ranks, n );
+    Kokkos::parallel_for( REGION_NAME( "map_results_to_owners" ),
+                          Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
+                          KOKKOS_LAMBDA( int i ) {
+                              if ( repartitioned )
+                              {
+                                  int const j = indices( i );
+                                  ranks( i ) = original_ranks( j );
+                                  indices( i ) = original_indices( j );
+                              }
+                              else
+                                  ranks( i ) = comm_rank;
+                          } );
+    Kokkos::fence();
+}
+
+template <typename DeviceType>
+void DistributedSearchTreeImpl<DeviceType>::mapBoxesToRanks(
+    Kokkos::View<int *, DeviceType> box_ranks,
+    Kokkos::View<int *, DeviceType> &indices,
+    Kokkos::View<int *, DeviceType> &offset )
+{
+    // A query may overlap several boxes of the same process.  Lists are
+    // short, the duplicates are found by comparing with the previous entries.
+    int const n_queries = offset.extent_int( 0 ) - 1;
+    Kokkos::View<int *, DeviceType> rank_offset( offset.label(),
+                                                 n_queries + 1 );
+    Kokkos::parallel_for(
+        REGION_NAME( "count_ranks" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
+        KOKKOS_LAMBDA( int q ) {
+            int count = 0;
+            for ( int i = offset( q ); i < offset( q + 1 ); ++i )
+            {
+                bool duplicate = false;
+                for ( int j = offset( q ); j < i && !duplicate; ++j )
+                    duplicate = ( box_ranks( indices( j ) ) ==
+                                  box_ranks( indices( i ) ) );
+                if ( !duplicate )
+                    ++count;
+            }
+            rank_offset( q ) = count;
+        } );
+    Kokkos::fence();
+    exclusivePrefixSum( rank_offset );
+
+    Kokkos::View<int *, DeviceType> rank_indices(
+        indices.label(), lastElement( rank_offset ) );
+    Kokkos::parallel_for(
+        REGION_NAME( "map_boxes_to_ranks" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
+        KOKKOS_LAMBDA( int q ) {
+            int k = rank_offset( q );
+            for ( int i = offset( q ); i < offset( q + 1 ); ++i )
+            {
+                bool duplicate = false;
+                for ( int j = offset( q ); j < i && !duplicate; ++j )
+                    duplicate = ( box_ranks( indices( j ) ) ==
+                                  box_ranks( indices( i ) ) );
+                if ( !duplicate )
+                    rank_indices( k++ ) = box_ranks( indices( i ) );
+            }
+        } );
+    Kokkos::fence();
+
+    indices = rank_indices;
+    offset = rank_offset;
+}
+
+template <typename DeviceType>
+Kokkos::View<Box *, DeviceType>
+DistributedSearchTreeImpl<DeviceType>::boundingBoxes(
+    BVH<DeviceType> const &tree )
+{
+    using TreeTraversal = Details::TreeTraversal<DeviceType>;
+    int const n = tree.size();
+    Kokkos::View<Box *, DeviceType> boxes( "bounding_boxes", n );
+    Kokkos::parallel_for( REGION_NAME( "extract_bounding_boxes" ),
+                          Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
+                          KOKKOS_LAMBDA( int i ) {
+                              Node const *leaf =
+                                  TreeTraversal::getLeaf( tree, i );
+                              boxes( TreeTraversal::getIndex( tree, leaf ) ) =
+                                  leaf->bounding_box;
+                          } );
+    Kokkos::fence();
+    return boxes;
+}
+
+template <typename DeviceType>
+void DistributedSearchTreeImpl<DeviceType>::discardInvalidResults(
+    Kokkos::View<int *, DeviceType> &indices,
+    Kokkos::View<int *, DeviceType> &offset,
+    Kokkos::View<double *, DeviceType> *distances_ptr )
+{
+    int const n_queries = offset.extent_int( 0 ) - 1;
+    Kokkos::View<int *, DeviceType> valid_offset( offset.label(),
+                                                  n_queries + 1 );
+    Kokkos::parallel_for( REGION_NAME( "count_valid_results" ),
                           Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
                           KOKKOS_LAMBDA( int q ) {
+                              int count = 0;
                               for ( int i = offset( q ); i < offset( q + 1 );
                                     ++i )
-                              {
-                                  exports( i ) = queries( q );
-                              }
+                                  if ( indices( i ) >= 0 )
+                                      ++count;
+                              valid_offset( q ) = count;
+                          } );
+    Kokkos::fence();
+    exclusivePrefixSum( valid_offset );
+
+    int const n_valid = lastElement( valid_offset );
+    bool const with_distances = ( distances_ptr != nullptr );
+    Kokkos::View<int *, DeviceType> valid_indices( indices.label(), n_valid );
+    Kokkos::View<double *, DeviceType> distances;
+    Kokkos::View<double *, DeviceType> valid_distances;
+    if ( with_distances )
+    {
+        distances = *distances_ptr;
+        valid_distances =
+            Kokkos::View<double *, DeviceType>( distances.label(), n_valid );
+    }
+    Kokkos::parallel_for( REGION_NAME( "copy_valid_results" ),
+                          Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
+                          KOKKOS_LAMBDA( int q ) {
+                              int j = valid_offset( q );
+                              for ( int i = offset( q ); i < offset( q + 1 );
+                                    ++i )
+                                  if ( indices( i ) >= 0 )
+                                  {
+                                      valid_indices( j ) = indices( i );
+                                      if ( with_distances )
+                                          valid_distances( j ) =
+                                              distances( i );
+                                      ++j;
+                                  }
                           } );
     Kokkos::fence();
 
-    Kokkos::View<int *, DeviceType> export_ranks( "export_ranks", n_exports );
-    fill( export_ranks, comm_rank );
+    indices = valid_indices;
+    offset = valid_offset;
+    if ( with_distances )
+        *distances_ptr = valid_distances;
+}
 
-    Kokkos::View<int *, DeviceType> import_ranks( "import_ranks", n_imports );
-    sendAcrossNetwork( distributor, export_ranks, import_ranks );
+template <typename DeviceType>
+void DistributedSearchTreeImpl<DeviceType>::mergeRounds(
+    Kokkos::View<int *, DeviceType> more_indices,
+    Kokkos::View<int *, DeviceType> more_offset,
+    Kokkos::View<int *, DeviceType> more_ranks,
+    Kokkos::View<double *, DeviceType> more_distances,
+    Kokkos::View<int *, DeviceType> &indices,
+    Kokkos::View<int *, DeviceType> &offset,
+    Kokkos::View<int *, DeviceType> &ranks,
+    Kokkos::View<double *, DeviceType> &distances )
+{
+    int const n_queries = offset.extent_int( 0 ) - 1;
+    Kokkos::View<int *, DeviceType> merged_offset( offset.label(),
+                                                   n_queries + 1 );
+    Kokkos::parallel_for( REGION_NAME( "count_merged_results" ),
+                          Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
+                          KOKKOS_LAMBDA( int q ) {
+                              merged_offset( q ) =
+                                  offset( q + 1 ) - offset( q ) +
+                                  more_offset( q + 1 ) - more_offset( q );
+                          } );
+    Kokkos::fence();
+    exclusivePrefixSum( merged_offset );
+
+    // All the results of a query in the first round come from the same
+    // process.  They go between the results of the second round from lower
+    // and higher ranks.
+    int const n = lastElement( merged_offset );
+    Kokkos::View<int *, DeviceType> merged_indices( indices.label(), n );
+    Kokkos::View<int *, DeviceType> merged_ranks( ranks.label(), n );
+    Kokkos::View<double *, DeviceType> merged_distances( distances.label(),
+                                                         n );
+    Kokkos::parallel_for(
+        REGION_NAME( "merge_results" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
+        KOKKOS_LAMBDA( int q ) {
+            int k = merged_offset( q );
+            int i = more_offset( q );
+            if ( offset( q + 1 ) > offset( q ) )
+            {
+                for ( ; i < more_offset( q + 1 ) &&
+                        more_ranks( i ) < ranks( offset( q ) );
+                      ++i, ++k )
+                {
+                    merged_indices( k ) = more_indices( i );
+                    merged_ranks( k ) = more_ranks( i );
+                    merged_distances( k ) = more_distances( i );
+                }
+                for ( int j = offset( q ); j < offset( q + 1 ); ++j, ++k )
+                {
+                    merged_indices( k ) = indices( j );
+                    merged_ranks( k ) = ranks( j );
+                    merged_distances( k ) = distances( j );
+                }
+            }
+            for ( ; i < more_offset( q + 1 ); ++i, ++k )
+            {
+                merged_indices( k ) = more_indices( i );
+                merged_ranks( k ) = more_ranks( i );
+                merged_distances( k ) = more_distances( i );
+            }
+        } );
+    Kokkos::fence();
+
+    indices = merged_indices;
+    offset = merged_offset;
+    ranks = merged_ranks;
+    distances = merged_distances;
+}
 
-    Kokkos::View<int *, DeviceType> export_ids( "export_ids", n_exports );
-    Kokkos::parallel_for( REGION_NAME( "forward_queries_fill_ids" ),
+template <typename DeviceType>
+void DistributedSearchTreeImpl<DeviceType>::removeSearchedRanks(
+    Kokkos::View<int *, DeviceType> searched_indices,
+    Kokkos::View<int *, DeviceType> searched_offset,
+    Kokkos::View<int *, DeviceType> &indices,
+    Kokkos::View<int *, DeviceType> &offset )
+{
+    int const n_queries = offset.extent_int( 0 ) - 1;
+    Kokkos::View<int *, DeviceType> remaining_offset( offset.label(),
+                                                      n_queries + 1 );
+    Kokkos::parallel_for(
+        REGION_NAME( "count_ranks_not_searched" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
+        KOKKOS_LAMBDA( int q ) {
+            int count = 0;
+            for ( int i = offset( q ); i < offset( q + 1 ); ++i )
+            {
+                bool searched = false;
+                for ( int j = searched_offset( q );
+                      j < searched_offset( q + 1 ) && !searched; ++j )
+                    searched = ( searched_indices( j ) == indices( i ) );
+                if ( !searched )
+                    ++count;
+            }
+            remaining_offset( q ) = count;
+        } );
+    Kokkos::fence();
+    exclusivePrefixSum( remaining_offset );
+
+    Kokkos::View<int *, DeviceType> remaining_indices(
+        indices.label(), lastElement( remaining_offset ) );
+    Kokkos::parallel_for(
+        REGION_NAME( "remove_searched_ranks" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
+        KOKKOS_LAMBDA( int q ) {
+            int k = remaining_offset( q );
+            for ( int i = offset( q ); i < offset( q + 1 ); ++i )
+            {
+                bool searched = false;
+                for ( int j = searched_offset( q );
+                      j < searched_offset( q + 1 ) && !searched; ++j )
+                    searched = ( searched_indices( j ) == indices( i ) );
+                if ( !searched )
+                    remaining_indices( k++ ) = indices( i );
+            }
+        } );
+    Kokkos::fence();
+
+    indices = remaining_indices;
+    offset = remaining_offset;
+}
+
+template <typename DeviceType>
+template <typename Query>
+void DistributedSearchTreeImpl<DeviceType>::splitQueries(
+    int comm_rank, Kokkos::View<Query *, DeviceType> queries,
+    Kokkos::View<int *, DeviceType> &indices,
+    Kokkos::View<int *, DeviceType> &offset,
+    Kokkos::View<Query *, DeviceType> &local_queries,
+    Kokkos::View<int *, DeviceType> &local_ids )
+{
+    int const n_queries = queries.extent_int( 0 );
+    Kokkos::View<int *, DeviceType> remote_offset( offset.label(),
+                                                   n_queries + 1 );
+    Kokkos::View<int *, DeviceType> local_offset( "local_offset",
+                                                  n_queries + 1 );
+    Kokkos::parallel_for( REGION_NAME( "count_remote_and_local_queries" ),
                           Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
                           KOKKOS_LAMBDA( int q ) {
+                              int n_remote = 0;
+                              int n_local = 0;
                               for ( int i = offset( q ); i < offset( q + 1 );
                                     ++i )
                               {
-                                  export_ids( i ) = q;
+                                  if ( indices( i ) == comm_rank )
+                                      n_local = 1;
+                                  else
+                                      ++n_remote;
                               }
+                              remote_offset( q ) = n_remote;
+                              local_offset( q ) = n_local;
                           } );
     Kokkos::fence();
-    Kokkos::View<int *, DeviceType> import_ids( "import_ids", n_imports );
-    sendAcrossNetwork( distributor, export_ids, import_ids );
-
-    // Send queries across the network
-    Kokkos::View<Query *, DeviceType> imports( queries.label(), n_imports );
-    sendAcrossNetwork( distributor, exports, imports );
+    exclusivePrefixSum( remote_offset );
+    exclusivePrefixSum( local_offset );
+
+    Kokkos::View<int *, DeviceType> remote_indices(
+        indices.label(), lastElement( remote_offset ) );
+    int const n_local_queries = lastElement( local_offset );
+    Kokkos::realloc( local_queries, n_local_queries );
+    Kokkos::realloc( local_ids, n_local_queries );
+    Kokkos::parallel_for(
+        REGION_NAME( "split_remote_and_local_queries" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
+        KOKKOS_LAMBDA( int q ) {
+            int j = remote_offset( q );
+            for ( int i = offset( q ); i < offset( q + 1 ); ++i )
+                if ( indices( i ) != comm_rank )
+                    remote_indices( j++ ) = indices( i );
+            if ( local_offset( q + 1 ) > local_offset( q ) )
+            {
+                local_queries( local_offset( q ) ) = queries( q );
+                local_ids( local_offset( q ) ) = q;
+            }
+        } );
+    Kokkos::fence();
 
-    fwd_queries = imports;
-    fwd_ids = import_ids;
-    fwd_ranks = import_ranks;
+    indices = remote_indices;
+    offset = remote_offset;
 }
 
 template <typename DeviceType>
-void DistributedSearchTreeImpl<DeviceType>::communicateResultsBack(
-    Teuchos::RCP<Teuchos::Comm<int> const> comm,
+void DistributedSearchTreeImpl<DeviceType>::mergeLocalResults(
+    int comm_rank, Kokkos::View<int *, DeviceType> local_ids,
+    Kokkos::View<int *, DeviceType> local_indices,
+    Kokkos::View<int *, DeviceType> local_offset,
+    Kokkos::View<int *, DeviceType> local_ranks,
+    Kokkos::View<double *, DeviceType> local_distances,
+    Kokkos::View<int *, DeviceType> &ids,
     Kokkos::View<int *, DeviceType> &indices,
-    Kokkos::View<int *, DeviceType> offset,
     Kokkos::View<int *, DeviceType> &ranks,
-    Kokkos::View<int *, DeviceType> &ids,
     Kokkos::View<double *, DeviceType> *distances_ptr )
 {
-    int const comm_rank = comm->getRank();
+    int const n_local_queries = local_ids.extent_int( 0 );
+    int const n_local = lastElement( local_offset );
+    int const n_remote = ids.extent_int( 0 );
+
+    // The results received from the other processes are grouped by the
+    // process that found them in increasing order.  Unless the objects were
+    // repartitioned, this is the process that owns them, and the local
+    // results are inserted where the ones of the calling process belong so
+    // that this order is preserved.
+    int n_before = 0;
+    Kokkos::parallel_reduce(
+        REGION_NAME( "count_results_from_lower_ranks" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_remote ),
+        KOKKOS_LAMBDA( int i, int &update ) {
+            if ( ranks( i ) < comm_rank )
+                ++update;
+        },
+        n_before );
+    Kokkos::fence();
 
-    int const n_fwd_queries = offset.extent_int( 0 ) - 1;
-    int const n_exports = offset( n_fwd_queries );
-    Kokkos::View<int *, DeviceType> export_ranks( ranks.label(), n_exports );
+    bool const with_distances = ( distances_ptr != nullptr );
+    int const n = n_remote + n_local;
+    Kokkos::View<int *, DeviceType> merged_ids( ids.label(), n );
+    Kokkos::View<int *, DeviceType> merged_indices( indices.label(), n );
+    Kokkos::View<int *, DeviceType> merged_ranks( ranks.label(), n );
+    Kokkos::View<double *, DeviceType> distances;
+    Kokkos::View<double *, DeviceType> merged_distances;
+    if ( with_distances )
+    {
+        distances = *distances_ptr;
+        merged_distances =
+            Kokkos::View<double *, DeviceType>( distances.label(), n );
+    }
     Kokkos::parallel_for(
-        REGION_NAME( "setup_communication_plan" ),
-        Kokkos::RangePolicy<ExecutionSpace>( 0, n_fwd_queries ),
+        REGION_NAME( "copy_remote_results" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_remote ),
+        KOKKOS_LAMBDA( int i ) {
+            int const j = ( i < n_before ? i : i + n_local );
+            merged_ids( j ) = ids( i );
+            merged_indices( j ) = indices( i );
+            merged_ranks( j ) = ranks( i );
+            if ( with_distances )
+                merged_distances( j ) = distances( i );
+        } );
+    Kokkos::parallel_for(
+        REGION_NAME( "copy_local_results" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_local_queries ),
         KOKKOS_LAMBDA( int q ) {
-            for ( int i = offset( q ); i < offset( q + 1 ); ++i )
+            for ( int i = local_offset( q ); i < local_offset( q + 1 ); ++i )
             {
-                export_ranks( i ) = ranks( q );
+                int const j = n_before + i;
+                merged_ids( j ) = local_ids( q );
+                merged_indices( j ) = local_indices( i );
+                merged_ranks( j ) = local_ranks( i );
+                if ( with_distances )
+                    merged_distances( j ) = local_distances( i );
             }
         } );
     Kokkos::fence();
 
-    Tpetra::Distributor distributor( comm );
-    int const n_imports = distributor.createFromSends(
-        Teuchos::ArrayView<int>( export_ranks.data(), n_exports ) );
+    ids = merged_ids;
+    indices = merged_indices;
+    ranks = merged_ranks;
+    if ( with_distances )
+        *distances_ptr = merged_distances;
+}
 
-    // export_ranks already has adequate size since it was used as a buffer to
-    // make the new communication plan.
-    fill( export_ranks, comm_rank );
+template <typename DeviceType>
+std::shared_ptr<Details::HierarchicalDistributor>
+DistributedSearchTreeImpl<DeviceType>::setupCommunicationPlan(
+    Teuchos::RCP<Teuchos::Comm<int> const> comm,
+    Kokkos::View<int *, DeviceType> indices,
+    Kokkos::View<int *, DeviceType> offset,
+    DistributedQueryPlan<DeviceType> *plan_ptr, int round )
+{
+    if ( plan_ptr && plan_ptr->_rounds.size() <= std::size_t( round ) )
+        plan_ptr->_rounds.resize( round + 1 );
+    if ( plan_ptr && plan_ptr->_rounds[round].distributor )
+    {
+        auto const &cached = plan_ptr->_rounds[round];
+        int const unchanged = ( equal( indices, cached.indices ) &&
+                                equal( offset, cached.offset ) )
+                                  ? 1
+                                  : 0;
+        int all_unchanged = 0;
+        Teuchos::reduceAll( *comm, Teuchos::REDUCE_MIN, unchanged,
+                            Teuchos::ptr( &all_unchanged ) );
+        if ( all_unchanged == 1 )
+            return cached.distributor;
+    }
 
-    Kokkos::View<int *, DeviceType> export_ids( ids.label(), n_exports );
+    auto distributor = createDistributor( comm, indices, offset, plan_ptr );
+    if ( plan_ptr )
+    {
+        // Copies are stored since the views passed as argument are reused for
+        // the results.
+        auto &cached = plan_ptr->_rounds[round];
+        cached.distributor = distributor;
+        cached.indices = Kokkos::View<int *, DeviceType>(
+            "plan_indices", indices.extent( 0 ) );
+        Kokkos::deep_copy( cached.indices, indices );
+        cached.offset = Kokkos::View<int *, DeviceType>( "plan_offset",
+                                                         offset.extent( 0 ) );
+        Kokkos::deep_copy( cached.offset, offset );
+        ++plan_ptr->_n_setups;
+    }
+
+    return distributor;
+}
+
+template <typename DeviceType>
+std::shared_ptr<Details::HierarchicalDistributor>
+DistributedSearchTreeImpl<DeviceType>::setupCommunicationPlan(
+    Teuchos::RCP<Teuchos::Comm<int> const> comm,
+    std::vector<Details::HandOver> const &hand_overs,
+    Kokkos::View<int *, DeviceType> indices,
+    Kokkos::View<int *, DeviceType> offset,
+    DistributedQueryPlan<DeviceType> &plan, int round )
+{
+    // The hand-overs are the same on all the processes, hence so is the
+    // decision to reuse the cached plan.
+    if ( plan._rounds.size() <= std::size_t( round ) )
+        plan._rounds.resize( round + 1 );
+    auto &cached = plan._rounds[round];
+    if ( cached.hand_over_distributor && cached.hand_overs == hand_overs )
+        return cached.hand_over_distributor;
+
+    cached.hand_over_distributor =
+        createDistributor( comm, indices, offset, &plan );
+    cached.hand_overs = hand_overs;
+    ++plan._n_setups;
+
+    return cached.hand_over_distributor;
+}
+
+template <typename DeviceType>
+std::shared_ptr<Details::HierarchicalDistributor>
+DistributedSearchTreeImpl<DeviceType>::createDistributor(
+    Teuchos::RCP<Teuchos::Comm<int> const> comm,
+    Kokkos::View<int *, DeviceType> indices,
+    Kokkos::View<int *, DeviceType> offset,
+    DistributedQueryPlan<DeviceType> *plan_ptr )
+{
+    int const n_exports = lastElement( offset );
+    std::vector<int> leaders;
+    if ( plan_ptr && plan_ptr->_aggregate_by_node )
+    {
+        if ( plan_ptr->_node_leaders.empty() )
+            plan_ptr->_node_leaders = Details::findNodeLeaders( comm );
+        leaders = plan_ptr->_node_leaders;
+    }
+    auto distributor =
+        std::make_shared<Details::HierarchicalDistributor>( comm, leaders );
+    distributor->createFromSends(
+        Teuchos::ArrayView<int>( indices.data(), n_exports ) );
+    return distributor;
+}
+
+template <typename DeviceType>
+template <typename Distributor, typename Query, typename Function>
+void DistributedSearchTreeImpl<DeviceType>::forwardQueries(
+    Distributor &distributor, Kokkos::View<Query *, DeviceType> queries,
+    Kokkos::View<int *, DeviceType> indices,
+    Kokkos::View<int *, DeviceType> offset,
+    Kokkos::View<Query *, DeviceType> &fwd_queries,
+    Kokkos::View<int *, DeviceType> &fwd_ids,
+    Kokkos::View<int *, DeviceType> &fwd_ranks,
+    Function const &overlapped_work )
+{
+    int const n_queries = queries.extent( 0 );
+    int const n_exports = offset( n_queries );
+    int const n_imports = distributor.getTotalReceiveLength();
+
+    using ForwardedQuery = Details::ForwardedQuery<Query>;
+    Kokkos::View<ForwardedQuery *, DeviceType> exports( queries.label(),
+                                                        n_exports );
+    Kokkos::parallel_for( REGION_NAME( "forward_queries_fill_buffer" ),
+                          Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
+                          KOKKOS_LAMBDA( int q ) {
+                              for ( int i = offset( q ); i < offset( q + 1 );
+                                    ++i )
+                              {
+                                  exports( i ).query = queries( q );
+                                  exports( i ).query_id = q;
+                              }
+                          } );
+    Kokkos::fence();
+
+    Kokkos::View<ForwardedQuery *, DeviceType> imports( queries.label(),
+                                                        n_imports );
+    sendAcrossNetwork( distributor, exports, imports, overlapped_work );
+
+    Kokkos::realloc( fwd_queries, n_imports );
+    Kokkos::realloc( fwd_ids, n_imports );
+    Kokkos::parallel_for( REGION_NAME( "forward_queries_unpack_buffer" ),
+                          Kokkos::RangePolicy<ExecutionSpace>( 0, n_imports ),
+                          KOKKOS_LAMBDA( int i ) {
+                              fwd_queries( i ) = imports( i ).query;
+                              fwd_ids( i ) = imports( i ).query_id;
+                          } );
+    Kokkos::fence();
+
+    getImportRanks( distributor, fwd_ranks );
+}
+
+template <typename DeviceType>
+template <typename Query, typename Search>
+void DistributedSearchTreeImpl<DeviceType>::performForwardedQueries(
+    Teuchos::RCP<Teuchos::Comm<int> const> comm,
+    BVH<DeviceType> const &local_tree,
+    Kokkos::View<Query *, DeviceType> fwd_queries, int n_local_queries,
+    Kokkos::View<int *, DeviceType> &indices,
+    Kokkos::View<int *, DeviceType> &offset,
+    Kokkos::View<double *, DeviceType> *distances_ptr,
+    DistributedQueryPlan<DeviceType> *plan_ptr, int round,
+    Search const &search )
+{
+    if ( !plan_ptr || !( plan_ptr->_max_imbalance > 0. ) )
+    {
+        search( local_tree, fwd_queries, indices, offset, distances_ptr );
+        return;
+    }
+    DistributedQueryPlan<DeviceType> &plan = *plan_ptr;
+
+    // All the processes need the loads of the others to agree on the
+    // hand-overs.  Only the queries received from other processes may be
+    // handed over since the local ones were already performed.
+    int const comm_rank = comm->getRank();
+    int const comm_size = comm->getSize();
+    int const n_fwd_queries = fwd_queries.extent_int( 0 );
+    int const local_counts[2] = {n_fwd_queries + n_local_queries,
+                                 n_fwd_queries};
+    std::vector<int> counts( 2 * comm_size );
+    Teuchos::gatherAll( *comm, 2, local_counts, 2 * comm_size,
+                        counts.data() );
+    std::vector<int> loads( comm_size );
+    std::vector<int> n_movable( comm_size );
+    for ( int r = 0; r < comm_size; ++r )
+    {
+        loads[r] = counts[2 * r];
+        n_movable[r] = counts[2 * r + 1];
+    }
+    if ( round == 0 )
+        plan._query_loads.assign( comm_size, 0 );
+    for ( int r = 0; r < comm_size; ++r )
+        plan._query_loads[r] += loads[r];
+
+    auto const hand_overs =
+        balanceLoads( loads, n_movable, plan._max_imbalance );
+    if ( hand_overs.empty() )
+    {
+        search( local_tree, fwd_queries, indices, offset, distances_ptr );
+        return;
+    }
+    replicateLocalTrees( comm, local_tree, hand_overs, plan );
+
+    // The calling process keeps the first queries it received and hands the
+    // last ones over.
+    std::vector<int> helpers;
+    int donor = -1;
+    for ( auto const &hand_over : hand_overs )
+    {
+        if ( hand_over.donor == comm_rank )
+            helpers.insert( helpers.end(), hand_over.n_queries,
+                            hand_over.helper );
+        if ( hand_over.helper == comm_rank )
+            donor = hand_over.donor;
+    }
+    int const n_handed = helpers.size();
+    int const n_kept = n_fwd_queries - n_handed;
+
+    Kokkos::View<int *, DeviceType> targets( "helpers", n_handed );
+    auto targets_host = Kokkos::create_mirror_view( targets );
+    for ( int i = 0; i < n_handed; ++i )
+        targets_host( i ) = helpers[i];
+    Kokkos::deep_copy( targets, targets_host );
+    Kokkos::View<int *, DeviceType> target_offset( "helpers_offset",
+                                                   n_fwd_queries + 1 );
+    Kokkos::View<Query *, DeviceType> kept_queries( "kept_queries", n_kept );
+    Kokkos::parallel_for(
+        REGION_NAME( "split_handed_over_queries" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_fwd_queries + 1 ),
+        KOKKOS_LAMBDA( int q ) {
+            target_offset( q ) = ( q > n_kept ? q - n_kept : 0 );
+            if ( q < n_kept )
+                kept_queries( q ) = fwd_queries( q );
+        } );
+    Kokkos::fence();
+
+    bool const with_distances = ( distances_ptr != nullptr );
+    auto distributor = setupCommunicationPlan( comm, hand_overs, targets,
+                                               target_offset, plan, round );
+    Kokkos::View<Query *, DeviceType> helped_queries( "helped_queries" );
+    Kokkos::View<int *, DeviceType> ids( "helped_query_ids" );
+    Kokkos::View<int *, DeviceType> ranks( "helped_ranks" );
+    Kokkos::View<int *, DeviceType> kept_indices( "kept_indices" );
+    Kokkos::View<int *, DeviceType> kept_offset( "kept_offset" );
+    Kokkos::View<double *, DeviceType> kept_distances( "kept_distances" );
+    forwardQueries( *distributor, fwd_queries, targets, target_offset,
+                    helped_queries, ids, ranks, [&]() {
+                        search( local_tree, kept_queries, kept_indices,
+                                kept_offset,
+                                with_distances ? &kept_distances : nullptr );
+                    } );
+
+    // The queries handed over to the calling process are performed with the
+    // copy of the tree of the process they come from.
+    Kokkos::View<int *, DeviceType> helped_indices( "helped_indices" );
+    Kokkos::View<int *, DeviceType> helped_offset( "helped_offset" );
+    Kokkos::View<double *, DeviceType> helped_distances( "helped_distances" );
+    search( donor >= 0 ? plan._replicas.at( donor ) : local_tree,
+            helped_queries, helped_indices, helped_offset,
+            with_distances ? &helped_distances : nullptr );
+    // The donor looks up the owners of the objects found, along with the ones
+    // of the results of the queries it kept.
+    Kokkos::realloc( ranks, helped_indices.extent( 0 ) );
+    communicateResultsBack( *distributor, helped_indices, helped_offset,
+                            ranks, ids,
+                            with_distances ? &helped_distances : nullptr );
+    countResults( n_fwd_queries, ids, helped_offset );
+    sortResults( ids, helped_indices, ranks,
+                 with_distances ? &helped_distances : nullptr );
+
+    // The results of the queries that were kept come first.
+    Kokkos::realloc( offset, n_fwd_queries + 1 );
+    fill( offset, 0 );
+    Kokkos::parallel_for(
+        REGION_NAME( "count_results_of_handed_over_queries" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_fwd_queries ),
+        KOKKOS_LAMBDA( int q ) {
+            offset( q ) = ( q < n_kept
+                                ? kept_offset( q + 1 ) - kept_offset( q )
+                                : helped_offset( q + 1 ) - helped_offset( q ) );
+        } );
+    Kokkos::fence();
+    exclusivePrefixSum( offset );
+
+    int const n_results = lastElement( offset );
+    Kokkos::realloc( indices, n_results );
+    Kokkos::View<double *, DeviceType> distances;
+    if ( with_distances )
+        distances = Kokkos::View<double *, DeviceType>( distances_ptr->label(),
+                                                        n_results );
     Kokkos::parallel_for(
-        REGION_NAME( "fill_buffer" ),
+        REGION_NAME( "merge_results_of_handed_over_queries" ),
         Kokkos::RangePolicy<ExecutionSpace>( 0, n_fwd_queries ),
         KOKKOS_LAMBDA( int q ) {
+            bool const kept = ( q < n_kept );
+            int const first = ( kept ? kept_offset( q ) : helped_offset( q ) );
             for ( int i = offset( q ); i < offset( q + 1 ); ++i )
             {
-                export_ids( i ) = ids( q );
+                int const j = first + i - offset( q );
+                indices( i ) =
+                    ( kept ? kept_indices( j ) : helped_indices( j ) );
+                if ( with_distances )
+                    distances( i ) =
+                        ( kept ? kept_distances( j ) : helped_distances( j ) );
             }
         } );
     Kokkos::fence();
-    Kokkos::View<int *, DeviceType> export_indices = indices;
+    if ( with_distances )
+        *distances_ptr = distances;
+}
+
+template <typename DeviceType>
+std::vector<Details::HandOver>
+DistributedSearchTreeImpl<DeviceType>::balanceLoads(
+    std::vector<int> const &loads, std::vector<int> const &n_movable,
+    double max_imbalance )
+{
+    std::vector<Details::HandOver> hand_overs;
+    int const comm_size = loads.size();
+    long long total = 0;
+    int max_load = 0;
+    for ( int load : loads )
+    {
+        total += load;
+        max_load = std::max( max_load, load );
+    }
+    double const average = static_cast<double>( total ) / comm_size;
+    if ( max_load <= max_imbalance * average )
+        return hand_overs;
+
+    // The processes are sorted by decreasing load, the donors are taken from
+    // the front and the helpers from the back.
+    int const target = static_cast<int>( std::ceil( average ) );
+    std::vector<int> order( comm_size );
+    std::iota( order.begin(), order.end(), 0 );
+    std::stable_sort( order.begin(), order.end(), [&loads]( int i, int j ) {
+        return loads[i] > loads[j];
+    } );
+    int next_helper = comm_size - 1;
+    for ( int donor : order )
+    {
+        if ( loads[donor] <= target )
+            break;
+        int excess = std::min( loads[donor] - target, n_movable[donor] );
+        while ( excess > 0 && next_helper >= 0 &&
+                loads[order[next_helper]] < target )
+        {
+            int const helper = order[next_helper--];
+            int const n_queries = std::min( excess, target - loads[helper] );
+            hand_overs.push_back( {donor, helper, n_queries} );
+            excess -= n_queries;
+        }
+    }
+    return hand_overs;
+}
+
+template <typename DeviceType>
+void DistributedSearchTreeImpl<DeviceType>::replicateLocalTrees(
+    Teuchos::RCP<Teuchos::Comm<int> const> comm,
+    BVH<DeviceType> const &local_tree,
+    std::vector<Details::HandOver> const &hand_overs,
+    DistributedQueryPlan<DeviceType> &plan )
+{
+    // Every process knows which copies exist, so they all skip the
+    // communication when no new copy is needed.
+    int const comm_rank = comm->getRank();
+    bool new_copies = false;
+    std::vector<int> destinations;
+    for ( auto const &hand_over : hand_overs )
+    {
+        if ( !plan._replicated
+                  .insert( std::make_pair( hand_over.donor, hand_over.helper ) )
+                  .second )
+            continue;
+        new_copies = true;
+        if ( hand_over.donor == comm_rank )
+            destinations.push_back( hand_over.helper );
+    }
+    if ( !new_copies )
+        return;
+
+    std::string buffer;
+    if ( !destinations.empty() )
+    {
+        std::ostringstream os;
+        local_tree.save( os );
+        buffer = os.str();
+    }
+    Tpetra::Distributor distributor( comm );
+    int const n_copies = distributor.createFromSends(
+        Teuchos::ArrayView<int>( destinations.data(), destinations.size() ) );
+
+    // The sizes of the serialized trees are sent first.
+    std::vector<std::size_t> export_sizes( destinations.size(),
+                                           buffer.size() );
+    std::vector<std::size_t> import_sizes( n_copies );
+    distributor.doPostsAndWaits(
+        Teuchos::ArrayView<std::size_t const>( export_sizes.data(),
+                                               export_sizes.size() ),
+        1, Teuchos::ArrayView<std::size_t>( import_sizes.data(),
+                                            import_sizes.size() ) );
+
+    std::vector<char> exports;
+    for ( std::size_t i = 0; i < destinations.size(); ++i )
+        exports.insert( exports.end(), buffer.begin(), buffer.end() );
+    std::vector<char> imports(
+        std::accumulate( import_sizes.begin(), import_sizes.end(),
+                         std::size_t( 0 ) ) );
+    distributor.doPostsAndWaits(
+        Teuchos::ArrayView<char const>( exports.data(), exports.size() ),
+        Teuchos::ArrayView<std::size_t const>( export_sizes.data(),
+                                               export_sizes.size() ),
+        Teuchos::ArrayView<char>( imports.data(), imports.size() ),
+        Teuchos::ArrayView<std::size_t const>( import_sizes.data(),
+                                               import_sizes.size() ) );
+
+    auto const procs_from = distributor.getProcsFrom();
+    std::size_t position = 0;
+    for ( int j = 0; j < procs_from.size(); ++j )
+    {
+        plan._replicas[procs_from[j]] = BVH<DeviceType>::load(
+            imports.data() + position, import_sizes[j] );
+        position += import_sizes[j];
+    }
+}
 
-    Kokkos::View<int *, DeviceType> import_indices( indices.label(),
-                                                    n_imports );
-    Kokkos::View<int *, DeviceType> import_ranks( ranks.label(), n_imports );
-    Kokkos::View<int *, DeviceType> import_ids( ids.label(), n_imports );
-    sendAcrossNetwork( distributor, export_indices, import_indices );
-    sendAcrossNetwork( distributor, export_ranks, import_ranks );
-    sendAcrossNetwork( distributor, export_ids, import_ids );
+template <typename DeviceType>
+template <typename Distributor>
+void DistributedSearchTreeImpl<DeviceType>::communicateResultsBack(
+    Distributor &distributor, Kokkos::View<int *, DeviceType> &indices,
+    Kokkos::View<int *, DeviceType> offset,
+    Kokkos::View<int *, DeviceType> &ranks,
+    Kokkos::View<int *, DeviceType> &ids,
+    Kokkos::View<double *, DeviceType> *distances_ptr )
+{
+    // The results of a forwarded query go back to the process it came from,
+    // hence the plan that was used to forward the queries is used in reverse.
+    // This saves setting up a new one, but the processes need to be told how
+    // many results to expect for each of the queries they sent.
+    int const n_fwd_queries = offset.extent_int( 0 ) - 1;
+    int const n_exports = offset( n_fwd_queries );
+    auto offset_host = Kokkos::create_mirror_view( offset );
+    Kokkos::deep_copy( offset_host, offset );
+    std::vector<std::size_t> export_counts( n_fwd_queries );
+    for ( int q = 0; q < n_fwd_queries; ++q )
+        export_counts[q] = offset_host( q + 1 ) - offset_host( q );
+
+    auto const procs_to = distributor.getProcsTo();
+    auto const lengths_to = distributor.getLengthsTo();
+    std::size_t n_sent_queries = 0;
+    for ( int j = 0; j < procs_to.size(); ++j )
+        n_sent_queries += lengths_to[j];
+    std::vector<std::size_t> import_counts( n_sent_queries );
+    distributor.doReversePostsAndWaits(
+        Teuchos::ArrayView<std::size_t const>( export_counts.data(),
+                                               export_counts.size() ),
+        1, Teuchos::ArrayView<std::size_t>( import_counts.data(),
+                                            import_counts.size() ) );
+
+    int n_imports = 0;
+    for ( auto count : import_counts )
+        n_imports += count;
+
+    Teuchos::ArrayView<std::size_t const> n_exported_results(
+        export_counts.data(), export_counts.size() );
+    Teuchos::ArrayView<std::size_t const> n_imported_results(
+        import_counts.data(), import_counts.size() );
 
-    ids = import_ids;
-    ranks = import_ranks;
-    indices = import_indices;
+    Kokkos::View<int *, DeviceType> export_indices = indices;
+    Kokkos::realloc( indices, n_imports );
+    Kokkos::View<int *, DeviceType> export_ranks = ranks;
+    Kokkos::realloc( ranks, n_imports );
+    Kokkos::View<int *, DeviceType> export_ids = ids;
+    Kokkos::realloc( ids, n_imports );
 
+    // The distances are only sent for the nearest neighbors queries.
     if ( distances_ptr )
     {
         Kokkos::View<double *, DeviceType> &distances = *distances_ptr;
         Kokkos::View<double *, DeviceType> export_distances = distances;
-        Kokkos::View<double *, DeviceType> import_distances( distances.label(),
-                                                             n_imports );
-        sendAcrossNetwork( distributor, export_distances, import_distances );
-        distances = import_distances;
+        Kokkos::realloc( distances, n_imports );
+
+        Kokkos::View<Details::ForwardedNearestResult *, DeviceType> exports(
+            "exports", n_exports );
+        Kokkos::parallel_for(
+            REGION_NAME( "fill_buffer" ),
+            Kokkos::RangePolicy<ExecutionSpace>( 0, n_fwd_queries ),
+            KOKKOS_LAMBDA( int q ) {
+                for ( int i = offset( q ); i < offset( q + 1 ); ++i )
+                {
+                    exports( i ).index = export_indices( i );
+                    exports( i ).rank = export_ranks( i );
+                    exports( i ).query_id = export_ids( q );
+                    exports( i ).distance = export_distances( i );
+                }
+            } );
+        Kokkos::fence();
+
+        Kokkos::View<Details::ForwardedNearestResult *, DeviceType> imports(
+            "imports", n_imports );
+        sendBackAcrossNetwork( distributor, exports, n_exported_results,
+                               imports, n_imported_results );
+
+        Kokkos::parallel_for(
+            REGION_NAME( "unpack_buffer" ),
+            Kokkos::RangePolicy<ExecutionSpace>( 0, n_imports ),
+            KOKKOS_LAMBDA( int i ) {
+                indices( i ) = imports( i ).index;
+                ranks( i ) = imports( i ).rank;
+                ids( i ) = imports( i ).query_id;
+                distances( i ) = imports( i ).distance;
+            } );
+        Kokkos::fence();
+    }
+    else
+    {
+        Kokkos::View<Details::ForwardedResult *, DeviceType> exports(
+            "exports", n_exports );
+        Kokkos::parallel_for(
+            REGION_NAME( "fill_buffer" ),
+            Kokkos::RangePolicy<ExecutionSpace>( 0, n_fwd_queries ),
+            KOKKOS_LAMBDA( int q ) {
+                for ( int i = offset( q ); i < offset( q + 1 ); ++i )
+                {
+                    exports( i ).index = export_indices( i );
+                    exports( i ).rank = export_ranks( i );
+                    exports( i ).query_id = export_ids( q );
+                }
+            } );
+        Kokkos::fence();
+
+        Kokkos::View<Details::ForwardedResult *, DeviceType> imports(
+            "imports", n_imports );
+        sendBackAcrossNetwork( distributor, exports, n_exported_results,
+                               imports, n_imported_results );
+
+        Kokkos::parallel_for(
+            REGION_NAME( "unpack_buffer" ),
+            Kokkos::RangePolicy<ExecutionSpace>( 0, n_imports ),
+            KOKKOS_LAMBDA( int i ) {
+                indices( i ) = imports( i ).index;
+                ranks( i ) = imports( i ).rank;
+                ids( i ) = imports( i ).query_id;
+            } );
+        Kokkos::fence();
     }
 }
 
+template <typename DeviceType>
+template <typename Distributor>
+void DistributedSearchTreeImpl<DeviceType>::getImportRanks(
+    Distributor const &distributor, Kokkos::View<int *, DeviceType> &ranks )
+{
+    // Imports are grouped by sending process, in the same order as the
+    // process list of the communication plan.
+    auto const procs_from = distributor.getProcsFrom();
+    auto const lengths_from = distributor.getLengthsFrom();
+    int n_imports = 0;
+    for ( int j = 0; j < procs_from.size(); ++j )
+        n_imports += lengths_from[j];
+
+    Kokkos::realloc( ranks, n_imports );
+    auto ranks_host = Kokkos::create_mirror_view( ranks );
+    int i = 0;
+    for ( int j = 0; j < procs_from.size(); ++j )
+        for ( std::size_t k = 0; k < lengths_from[j]; ++k )
+            ranks_host( i++ ) = procs_from[j];
+    Kokkos::deep_copy( ranks, ranks_host );
+}
+
 template <typename DeviceType>
 template <typename Query>
 void DistributedSearchTreeImpl<DeviceType>::filterResults(
     Kokkos::View<Query *, DeviceType> queries,
-    Kokkos::View<double *, DeviceType> distances,
+    Kokkos::View<double *, DeviceType> &distances,
     Kokkos::View<int *, DeviceType> &indices,
     Kokkos::View<int *, DeviceType> &offset,
     Kokkos::View<int *, DeviceType> &ranks )
@@ -480,47 +2026,56 @@ void DistributedSearchTreeImpl<DeviceType>::filterResults(
 
     exclusivePrefixSum( _offset );
 
-    int const n_truncated_results = _offset( n_queries );
+    int const n_truncated_results = lastElement( _offset );
     Kokkos::View<int *, DeviceType> _indices( indices.label(),
                                               n_truncated_results );
     Kokkos::View<int *, DeviceType> _ranks( ranks.label(),
                                             n_truncated_results );
+    Kokkos::View<double *, DeviceType> _distances( distances.label(),
+                                                   n_truncated_results );
 
-    using PairIndexDistance = Kokkos::pair<Kokkos::Array<int, 2>, double>;
-    struct CompareDistance
-    {
-        KOKKOS_INLINE_FUNCTION bool operator()( PairIndexDistance const &lhs,
-                                                PairIndexDistance const &rhs )
-        {
-            // reverse order (larger distance means lower priority)
-            return lhs.second > rhs.second;
-        }
-    };
-    using PriorityQueue =
-        Details::PriorityQueue<PairIndexDistance, CompareDistance>;
-
+    // The k nearest candidates are selected with a max-heap of at most k
+    // entries that occupies the slots of the truncated results of the query
+    // and is sorted at the end.
+    Kokkos::View<int *, DeviceType> heap( "heap", n_truncated_results );
     Kokkos::parallel_for(
         REGION_NAME( "truncate_results" ),
         Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
         KOKKOS_LAMBDA( int q ) {
-            PriorityQueue queue;
+            int const first = _offset( q );
+            int const k = _offset( q + 1 ) - first;
+            int size = 0;
             for ( int i = offset( q ); i < offset( q + 1 ); ++i )
-                queue.push( Kokkos::Array<int, 2>{{indices( i ), ranks( i )}},
-                            distances( i ) );
-
-            int count = 0;
-            while ( !queue.empty() && count < queries( q )._k )
             {
-                _indices( _offset( q ) + count ) = queue.top().first[0];
-                _ranks( _offset( q ) + count ) = queue.top().first[1];
-                queue.pop();
-                ++count;
+                if ( size < k )
+                {
+                    heap( first + size ) = i;
+                    Details::siftUp( heap, first, size++, distances );
+                }
+                else if ( distances( i ) < distances( heap( first ) ) )
+                {
+                    heap( first ) = i;
+                    Details::siftDown( heap, first, k, 0, distances );
+                }
+            }
+            for ( int last = k - 1; last > 0; --last )
+            {
+                int const tmp = heap( first + last );
+                heap( first + last ) = heap( first );
+                heap( first ) = tmp;
+                Details::siftDown( heap, first, last, 0, distances );
+            }
+            for ( int j = first; j < first + k; ++j )
+            {
+                _indices( j ) = indices( heap( j ) );
+                _ranks( j ) = ranks( heap( j ) );
+                _distances( j ) = distances( heap( j ) );
             }
-
         } );
     Kokkos::fence();
     indices = _indices;
     ranks = _ranks;
+    distances = _distances;
     offset = _offset;
 }
 
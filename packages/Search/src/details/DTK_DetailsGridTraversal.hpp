@@ -0,0 +1,239 @@
+/****************************************************************************
+ * Copyright (c) 2012-2017 by the DataTransferKit authors                   *
+ * All rights reserved.                                                     *
+ *                                                                          *
+ * This file is part of the DataTransferKit library. DataTransferKit is     *
+ * distributed under a BSD 3-clause license. For the licensing terms see    *
+ * the LICENSE file in the top-level directory.                             *
+ ****************************************************************************/
+#ifndef DTK_DETAILS_GRID_TRAVERSAL_HPP
+#define DTK_DETAILS_GRID_TRAVERSAL_HPP
+
+#include <DTK_DetailsAlgorithms.hpp>
+#include <DTK_DetailsPredicate.hpp>
+#include <DTK_DetailsPriorityQueue.hpp>
+#include <DTK_KokkosHelpers.hpp>
+
+#include <Kokkos_ArithTraits.hpp>
+#include <Kokkos_Pair.hpp>
+
+namespace DataTransferKit
+{
+
+template <typename DeviceType>
+class UniformGrid;
+
+namespace Details
+{
+template <typename DeviceType>
+struct GridTraversal
+{
+  public:
+    /**
+     * Return the index of the cell that contains the coordinate \c x along
+     * dimension \c d.  Coordinates outside of the grid are clamped to the
+     * first or last cell.
+     */
+    KOKKOS_INLINE_FUNCTION
+    static int cellIndex( UniformGrid<DeviceType> const &grid, double x,
+                          int d )
+    {
+        double const i =
+            ( x - grid._bounds[2 * d + 0] ) / grid._cell_size[d];
+        if ( !( i > 0. ) )
+            return 0;
+        if ( i >= grid._n_cells[d] )
+            return grid._n_cells[d] - 1;
+        return static_cast<int>( i );
+    }
+
+    KOKKOS_INLINE_FUNCTION
+    static int flattenCellIndex( UniformGrid<DeviceType> const &grid, int i,
+                                 int j, int k )
+    {
+        return ( k * grid._n_cells[1] + j ) * grid._n_cells[0] + i;
+    }
+
+    /**
+     * Call \c insert with the index of every object that satisfies the
+     * predicate and return how many were found.
+     */
+    template <typename Predicate, typename Insert>
+    KOKKOS_INLINE_FUNCTION static int
+    spatialQuery( UniformGrid<DeviceType> const &grid,
+                  Predicate const &predicate, Insert const &insert )
+    {
+        if ( grid.empty() )
+            return 0;
+
+        // Objects are binned according to their centroid, so the cells to
+        // search are the ones overlapping the predicate region extended by
+        // the largest half-extent of the objects.
+        Box const region = predicate.boundingBox();
+        if ( !overlaps( region, grid._bounds ) )
+            return 0;
+        int first[3];
+        int last[3];
+        for ( int d = 0; d < 3; ++d )
+        {
+            first[d] =
+                cellIndex( grid, region[2 * d + 0] - grid._half_extent[d], d );
+            last[d] =
+                cellIndex( grid, region[2 * d + 1] + grid._half_extent[d], d );
+        }
+
+        int count = 0;
+        for ( int k = first[2]; k <= last[2]; ++k )
+            for ( int j = first[1]; j <= last[1]; ++j )
+                for ( int i = first[0]; i <= last[0]; ++i )
+                {
+                    int const cell = flattenCellIndex( grid, i, j, k );
+                    for ( int p = grid._cell_offset( cell );
+                          p < grid._cell_offset( cell + 1 ); ++p )
+                        if ( predicate( grid._boxes( p ) ) )
+                        {
+                            insert( grid._indices( p ) );
+                            ++count;
+                        }
+                }
+        return count;
+    }
+
+    /**
+     * Lower bound on the distance from the query point to any object binned
+     * in a cell that is at least \c r cells away from \c center along some
+     * dimension.
+     */
+    KOKKOS_INLINE_FUNCTION
+    static double ringDistance( UniformGrid<DeviceType> const &grid,
+                                Point const &query_point, int const center[3],
+                                int r )
+    {
+        double bound = Kokkos::ArithTraits<double>::max();
+        for ( int d = 0; d < 3; ++d )
+        {
+            if ( center[d] - r >= 0 )
+            {
+                double const face = grid._bounds[2 * d + 0] +
+                                    ( center[d] - r + 1 ) * grid._cell_size[d];
+                bound = KokkosHelpers::min(
+                    bound, query_point[d] - face - grid._half_extent[d] );
+            }
+            if ( center[d] + r < grid._n_cells[d] )
+            {
+                double const face = grid._bounds[2 * d + 0] +
+                                    ( center[d] + r ) * grid._cell_size[d];
+                bound = KokkosHelpers::min(
+                    bound, face - query_point[d] - grid._half_extent[d] );
+            }
+        }
+        return bound;
+    }
+
+    /**
+     * Find the \c k objects closest to the query point.  The search visits
+     * rings of cells of increasing radius around the cell that contains the
+     * query point and stops when the next ring is further away than the k-th
+     * closest object found so far.  \c insert is called with the rank of the
+     * object (0 for the closest), its index, and its distance to the query
+     * point.
+     *
+     * \note \c k may not exceed the capacity of the priority queue (256),
+     * which queryDispatch() enforces.
+     */
+    template <typename Insert>
+    KOKKOS_INLINE_FUNCTION static int
+    nearestQuery( UniformGrid<DeviceType> const &grid,
+                  Point const &query_point, int k, Insert const &insert )
+    {
+        if ( grid.empty() || k < 1 )
+            return 0;
+
+        using PairIndexDistance = Kokkos::pair<int, double>;
+
+        struct CompareDistance
+        {
+            KOKKOS_INLINE_FUNCTION bool
+            operator()( PairIndexDistance const &lhs,
+                        PairIndexDistance const &rhs )
+            {
+                // furthest object on top so that it gets replaced first
+                return lhs.second < rhs.second;
+            }
+        };
+
+        PriorityQueue<PairIndexDistance, CompareDistance> heap;
+
+        int center[3];
+        int max_radius = 0;
+        for ( int d = 0; d < 3; ++d )
+        {
+            center[d] = cellIndex( grid, query_point[d], d );
+            max_radius = KokkosHelpers::max(
+                max_radius,
+                KokkosHelpers::max( center[d],
+                                    grid._n_cells[d] - 1 - center[d] ) );
+        }
+
+        for ( int r = 0; r <= max_radius; ++r )
+        {
+            if ( static_cast<int>( heap.size() ) == k &&
+                 ringDistance( grid, query_point, center, r ) >
+                     heap.top().second )
+                break;
+
+            for ( int kk = center[2] - r; kk <= center[2] + r; ++kk )
+            {
+                if ( kk < 0 || kk >= grid._n_cells[2] )
+                    continue;
+                for ( int j = center[1] - r; j <= center[1] + r; ++j )
+                {
+                    if ( j < 0 || j >= grid._n_cells[1] )
+                        continue;
+                    // only the cells on the boundary of the ring are visited
+                    bool const interior = ( kk - center[2] > -r ) &&
+                                          ( kk - center[2] < r ) &&
+                                          ( j - center[1] > -r ) &&
+                                          ( j - center[1] < r );
+                    int const step = ( interior ? 2 * r : 1 );
+                    for ( int i = center[0] - r; i <= center[0] + r;
+                          i += step )
+                    {
+                        if ( i < 0 || i >= grid._n_cells[0] )
+                            continue;
+                        int const cell = flattenCellIndex( grid, i, j, kk );
+                        for ( int p = grid._cell_offset( cell );
+                              p < grid._cell_offset( cell + 1 ); ++p )
+                        {
+                            double const distance_to_object =
+                                distance( query_point, grid._boxes( p ) );
+                            if ( static_cast<int>( heap.size() ) < k )
+                                heap.push( grid._indices( p ),
+                                           distance_to_object );
+                            else if ( distance_to_object < heap.top().second )
+                            {
+                                heap.pop();
+                                heap.push( grid._indices( p ),
+                                           distance_to_object );
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        int const count = heap.size();
+        while ( !heap.empty() )
+        {
+            insert( static_cast<int>( heap.size() ) - 1, heap.top().first,
+                    heap.top().second );
+            heap.pop();
+        }
+        return count;
+    }
+};
+
+} // end namespace Details
+} // end namespace DataTransferKit
+
+#endif
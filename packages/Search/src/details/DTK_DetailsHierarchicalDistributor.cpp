@@ -0,0 +1,230 @@
+/****************************************************************************
+ * Copyright (c) 2012-2017 by the DataTransferKit authors                   *
+ * All rights reserved.                                                     *
+ *                                                                          *
+ * This file is part of the DataTransferKit library. DataTransferKit is     *
+ * distributed under a BSD 3-clause license. For the licensing terms see    *
+ * the LICENSE file in the top-level directory.                             *
+ ****************************************************************************/
+#include <DTK_DetailsHierarchicalDistributor.hpp>
+
+#include <Teuchos_CommHelpers.hpp>
+#ifdef HAVE_MPI
+#include <Teuchos_DefaultMpiComm.hpp>
+#include <mpi.h>
+#endif
+
+#include <map>
+#include <numeric>
+
+namespace DataTransferKit
+{
+namespace Details
+{
+
+std::vector<int>
+findNodeLeaders( Teuchos::RCP<Teuchos::Comm<int> const> const &comm )
+{
+    int const comm_rank = comm->getRank();
+    int const comm_size = comm->getSize();
+    int leader = comm_rank;
+#ifdef HAVE_MPI
+    auto const mpi_comm =
+        Teuchos::rcp_dynamic_cast<Teuchos::MpiComm<int> const>( comm );
+    if ( mpi_comm != Teuchos::null )
+    {
+        MPI_Comm node_comm;
+        MPI_Comm_split_type( ( *mpi_comm->getRawMpiComm() )(),
+                             MPI_COMM_TYPE_SHARED, comm_rank, MPI_INFO_NULL,
+                             &node_comm );
+        MPI_Allreduce( &comm_rank, &leader, 1, MPI_INT, MPI_MIN, node_comm );
+        MPI_Comm_free( &node_comm );
+    }
+#endif
+    std::vector<int> leaders( comm_size );
+    Teuchos::gatherAll( *comm, 1, &leader, comm_size, leaders.data() );
+    return leaders;
+}
+
+HierarchicalDistributor::HierarchicalDistributor(
+    Teuchos::RCP<Teuchos::Comm<int> const> const &comm,
+    std::vector<int> const &leaders )
+    : _comm( comm )
+    , _leaders( leaders )
+{
+    DTK_REQUIRE( _leaders.empty() ||
+                 _leaders.size() == std::size_t( comm->getSize() ) );
+}
+
+std::size_t HierarchicalDistributor::createFromSends(
+    Teuchos::ArrayView<int const> const &procs )
+{
+    _stages.clear();
+    _reverse_positions.clear();
+    if ( !hierarchical() )
+    {
+        _stages.push_back( std::make_shared<Tpetra::Distributor>( _comm ) );
+        return _stages[0]->createFromSends( procs );
+    }
+
+    // The routes of the items are sent through the stages so that the
+    // processes know where to pass every item on.
+    int const comm_rank = _comm->getRank();
+    int const n_exports = procs.size();
+    std::vector<Route> routes( n_exports );
+    for ( int i = 0; i < n_exports; ++i )
+        routes[i] = {comm_rank, procs[i], i};
+    for ( int k = 0; k < 3; ++k )
+    {
+        std::vector<int> destinations( routes.size() );
+        for ( std::size_t i = 0; i < routes.size(); ++i )
+            destinations[i] =
+                ( k == 0 ? _leaders[comm_rank]
+                         : k == 1 ? _leaders[routes[i].destination]
+                                  : routes[i].destination );
+        auto stage = std::make_shared<Tpetra::Distributor>( _comm );
+        std::size_t const n_imports = stage->createFromSends(
+            Teuchos::ArrayView<int const>( destinations.data(),
+                                           destinations.size() ) );
+
+        // When sending back, the items come back grouped by process, in the
+        // same order as the process list of the stage.
+        auto const procs_to = stage->getProcsTo();
+        auto const lengths_to = stage->getLengthsTo();
+        std::map<int, int> next_position;
+        for ( int j = 0, position = 0; j < procs_to.size(); ++j )
+        {
+            next_position[procs_to[j]] = position;
+            position += lengths_to[j];
+        }
+        std::vector<int> reverse_positions( destinations.size() );
+        for ( std::size_t i = 0; i < destinations.size(); ++i )
+            reverse_positions[i] = next_position[destinations[i]]++;
+        _reverse_positions.push_back( reverse_positions );
+
+        std::vector<Route> imports( n_imports );
+        stage->doPostsAndWaits(
+            Teuchos::ArrayView<Route const>( routes.data(), routes.size() ), 1,
+            Teuchos::ArrayView<Route>( imports.data(), imports.size() ) );
+        routes.swap( imports );
+        _stages.push_back( stage );
+    }
+
+    // The imports are presented grouped by source, in the order they were
+    // exported.
+    int const n_imports = routes.size();
+    _import_order.resize( n_imports );
+    std::iota( _import_order.begin(), _import_order.end(), 0 );
+    std::sort( _import_order.begin(), _import_order.end(),
+               [&routes]( int i, int j ) {
+                   return std::make_pair( routes[i].source,
+                                          routes[i].position ) <
+                          std::make_pair( routes[j].source,
+                                          routes[j].position );
+               } );
+    _import_positions.resize( n_imports );
+    _procs_from.clear();
+    _lengths_from.clear();
+    for ( int i = 0; i < n_imports; ++i )
+    {
+        _import_positions[_import_order[i]] = i;
+        int const source = routes[_import_order[i]].source;
+        if ( _procs_from.empty() || _procs_from.back() != source )
+        {
+            _procs_from.push_back( source );
+            _lengths_from.push_back( 0 );
+        }
+        ++_lengths_from.back();
+    }
+
+    // When sending back, the items are presented grouped by the process they
+    // were sent to, in increasing order of the ranks.
+    _reverse_import_order.resize( n_exports );
+    std::iota( _reverse_import_order.begin(), _reverse_import_order.end(), 0 );
+    std::stable_sort( _reverse_import_order.begin(),
+                      _reverse_import_order.end(),
+                      [&procs]( int i, int j ) {
+                          return procs[i] < procs[j];
+                      } );
+    _procs_to.clear();
+    _lengths_to.clear();
+    for ( int i : _reverse_import_order )
+    {
+        if ( _procs_to.empty() || _procs_to.back() != procs[i] )
+        {
+            _procs_to.push_back( procs[i] );
+            _lengths_to.push_back( 0 );
+        }
+        ++_lengths_to.back();
+    }
+
+    return n_imports;
+}
+
+void HierarchicalDistributor::doWaits()
+{
+    if ( !hierarchical() )
+    {
+        _stages[0]->doWaits();
+        return;
+    }
+
+    _stages.back()->doWaits();
+    _pending();
+    _pending = nullptr;
+}
+
+std::size_t HierarchicalDistributor::getTotalReceiveLength() const
+{
+    return hierarchical() ? _import_order.size()
+                          : _stages[0]->getTotalReceiveLength();
+}
+
+Teuchos::ArrayView<int const> HierarchicalDistributor::getProcsFrom() const
+{
+    return hierarchical() ? Teuchos::ArrayView<int const>( _procs_from.data(),
+                                                           _procs_from.size() )
+                          : _stages[0]->getProcsFrom();
+}
+
+Teuchos::ArrayView<std::size_t const>
+HierarchicalDistributor::getLengthsFrom() const
+{
+    return hierarchical() ? Teuchos::ArrayView<std::size_t const>(
+                                _lengths_from.data(), _lengths_from.size() )
+                          : _stages[0]->getLengthsFrom();
+}
+
+Teuchos::ArrayView<int const> HierarchicalDistributor::getProcsTo() const
+{
+    return hierarchical() ? Teuchos::ArrayView<int const>( _procs_to.data(),
+                                                           _procs_to.size() )
+                          : _stages[0]->getProcsTo();
+}
+
+Teuchos::ArrayView<std::size_t const>
+HierarchicalDistributor::getLengthsTo() const
+{
+    return hierarchical() ? Teuchos::ArrayView<std::size_t const>(
+                                _lengths_to.data(), _lengths_to.size() )
+                          : _stages[0]->getLengthsTo();
+}
+
+std::size_t HierarchicalDistributor::getNumSends() const
+{
+    std::size_t n = 0;
+    for ( auto const &stage : _stages )
+        n += stage->getNumSends();
+    return n;
+}
+
+std::size_t HierarchicalDistributor::getNumReceives() const
+{
+    std::size_t n = 0;
+    for ( auto const &stage : _stages )
+        n += stage->getNumReceives();
+    return n;
+}
+
+} // end namespace Details
+} // end namespace DataTransferKit
@@ -0,0 +1,350 @@
+/****************************************************************************
+ * Copyright (c) 2012-2017 by the DataTransferKit authors                   *
+ * All rights reserved.                                                     *
+ *                                                                          *
+ * This file is part of the DataTransferKit library. DataTransferKit is     *
+ * distributed under a BSD 3-clause license. For the licensing terms see    *
+ * the LICENSE file in the top-level directory.                             *
+ ****************************************************************************/
+#ifndef DTK_DETAILS_HIERARCHICAL_DISTRIBUTOR_HPP
+#define DTK_DETAILS_HIERARCHICAL_DISTRIBUTOR_HPP
+
+#include <DTK_DBC.hpp>
+
+#include <Teuchos_ArrayRCP.hpp>
+#include <Teuchos_ArrayView.hpp>
+#include <Teuchos_Comm.hpp>
+#include <Teuchos_RCP.hpp>
+#include <Teuchos_SerializationTraits.hpp>
+#include <Tpetra_Distributor.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace DataTransferKit
+{
+namespace Details
+{
+// Source and destination of an item routed through the nodes, and position
+// of the item among the exports of the source.
+struct Route
+{
+    int source;
+    int destination;
+    int position;
+};
+} // end namespace Details
+} // end namespace DataTransferKit
+
+namespace Teuchos
+{
+template <typename Ordinal>
+class SerializationTraits<Ordinal, DataTransferKit::Details::Route>
+    : public DirectSerializationTraits<Ordinal,
+                                       DataTransferKit::Details::Route>
+{
+};
+} // end namespace Teuchos
+
+namespace DataTransferKit
+{
+namespace Details
+{
+/**
+ * Returns for every process the lowest rank among the processes that share
+ * its memory, i.e. that run on the same node.  This process acts as the
+ * leader of the node.
+ */
+std::vector<int>
+findNodeLeaders( Teuchos::RCP<Teuchos::Comm<int> const> const &comm );
+
+/**
+ * Communication plan with the interface of Tpetra::Distributor, as far as
+ * the distributed search uses it, that can aggregate the messages by node.
+ *
+ * When the leaders of the nodes are given, an item does not go directly to
+ * its destination.  It first goes to the leader of the node of its source,
+ * then to the leader of the node of its destination, and finally to its
+ * destination.  A process that is not a leader only sends and receives one
+ * message and a leader exchanges one message with every other node, instead
+ * of one message per pair of processes that communicate.  The imports are
+ * ordered as if the items had been sent directly: grouped by source in
+ * increasing order of the ranks, and in the order they were exported.
+ *
+ * Without leaders, the items are sent directly with a single
+ * Tpetra::Distributor.
+ */
+class HierarchicalDistributor
+{
+  public:
+    HierarchicalDistributor( Teuchos::RCP<Teuchos::Comm<int> const> const &comm,
+                             std::vector<int> const &leaders = {} );
+
+    std::size_t createFromSends( Teuchos::ArrayView<int const> const &procs );
+
+    template <typename T>
+    void doPostsAndWaits( Teuchos::ArrayView<T const> const &exports,
+                          std::size_t num_packets,
+                          Teuchos::ArrayView<T> const &imports );
+
+    // Only the last stage is in flight between doPosts() and doWaits().
+    template <typename T>
+    void doPosts( Teuchos::ArrayRCP<T const> const &exports,
+                  std::size_t num_packets,
+                  Teuchos::ArrayRCP<T> const &imports );
+
+    void doWaits();
+
+    template <typename T>
+    void doReversePostsAndWaits( Teuchos::ArrayView<T const> const &exports,
+                                 std::size_t num_packets,
+                                 Teuchos::ArrayView<T> const &imports );
+
+    template <typename T>
+    void doReversePostsAndWaits(
+        Teuchos::ArrayView<T const> const &exports,
+        Teuchos::ArrayView<std::size_t const> const &num_exports,
+        Teuchos::ArrayView<T> const &imports,
+        Teuchos::ArrayView<std::size_t const> const &num_imports );
+
+    std::size_t getTotalReceiveLength() const;
+    Teuchos::ArrayView<int const> getProcsFrom() const;
+    Teuchos::ArrayView<std::size_t const> getLengthsFrom() const;
+    Teuchos::ArrayView<int const> getProcsTo() const;
+    Teuchos::ArrayView<std::size_t const> getLengthsTo() const;
+
+    // Number of messages the calling process sends to and receives from
+    // other processes, over all the stages.
+    std::size_t getNumSends() const;
+    std::size_t getNumReceives() const;
+
+  private:
+    bool hierarchical() const { return !_leaders.empty(); }
+
+    // Passes the items held before the stage first through the stages up to
+    // last, excluded.
+    template <typename T>
+    void forward( std::vector<T> &items, std::size_t num_packets,
+                  std::size_t first, std::size_t last );
+
+    // Item i of the output is item permutation[i] of the input.
+    template <typename T>
+    static std::vector<T> permute( std::vector<T> const &items,
+                                   std::size_t num_packets,
+                                   std::vector<int> const &permutation );
+    template <typename T>
+    static void permute( std::vector<T> &items,
+                         std::vector<std::size_t> &counts,
+                         std::vector<int> const &permutation );
+
+    Teuchos::RCP<Teuchos::Comm<int> const> _comm;
+    std::vector<int> _leaders;
+    // One distributor per stage: to the leader of the node of the source,
+    // between the leaders, and from the leader to the destination.
+    std::vector<std::shared_ptr<Tpetra::Distributor>> _stages;
+    // Positions among the items received by the last stage of the imports
+    // in the order they are presented in, and the reverse.
+    std::vector<int> _import_order;
+    std::vector<int> _import_positions;
+    // For every stage, positions among the items received when sending back,
+    // which come back grouped by process, of the items that were exported.
+    std::vector<std::vector<int>> _reverse_positions;
+    // Positions among the exports of the items received when sending back,
+    // in the order they are presented in.
+    std::vector<int> _reverse_import_order;
+    std::vector<int> _procs_from;
+    std::vector<std::size_t> _lengths_from;
+    std::vector<int> _procs_to;
+    std::vector<std::size_t> _lengths_to;
+    // Completes the communication started by doPosts().
+    std::function<void()> _pending;
+};
+
+template <typename T>
+void HierarchicalDistributor::forward( std::vector<T> &items,
+                                       std::size_t num_packets,
+                                       std::size_t first, std::size_t last )
+{
+    for ( std::size_t k = first; k < last; ++k )
+    {
+        std::vector<T> imports( _stages[k]->getTotalReceiveLength() *
+                                num_packets );
+        _stages[k]->doPostsAndWaits(
+            Teuchos::ArrayView<T const>( items.data(), items.size() ),
+            num_packets,
+            Teuchos::ArrayView<T>( imports.data(), imports.size() ) );
+        items.swap( imports );
+    }
+}
+
+template <typename T>
+std::vector<T>
+HierarchicalDistributor::permute( std::vector<T> const &items,
+                                  std::size_t num_packets,
+                                  std::vector<int> const &permutation )
+{
+    std::vector<T> permuted( items.size() );
+    for ( std::size_t i = 0; i < permutation.size(); ++i )
+        for ( std::size_t j = 0; j < num_packets; ++j )
+            permuted[i * num_packets + j] =
+                items[permutation[i] * num_packets + j];
+    return permuted;
+}
+
+template <typename T>
+void HierarchicalDistributor::permute( std::vector<T> &items,
+                                       std::vector<std::size_t> &counts,
+                                       std::vector<int> const &permutation )
+{
+    std::vector<std::size_t> offset( counts.size() + 1, 0 );
+    for ( std::size_t i = 0; i < counts.size(); ++i )
+        offset[i + 1] = offset[i] + counts[i];
+    std::vector<T> permuted_items;
+    permuted_items.reserve( items.size() );
+    std::vector<std::size_t> permuted_counts( counts.size() );
+    for ( std::size_t i = 0; i < permutation.size(); ++i )
+    {
+        int const p = permutation[i];
+        permuted_items.insert( permuted_items.end(), items.begin() + offset[p],
+                               items.begin() + offset[p + 1] );
+        permuted_counts[i] = counts[p];
+    }
+    items.swap( permuted_items );
+    counts.swap( permuted_counts );
+}
+
+template <typename T>
+void HierarchicalDistributor::doPostsAndWaits(
+    Teuchos::ArrayView<T const> const &exports, std::size_t num_packets,
+    Teuchos::ArrayView<T> const &imports )
+{
+    if ( !hierarchical() )
+    {
+        _stages[0]->doPostsAndWaits( exports, num_packets, imports );
+        return;
+    }
+
+    std::vector<T> items( exports.getRawPtr(),
+                          exports.getRawPtr() + exports.size() );
+    forward( items, num_packets, 0, _stages.size() );
+    items = permute( items, num_packets, _import_order );
+    std::copy( items.begin(), items.end(), imports.getRawPtr() );
+}
+
+template <typename T>
+void HierarchicalDistributor::doPosts(
+    Teuchos::ArrayRCP<T const> const &exports, std::size_t num_packets,
+    Teuchos::ArrayRCP<T> const &imports )
+{
+    if ( !hierarchical() )
+    {
+        _stages[0]->doPosts( exports, num_packets, imports );
+        return;
+    }
+
+    // The buffers of the last stage must outlive the communication.
+    auto buffers =
+        std::make_shared<std::pair<std::vector<T>, std::vector<T>>>();
+    auto &items = buffers->first;
+    items.assign( exports.getRawPtr(), exports.getRawPtr() + exports.size() );
+    forward( items, num_packets, 0, _stages.size() - 1 );
+    auto &last_stage = *_stages.back();
+    buffers->second.resize( last_stage.getTotalReceiveLength() * num_packets );
+    last_stage.doPosts(
+        Teuchos::arcp<T const>( items.data(), 0, items.size(), false ),
+        num_packets,
+        Teuchos::arcp<T>( buffers->second.data(), 0, buffers->second.size(),
+                          false ) );
+    _pending = [this, buffers, num_packets, imports]() {
+        auto const items = permute( buffers->second, num_packets,
+                                    _import_order );
+        std::copy( items.begin(), items.end(), imports.getRawPtr() );
+    };
+}
+
+template <typename T>
+void HierarchicalDistributor::doReversePostsAndWaits(
+    Teuchos::ArrayView<T const> const &exports, std::size_t num_packets,
+    Teuchos::ArrayView<T> const &imports )
+{
+    if ( !hierarchical() )
+    {
+        _stages[0]->doReversePostsAndWaits( exports, num_packets, imports );
+        return;
+    }
+
+    std::vector<T> items( exports.getRawPtr(),
+                          exports.getRawPtr() + exports.size() );
+    items = permute( items, num_packets, _import_positions );
+    for ( std::size_t k = _stages.size(); k-- > 0; )
+    {
+        std::vector<T> reverse_imports( _reverse_positions[k].size() *
+                                        num_packets );
+        _stages[k]->doReversePostsAndWaits(
+            Teuchos::ArrayView<T const>( items.data(), items.size() ),
+            num_packets, Teuchos::ArrayView<T>( reverse_imports.data(),
+                                                reverse_imports.size() ) );
+        items = permute( reverse_imports, num_packets, _reverse_positions[k] );
+    }
+    items = permute( items, num_packets, _reverse_import_order );
+    std::copy( items.begin(), items.end(), imports.getRawPtr() );
+}
+
+template <typename T>
+void HierarchicalDistributor::doReversePostsAndWaits(
+    Teuchos::ArrayView<T const> const &exports,
+    Teuchos::ArrayView<std::size_t const> const &num_exports,
+    Teuchos::ArrayView<T> const &imports,
+    Teuchos::ArrayView<std::size_t const> const &num_imports )
+{
+    if ( !hierarchical() )
+    {
+        _stages[0]->doReversePostsAndWaits( exports, num_exports, imports,
+                                            num_imports );
+        return;
+    }
+
+    // The intermediate processes need the number of packets of every item
+    // they pass on, so these are sent along first.
+    std::vector<T> items( exports.getRawPtr(),
+                          exports.getRawPtr() + exports.size() );
+    std::vector<std::size_t> counts(
+        num_exports.getRawPtr(), num_exports.getRawPtr() + num_exports.size() );
+    permute( items, counts, _import_positions );
+    for ( std::size_t k = _stages.size(); k-- > 0; )
+    {
+        std::vector<std::size_t> reverse_counts( _reverse_positions[k].size() );
+        _stages[k]->doReversePostsAndWaits(
+            Teuchos::ArrayView<std::size_t const>( counts.data(),
+                                                   counts.size() ),
+            1, Teuchos::ArrayView<std::size_t>( reverse_counts.data(),
+                                                reverse_counts.size() ) );
+        std::size_t n_packets = 0;
+        for ( auto count : reverse_counts )
+            n_packets += count;
+        std::vector<T> reverse_imports( n_packets );
+        _stages[k]->doReversePostsAndWaits(
+            Teuchos::ArrayView<T const>( items.data(), items.size() ),
+            Teuchos::ArrayView<std::size_t const>( counts.data(),
+                                                   counts.size() ),
+            Teuchos::ArrayView<T>( reverse_imports.data(),
+                                   reverse_imports.size() ),
+            Teuchos::ArrayView<std::size_t const>( reverse_counts.data(),
+                                                   reverse_counts.size() ) );
+        items.swap( reverse_imports );
+        counts.swap( reverse_counts );
+        permute( items, counts, _reverse_positions[k] );
+    }
+    permute( items, counts, _reverse_import_order );
+    DTK_REQUIRE( std::equal( counts.begin(), counts.end(),
+                             num_imports.getRawPtr() ) );
+    std::copy( items.begin(), items.end(), imports.getRawPtr() );
+}
+
+} // end namespace Details
+} // end namespace DataTransferKit
+
+#endif
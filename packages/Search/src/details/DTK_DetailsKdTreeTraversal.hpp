@@ -0,0 +1,192 @@
+/****************************************************************************
+ * Copyright (c) 2012-2017 by the DataTransferKit authors                   *
+ * All rights reserved.                                                     *
+ *                                                                          *
+ * This file is part of the DataTransferKit library. DataTransferKit is     *
+ * distributed under a BSD 3-clause license. For the licensing terms see    *
+ * the LICENSE file in the top-level directory.                             *
+ ****************************************************************************/
+#ifndef DTK_DETAILS_KDTREE_TRAVERSAL_HPP
+#define DTK_DETAILS_KDTREE_TRAVERSAL_HPP
+
+#include <DTK_DetailsAlgorithms.hpp>
+#include <DTK_DetailsPredicate.hpp>
+#include <DTK_DetailsPriorityQueue.hpp>
+#include <DTK_DetailsStack.hpp>
+
+#include <Kokkos_Pair.hpp>
+
+namespace DataTransferKit
+{
+
+template <typename DeviceType>
+class KdTree;
+
+namespace Details
+{
+/**
+ * Range [begin, end) of points that make up a subtree and lower bound on the
+ * distance from the query point to any of them.
+ */
+struct KdTreeRange
+{
+    KOKKOS_INLINE_FUNCTION
+    KdTreeRange() = default;
+
+    KOKKOS_INLINE_FUNCTION
+    KdTreeRange( int begin, int end, double distance = 0. )
+        : _begin( begin )
+        , _end( end )
+        , _distance( distance )
+    {
+    }
+
+    int _begin = 0;
+    int _end = 0;
+    double _distance = 0.;
+};
+
+/**
+ * The kd-tree is implicit.  The subtree over the range [begin, end) is
+ * rooted at the point mid = (begin + end) / 2 and its children are the
+ * subtrees over [begin, mid) and [mid + 1, end).  Points in the left subtree
+ * are not greater than the root along the split dimension and points in the
+ * right subtree are not less.
+ */
+template <typename DeviceType>
+struct KdTreeTraversal
+{
+  public:
+    KOKKOS_INLINE_FUNCTION
+    static Point getPoint( KdTree<DeviceType> const &tree, int i )
+    {
+        return {{tree._coordinates( i, 0 ), tree._coordinates( i, 1 ),
+                 tree._coordinates( i, 2 )}};
+    }
+
+    template <typename Predicate, typename Insert>
+    KOKKOS_INLINE_FUNCTION static int
+    spatialQuery( KdTree<DeviceType> const &tree, Predicate const &predicate,
+                  Insert const &insert )
+    {
+        if ( tree.empty() )
+            return 0;
+
+        Box const region = predicate.boundingBox();
+
+        Stack<KdTreeRange> stack;
+        stack.push( 0, static_cast<int>( tree.size() ) );
+        int count = 0;
+        while ( !stack.empty() )
+        {
+            int const begin = stack.top()._begin;
+            int const end = stack.top()._end;
+            stack.pop();
+
+            int const mid = ( begin + end ) / 2;
+            Point const point = getPoint( tree, mid );
+            if ( predicate( Box( {point[0], point[0], point[1], point[1],
+                                  point[2], point[2]} ) ) )
+            {
+                insert( tree._indices( mid ) );
+                ++count;
+            }
+
+            int const d = tree._split_dimensions( mid );
+            if ( mid + 1 < end && region[2 * d + 1] >= point[d] )
+                stack.push( mid + 1, end );
+            if ( begin < mid && region[2 * d + 0] <= point[d] )
+                stack.push( begin, mid );
+        }
+        return count;
+    }
+
+    /**
+     * Find the \c k points closest to the query point.  \c insert is called
+     * with the rank of the point (0 for the closest), its index, and its
+     * distance to the query point.
+     *
+     * \note \c k may not exceed the capacity of the priority queue (256),
+     * which queryDispatch() enforces.
+     */
+    template <typename Insert>
+    KOKKOS_INLINE_FUNCTION static int
+    nearestQuery( KdTree<DeviceType> const &tree, Point const &query_point,
+                  int k, Insert const &insert )
+    {
+        if ( tree.empty() || k < 1 )
+            return 0;
+
+        using PairIndexDistance = Kokkos::pair<int, double>;
+
+        struct CompareDistance
+        {
+            KOKKOS_INLINE_FUNCTION bool
+            operator()( PairIndexDistance const &lhs,
+                        PairIndexDistance const &rhs )
+            {
+                // furthest point on top so that it gets replaced first
+                return lhs.second < rhs.second;
+            }
+        };
+
+        PriorityQueue<PairIndexDistance, CompareDistance> heap;
+
+        Stack<KdTreeRange> stack;
+        stack.push( 0, static_cast<int>( tree.size() ) );
+        while ( !stack.empty() )
+        {
+            KdTreeRange const range = stack.top();
+            stack.pop();
+
+            bool const full = ( static_cast<int>( heap.size() ) == k );
+            if ( full && range._distance >= heap.top().second )
+                continue;
+
+            int const mid = ( range._begin + range._end ) / 2;
+            Point const point = getPoint( tree, mid );
+            double const distance_to_point = distance( query_point, point );
+            if ( !full )
+                heap.push( tree._indices( mid ), distance_to_point );
+            else if ( distance_to_point < heap.top().second )
+            {
+                heap.pop();
+                heap.push( tree._indices( mid ), distance_to_point );
+            }
+
+            // push the far side first so that the near side is searched
+            // first
+            int const d = tree._split_dimensions( mid );
+            double const offset = query_point[d] - point[d];
+            double const far_distance =
+                KokkosHelpers::max( range._distance, offset > 0 ? offset
+                                                                : -offset );
+            KdTreeRange const left( range._begin, mid,
+                                    offset < 0 ? range._distance
+                                               : far_distance );
+            KdTreeRange const right( mid + 1, range._end,
+                                     offset < 0 ? far_distance
+                                                : range._distance );
+            KdTreeRange const &near = ( offset < 0 ? left : right );
+            KdTreeRange const &far = ( offset < 0 ? right : left );
+            if ( far._begin < far._end )
+                stack.push( far );
+            if ( near._begin < near._end )
+                stack.push( near );
+        }
+
+        int const count = heap.size();
+        while ( !heap.empty() )
+        {
+            insert( static_cast<int>( heap.size() ) - 1, heap.top().first,
+                    heap.top().second );
+            heap.pop();
+        }
+        return count;
+    }
+};
+
+} // end namespace Details
+} // end namespace DataTransferKit
+
+#endif
@@ -17,6 +17,10 @@ namespace DataTransferKit
 {
 struct Node
 {
+    // Tags of an object that was not given any, it matches every mask.  The
+    // tags themselves are kept by the BVH, outside of the nodes.
+    static unsigned int constexpr all_tags = ~0u;
+
     KOKKOS_INLINE_FUNCTION
     Node()
         : parent( nullptr )
@@ -0,0 +1,78 @@
+/****************************************************************************
+ * Copyright (c) 2012-2017 by the DataTransferKit authors                   *
+ * All rights reserved.                                                     *
+ *                                                                          *
+ * This file is part of the DataTransferKit library. DataTransferKit is     *
+ * distributed under a BSD 3-clause license. For the licensing terms see    *
+ * the LICENSE file in the top-level directory.                             *
+ ****************************************************************************/
+#ifndef DTK_DETAILS_PERIODICITY_HPP
+#define DTK_DETAILS_PERIODICITY_HPP
+
+#include <DTK_DetailsPoint.hpp>
+
+#include <Kokkos_Macros.hpp>
+
+namespace DataTransferKit
+{
+/**
+ * Periods of a domain along each dimension.  A period that is not positive
+ * means that the domain is not periodic along that dimension.
+ *
+ * Objects have 27 periodic images, obtained by shifting them by -1, 0, or +1
+ * period along each dimension.  Image \c m is shifted by (m % 3 - 1, m / 3 %
+ * 3 - 1, m / 9 - 1) periods, so that image 13 is the object itself and
+ * images \c m and 26 - \c m are shifted in opposite directions.  Only the
+ * images that are shifted along periodic dimensions are active.
+ */
+class Periodicity
+{
+  public:
+    static int constexpr n_images = 27;
+    static int constexpr identity = 13;
+
+    KOKKOS_INLINE_FUNCTION
+    Periodicity( double period_x = 0., double period_y = 0.,
+                 double period_z = 0. )
+        : _periods{{period_x, period_y, period_z}}
+    {
+    }
+
+    KOKKOS_INLINE_FUNCTION
+    double period( int d ) const { return _periods[d]; }
+
+    // Number of periods by which the image is shifted along dimension d.
+    KOKKOS_INLINE_FUNCTION
+    static int offset( int image, int d )
+    {
+        for ( ; d > 0; --d )
+            image /= 3;
+        return image % 3 - 1;
+    }
+
+    KOKKOS_INLINE_FUNCTION
+    bool isActive( int image ) const
+    {
+        for ( int d = 0; d < 3; ++d )
+            if ( offset( image, d ) != 0 && !( _periods[d] > 0. ) )
+                return false;
+        return true;
+    }
+
+    KOKKOS_INLINE_FUNCTION
+    Point shift( int image ) const
+    {
+        Point shift;
+        for ( int d = 0; d < 3; ++d )
+            shift[d] = ( _periods[d] > 0. ? offset( image, d ) * _periods[d]
+                                          : 0. );
+        return shift;
+    }
+
+  private:
+    Point _periods;
+};
+
+} // end namespace DataTransferKit
+
+#endif
@@ -28,6 +28,10 @@ struct SpatialPredicateTag
 // to declare a Kokkos::View of a predicate type and fill it with a
 // Kokkos::for_parallel.
 
+// Every predicate carries a mask.  Only the objects whose tags (see BVH) have
+// at least one bit in common with it may satisfy the predicate.  The default
+// mask matches any object.
+
 struct Nearest
 {
     using Tag = NearestPredicateTag;
@@ -36,6 +40,7 @@ struct Nearest
     Nearest()
         : _query_point( {{0., 0., 0.}} )
         , _k( 0 )
+        , _mask( Node::all_tags )
     {
     }
 
@@ -43,18 +48,35 @@ struct Nearest
     {
         _query_point = other._query_point;
         _k = other._k;
+        _mask = other._mask;
         return *this;
     }
 
     KOKKOS_INLINE_FUNCTION
-    Nearest( Point const &query_point, int k )
+    Nearest( Point const &query_point, int k,
+             unsigned int mask = Node::all_tags )
         : _query_point( query_point )
         , _k( k )
+        , _mask( mask )
+    {
+    }
+
+    // Same predicate with the query point moved by the given shift.
+    KOKKOS_INLINE_FUNCTION
+    Nearest translated( Point const &shift ) const
     {
+        Point query_point;
+        for ( int d = 0; d < 3; ++d )
+            query_point[d] = _query_point[d] + shift[d];
+        return Nearest( query_point, _k, _mask );
     }
 
+    KOKKOS_INLINE_FUNCTION
+    unsigned int mask() const { return _mask; }
+
     Point _query_point;
     int _k;
+    unsigned int _mask;
 };
 
 class Within
@@ -66,6 +88,7 @@ class Within
     Within()
         : _query_point( {{0., 0., 0.}} )
         , _radius( 0. )
+        , _mask( Node::all_tags )
     {
     }
 
@@ -73,26 +96,63 @@ class Within
     {
         _query_point = other._query_point;
         _radius = other._radius;
+        _mask = other._mask;
         return *this;
     }
 
     KOKKOS_INLINE_FUNCTION
-    Within( Point const &query_point, double const radius )
+    Within( Point const &query_point, double const radius,
+            unsigned int mask = Node::all_tags )
         : _query_point( query_point )
         , _radius( radius )
+        , _mask( mask )
     {
     }
 
     KOKKOS_INLINE_FUNCTION
     bool operator()( Node const *node ) const
     {
-        double node_distance = distance( _query_point, node->bounding_box );
-        return ( node_distance <= _radius ) ? true : false;
+        return ( *this )( node->bounding_box );
+    }
+
+    KOKKOS_INLINE_FUNCTION
+    bool operator()( Box const &box ) const
+    {
+        double box_distance = distance( _query_point, box );
+        return ( box_distance <= _radius ) ? true : false;
+    }
+
+    // Smallest box that contains the region of space satisfying the
+    // predicate.
+    KOKKOS_INLINE_FUNCTION
+    Box boundingBox() const
+    {
+        Box box;
+        for ( int d = 0; d < 3; ++d )
+        {
+            box[2 * d + 0] = _query_point[d] - _radius;
+            box[2 * d + 1] = _query_point[d] + _radius;
+        }
+        return box;
+    }
+
+    // Same predicate with the query region moved by the given shift.
+    KOKKOS_INLINE_FUNCTION
+    Within translated( Point const &shift ) const
+    {
+        Point query_point;
+        for ( int d = 0; d < 3; ++d )
+            query_point[d] = _query_point[d] + shift[d];
+        return Within( query_point, _radius, _mask );
     }
 
+    KOKKOS_INLINE_FUNCTION
+    unsigned int mask() const { return _mask; }
+
   private:
     Point _query_point;
     double _radius;
+    unsigned int _mask;
 };
 
 class Overlap
@@ -103,39 +163,78 @@ class Overlap
     KOKKOS_INLINE_FUNCTION
     Overlap()
         : _query_box( Box() )
+        , _mask( Node::all_tags )
     {
     }
 
     KOKKOS_INLINE_FUNCTION Overlap &operator=( Overlap const &other )
     {
         _query_box = other._query_box;
+        _mask = other._mask;
         return *this;
     }
 
     KOKKOS_INLINE_FUNCTION
-    Overlap( Box const &query_box )
+    Overlap( Box const &query_box, unsigned int mask = Node::all_tags )
         : _query_box( query_box )
+        , _mask( mask )
     {
     }
 
     KOKKOS_INLINE_FUNCTION
     bool operator()( Node const *node ) const
     {
-        return overlaps( node->bounding_box, _query_box );
+        return ( *this )( node->bounding_box );
+    }
+
+    KOKKOS_INLINE_FUNCTION
+    bool operator()( Box const &box ) const
+    {
+        return overlaps( box, _query_box );
+    }
+
+    KOKKOS_INLINE_FUNCTION
+    Box boundingBox() const { return _query_box; }
+
+    // Same predicate with the query region moved by the given shift.
+    KOKKOS_INLINE_FUNCTION
+    Overlap translated( Point const &shift ) const
+    {
+        Box query_box;
+        for ( int d = 0; d < 3; ++d )
+        {
+            query_box[2 * d + 0] = _query_box[2 * d + 0] + shift[d];
+            query_box[2 * d + 1] = _query_box[2 * d + 1] + shift[d];
+        }
+        return Overlap( query_box, _mask );
     }
 
+    KOKKOS_INLINE_FUNCTION
+    unsigned int mask() const { return _mask; }
+
   private:
     DataTransferKit::Box _query_box;
+    unsigned int _mask;
 };
 
 KOKKOS_INLINE_FUNCTION
-Nearest nearest( Point const &p, int k = 1 ) { return Nearest( p, k ); }
+Nearest nearest( Point const &p, int k = 1,
+                 unsigned int mask = Node::all_tags )
+{
+    return Nearest( p, k, mask );
+}
 
 KOKKOS_INLINE_FUNCTION
-Within within( Point const &p, double r ) { return Within( p, r ); }
+Within within( Point const &p, double r, unsigned int mask = Node::all_tags )
+{
+    return Within( p, r, mask );
+}
 
 KOKKOS_INLINE_FUNCTION
-Overlap overlap( Box const &b ) { return Overlap( b ); }
+Overlap overlap( Box const &b, unsigned int mask = Node::all_tags )
+{
+    return Overlap( b, mask );
+}
 
 } // end namespace Details
 } // end namespace DataTransferKit
@@ -0,0 +1,177 @@
+/****************************************************************************
+ * Copyright (c) 2012-2017 by the DataTransferKit authors                   *
+ * All rights reserved.                                                     *
+ *                                                                          *
+ * This file is part of the DataTransferKit library. DataTransferKit is     *
+ * distributed under a BSD 3-clause license. For the licensing terms see    *
+ * the LICENSE file in the top-level directory.                             *
+ ****************************************************************************/
+#ifndef DTK_DETAILS_QUERY_DISPATCH_HPP
+#define DTK_DETAILS_QUERY_DISPATCH_HPP
+
+#include "DTK_ConfigDefs.hpp"
+
+#include <DTK_DBC.hpp>
+#include <DTK_DetailsPredicate.hpp>
+#include <DTK_DetailsPriorityQueue.hpp>
+#include <DTK_DetailsUtils.hpp>
+
+#include <Kokkos_ArithTraits.hpp>
+#include <Kokkos_Pair.hpp>
+#include <Kokkos_View.hpp>
+
+namespace DataTransferKit
+{
+namespace Details
+{
+// Batched queries for the search structures other than the BVH.  Traversal
+// must provide the static member functions
+//   int spatialQuery( structure, predicate, insert( index ) )
+//   int nearestQuery( structure, point, k, insert( rank, index, distance ) )
+// where rank is the position of the object in the list of nearest neighbors
+// sorted by increasing distance to the query point.
+//
+// These structures do not hold tags, so predicates that carry a mask are
+// rejected rather than silently matching every object.
+
+template <typename DeviceType, typename Query>
+int countMaskedQueries( Kokkos::View<Query *, DeviceType> queries )
+{
+    using ExecutionSpace = typename DeviceType::execution_space;
+    int n_masked = 0;
+    Kokkos::parallel_reduce(
+        REGION_NAME( "count_masked_queries" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, queries.extent( 0 ) ),
+        KOKKOS_LAMBDA( int i, int &update ) {
+            if ( queries( i ).mask() != Node::all_tags )
+                ++update;
+        },
+        n_masked );
+    Kokkos::fence();
+    return n_masked;
+}
+
+template <typename Traversal, typename Structure, typename DeviceType,
+          typename Query>
+void queryDispatch(
+    Structure const structure, Kokkos::View<Query *, DeviceType> queries,
+    Kokkos::View<int *, DeviceType> &indices,
+    Kokkos::View<int *, DeviceType> &offset, NearestPredicateTag,
+    Kokkos::View<double *, DeviceType> *distances_ptr = nullptr )
+{
+    using ExecutionSpace = typename DeviceType::execution_space;
+
+    DTK_INSIST( countMaskedQueries( queries ) == 0 );
+
+    int const n_queries = queries.extent( 0 );
+
+    Kokkos::realloc( offset, n_queries + 1 );
+    fill( offset, 0 );
+
+    // The traversals keep the candidates in a priority queue of fixed
+    // capacity.
+    int const max_k = static_cast<int>(
+        PriorityQueue<Kokkos::pair<int, double>>::maxSize() );
+    int n_too_many_neighbors = 0;
+    Kokkos::parallel_reduce(
+        REGION_NAME( "scan_queries_for_numbers_of_nearest_neighbors" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
+        KOKKOS_LAMBDA( int i, int &update ) {
+            offset( i ) = queries( i )._k;
+            if ( queries( i )._k > max_k )
+                ++update;
+        },
+        n_too_many_neighbors );
+    Kokkos::fence();
+    DTK_INSIST( n_too_many_neighbors == 0 );
+
+    exclusivePrefixSum( offset );
+    int const n_results = lastElement( offset );
+
+    Kokkos::realloc( indices, n_results );
+    fill( indices, -1 );
+    if ( distances_ptr )
+    {
+        Kokkos::View<double *, DeviceType> &distances = *distances_ptr;
+        Kokkos::realloc( distances, n_results );
+        fill( distances, Kokkos::ArithTraits<double>::max() );
+
+        Kokkos::parallel_for(
+            REGION_NAME( "perform_nearest_queries_and_return_distances" ),
+            Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
+            KOKKOS_LAMBDA( int i ) {
+                Traversal::nearestQuery(
+                    structure, queries( i )._query_point, queries( i )._k,
+                    [indices, offset, distances, i](
+                        int rank, int index, double distance ) {
+                        indices( offset( i ) + rank ) = index;
+                        distances( offset( i ) + rank ) = distance;
+                    } );
+            } );
+        Kokkos::fence();
+    }
+    else
+    {
+        Kokkos::parallel_for(
+            REGION_NAME( "perform_nearest_queries" ),
+            Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
+            KOKKOS_LAMBDA( int i ) {
+                Traversal::nearestQuery(
+                    structure, queries( i )._query_point, queries( i )._k,
+                    [indices, offset, i]( int rank, int index, double ) {
+                        indices( offset( i ) + rank ) = index;
+                    } );
+            } );
+        Kokkos::fence();
+    }
+}
+
+template <typename Traversal, typename Structure, typename DeviceType,
+          typename Query>
+void queryDispatch( Structure const structure,
+                    Kokkos::View<Query *, DeviceType> queries,
+                    Kokkos::View<int *, DeviceType> &indices,
+                    Kokkos::View<int *, DeviceType> &offset,
+                    SpatialPredicateTag )
+{
+    using ExecutionSpace = typename DeviceType::execution_space;
+
+    DTK_INSIST( countMaskedQueries( queries ) == 0 );
+
+    int const n_queries = queries.extent( 0 );
+
+    Kokkos::realloc( offset, n_queries + 1 );
+    fill( offset, 0 );
+
+    // count the number of objects that satisfy each predicate
+    Kokkos::parallel_for(
+        REGION_NAME( "first_pass_at_the_search_count_the_number_of_indices" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
+        KOKKOS_LAMBDA( int i ) {
+            offset( i ) = Traversal::spatialQuery( structure, queries( i ),
+                                                   []( int index ) {} );
+        } );
+    Kokkos::fence();
+
+    exclusivePrefixSum( offset );
+    int const n_results = lastElement( offset );
+
+    // search again and store the indices
+    Kokkos::realloc( indices, n_results );
+    Kokkos::parallel_for( REGION_NAME( "second_pass" ),
+                          Kokkos::RangePolicy<ExecutionSpace>( 0, n_queries ),
+                          KOKKOS_LAMBDA( int i ) {
+                              int count = 0;
+                              Traversal::spatialQuery(
+                                  structure, queries( i ),
+                                  [indices, offset, i, &count]( int index ) {
+                                      indices( offset( i ) + count++ ) = index;
+                                  } );
+                          } );
+    Kokkos::fence();
+}
+
+} // end namespace Details
+} // end namespace DataTransferKit
+
+#endif
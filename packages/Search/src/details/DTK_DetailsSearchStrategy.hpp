@@ -0,0 +1,326 @@
+/****************************************************************************
+ * Copyright (c) 2012-2017 by the DataTransferKit authors                   *
+ * All rights reserved.                                                     *
+ *                                                                          *
+ * This file is part of the DataTransferKit library. DataTransferKit is     *
+ * distributed under a BSD 3-clause license. For the licensing terms see    *
+ * the LICENSE file in the top-level directory.                             *
+ ****************************************************************************/
+#ifndef DTK_DETAILS_SEARCH_STRATEGY_HPP
+#define DTK_DETAILS_SEARCH_STRATEGY_HPP
+
+#include "DTK_ConfigDefs.hpp"
+
+#include <DTK_DetailsAlgorithms.hpp>
+#include <DTK_DetailsBox.hpp>
+#include <DTK_DetailsTreeConstruction.hpp>
+#include <DTK_KokkosHelpers.hpp>
+
+#include <Kokkos_Sort.hpp> // min_max_functor
+#include <Kokkos_View.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+
+namespace DataTransferKit
+{
+
+/**
+ * Search structures among which AdaptiveSearchTree may choose.
+ */
+enum class SearchStrategy
+{
+    BruteForce,
+    BoundingVolumeHierarchy,
+    UniformGrid,
+    KdTree
+};
+
+inline std::ostream &operator<<( std::ostream &os, SearchStrategy strategy )
+{
+    switch ( strategy )
+    {
+    case SearchStrategy::BruteForce:
+        return os << "brute force";
+    case SearchStrategy::BoundingVolumeHierarchy:
+        return os << "bounding volume hierarchy";
+    case SearchStrategy::UniformGrid:
+        return os << "uniform grid";
+    case SearchStrategy::KdTree:
+        return os << "kd-tree";
+    }
+    return os;
+}
+
+namespace Details
+{
+/**
+ * Description of a set of objects that is cheap to gather and from which the
+ * cost of the different search strategies is estimated.
+ */
+struct SceneStatistics
+{
+    int n_objects = 0;
+    // number of dimensions along which the scene spans more than one cell
+    int n_dimensions = 0;
+    // true if all the bounding boxes are degenerated to points
+    bool points = true;
+    // size of the cells of a uniform grid with about one object per cell
+    double cell_size = 0.;
+    // the size of an object is the largest side of its bounding box
+    double max_size = 0.;
+    double mean_size = 0.;
+    double size_variance = 0.;
+    // fraction of the cells of the above grid that hold at least one object,
+    // relative to the fraction expected for uniformly distributed objects.
+    // Small values indicate clustered objects.
+    double spread = 1.;
+};
+
+/**
+ * Cost model of the search strategies.  Costs are expressed in number of
+ * bounding box tests so that they can be compared with each other but not
+ * with actual timings.  AdaptiveSearchTree relates them to the measured
+ * query times.
+ */
+template <typename DeviceType>
+struct SearchStrategySelection
+{
+  public:
+    using ExecutionSpace = typename DeviceType::execution_space;
+
+    static SceneStatistics
+    sceneStatistics( Kokkos::View<Box const *, DeviceType> bounding_boxes );
+
+    // Cost of building the structure.
+    static double constructionCost( SceneStatistics const &scene,
+                                    SearchStrategy strategy );
+
+    // Average cost of a single query.
+    static double queryCost( SceneStatistics const &scene,
+                             SearchStrategy strategy );
+
+    // Whether the strategy can handle the objects at all.
+    static bool isApplicable( SceneStatistics const &scene,
+                              SearchStrategy strategy );
+
+    // Strategy with the lowest estimated cost for building the structure and
+    // performing the given number of queries.
+    static SearchStrategy select( SceneStatistics const &scene,
+                                  int n_queries );
+};
+
+template <typename DeviceType>
+SceneStatistics SearchStrategySelection<DeviceType>::sceneStatistics(
+    Kokkos::View<Box const *, DeviceType> bounding_boxes )
+{
+    SceneStatistics scene;
+    int const n = bounding_boxes.extent( 0 );
+    scene.n_objects = n;
+    if ( n == 0 )
+        return scene;
+
+    Box bounds;
+    TreeConstruction<DeviceType>::calculateBoundingBoxOfTheScene(
+        bounding_boxes, bounds );
+
+    // sizes of the objects
+    Kokkos::View<double *, DeviceType> sizes( "sizes", n );
+    Kokkos::parallel_for( REGION_NAME( "compute_object_sizes" ),
+                          Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
+                          KOKKOS_LAMBDA( int i ) {
+                              Box const &box = bounding_boxes( i );
+                              double size = 0.;
+                              for ( int d = 0; d < 3; ++d )
+                                  size = KokkosHelpers::max(
+                                      size, box[2 * d + 1] - box[2 * d + 0] );
+                              sizes( i ) = size;
+                          } );
+    Kokkos::fence();
+
+    Kokkos::Experimental::MinMaxScalar<double> result;
+    Kokkos::Experimental::MinMax<double> reducer( result );
+    Kokkos::parallel_reduce(
+        REGION_NAME( "find_largest_object" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
+        Kokkos::Impl::min_max_functor<Kokkos::View<double *, DeviceType>>(
+            sizes ),
+        reducer );
+    Kokkos::fence();
+    scene.max_size = result.max_val;
+    scene.points = ( result.max_val == 0. );
+
+    double sum = 0.;
+    Kokkos::parallel_reduce(
+        REGION_NAME( "sum_object_sizes" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
+        KOKKOS_LAMBDA( int i, double &partial_sum ) {
+            partial_sum += sizes( i );
+        },
+        sum );
+    Kokkos::fence();
+    scene.mean_size = sum / n;
+    double const mean_size = scene.mean_size;
+    double sum_of_squares = 0.;
+    Kokkos::parallel_reduce(
+        REGION_NAME( "sum_squared_deviations_of_object_sizes" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
+        KOKKOS_LAMBDA( int i, double &partial_sum ) {
+            double const deviation = sizes( i ) - mean_size;
+            partial_sum += deviation * deviation;
+        },
+        sum_of_squares );
+    Kokkos::fence();
+    scene.size_variance = sum_of_squares / n;
+
+    // same choice of cell size as the uniform grid
+    double const cell_size = defaultCellSize( bounds, n, scene.n_dimensions );
+    if ( scene.n_dimensions == 0 )
+        return scene;
+    scene.cell_size = cell_size;
+
+    // bin the centroids of the objects
+    int n_cells[3];
+    int n_cells_total = 1;
+    for ( int d = 0; d < 3; ++d )
+    {
+        double const extent = bounds[2 * d + 1] - bounds[2 * d + 0];
+        n_cells[d] = KokkosHelpers::max(
+            static_cast<int>( std::ceil( extent / cell_size ) ), 1 );
+        n_cells_total *= n_cells[d];
+    }
+    int const nx = n_cells[0];
+    int const ny = n_cells[1];
+    int const nz = n_cells[2];
+    Kokkos::View<int *, DeviceType> occupied( "occupied", n_cells_total );
+    Kokkos::parallel_for(
+        REGION_NAME( "mark_occupied_cells" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n ), KOKKOS_LAMBDA( int i ) {
+            Point c;
+            centroid( bounding_boxes( i ), c );
+            int const n_cells_d[3] = {nx, ny, nz};
+            int cell[3];
+            for ( int d = 0; d < 3; ++d )
+                cell[d] = KokkosHelpers::min(
+                    KokkosHelpers::max(
+                        static_cast<int>( ( c[d] - bounds[2 * d + 0] ) /
+                                          cell_size ),
+                        0 ),
+                    n_cells_d[d] - 1 );
+            occupied( cell[0] + nx * ( cell[1] + ny * cell[2] ) ) = 1;
+        } );
+    Kokkos::fence();
+    int n_occupied = 0;
+    Kokkos::parallel_reduce( REGION_NAME( "count_occupied_cells" ),
+                             Kokkos::RangePolicy<ExecutionSpace>(
+                                 0, n_cells_total ),
+                             KOKKOS_LAMBDA( int c, int &count ) {
+                                 count += occupied( c );
+                             },
+                             n_occupied );
+    Kokkos::fence();
+
+    // n objects thrown uniformly at random in m cells occupy on average
+    // m * (1 - (1 - 1/m)^n) of them
+    double const m = n_cells_total;
+    double const expected_occupied = m * ( 1. - std::pow( 1. - 1. / m, n ) );
+    scene.spread =
+        std::min( 1., static_cast<double>( n_occupied ) / expected_occupied );
+
+    return scene;
+}
+
+template <typename DeviceType>
+bool SearchStrategySelection<DeviceType>::isApplicable(
+    SceneStatistics const &scene, SearchStrategy strategy )
+{
+    return strategy != SearchStrategy::KdTree || scene.points;
+}
+
+template <typename DeviceType>
+double SearchStrategySelection<DeviceType>::constructionCost(
+    SceneStatistics const &scene, SearchStrategy strategy )
+{
+    // The fixed costs account for the kernel launches.
+    double const n = scene.n_objects;
+    switch ( strategy )
+    {
+    case SearchStrategy::BruteForce:
+        return 10. + n;
+    case SearchStrategy::BoundingVolumeHierarchy:
+        return 100. + 20. * n;
+    case SearchStrategy::UniformGrid:
+        return 80. + 10. * n;
+    case SearchStrategy::KdTree:
+        // built on the host
+        return 20. + 2. * n * std::log2( n + 1. );
+    }
+    return 0.;
+}
+
+template <typename DeviceType>
+double
+SearchStrategySelection<DeviceType>::queryCost( SceneStatistics const &scene,
+                                                SearchStrategy strategy )
+{
+    double const n = scene.n_objects;
+    if ( n == 0 )
+        return 0.;
+    double const depth = std::log2( n + 1. );
+    // Spread in object sizes makes the bounding volumes overlap more.
+    double const size_dispersion =
+        scene.mean_size > 0.
+            ? std::sqrt( scene.size_variance ) / scene.mean_size
+            : 0.;
+    switch ( strategy )
+    {
+    case SearchStrategy::BruteForce:
+        // contiguous scan without any indirection
+        return 0.5 * n;
+    case SearchStrategy::BoundingVolumeHierarchy:
+        return 4. * depth * ( 1. + size_dispersion );
+    case SearchStrategy::UniformGrid:
+    {
+        if ( scene.cell_size == 0. )
+            return n;
+        // The search region is expanded by the size of the largest object
+        // and clustered objects crowd the occupied cells.
+        double const cells_per_side = 2. + scene.max_size / scene.cell_size;
+        double const n_cells = std::pow( cells_per_side, scene.n_dimensions );
+        return n_cells * ( 1. + 1. / scene.spread );
+    }
+    case SearchStrategy::KdTree:
+        return 2. * depth;
+    }
+    return 0.;
+}
+
+template <typename DeviceType>
+SearchStrategy
+SearchStrategySelection<DeviceType>::select( SceneStatistics const &scene,
+                                             int n_queries )
+{
+    SearchStrategy best = SearchStrategy::BruteForce;
+    double best_cost = -1.;
+    for ( SearchStrategy strategy :
+          {SearchStrategy::BruteForce, SearchStrategy::BoundingVolumeHierarchy,
+           SearchStrategy::UniformGrid, SearchStrategy::KdTree} )
+    {
+        if ( !isApplicable( scene, strategy ) )
+            continue;
+        double const cost = constructionCost( scene, strategy ) +
+                            n_queries * queryCost( scene, strategy );
+        if ( best_cost < 0. || cost < best_cost )
+        {
+            best = strategy;
+            best_cost = cost;
+        }
+    }
+    return best;
+}
+
+} // end namespace Details
+} // end namespace DataTransferKit
+
+#endif
@@ -30,6 +30,8 @@ class Stack
 
     KOKKOS_INLINE_FUNCTION bool empty() const { return _size == 0; }
 
+    KOKKOS_INLINE_FUNCTION SizeType size() const { return _size; }
+
     template <typename... Args>
     KOKKOS_INLINE_FUNCTION void push( Args &&... args )
     {
@@ -0,0 +1,142 @@
+/****************************************************************************
+ * Copyright (c) 2012-2017 by the DataTransferKit authors                   *
+ * All rights reserved.                                                     *
+ *                                                                          *
+ * This file is part of the DataTransferKit library. DataTransferKit is     *
+ * distributed under a BSD 3-clause license. For the licensing terms see    *
+ * the LICENSE file in the top-level directory.                             *
+ ****************************************************************************/
+#ifndef DTK_DETAILS_TRAVERSAL_STATISTICS_HPP
+#define DTK_DETAILS_TRAVERSAL_STATISTICS_HPP
+
+#include <DTK_KokkosHelpers.hpp>
+
+#include <Kokkos_Macros.hpp>
+#include <Kokkos_View.hpp>
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+
+namespace DataTransferKit
+{
+namespace Details
+{
+
+/**
+ * Statistics policy that does nothing.  This is what the tree traversal uses
+ * by default so the calls to the counters are optimized away.
+ */
+struct NullStatistics
+{
+    KOKKOS_INLINE_FUNCTION void visitNode() {}
+    KOKKOS_INLINE_FUNCTION void testLeaf() {}
+    KOKKOS_INLINE_FUNCTION void updateDepth( int ) {}
+};
+
+/**
+ * Counters gathered during the traversal of the tree for a single query.
+ * For spatial queries the depth is the size of the stack and for nearest
+ * queries it is the size of the priority queue.
+ */
+struct QueryStatistics
+{
+    KOKKOS_INLINE_FUNCTION void visitNode() { ++nodes_visited; }
+    KOKKOS_INLINE_FUNCTION void testLeaf() { ++leaves_tested; }
+    KOKKOS_INLINE_FUNCTION void updateDepth( int depth )
+    {
+        max_depth = KokkosHelpers::max( max_depth, depth );
+    }
+
+    int nodes_visited = 0;
+    int leaves_tested = 0;
+    int max_depth = 0;
+};
+
+/**
+ * Summary of one counter over a batch of queries.  Bin \c b of the
+ * histogram holds the number of queries with a value in [2^(b-1), 2^b), bin
+ * 0 counts the zeros.
+ */
+struct StatisticsSummary
+{
+    static int constexpr n_bins = 32;
+
+    void add( int value )
+    {
+        min = ( count == 0 ? value : KokkosHelpers::min( min, value ) );
+        max = ( count == 0 ? value : KokkosHelpers::max( max, value ) );
+        mean = ( mean * count + value ) / ( count + 1 );
+        ++count;
+        int bin = 0;
+        while ( value > 0 && bin < n_bins - 1 )
+        {
+            value >>= 1;
+            ++bin;
+        }
+        ++histogram[bin];
+    }
+
+    int count = 0;
+    int min = 0;
+    int max = 0;
+    double mean = 0.;
+    std::array<int, n_bins> histogram = {};
+
+    friend std::ostream &operator<<( std::ostream &os,
+                                     StatisticsSummary const &summary )
+    {
+        os << "min=" << summary.min << " mean=" << summary.mean
+           << " max=" << summary.max << " histogram={";
+        for ( int b = 0; b < n_bins; ++b )
+            if ( summary.histogram[b] > 0 )
+            {
+                // the upper bound of the last bin does not fit in an int
+                std::uint64_t const one = 1;
+                os << " [" << ( b > 0 ? one << ( b - 1 ) : 0 ) << ", "
+                   << ( one << b ) << "):" << summary.histogram[b];
+            }
+        os << " }";
+        return os;
+    }
+};
+
+/**
+ * Statistics of the tree traversal for a batch of queries.  They are
+ * returned by BVH::query() when DTK was configured with
+ * DataTransferKit_ENABLE_TRAVERSAL_STATISTICS=ON.
+ */
+struct TraversalStatistics
+{
+    template <typename DeviceType>
+    void summarize( Kokkos::View<QueryStatistics *, DeviceType> stats )
+    {
+        *this = TraversalStatistics();
+        auto stats_host = Kokkos::create_mirror_view( stats );
+        Kokkos::deep_copy( stats_host, stats );
+        for ( int i = 0; i < stats_host.extent_int( 0 ); ++i )
+        {
+            nodes_visited.add( stats_host( i ).nodes_visited );
+            leaves_tested.add( stats_host( i ).leaves_tested );
+            max_depth.add( stats_host( i ).max_depth );
+        }
+    }
+
+    StatisticsSummary nodes_visited;
+    StatisticsSummary leaves_tested;
+    StatisticsSummary max_depth;
+
+    friend std::ostream &operator<<( std::ostream &os,
+                                     TraversalStatistics const &stats )
+    {
+        os << "nodes visited: " << stats.nodes_visited << "\n";
+        os << "leaves tested: " << stats.leaves_tested << "\n";
+        os << "maximum depth: " << stats.max_depth << "\n";
+        return os;
+    }
+};
+
+} // end namespace Details
+} // end namespace DataTransferKit
+
+#endif
@@ -23,6 +23,14 @@ namespace DataTransferKit
 {
 namespace Details
 {
+// Space-filling curves along which the objects can be sorted.
+struct MortonCurve
+{
+};
+struct HilbertCurve
+{
+};
+
 /**
  * This structure contains all the functions used to build the BVH. All the
  * functions are static.
@@ -39,11 +47,18 @@ struct TreeConstruction
 
     // to assign the Morton code for a given object, we use the centroid point
     // of its bounding box, and express it relative to the bounding box of the
-    // scene.
-    static void
+    // scene.  Returns true when the codes are already sorted, i.e. when the
+    // objects come in Z-order.  The codes are keys along the Hilbert curve
+    // instead when passing HilbertCurve.
+    static bool
+    assignMortonCodes( Kokkos::View<Box const *, DeviceType> bounding_boxes,
+                       Kokkos::View<unsigned int *, DeviceType> morton_codes,
+                       Box const &scene_bounding_box,
+                       MortonCurve = MortonCurve{} );
+    static bool
     assignMortonCodes( Kokkos::View<Box const *, DeviceType> bounding_boxes,
                        Kokkos::View<unsigned int *, DeviceType> morton_codes,
-                       Box const &scene_bounding_box );
+                       Box const &scene_bounding_box, HilbertCurve );
 
     static void
     sortObjects( Kokkos::View<unsigned int *, DeviceType> morton_codes,
@@ -54,9 +69,15 @@ struct TreeConstruction
         Kokkos::View<Node *, DeviceType> leaf_nodes,
         Kokkos::View<Node *, DeviceType> internal_nodes );
 
-    static void
-    calculateBoundingBoxes( Kokkos::View<Node *, DeviceType> leaf_nodes,
-                            Kokkos::View<Node *, DeviceType> internal_nodes );
+    // The tags of the internal nodes (the union of those of their children)
+    // are computed along with the bounding boxes unless the view is empty.
+    // It holds the tags of the internal nodes followed by those of the
+    // leaves.
+    static void calculateBoundingBoxes(
+        Kokkos::View<Node *, DeviceType> leaf_nodes,
+        Kokkos::View<Node *, DeviceType> internal_nodes,
+        Kokkos::View<unsigned int *, DeviceType> tags =
+            Kokkos::View<unsigned int *, DeviceType>() );
 
     KOKKOS_INLINE_FUNCTION
     static int
@@ -110,6 +131,60 @@ struct TreeConstruction
         return xx * 4 + yy * 2 + zz;
     }
 
+    // Calculates a 30-bit key along the Hilbert curve for the given 3D point
+    // located within the unit cube [0,1], with the same resolution as
+    // morton3D().  Unlike the Z-order curve, consecutive cells along the
+    // Hilbert curve always share a face.  The coordinates are converted to
+    // the "transposed" Hilbert index whose bits are then interleaved, see
+    // J. Skilling, Programming the Hilbert curve, AIP Conf. Proc. 707 (2004).
+    KOKKOS_INLINE_FUNCTION
+    static unsigned int hilbert3D( double x, double y, double z )
+    {
+        x = KokkosHelpers::min( KokkosHelpers::max( x * 1024.0, 0.0 ), 1023.0 );
+        y = KokkosHelpers::min( KokkosHelpers::max( y * 1024.0, 0.0 ), 1023.0 );
+        z = KokkosHelpers::min( KokkosHelpers::max( z * 1024.0, 0.0 ), 1023.0 );
+        unsigned int X[3] = {(unsigned int)x, (unsigned int)y,
+                             (unsigned int)z};
+        // inverse undo
+        for ( unsigned int q = 1u << 9; q > 1; q >>= 1 )
+        {
+            unsigned int const p = q - 1;
+            for ( int i = 0; i < 3; ++i )
+                if ( X[i] & q )
+                    X[0] ^= p; // invert
+                else
+                {
+                    // exchange
+                    unsigned int const t = ( X[0] ^ X[i] ) & p;
+                    X[0] ^= t;
+                    X[i] ^= t;
+                }
+        }
+        // Gray encode
+        for ( int i = 1; i < 3; ++i )
+            X[i] ^= X[i - 1];
+        unsigned int t = 0;
+        for ( unsigned int q = 1u << 9; q > 1; q >>= 1 )
+            if ( X[2] & q )
+                t ^= q - 1;
+        for ( int i = 0; i < 3; ++i )
+            X[i] ^= t;
+        return expandBits( X[0] ) * 4 + expandBits( X[1] ) * 2 +
+               expandBits( X[2] );
+    }
+
+    KOKKOS_INLINE_FUNCTION
+    static unsigned int encode( MortonCurve, double x, double y, double z )
+    {
+        return morton3D( x, y, z );
+    }
+
+    KOKKOS_INLINE_FUNCTION
+    static unsigned int encode( HilbertCurve, double x, double y, double z )
+    {
+        return hilbert3D( x, y, z );
+    }
+
     KOKKOS_FUNCTION
     static int
     findSplit( Kokkos::View<unsigned int *, DeviceType> sorted_morton_codes,
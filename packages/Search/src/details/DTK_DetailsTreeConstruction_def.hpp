@@ -25,7 +25,7 @@ namespace DataTransferKit
 namespace Details
 {
 
-template <typename DeviceType>
+template <typename DeviceType, typename SpaceFillingCurve>
 class AssignMortonCodesFunctor
 {
   public:
@@ -40,7 +40,22 @@ class AssignMortonCodesFunctor
     }
 
     KOKKOS_INLINE_FUNCTION
-    void operator()( int const i ) const
+    void operator()( int const i ) const { _morton_codes[i] = mortonCode( i ); }
+
+    // Same as above but also counts the objects whose code is smaller than
+    // the one of the previous object.  The code of the previous object is
+    // recomputed rather than read since it may not be assigned yet.
+    KOKKOS_INLINE_FUNCTION
+    void operator()( int const i, int &n_descents ) const
+    {
+        _morton_codes[i] = mortonCode( i );
+        if ( i > 0 && mortonCode( i - 1 ) > _morton_codes[i] )
+            ++n_descents;
+    }
+
+  private:
+    KOKKOS_INLINE_FUNCTION
+    unsigned int mortonCode( int const i ) const
     {
         Point xyz;
         double a, b;
@@ -52,11 +67,10 @@ class AssignMortonCodesFunctor
             b = _scene_bounding_box[2 * d + 1];
             xyz[d] = ( a != b ? ( xyz[d] - a ) / ( b - a ) : 0 );
         }
-        _morton_codes[i] =
-            TreeConstruction<DeviceType>::morton3D( xyz[0], xyz[1], xyz[2] );
+        return TreeConstruction<DeviceType>::encode( SpaceFillingCurve{},
+                                                     xyz[0], xyz[1], xyz[2] );
     }
 
-  private:
     Kokkos::View<Box const *, DeviceType> _bounding_boxes;
     Kokkos::View<unsigned int *, DeviceType> _morton_codes;
     Box const &_scene_bounding_box;
@@ -129,13 +143,25 @@ template <typename DeviceType>
 class CalculateBoundingBoxesFunctor
 {
   public:
-    CalculateBoundingBoxesFunctor( Kokkos::View<Node *, DeviceType> leaf_nodes,
-                                   Node *root,
-                                   Kokkos::View<int *, DeviceType> ready_flags )
+    CalculateBoundingBoxesFunctor(
+        Kokkos::View<Node *, DeviceType> leaf_nodes, Node *root,
+        Kokkos::View<int *, DeviceType> ready_flags,
+        Kokkos::View<unsigned int *, DeviceType> tags )
         : _leaf_nodes( leaf_nodes )
         , _root( root )
         , _ready_flags( ready_flags )
+        , _tags( tags )
+    {
+    }
+
+    // Position of the node in the array of tags.
+    KOKKOS_INLINE_FUNCTION
+    int tagPosition( Node const *node ) const
     {
+        int const n_internal_nodes = _leaf_nodes.extent_int( 0 ) - 1;
+        if ( node->children.first == nullptr )
+            return n_internal_nodes + ( node - _leaf_nodes.data() );
+        return node - _root;
     }
 
     KOKKOS_INLINE_FUNCTION
@@ -149,17 +175,23 @@ class CalculateBoundingBoxesFunctor
                 break;
             for ( Node *child : {node->children.first, node->children.second} )
                 expand( node->bounding_box, child->bounding_box );
+            if ( _tags.extent( 0 ) > 0 )
+                _tags[tagPosition( node )] =
+                    _tags[tagPosition( node->children.first )] |
+                    _tags[tagPosition( node->children.second )];
             node = node->parent;
         }
         // NOTE: could stop at node != root and then just check that what we
         // computed earlier (bounding box of the scene) is indeed the union of
-        // the two children.
+        // the two children.  The root is never tested against the predicates
+        // so its tags are left untouched.
     }
 
   private:
     Kokkos::View<Node *, DeviceType> _leaf_nodes;
     Node *_root;
     Kokkos::View<int *, DeviceType> _ready_flags;
+    Kokkos::View<unsigned int *, DeviceType> _tags;
 };
 
 template <typename DeviceType>
@@ -175,19 +207,42 @@ void TreeConstruction<DeviceType>::calculateBoundingBoxOfTheScene(
     Kokkos::fence();
 }
 
-template <typename DeviceType>
-void TreeConstruction<DeviceType>::assignMortonCodes(
+template <typename DeviceType, typename SpaceFillingCurve>
+bool assignSpaceFillingCurveCodes(
     Kokkos::View<Box const *, DeviceType> bounding_boxes,
-    Kokkos::View<unsigned int *, DeviceType> morton_codes,
+    Kokkos::View<unsigned int *, DeviceType> codes,
     Box const &scene_bounding_box )
 {
-    int const n = morton_codes.extent( 0 );
-    AssignMortonCodesFunctor<DeviceType> functor( bounding_boxes, morton_codes,
-                                                  scene_bounding_box );
-    Kokkos::parallel_for( REGION_NAME( "assign_morton_codes" ),
-                          Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
-                          functor );
+    using ExecutionSpace = typename DeviceType::execution_space;
+    int const n = codes.extent( 0 );
+    AssignMortonCodesFunctor<DeviceType, SpaceFillingCurve> functor(
+        bounding_boxes, codes, scene_bounding_box );
+    int n_descents = 0;
+    Kokkos::parallel_reduce( REGION_NAME( "assign_morton_codes" ),
+                             Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
+                             functor, n_descents );
     Kokkos::fence();
+    return n_descents == 0;
+}
+
+template <typename DeviceType>
+bool TreeConstruction<DeviceType>::assignMortonCodes(
+    Kokkos::View<Box const *, DeviceType> bounding_boxes,
+    Kokkos::View<unsigned int *, DeviceType> morton_codes,
+    Box const &scene_bounding_box, MortonCurve )
+{
+    return assignSpaceFillingCurveCodes<DeviceType, MortonCurve>(
+        bounding_boxes, morton_codes, scene_bounding_box );
+}
+
+template <typename DeviceType>
+bool TreeConstruction<DeviceType>::assignMortonCodes(
+    Kokkos::View<Box const *, DeviceType> bounding_boxes,
+    Kokkos::View<unsigned int *, DeviceType> morton_codes,
+    Box const &scene_bounding_box, HilbertCurve )
+{
+    return assignSpaceFillingCurveCodes<DeviceType, HilbertCurve>(
+        bounding_boxes, morton_codes, scene_bounding_box );
 }
 
 template <typename DeviceType>
@@ -241,7 +296,8 @@ Node *TreeConstruction<DeviceType>::generateHierarchy(
 template <typename DeviceType>
 void TreeConstruction<DeviceType>::calculateBoundingBoxes(
     Kokkos::View<Node *, DeviceType> leaf_nodes,
-    Kokkos::View<Node *, DeviceType> internal_nodes )
+    Kokkos::View<Node *, DeviceType> internal_nodes,
+    Kokkos::View<unsigned int *, DeviceType> tags )
 {
     int const n = leaf_nodes.extent( 0 );
 
@@ -254,8 +310,8 @@ void TreeConstruction<DeviceType>::calculateBoundingBoxes(
 
     Node *root = &internal_nodes[0];
 
-    CalculateBoundingBoxesFunctor<DeviceType> calc_functor( leaf_nodes, root,
-                                                            ready_flags );
+    CalculateBoundingBoxesFunctor<DeviceType> calc_functor(
+        leaf_nodes, root, ready_flags, tags );
     Kokkos::parallel_for( REGION_NAME( "calculate_bounding_boxes" ),
                           Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
                           calc_functor );
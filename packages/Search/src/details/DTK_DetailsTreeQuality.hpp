@@ -0,0 +1,166 @@
+/****************************************************************************
+ * Copyright (c) 2012-2017 by the DataTransferKit authors                   *
+ * All rights reserved.                                                     *
+ *                                                                          *
+ * This file is part of the DataTransferKit library. DataTransferKit is     *
+ * distributed under a BSD 3-clause license. For the licensing terms see    *
+ * the LICENSE file in the top-level directory.                             *
+ ****************************************************************************/
+#ifndef DTK_DETAILS_TREE_QUALITY_HPP
+#define DTK_DETAILS_TREE_QUALITY_HPP
+
+#include "DTK_ConfigDefs.hpp"
+
+#include <DTK_DetailsAlgorithms.hpp>
+#include <DTK_DetailsNode.hpp>
+
+#include <Kokkos_Core.hpp>
+#include <Kokkos_Sort.hpp>
+
+namespace DataTransferKit
+{
+namespace Details
+{
+/**
+ * Depth of the leaves in the hierarchy.  The root is at depth zero.
+ */
+struct LeafDepth
+{
+    int min_depth = 0;
+    int max_depth = 0;
+    double average_depth = 0.;
+};
+
+/**
+ * This structure contains the functions that measure the quality of a BVH
+ * once it has been built.  All the functions are static.
+ */
+template <typename DeviceType>
+struct TreeQuality
+{
+  public:
+    using ExecutionSpace = typename DeviceType::execution_space;
+
+    // Cost of the hierarchy according to the surface area heuristic.  The
+    // area of each node relative to the area of the root is the probability
+    // that it is visited by a random ray.  Visiting an internal node or
+    // testing a leaf is assigned a unit cost.  If the root has zero area,
+    // every node is assumed to be visited.
+    static double
+    sahCost( Kokkos::View<Node const *, DeviceType> leaf_nodes,
+             Kokkos::View<Node const *, DeviceType> internal_nodes );
+
+    static LeafDepth
+    leafDepth( Kokkos::View<Node const *, DeviceType> leaf_nodes );
+
+    // Sum over all internal nodes of the volume of the intersection of the
+    // bounding boxes of its two children.
+    static double siblingOverlapVolume(
+        Kokkos::View<Node const *, DeviceType> internal_nodes );
+};
+
+template <typename DeviceType>
+double TreeQuality<DeviceType>::sahCost(
+    Kokkos::View<Node const *, DeviceType> leaf_nodes,
+    Kokkos::View<Node const *, DeviceType> internal_nodes )
+{
+    int const n_leaves = leaf_nodes.extent( 0 );
+    int const n_internal_nodes = internal_nodes.extent( 0 );
+    if ( n_leaves == 0 )
+        return 0.;
+
+    Kokkos::View<Node const *, DeviceType> root(
+        n_internal_nodes > 0 ? internal_nodes : leaf_nodes );
+    double root_area = 0.;
+    Kokkos::parallel_reduce( REGION_NAME( "compute_root_surface_area" ),
+                             Kokkos::RangePolicy<ExecutionSpace>( 0, 1 ),
+                             KOKKOS_LAMBDA( int i, double &area ) {
+                                 area += surfaceArea( root( i ).bounding_box );
+                             },
+                             root_area );
+    Kokkos::fence();
+    if ( root_area == 0. )
+        return n_leaves + n_internal_nodes;
+
+    double area = 0.;
+    Kokkos::parallel_reduce(
+        REGION_NAME( "sum_surface_areas" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_leaves + n_internal_nodes ),
+        KOKKOS_LAMBDA( int i, double &sum ) {
+            sum += surfaceArea(
+                ( i < n_leaves ? leaf_nodes( i )
+                               : internal_nodes( i - n_leaves ) )
+                    .bounding_box );
+        },
+        area );
+    Kokkos::fence();
+
+    return area / root_area;
+}
+
+template <typename DeviceType>
+LeafDepth TreeQuality<DeviceType>::leafDepth(
+    Kokkos::View<Node const *, DeviceType> leaf_nodes )
+{
+    int const n = leaf_nodes.extent( 0 );
+    LeafDepth depth;
+    if ( n == 0 )
+        return depth;
+
+    // count the number of ancestors of each leaf
+    Kokkos::View<int *, DeviceType> depths( "leaf_depths", n );
+    Kokkos::parallel_for( REGION_NAME( "compute_leaf_depths" ),
+                          Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
+                          KOKKOS_LAMBDA( int i ) {
+                              int d = 0;
+                              for ( Node const *node = leaf_nodes( i ).parent;
+                                    node != nullptr; node = node->parent )
+                                  ++d;
+                              depths( i ) = d;
+                          } );
+    Kokkos::fence();
+
+    Kokkos::Experimental::MinMaxScalar<int> result;
+    Kokkos::Experimental::MinMax<int> reducer( result );
+    Kokkos::parallel_reduce(
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
+        Kokkos::Impl::min_max_functor<Kokkos::View<int *, DeviceType>>(
+            depths ),
+        reducer );
+    int sum = 0;
+    Kokkos::parallel_reduce( REGION_NAME( "sum_leaf_depths" ),
+                             Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
+                             KOKKOS_LAMBDA( int i, int &partial_sum ) {
+                                 partial_sum += depths( i );
+                             },
+                             sum );
+    Kokkos::fence();
+
+    depth.min_depth = result.min_val;
+    depth.max_depth = result.max_val;
+    depth.average_depth = static_cast<double>( sum ) / n;
+    return depth;
+}
+
+template <typename DeviceType>
+double TreeQuality<DeviceType>::siblingOverlapVolume(
+    Kokkos::View<Node const *, DeviceType> internal_nodes )
+{
+    double volume = 0.;
+    Kokkos::parallel_reduce(
+        REGION_NAME( "sum_sibling_overlap_volumes" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, internal_nodes.extent( 0 ) ),
+        KOKKOS_LAMBDA( int i, double &sum ) {
+            Node const &node = internal_nodes( i );
+            sum += overlapVolume( node.children.first->bounding_box,
+                                  node.children.second->bounding_box );
+        },
+        volume );
+    Kokkos::fence();
+    return volume;
+}
+
+} // end namespace Details
+} // end namespace DataTransferKit
+
+#endif
@@ -0,0 +1,335 @@
+/****************************************************************************
+ * Copyright (c) 2012-2017 by the DataTransferKit authors                   *
+ * All rights reserved.                                                     *
+ *                                                                          *
+ * This file is part of the DataTransferKit library. DataTransferKit is     *
+ * distributed under a BSD 3-clause license. For the licensing terms see    *
+ * the LICENSE file in the top-level directory.                             *
+ ****************************************************************************/
+#ifndef DTK_DETAILS_TREE_SERIALIZATION_HPP
+#define DTK_DETAILS_TREE_SERIALIZATION_HPP
+
+#include "DTK_ConfigDefs.hpp"
+
+#include <DTK_DBC.hpp>
+#include <DTK_DetailsNode.hpp>
+
+#include <Kokkos_View.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <ostream>
+#include <type_traits>
+#include <vector>
+
+namespace DataTransferKit
+{
+
+template <typename DeviceType>
+class BVH;
+
+namespace Details
+{
+/**
+ * Binary layout of a serialized BVH: a header followed by the nodes (the
+ * internal nodes first, then the leaves) and by the permutation indices.
+ * Everything is stored in native byte order without any padding between the
+ * sections so that a file can be memory-mapped and copied as is.
+ */
+struct SerializedTreeHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    // Written as 0x01020304 to detect files from a machine with a different
+    // byte order.
+    std::uint32_t byte_order;
+    std::uint32_t brute_force;
+    std::uint32_t reserved;
+    std::uint64_t n_leaf_nodes;
+    std::uint64_t n_internal_nodes;
+};
+
+/**
+ * Node with the pointers replaced by positions in the array of serialized
+ * nodes.  -1 stands for no node.  Trees without tags store Node::all_tags.
+ */
+struct SerializedNode
+{
+    double bounding_box[6];
+    std::int32_t parent;
+    std::int32_t children[2];
+    std::uint32_t tags;
+};
+
+static_assert( std::is_trivially_copyable<SerializedTreeHeader>::value &&
+                   std::is_trivially_copyable<SerializedNode>::value,
+               "serialized types must be copyable as raw bytes" );
+
+template <typename DeviceType>
+struct TreeSerialization
+{
+  public:
+    using ExecutionSpace = typename DeviceType::execution_space;
+
+    // Increment whenever the layout changes.
+    static std::uint32_t constexpr version = 1;
+
+    static void save( BVH<DeviceType> const &bvh, std::ostream &os );
+
+    static BVH<DeviceType> load( char const *buffer, std::size_t size );
+
+    // Throws unless the nodes only refer to nodes in the arrays, the leaves
+    // have no children, and the children of the internal nodes form a tree
+    // rooted at the first node that holds every node once, which the
+    // traversals rely on.
+    static void checkHierarchy( SerializedNode const *nodes,
+                                std::int32_t n_internal_nodes,
+                                std::int32_t n_leaf_nodes, bool brute_force );
+
+    KOKKOS_INLINE_FUNCTION
+    static std::int32_t encode( Node const *node, Node const *internal_nodes,
+                                std::int32_t n_internal_nodes,
+                                Node const *leaf_nodes )
+    {
+        if ( node == nullptr )
+            return -1;
+        if ( node >= internal_nodes &&
+             node < internal_nodes + n_internal_nodes )
+            return node - internal_nodes;
+        return n_internal_nodes + ( node - leaf_nodes );
+    }
+
+    KOKKOS_INLINE_FUNCTION
+    static Node *decode( std::int32_t position, Node *internal_nodes,
+                         std::int32_t n_internal_nodes, Node *leaf_nodes )
+    {
+        if ( position < 0 )
+            return nullptr;
+        if ( position < n_internal_nodes )
+            return internal_nodes + position;
+        return leaf_nodes + ( position - n_internal_nodes );
+    }
+};
+
+template <typename DeviceType>
+void TreeSerialization<DeviceType>::save( BVH<DeviceType> const &bvh,
+                                          std::ostream &os )
+{
+    std::int32_t const n_leaf_nodes = bvh._leaf_nodes.extent( 0 );
+    std::int32_t const n_internal_nodes = bvh._internal_nodes.extent( 0 );
+    std::int32_t const n_nodes = n_internal_nodes + n_leaf_nodes;
+
+    SerializedTreeHeader header;
+    std::memset( &header, 0, sizeof( header ) );
+    std::memcpy( header.magic, "DTKBVH", 6 );
+    header.version = version;
+    header.byte_order = 0x01020304;
+    header.brute_force = bvh._brute_force ? 1 : 0;
+    header.n_leaf_nodes = n_leaf_nodes;
+    header.n_internal_nodes = n_internal_nodes;
+
+    // The children and parents are converted on the device where the
+    // pointers are meaningful.
+    Kokkos::View<Node *, DeviceType> leaf_nodes = bvh._leaf_nodes;
+    Kokkos::View<Node *, DeviceType> internal_nodes = bvh._internal_nodes;
+    Kokkos::View<unsigned int *, DeviceType> tags = bvh._tags;
+    bool const has_tags = ( tags.extent( 0 ) > 0 );
+    Kokkos::View<SerializedNode *, DeviceType> serialized_nodes(
+        "serialized_nodes", n_nodes );
+    Kokkos::parallel_for(
+        REGION_NAME( "serialize_nodes" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_nodes ),
+        KOKKOS_LAMBDA( int i ) {
+            Node const &node = ( i < n_internal_nodes
+                                     ? internal_nodes( i )
+                                     : leaf_nodes( i - n_internal_nodes ) );
+            SerializedNode &serialized_node = serialized_nodes( i );
+            for ( int d = 0; d < 6; ++d )
+                serialized_node.bounding_box[d] = node.bounding_box[d];
+            serialized_node.parent =
+                encode( node.parent, internal_nodes.data(), n_internal_nodes,
+                        leaf_nodes.data() );
+            serialized_node.children[0] =
+                encode( node.children.first, internal_nodes.data(),
+                        n_internal_nodes, leaf_nodes.data() );
+            serialized_node.children[1] =
+                encode( node.children.second, internal_nodes.data(),
+                        n_internal_nodes, leaf_nodes.data() );
+            serialized_node.tags = Node::all_tags;
+            if ( has_tags )
+                serialized_node.tags = tags( i );
+        } );
+    Kokkos::fence();
+
+    auto serialized_nodes_host = Kokkos::create_mirror_view( serialized_nodes );
+    Kokkos::deep_copy( serialized_nodes_host, serialized_nodes );
+    auto indices_host = Kokkos::create_mirror_view( bvh._indices );
+    Kokkos::deep_copy( indices_host, bvh._indices );
+
+    os.write( reinterpret_cast<char const *>( &header ), sizeof( header ) );
+    os.write( reinterpret_cast<char const *>( serialized_nodes_host.data() ),
+              n_nodes * sizeof( SerializedNode ) );
+    os.write( reinterpret_cast<char const *>( indices_host.data() ),
+              n_leaf_nodes * sizeof( std::int32_t ) );
+    DTK_INSIST( os.good() );
+}
+
+template <typename DeviceType>
+void TreeSerialization<DeviceType>::checkHierarchy(
+    SerializedNode const *nodes, std::int32_t n_internal_nodes,
+    std::int32_t n_leaf_nodes, bool brute_force )
+{
+    std::int32_t const n_nodes = n_internal_nodes + n_leaf_nodes;
+    for ( std::int32_t i = 0; i < n_nodes; ++i )
+    {
+        DTK_INSIST( nodes[i].parent >= -1 && nodes[i].parent < n_nodes );
+        for ( int j = 0; j < 2; ++j )
+            DTK_INSIST( nodes[i].children[j] >= -1 &&
+                        nodes[i].children[j] < n_nodes );
+        // a node is a leaf when it has no children
+        if ( i >= n_internal_nodes )
+            for ( int j = 0; j < 2; ++j )
+                DTK_INSIST( nodes[i].children[j] == -1 );
+    }
+
+    // The leaves of trees without hierarchy are scanned, the children are
+    // never followed.
+    if ( brute_force || n_internal_nodes == 0 )
+        return;
+
+    std::vector<char> visited( n_nodes, 0 );
+    std::vector<std::int32_t> stack( 1, 0 );
+    std::int32_t n_visited = 0;
+    while ( !stack.empty() )
+    {
+        std::int32_t const i = stack.back();
+        stack.pop_back();
+        DTK_INSIST( !visited[i] );
+        visited[i] = 1;
+        ++n_visited;
+        if ( i < n_internal_nodes )
+            for ( int j = 0; j < 2; ++j )
+            {
+                DTK_INSIST( nodes[i].children[j] >= 0 );
+                stack.push_back( nodes[i].children[j] );
+            }
+    }
+    DTK_INSIST( n_visited == n_nodes );
+}
+
+template <typename DeviceType>
+BVH<DeviceType> TreeSerialization<DeviceType>::load( char const *buffer,
+                                                     std::size_t size )
+{
+    static_assert( sizeof( int ) == sizeof( std::int32_t ),
+                   "indices are stored as 32-bit integers" );
+
+    SerializedTreeHeader header;
+    DTK_INSIST( size >= sizeof( header ) );
+    std::memcpy( &header, buffer, sizeof( header ) );
+    DTK_INSIST( std::memcmp( header.magic, "DTKBVH", 6 ) == 0 );
+    DTK_INSIST( header.version == version );
+    DTK_INSIST( header.byte_order == 0x01020304 );
+
+    DTK_INSIST( header.brute_force == 0 || header.brute_force == 1 );
+
+    // The counts are checked before anything is computed from them so that
+    // a corrupted header can neither overflow the sizes nor make the buffer
+    // be read past its end.
+    std::uint64_t const max_nodes = std::numeric_limits<std::int32_t>::max();
+    DTK_INSIST( header.n_leaf_nodes <= max_nodes &&
+                header.n_internal_nodes <= max_nodes - header.n_leaf_nodes );
+    std::int32_t const n_leaf_nodes = header.n_leaf_nodes;
+    std::int32_t const n_internal_nodes = header.n_internal_nodes;
+    std::int32_t const n_nodes = n_internal_nodes + n_leaf_nodes;
+    std::size_t const nodes_offset = sizeof( header );
+    DTK_INSIST( ( size - nodes_offset ) / sizeof( SerializedNode ) >=
+                static_cast<std::size_t>( n_nodes ) );
+    std::size_t const indices_offset =
+        nodes_offset + n_nodes * sizeof( SerializedNode );
+    DTK_INSIST( ( size - indices_offset ) / sizeof( int ) >=
+                static_cast<std::size_t>( n_leaf_nodes ) );
+
+    // Trees without hierarchy only keep an internal node for the bounds.
+    bool const brute_force = ( header.brute_force != 0 );
+    DTK_INSIST( brute_force ? ( n_leaf_nodes > 1 && n_internal_nodes == 1 )
+                            : ( n_internal_nodes ==
+                                std::max( n_leaf_nodes - 1, 0 ) ) );
+
+    BVH<DeviceType> bvh;
+    bvh._brute_force = brute_force;
+    bvh._leaf_nodes =
+        Kokkos::View<Node *, DeviceType>( "leaf_nodes", n_leaf_nodes );
+    bvh._internal_nodes =
+        Kokkos::View<Node *, DeviceType>( "internal_nodes", n_internal_nodes );
+    bvh._indices =
+        Kokkos::View<int *, DeviceType>( "sorted_indices", n_leaf_nodes );
+
+    // The arrays are copied in one go and the pointers are restored on the
+    // device.
+    Kokkos::View<SerializedNode *, DeviceType> serialized_nodes(
+        "serialized_nodes", n_nodes );
+    auto serialized_nodes_host = Kokkos::create_mirror_view( serialized_nodes );
+    std::memcpy( serialized_nodes_host.data(), buffer + nodes_offset,
+                 n_nodes * sizeof( SerializedNode ) );
+    checkHierarchy( serialized_nodes_host.data(), n_internal_nodes,
+                    n_leaf_nodes, brute_force );
+    Kokkos::deep_copy( serialized_nodes, serialized_nodes_host );
+
+    // The tags are only allocated if the saved tree had some.
+    bool has_tags = false;
+    for ( std::int32_t i = 0; i < n_nodes; ++i )
+        if ( serialized_nodes_host( i ).tags != Node::all_tags )
+            has_tags = true;
+    if ( has_tags )
+        bvh._tags = Kokkos::View<unsigned int *, DeviceType>( "tags", n_nodes );
+    Kokkos::View<unsigned int *, DeviceType> tags = bvh._tags;
+
+    auto indices_host = Kokkos::create_mirror_view( bvh._indices );
+    std::memcpy( indices_host.data(), buffer + indices_offset,
+                 n_leaf_nodes * sizeof( int ) );
+    // every object must be reported by exactly one leaf
+    std::vector<char> found( n_leaf_nodes, 0 );
+    for ( std::int32_t i = 0; i < n_leaf_nodes; ++i )
+    {
+        int const index = indices_host( i );
+        DTK_INSIST( index >= 0 && index < n_leaf_nodes && !found[index] );
+        found[index] = 1;
+    }
+    Kokkos::deep_copy( bvh._indices, indices_host );
+
+    Kokkos::View<Node *, DeviceType> leaf_nodes = bvh._leaf_nodes;
+    Kokkos::View<Node *, DeviceType> internal_nodes = bvh._internal_nodes;
+    Kokkos::parallel_for(
+        REGION_NAME( "deserialize_nodes" ),
+        Kokkos::RangePolicy<ExecutionSpace>( 0, n_nodes ),
+        KOKKOS_LAMBDA( int i ) {
+            Node &node = ( i < n_internal_nodes
+                               ? internal_nodes( i )
+                               : leaf_nodes( i - n_internal_nodes ) );
+            SerializedNode const &serialized_node = serialized_nodes( i );
+            for ( int d = 0; d < 6; ++d )
+                node.bounding_box[d] = serialized_node.bounding_box[d];
+            node.parent =
+                decode( serialized_node.parent, internal_nodes.data(),
+                        n_internal_nodes, leaf_nodes.data() );
+            node.children.first =
+                decode( serialized_node.children[0], internal_nodes.data(),
+                        n_internal_nodes, leaf_nodes.data() );
+            node.children.second =
+                decode( serialized_node.children[1], internal_nodes.data(),
+                        n_internal_nodes, leaf_nodes.data() );
+            if ( has_tags )
+                tags( i ) = serialized_node.tags;
+        } );
+    Kokkos::fence();
+
+    return bvh;
+}
+
+} // end namespace Details
+} // end namespace DataTransferKit
+
+#endif
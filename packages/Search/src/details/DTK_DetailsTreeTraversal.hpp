@@ -16,6 +16,7 @@
 #include <DTK_DetailsPredicate.hpp>
 #include <DTK_DetailsPriorityQueue.hpp>
 #include <DTK_DetailsStack.hpp>
+#include <DTK_DetailsTraversalStatistics.hpp>
 
 namespace DataTransferKit
 {
@@ -40,6 +41,16 @@ struct TreeTraversal
         return queryDispatch( bvh, pred, insert, Tag{} );
     }
 
+    // Same as above but also fills in the traversal counters.
+    template <typename Predicate, typename Insert>
+    KOKKOS_INLINE_FUNCTION static int
+    query( BVH<DeviceType> const bvh, Predicate const &pred,
+           Insert const &insert, QueryStatistics &stats )
+    {
+        using Tag = typename Predicate::Tag;
+        return queryDispatch( bvh, pred, insert, Tag{}, stats );
+    }
+
     /**
      * Return true if the node is a leaf.
      */
@@ -62,6 +73,42 @@ struct TreeTraversal
         return bvh._indices[leaf - bvh._leaf_nodes.data()];
     }
 
+    /**
+     * Return the leaf node at the given position in the sorted leaf array.
+     */
+    KOKKOS_INLINE_FUNCTION
+    static Node const *getLeaf( BVH<DeviceType> bvh, int i )
+    {
+        return bvh._leaf_nodes.data() + i;
+    }
+
+    /**
+     * Return the tags of the node, i.e. those of the object for a leaf and
+     * the union of the tags of the children for an internal node.  Trees
+     * built without tags keep none and every node matches every mask.
+     */
+    KOKKOS_INLINE_FUNCTION
+    static unsigned int getTags( BVH<DeviceType> bvh, Node const *node )
+    {
+        if ( bvh._tags.extent( 0 ) == 0 )
+            return Node::all_tags;
+        int const n_internal_nodes = bvh._internal_nodes.extent( 0 );
+        if ( isLeaf( bvh, node ) )
+            return bvh._tags[n_internal_nodes +
+                             ( node - bvh._leaf_nodes.data() )];
+        return bvh._tags[node - bvh._internal_nodes.data()];
+    }
+
+    /**
+     * Return true if the hierarchy was not built and the leaves must all be
+     * scanned.
+     */
+    KOKKOS_INLINE_FUNCTION
+    static bool isBruteForce( BVH<DeviceType> bvh )
+    {
+        return bvh._brute_force;
+    }
+
     /**
      * Return the root node of the BVH.
      */
@@ -75,13 +122,149 @@ struct TreeTraversal
     }
 };
 
+// A node may satisfy a spatial predicate only if its tags have a bit in
+// common with the mask of the predicate.
+template <typename DeviceType, typename Predicate>
+KOKKOS_INLINE_FUNCTION bool matches( BVH<DeviceType> const bvh,
+                                     Node const *node,
+                                     Predicate const &predicate )
+{
+    return ( TreeTraversal<DeviceType>::getTags( bvh, node ) &
+             predicate.mask() ) != 0 &&
+           predicate( node );
+}
+
+// Linear scans over the leaves for trees that were built without hierarchy.
+// There is no pointer chasing, the leaves are read contiguously.
+template <typename DeviceType, typename Predicate, typename Insert,
+          typename Statistics>
+KOKKOS_FUNCTION int bruteForceSpatialQuery( BVH<DeviceType> const bvh,
+                                            Predicate const &predicate,
+                                            Insert const &insert,
+                                            Statistics &stats )
+{
+    // like the depth-first traversal, report the leaves from last to first
+    stats.visitNode();
+    int const n = bvh.size();
+    int count = 0;
+    for ( int i = n - 1; i >= 0; --i )
+    {
+        Node const *leaf = TreeTraversal<DeviceType>::getLeaf( bvh, i );
+        stats.testLeaf();
+        if ( matches( bvh, leaf, predicate ) )
+        {
+            insert( TreeTraversal<DeviceType>::getIndex( bvh, leaf ) );
+            count++;
+        }
+    }
+    return count;
+}
+
+// Unless a geometry is provided, the distance to an object is the distance to
+// its bounding box.
+struct BoundingBoxDistance
+{
+};
+
+KOKKOS_INLINE_FUNCTION double leafDistance( BoundingBoxDistance const &, int,
+                                            Point const &,
+                                            double box_distance )
+{
+    return box_distance;
+}
+
+// The geometry returns the exact distance from the point to the object with
+// the given index.  It must never be smaller than the distance to the
+// bounding box of the object.
+template <typename Geometry>
+KOKKOS_INLINE_FUNCTION double leafDistance( Geometry const &geometry,
+                                            int index,
+                                            Point const &query_point, double )
+{
+    return geometry( index, query_point );
+}
+
+// The leaves are scanned once for every batch of up to 256 nearest
+// neighbors, so a single time unless k is larger than that.  Each scan keeps
+// the closest leaves that come after the last reported one, in lexicographic
+// order of (distance, position) so that ties are handled, in a bounded buffer
+// sorted by increasing distance.
+template <typename DeviceType, typename Insert, typename Statistics,
+          typename Geometry>
+KOKKOS_FUNCTION int
+bruteForceNearestQuery( BVH<DeviceType> const bvh, Point const &query_point,
+                        int k, Insert const &insert, double radius,
+                        Statistics &stats, Geometry const &geometry,
+                        unsigned int mask )
+{
+    using PairPositionDistance = Kokkos::pair<int, double>;
+    int constexpr buffer_size = 256;
+    PairPositionDistance nearest[buffer_size];
+
+    stats.visitNode();
+    int const n = bvh.size();
+    int last = -1;
+    double last_distance = -1.;
+    int count = 0;
+    while ( count < k )
+    {
+        int const batch_size = KokkosHelpers::min( k - count, buffer_size );
+        int n_nearest = 0;
+        for ( int i = 0; i < n; ++i )
+        {
+            stats.testLeaf();
+            Node const *leaf = TreeTraversal<DeviceType>::getLeaf( bvh, i );
+            if ( ( TreeTraversal<DeviceType>::getTags( bvh, leaf ) & mask ) ==
+                 0 )
+                continue;
+            double const leaf_distance = leafDistance(
+                geometry, TreeTraversal<DeviceType>::getIndex( bvh, leaf ),
+                query_point, distance( query_point, leaf->bounding_box ) );
+            bool const after_last =
+                ( leaf_distance > last_distance ) ||
+                ( leaf_distance == last_distance && i > last );
+            if ( !after_last || leaf_distance > radius )
+                continue;
+            // leaves come by increasing position so a leaf that is as far as
+            // the furthest one in the full buffer is left out
+            if ( n_nearest == batch_size &&
+                 !( leaf_distance < nearest[batch_size - 1].second ) )
+                continue;
+            int pos = ( n_nearest < batch_size ? n_nearest++ : batch_size - 1 );
+            while ( pos > 0 && nearest[pos - 1].second > leaf_distance )
+            {
+                nearest[pos] = nearest[pos - 1];
+                --pos;
+            }
+            nearest[pos] = PairPositionDistance( i, leaf_distance );
+        }
+        for ( int j = 0; j < n_nearest; ++j )
+        {
+            Node const *leaf =
+                TreeTraversal<DeviceType>::getLeaf( bvh, nearest[j].first );
+            insert( TreeTraversal<DeviceType>::getIndex( bvh, leaf ),
+                    nearest[j].second );
+        }
+        count += n_nearest;
+        if ( n_nearest < batch_size )
+            break;
+        last = nearest[n_nearest - 1].first;
+        last_distance = nearest[n_nearest - 1].second;
+    }
+    return count;
+}
+
 // There are two (related) families of search: one using a spatial predicate and
 // one using nearest neighbours query (see boost::geometry::queries
 // documentation).
-template <typename DeviceType, typename Predicate, typename Insert>
+// The statistics policy is notified of the traversal events.  Unless
+// statistics are explicitly requested, NullStatistics is used and these calls
+// compile to nothing.
+template <typename DeviceType, typename Predicate, typename Insert,
+          typename Statistics>
 KOKKOS_FUNCTION int spatial_query( BVH<DeviceType> const bvh,
                                    Predicate const &predicate,
-                                   Insert const &insert )
+                                   Insert const &insert, Statistics &stats )
 {
     if ( bvh.empty() )
         return 0;
@@ -89,7 +272,9 @@ KOKKOS_FUNCTION int spatial_query( BVH<DeviceType> const bvh,
     if ( bvh.size() == 1 )
     {
         Node const *leaf = TreeTraversal<DeviceType>::getRoot( bvh );
-        if ( predicate( leaf ) )
+        stats.visitNode();
+        stats.testLeaf();
+        if ( matches( bvh, leaf, predicate ) )
         {
             int const leaf_index =
                 TreeTraversal<DeviceType>::getIndex( bvh, leaf );
@@ -100,6 +285,9 @@ KOKKOS_FUNCTION int spatial_query( BVH<DeviceType> const bvh,
             return 0;
     }
 
+    if ( TreeTraversal<DeviceType>::isBruteForce( bvh ) )
+        return bruteForceSpatialQuery( bvh, predicate, insert, stats );
+
     Stack<Node const *> stack;
 
     Node const *root = TreeTraversal<DeviceType>::getRoot( bvh );
@@ -108,8 +296,10 @@ KOKKOS_FUNCTION int spatial_query( BVH<DeviceType> const bvh,
 
     while ( !stack.empty() )
     {
+        stats.updateDepth( stack.size() );
         Node const *node = stack.top();
         stack.pop();
+        stats.visitNode();
 
         if ( TreeTraversal<DeviceType>::isLeaf( bvh, node ) )
         {
@@ -121,7 +311,9 @@ KOKKOS_FUNCTION int spatial_query( BVH<DeviceType> const bvh,
             for ( Node const *child :
                   {node->children.first, node->children.second} )
             {
-                if ( predicate( child ) )
+                if ( TreeTraversal<DeviceType>::isLeaf( bvh, child ) )
+                    stats.testLeaf();
+                if ( matches( bvh, child, predicate ) )
                 {
                     stack.push( child );
                 }
@@ -131,11 +323,49 @@ KOKKOS_FUNCTION int spatial_query( BVH<DeviceType> const bvh,
     return count;
 }
 
+template <typename DeviceType, typename Predicate, typename Insert>
+KOKKOS_INLINE_FUNCTION int spatial_query( BVH<DeviceType> const bvh,
+                                          Predicate const &predicate,
+                                          Insert const &insert )
+{
+    NullStatistics stats;
+    return spatial_query( bvh, predicate, insert, stats );
+}
+
+// Traversals for the nearest neighbors queries.  The brute-force scan keeps
+// its own buffer of candidates besides the priority queue of the hierarchical
+// traversal, so the batched searches launch kernels that are specialized for
+// the kind of tree rather than deciding for every query.  AnyTraversal
+// decides at run time (e.g. when the trees of a collection differ) and
+// carries both buffers.
+struct HierarchicalTraversal
+{
+};
+struct BruteForceTraversal
+{
+};
+struct AnyTraversal
+{
+};
+
 // query k nearest neighbours
-template <typename DeviceType, typename Insert>
-KOKKOS_FUNCTION int nearestQuery( BVH<DeviceType> const bvh,
-                                  Point const &query_point, int k,
-                                  Insert const &insert )
+// Nodes that are further away than radius from the query point are pruned
+// from the search.  It is the caller's responsability to guarantee that the
+// radius is greater or equal to the distance to the k-th nearest neighbour
+// (e.g. the largest distance to k objects found in a previous search).
+// When a geometry is provided, the exact distance to the object is evaluated
+// once its leaf reaches the top of the priority queue.  If other nodes might
+// hold closer objects, the leaf goes back in the queue with that distance and
+// is only reported when it reaches the top again.
+// Only the objects with tags matching the mask are considered.
+// The hierarchy of the tree must have been built.
+template <typename DeviceType, typename Insert, typename Statistics,
+          typename Geometry>
+KOKKOS_FUNCTION int
+nearestQuery( BVH<DeviceType> const bvh, Point const &query_point, int k,
+              Insert const &insert, double radius, Statistics &stats,
+              Geometry const &geometry, unsigned int mask,
+              HierarchicalTraversal )
 {
     if ( bvh.empty() || k < 1 )
         return 0;
@@ -143,9 +373,16 @@ KOKKOS_FUNCTION int nearestQuery( BVH<DeviceType> const bvh,
     if ( bvh.size() == 1 )
     {
         Node const *leaf = TreeTraversal<DeviceType>::getRoot( bvh );
+        stats.visitNode();
+        stats.testLeaf();
+        if ( ( TreeTraversal<DeviceType>::getTags( bvh, leaf ) & mask ) == 0 )
+            return 0;
         int const leaf_index = TreeTraversal<DeviceType>::getIndex( bvh, leaf );
         double const leaf_distance =
-            distance( query_point, leaf->bounding_box );
+            leafDistance( geometry, leaf_index, query_point,
+                          distance( query_point, leaf->bounding_box ) );
+        if ( leaf_distance > radius )
+            return 0;
         insert( leaf_index, leaf_distance );
         return 1;
     }
@@ -172,6 +409,7 @@ KOKKOS_FUNCTION int nearestQuery( BVH<DeviceType> const bvh,
 
     while ( !queue.empty() && count < k )
     {
+        stats.updateDepth( queue.size() );
         // get the node that is on top of the priority list (i.e. is the
         // closest to the query point)
         Node const *node = queue.top().first;
@@ -179,10 +417,21 @@ KOKKOS_FUNCTION int nearestQuery( BVH<DeviceType> const bvh,
         // NOTE: it would be nice to be able to do something like
         // tie( node, node_distance = queue.top();
         queue.pop();
+        stats.visitNode();
         if ( TreeTraversal<DeviceType>::isLeaf( bvh, node ) )
         {
-            insert( TreeTraversal<DeviceType>::getIndex( bvh, node ),
-                    node_distance );
+            int const leaf_index =
+                TreeTraversal<DeviceType>::getIndex( bvh, node );
+            double const leaf_distance = leafDistance(
+                geometry, leaf_index, query_point, node_distance );
+            if ( leaf_distance > node_distance && !queue.empty() &&
+                 leaf_distance > queue.top().second )
+            {
+                if ( leaf_distance <= radius )
+                    queue.push( node, leaf_distance );
+                continue;
+            }
+            insert( leaf_index, leaf_distance );
             count++;
         }
         else
@@ -191,15 +440,78 @@ KOKKOS_FUNCTION int nearestQuery( BVH<DeviceType> const bvh,
             for ( Node const *child :
                   {node->children.first, node->children.second} )
             {
+                if ( TreeTraversal<DeviceType>::isLeaf( bvh, child ) )
+                    stats.testLeaf();
+                if ( ( TreeTraversal<DeviceType>::getTags( bvh, child ) &
+                       mask ) == 0 )
+                    continue;
                 double child_distance =
                     distance( query_point, child->bounding_box );
-                queue.push( child, child_distance );
+                if ( child_distance <= radius )
+                    queue.push( child, child_distance );
             }
         }
     }
     return count;
 }
 
+template <typename DeviceType, typename Insert, typename Statistics,
+          typename Geometry>
+KOKKOS_INLINE_FUNCTION int
+nearestQuery( BVH<DeviceType> const bvh, Point const &query_point, int k,
+              Insert const &insert, double radius, Statistics &stats,
+              Geometry const &geometry, unsigned int mask,
+              BruteForceTraversal )
+{
+    if ( bvh.empty() || k < 1 )
+        return 0;
+    return bruteForceNearestQuery( bvh, query_point, k, insert, radius, stats,
+                                   geometry, mask );
+}
+
+template <typename DeviceType, typename Insert, typename Statistics,
+          typename Geometry>
+KOKKOS_INLINE_FUNCTION int
+nearestQuery( BVH<DeviceType> const bvh, Point const &query_point, int k,
+              Insert const &insert, double radius, Statistics &stats,
+              Geometry const &geometry, unsigned int mask = Node::all_tags,
+              AnyTraversal = AnyTraversal{} )
+{
+    if ( TreeTraversal<DeviceType>::isBruteForce( bvh ) )
+        return nearestQuery( bvh, query_point, k, insert, radius, stats,
+                             geometry, mask, BruteForceTraversal{} );
+    return nearestQuery( bvh, query_point, k, insert, radius, stats, geometry,
+                         mask, HierarchicalTraversal{} );
+}
+
+template <typename DeviceType, typename Insert, typename Statistics>
+KOKKOS_INLINE_FUNCTION int nearestQuery( BVH<DeviceType> const bvh,
+                                         Point const &query_point, int k,
+                                         Insert const &insert, double radius,
+                                         Statistics &stats )
+{
+    return nearestQuery( bvh, query_point, k, insert, radius, stats,
+                         BoundingBoxDistance{} );
+}
+
+template <typename DeviceType, typename Insert>
+KOKKOS_INLINE_FUNCTION int nearestQuery( BVH<DeviceType> const bvh,
+                                         Point const &query_point, int k,
+                                         Insert const &insert, double radius )
+{
+    NullStatistics stats;
+    return nearestQuery( bvh, query_point, k, insert, radius, stats );
+}
+
+template <typename DeviceType, typename Insert>
+KOKKOS_INLINE_FUNCTION int nearestQuery( BVH<DeviceType> const bvh,
+                                         Point const &query_point, int k,
+                                         Insert const &insert )
+{
+    return nearestQuery( bvh, query_point, k, insert,
+                         Kokkos::ArithTraits<double>::max() );
+}
+
 template <typename DeviceType, typename Predicate, typename Insert>
 KOKKOS_INLINE_FUNCTION int
 queryDispatch( BVH<DeviceType> const bvh, Predicate const &pred,
@@ -213,7 +525,30 @@ KOKKOS_INLINE_FUNCTION int
 queryDispatch( BVH<DeviceType> const bvh, Predicate const &pred,
                Insert const &insert, NearestPredicateTag )
 {
-    return nearestQuery( bvh, pred._query_point, pred._k, insert );
+    NullStatistics stats;
+    return nearestQuery( bvh, pred._query_point, pred._k, insert,
+                         Kokkos::ArithTraits<double>::max(), stats,
+                         BoundingBoxDistance{}, pred._mask );
+}
+
+template <typename DeviceType, typename Predicate, typename Insert>
+KOKKOS_INLINE_FUNCTION int
+queryDispatch( BVH<DeviceType> const bvh, Predicate const &pred,
+               Insert const &insert, SpatialPredicateTag,
+               QueryStatistics &stats )
+{
+    return spatial_query( bvh, pred, insert, stats );
+}
+
+template <typename DeviceType, typename Predicate, typename Insert>
+KOKKOS_INLINE_FUNCTION int
+queryDispatch( BVH<DeviceType> const bvh, Predicate const &pred,
+               Insert const &insert, NearestPredicateTag,
+               QueryStatistics &stats )
+{
+    return nearestQuery( bvh, pred._query_point, pred._k, insert,
+                         Kokkos::ArithTraits<double>::max(), stats,
+                         BoundingBoxDistance{}, pred._mask );
 }
 
 } // end namespace Details
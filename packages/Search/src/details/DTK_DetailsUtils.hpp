@@ -76,6 +76,27 @@ T lastElement( Kokkos::View<T *, DeviceType> in )
     return in_host( 0 );
 }
 
+/** \brief Returns whether two views have the same size and elements.
+ */
+template <typename T, typename DeviceType>
+bool equal( Kokkos::View<T *, DeviceType> a, Kokkos::View<T *, DeviceType> b )
+{
+    using ExecutionSpace = typename DeviceType::execution_space;
+    if ( a.extent( 0 ) != b.extent( 0 ) )
+        return false;
+    int n_differences = 0;
+    Kokkos::parallel_reduce(
+        "count_differences",
+        Kokkos::RangePolicy<ExecutionSpace>( 0, a.extent( 0 ) ),
+        KOKKOS_LAMBDA( int i, int &update ) {
+            if ( a( i ) != b( i ) )
+                ++update;
+        },
+        n_differences );
+    Kokkos::fence();
+    return n_differences == 0;
+}
+
 } // end namespace DataTransferKit
 
 #endif
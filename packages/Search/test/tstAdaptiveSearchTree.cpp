@@ -0,0 +1,243 @@
+/****************************************************************************
+ * Copyright (c) 2012-2017 by the DataTransferKit authors                   *
+ * All rights reserved.                                                     *
+ *                                                                          *
+ * This file is part of the DataTransferKit library. DataTransferKit is     *
+ * distributed under a BSD 3-clause license. For the licensing terms see    *
+ * the LICENSE file in the top-level directory.                             *
+ ****************************************************************************/
+
+#include <DTK_AdaptiveSearchTree.hpp>
+#include <DTK_LinearBVH.hpp>
+
+#include <Teuchos_UnitTestHarness.hpp>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace details = DataTransferKit::Details;
+
+// Sort the results of each query so that they can be compared regardless of
+// the order in which they were found.
+std::vector<int> sortedResults( std::vector<int> indices,
+                                std::vector<int> const &offset )
+{
+    for ( size_t i = 0; i + 1 < offset.size(); ++i )
+        std::sort( indices.begin() + offset[i],
+                   indices.begin() + offset[i + 1] );
+    return indices;
+}
+
+template <typename T, typename DeviceType>
+std::vector<T> toVector( Kokkos::View<T *, DeviceType> v )
+{
+    auto v_host = Kokkos::create_mirror_view( v );
+    Kokkos::deep_copy( v_host, v );
+    return std::vector<T>( v_host.data(), v_host.data() + v_host.extent( 0 ) );
+}
+
+template <typename DeviceType>
+Kokkos::View<DataTransferKit::Box *, DeviceType>
+toView( std::vector<DataTransferKit::Box> const &boxes )
+{
+    int const n = boxes.size();
+    Kokkos::View<DataTransferKit::Box *, DeviceType> view( "boxes", n );
+    auto view_host = Kokkos::create_mirror_view( view );
+    for ( int i = 0; i < n; ++i )
+        view_host( i ) = boxes[i];
+    Kokkos::deep_copy( view, view_host );
+    return view;
+}
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( AdaptiveSearchTree, strategy_selection,
+                                   DeviceType )
+{
+    using DataTransferKit::Box;
+    using DataTransferKit::SearchStrategy;
+    using Selection = details::SearchStrategySelection<DeviceType>;
+
+    std::default_random_engine generator( 2468 );
+    std::uniform_real_distribution<double> position( 0., 10. );
+    std::uniform_real_distribution<double> jitter( 0., 0.01 );
+
+    // points spread uniformly
+    int const n = 1000;
+    std::vector<Box> uniform_points( n );
+    for ( auto &box : uniform_points )
+    {
+        double const x = position( generator );
+        double const y = position( generator );
+        double const z = position( generator );
+        box = Box( {x, x, y, y, z, z} );
+    }
+    auto const uniform_scene =
+        Selection::sceneStatistics( toView<DeviceType>( uniform_points ) );
+    TEST_EQUALITY( uniform_scene.n_objects, n );
+    TEST_EQUALITY( uniform_scene.n_dimensions, 3 );
+    TEST_ASSERT( uniform_scene.points );
+    TEST_EQUALITY( uniform_scene.max_size, 0. );
+    TEST_ASSERT( uniform_scene.spread > 0.8 );
+
+    // the same number of points gathered in two small clusters
+    std::vector<Box> clustered_points( n );
+    for ( int i = 0; i < n; ++i )
+    {
+        double const c = ( i % 2 == 0 ? 0. : 10. );
+        double const x = c + jitter( generator );
+        double const y = c + jitter( generator );
+        double const z = c + jitter( generator );
+        clustered_points[i] = Box( {x, x, y, y, z, z} );
+    }
+    auto const clustered_scene =
+        Selection::sceneStatistics( toView<DeviceType>( clustered_points ) );
+    TEST_ASSERT( clustered_scene.points );
+    TEST_ASSERT( clustered_scene.spread < 0.1 );
+
+    // boxes of very different sizes
+    std::vector<Box> boxes( n );
+    for ( int i = 0; i < n; ++i )
+    {
+        double const x = position( generator );
+        double const y = position( generator );
+        double const z = position( generator );
+        double const h = ( i % 100 == 0 ? 5. : 0.01 );
+        boxes[i] = Box( {x, x + h, y, y + h, z, z + h} );
+    }
+    auto const boxes_scene =
+        Selection::sceneStatistics( toView<DeviceType>( boxes ) );
+    TEST_ASSERT( !boxes_scene.points );
+    TEST_FLOATING_EQUALITY( boxes_scene.max_size, 5., 1e-14 );
+    TEST_FLOATING_EQUALITY( boxes_scene.mean_size, 0.0599, 1e-12 );
+    TEST_ASSERT( boxes_scene.size_variance > 0. );
+
+    // a handful of queries do not justify building anything
+    TEST_EQUALITY( Selection::select( uniform_scene, 1 ),
+                   SearchStrategy::BruteForce );
+    // the grid is ideal for uniformly spread points, the kd-tree is not
+    // sensitive to clustering, and only the BVH handles objects of various
+    // sizes well
+    int const n_queries = 100000;
+    TEST_EQUALITY( Selection::select( uniform_scene, n_queries ),
+                   SearchStrategy::UniformGrid );
+    TEST_EQUALITY( Selection::select( clustered_scene, n_queries ),
+                   SearchStrategy::KdTree );
+    TEST_EQUALITY( Selection::select( boxes_scene, n_queries ),
+                   SearchStrategy::BoundingVolumeHierarchy );
+    TEST_ASSERT(
+        !Selection::isApplicable( boxes_scene, SearchStrategy::KdTree ) );
+}
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( AdaptiveSearchTree, compare_with_bvh,
+                                   DeviceType )
+{
+    using DataTransferKit::SearchStrategy;
+
+    DataTransferKit::AdaptiveSearchTree<DeviceType> empty_tree(
+        Kokkos::View<DataTransferKit::Box *, DeviceType>( "boxes", 0 ) );
+    TEST_ASSERT( empty_tree.empty() );
+
+    int const n = 300;
+    double const L = 10.;
+    std::default_random_engine generator( 1357 );
+    std::uniform_real_distribution<double> position( 0., L );
+    std::uniform_real_distribution<double> size( 0., 1. );
+    Kokkos::View<DataTransferKit::Box *, DeviceType> boxes( "boxes", n );
+    auto boxes_host = Kokkos::create_mirror_view( boxes );
+    for ( int i = 0; i < n; ++i )
+    {
+        double const x = position( generator );
+        double const y = position( generator );
+        double const z = position( generator );
+        double const h = size( generator );
+        boxes_host( i ) = DataTransferKit::Box( {x, x + h, y, y + h, z, z} );
+    }
+    Kokkos::deep_copy( boxes, boxes_host );
+
+    DataTransferKit::AdaptiveSearchTree<DeviceType> tree( boxes );
+    DataTransferKit::BVH<DeviceType> bvh( boxes );
+    TEST_EQUALITY( tree.size(), n );
+    for ( int d = 0; d < 6; ++d )
+        TEST_EQUALITY( tree.bounds()[d], bvh.bounds()[d] );
+
+    int const n_queries = 100;
+    Kokkos::View<details::Overlap *, DeviceType> overlap_queries(
+        "overlap_queries", n_queries );
+    Kokkos::View<details::Nearest *, DeviceType> nearest_queries(
+        "nearest_queries", n_queries );
+    auto overlap_queries_host = Kokkos::create_mirror_view( overlap_queries );
+    auto nearest_queries_host = Kokkos::create_mirror_view( nearest_queries );
+    for ( int i = 0; i < n_queries; ++i )
+    {
+        double const x = position( generator );
+        double const y = position( generator );
+        double const z = position( generator );
+        overlap_queries_host( i ) = details::overlap(
+            DataTransferKit::Box( {x, x + 1., y, y + 1., z, z + 1.} ) );
+        nearest_queries_host( i ) =
+            details::nearest( DataTransferKit::Point( {{x, y, z}} ), 3 );
+    }
+    Kokkos::deep_copy( overlap_queries, overlap_queries_host );
+    Kokkos::deep_copy( nearest_queries, nearest_queries_host );
+
+    Kokkos::View<int *, DeviceType> indices_ref( "indices_ref" );
+    Kokkos::View<int *, DeviceType> offset_ref( "offset_ref" );
+    Kokkos::View<double *, DeviceType> distances_ref( "distances_ref" );
+    bvh.query( overlap_queries, indices_ref, offset_ref );
+    auto const overlap_offset_ref = toVector( offset_ref );
+    auto const overlap_indices_ref =
+        sortedResults( toVector( indices_ref ), overlap_offset_ref );
+    bvh.query( nearest_queries, indices_ref, offset_ref, distances_ref );
+    auto const distances_ref_host = toVector( distances_ref );
+
+    // the strategy may change from one call to the next but the results
+    // must not
+    Kokkos::View<int *, DeviceType> indices( "indices" );
+    Kokkos::View<int *, DeviceType> offset( "offset" );
+    Kokkos::View<double *, DeviceType> distances( "distances" );
+    int const n_calls = 5;
+    for ( int call = 0; call < n_calls; ++call )
+    {
+        tree.query( overlap_queries, indices, offset );
+        auto const offset_host = toVector( offset );
+        TEST_COMPARE_ARRAYS( offset_host, overlap_offset_ref );
+        TEST_COMPARE_ARRAYS( sortedResults( toVector( indices ), offset_host ),
+                             overlap_indices_ref );
+
+        tree.query( nearest_queries, indices, offset, distances );
+        TEST_COMPARE_FLOATING_ARRAYS( toVector( distances ),
+                                      distances_ref_host, 1e-14 );
+    }
+
+    // every query was timed and accounted for
+    int n_timed_queries = 0;
+    for ( SearchStrategy strategy :
+          {SearchStrategy::BruteForce, SearchStrategy::BoundingVolumeHierarchy,
+           SearchStrategy::UniformGrid, SearchStrategy::KdTree} )
+    {
+        auto const &timings = tree.timings( strategy );
+        TEST_ASSERT( timings.construction >= 0. );
+        TEST_ASSERT( timings.query >= 0. );
+        n_timed_queries += timings.n_queries;
+    }
+    TEST_EQUALITY( n_timed_queries, 2 * n_calls * n_queries );
+    TEST_EQUALITY( tree.timings( SearchStrategy::KdTree ).n_queries, 0 );
+}
+
+// Include the test macros.
+#include "DataTransferKitSearch_ETIHelperMacros.h"
+
+// Create the test group
+#define UNIT_TEST_GROUP( NODE )                                                \
+    using DeviceType##NODE = typename NODE::device_type;                       \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( AdaptiveSearchTree,                  \
+                                          strategy_selection,                  \
+                                          DeviceType##NODE )                   \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( AdaptiveSearchTree,                  \
+                                          compare_with_bvh, DeviceType##NODE )
+
+// Demangle the types
+DTK_ETI_MANGLING_TYPEDEFS()
+
+// Instantiate the tests
+DTK_INSTANTIATE_N( UNIT_TEST_GROUP )
@@ -0,0 +1,172 @@
+/****************************************************************************
+ * Copyright (c) 2012-2017 by the DataTransferKit authors                   *
+ * All rights reserved.                                                     *
+ *                                                                          *
+ * This file is part of the DataTransferKit library. DataTransferKit is     *
+ * distributed under a BSD 3-clause license. For the licensing terms see    *
+ * the LICENSE file in the top-level directory.                             *
+ ****************************************************************************/
+
+#include <DTK_BVHCollection.hpp>
+#include <DTK_LinearBVH.hpp>
+
+#include <Teuchos_UnitTestHarness.hpp>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace details = DataTransferKit::Details;
+
+template <typename T, typename DeviceType>
+std::vector<T> toVector( Kokkos::View<T *, DeviceType> v )
+{
+    auto v_host = Kokkos::create_mirror_view( v );
+    Kokkos::deep_copy( v_host, v );
+    return std::vector<T>( v_host.data(), v_host.data() + v_host.extent( 0 ) );
+}
+
+template <typename DeviceType>
+Kokkos::View<DataTransferKit::Box *, DeviceType>
+toView( std::vector<DataTransferKit::Box> const &boxes )
+{
+    int const n = boxes.size();
+    Kokkos::View<DataTransferKit::Box *, DeviceType> view( "boxes", n );
+    auto view_host = Kokkos::create_mirror_view( view );
+    for ( int i = 0; i < n; ++i )
+        view_host( i ) = boxes[i];
+    Kokkos::deep_copy( view, view_host );
+    return view;
+}
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( BVHCollection, compare_with_single_bvh,
+                                   DeviceType )
+{
+    using DataTransferKit::Box;
+    using DataTransferKit::Point;
+
+    // blocks of various sizes, including an empty one and a small one that
+    // is searched without hierarchy, side by side along the x-axis
+    double const L = 10.;
+    std::default_random_engine generator( 8642 );
+    std::uniform_real_distribution<double> position( 0., L );
+    std::vector<int> const block_sizes = {300, 0, 50, 1};
+    int const n_blocks = block_sizes.size();
+    std::vector<int> first_object( n_blocks + 1, 0 );
+    std::vector<Box> all_boxes;
+    std::vector<DataTransferKit::BVH<DeviceType>> trees;
+    for ( int b = 0; b < n_blocks; ++b )
+    {
+        std::vector<Box> boxes( block_sizes[b] );
+        for ( auto &box : boxes )
+        {
+            double const x = b * L + position( generator );
+            double const y = position( generator );
+            double const z = position( generator );
+            box = Box( {x, x + 0.5, y, y + 0.5, z, z + 0.5} );
+        }
+        trees.emplace_back( toView<DeviceType>( boxes ) );
+        all_boxes.insert( all_boxes.end(), boxes.begin(), boxes.end() );
+        first_object[b + 1] = all_boxes.size();
+    }
+    DataTransferKit::BVHCollection<DeviceType> collection( trees );
+    TEST_EQUALITY( collection.size(), n_blocks );
+    DataTransferKit::BVH<DeviceType> bvh( toView<DeviceType>( all_boxes ) );
+
+    int const n_queries = 100;
+    std::uniform_real_distribution<double> x_position( 0., n_blocks * L );
+    Kokkos::View<details::Within *, DeviceType> within_queries(
+        "within_queries", n_queries );
+    Kokkos::View<details::Nearest *, DeviceType> nearest_queries(
+        "nearest_queries", n_queries );
+    auto within_queries_host = Kokkos::create_mirror_view( within_queries );
+    auto nearest_queries_host = Kokkos::create_mirror_view( nearest_queries );
+    for ( int i = 0; i < n_queries; ++i )
+    {
+        Point const p = {{x_position( generator ), position( generator ),
+                          position( generator )}};
+        within_queries_host( i ) = details::within( p, 1.5 );
+        nearest_queries_host( i ) = details::nearest( p, 5 );
+    }
+    Kokkos::deep_copy( within_queries, within_queries_host );
+    Kokkos::deep_copy( nearest_queries, nearest_queries_host );
+
+    Kokkos::View<int *, DeviceType> indices( "indices" );
+    Kokkos::View<int *, DeviceType> offset( "offset" );
+    Kokkos::View<int *, DeviceType> tree_ids( "tree_ids" );
+    Kokkos::View<double *, DeviceType> distances( "distances" );
+    Kokkos::View<int *, DeviceType> indices_ref( "indices_ref" );
+    Kokkos::View<int *, DeviceType> offset_ref( "offset_ref" );
+    Kokkos::View<double *, DeviceType> distances_ref( "distances_ref" );
+
+    collection.query( within_queries, indices, offset, tree_ids );
+    bvh.query( within_queries, indices_ref, offset_ref );
+    auto const offset_host = toVector( offset );
+    auto const indices_host = toVector( indices );
+    auto const tree_ids_host = toVector( tree_ids );
+    auto const offset_ref_host = toVector( offset_ref );
+    auto const indices_ref_host = toVector( indices_ref );
+    TEST_COMPARE_ARRAYS( offset_host, offset_ref_host );
+    for ( int i = 0; i < n_queries; ++i )
+    {
+        std::vector<int> found;
+        for ( int j = offset_host[i]; j < offset_host[i + 1]; ++j )
+            found.push_back( first_object[tree_ids_host[j]] +
+                             indices_host[j] );
+        std::vector<int> expected( indices_ref_host.begin() +
+                                       offset_ref_host[i],
+                                   indices_ref_host.begin() +
+                                       offset_ref_host[i + 1] );
+        std::sort( found.begin(), found.end() );
+        std::sort( expected.begin(), expected.end() );
+        TEST_COMPARE_ARRAYS( found, expected );
+    }
+
+    collection.query( nearest_queries, indices, offset, tree_ids, distances );
+    bvh.query( nearest_queries, indices_ref, offset_ref, distances_ref );
+    auto const distances_host = toVector( distances );
+    TEST_COMPARE_FLOATING_ARRAYS( distances_host, toVector( distances_ref ),
+                                  1e-14 );
+    auto const nearest_indices_host = toVector( indices );
+    auto const nearest_tree_ids_host = toVector( tree_ids );
+    for ( int i = 0; i < n_queries; ++i )
+        for ( int j = 5 * i; j < 5 * ( i + 1 ); ++j )
+        {
+            int const t = nearest_tree_ids_host[j];
+            TEST_ASSERT( t >= 0 && t < n_blocks );
+            TEST_FLOATING_EQUALITY(
+                details::distance(
+                    nearest_queries_host( i )._query_point,
+                    all_boxes[first_object[t] + nearest_indices_host[j]] ),
+                distances_host[j], 1e-14 );
+        }
+
+    // an empty collection finds nothing
+    DataTransferKit::BVHCollection<DeviceType> empty_collection(
+        std::vector<DataTransferKit::BVH<DeviceType>>{} );
+    TEST_ASSERT( empty_collection.empty() );
+    empty_collection.query( within_queries, indices, offset, tree_ids );
+    TEST_EQUALITY( indices.extent( 0 ), 0 );
+    empty_collection.query( nearest_queries, indices, offset, tree_ids,
+                            distances );
+    auto const empty_tree_ids_host = toVector( tree_ids );
+    TEST_ASSERT( std::all_of( empty_tree_ids_host.begin(),
+                              empty_tree_ids_host.end(),
+                              []( int t ) { return t == -1; } ) );
+}
+
+// Include the test macros.
+#include "DataTransferKitSearch_ETIHelperMacros.h"
+
+// Create the test group
+#define UNIT_TEST_GROUP( NODE )                                                \
+    using DeviceType##NODE = typename NODE::device_type;                       \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( BVHCollection,                       \
+                                          compare_with_single_bvh,             \
+                                          DeviceType##NODE )
+
+// Demangle the types
+DTK_ETI_MANGLING_TYPEDEFS()
+
+// Instantiate the tests
+DTK_INSTANTIATE_N( UNIT_TEST_GROUP )
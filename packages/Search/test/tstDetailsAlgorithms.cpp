@@ -42,6 +42,23 @@ TEUCHOS_UNIT_TEST( DetailsAlgorithms, distance )
         std::sqrt( 3.0 ) );
 }
 
+TEUCHOS_UNIT_TEST( DetailsAlgorithms, max_distance )
+{
+    // box is unit cube
+    DataTransferKit::Box box( {{0.0, 1.0, 0.0, 1.0, 0.0, 1.0}} );
+    // opposite corner from the center or from a corner
+    TEST_EQUALITY(
+        dtk::maxDistance( DataTransferKit::Point( {{0.5, 0.5, 0.5}} ), box ),
+        std::sqrt( 0.75 ) );
+    TEST_EQUALITY(
+        dtk::maxDistance( DataTransferKit::Point( {{0.0, 0.0, 0.0}} ), box ),
+        std::sqrt( 3.0 ) );
+    // from outside of the box
+    TEST_EQUALITY(
+        dtk::maxDistance( DataTransferKit::Point( {{2.0, 0.75, -1.0}} ), box ),
+        std::sqrt( 4.0 + 0.5625 + 4.0 ) );
+}
+
 TEUCHOS_UNIT_TEST( DetailsAlgorithms, overlaps )
 {
     DataTransferKit::Box box;
@@ -141,3 +158,37 @@ TEUCHOS_UNIT_TEST( DetailsAlgorithms, centroid )
     TEST_EQUALITY( centroid[1], 5.0 );
     TEST_EQUALITY( centroid[2], 15.0 );
 }
+
+TEUCHOS_UNIT_TEST( DetailsAlgorithms, default_cell_size )
+{
+    int n_dimensions = -1;
+    TEST_FLOATING_EQUALITY(
+        dtk::defaultCellSize(
+            DataTransferKit::Box( {{0.0, 1.0, 0.0, 1.0, 0.0, 1.0}} ), 1000,
+            n_dimensions ),
+        0.1, 1e-14 );
+    TEST_EQUALITY( n_dimensions, 3 );
+
+    // a thin shell only gets one layer of cells
+    TEST_FLOATING_EQUALITY(
+        dtk::defaultCellSize(
+            DataTransferKit::Box( {{0.0, 10.0, 0.0, 10.0, 0.0, 1e-6}} ), 100,
+            n_dimensions ),
+        1.0, 1e-14 );
+    TEST_EQUALITY( n_dimensions, 2 );
+
+    // leaving out the thinnest dimension makes the middle one thinner than a
+    // cell as well
+    TEST_FLOATING_EQUALITY(
+        dtk::defaultCellSize(
+            DataTransferKit::Box( {{0.0, 100.0, 0.0, 1.0, 0.0, 1e-3}} ), 10,
+            n_dimensions ),
+        10.0, 1e-14 );
+    TEST_EQUALITY( n_dimensions, 1 );
+
+    TEST_EQUALITY( dtk::defaultCellSize(
+                       DataTransferKit::Box( {{1.0, 1.0, 2.0, 2.0, 3.0, 3.0}} ),
+                       10, n_dimensions ),
+                   0.0 );
+    TEST_EQUALITY( n_dimensions, 0 );
+}
@@ -18,6 +18,19 @@
 #include <iostream>
 #include <random>
 #include <tuple>
+#include <vector>
+
+template <typename T, typename DeviceType>
+Kokkos::View<T *, DeviceType> toView( std::vector<T> const &v )
+{
+    int const n = v.size();
+    Kokkos::View<T *, DeviceType> view( "view", n );
+    auto view_host = Kokkos::create_mirror_view( view );
+    for ( int i = 0; i < n; ++i )
+        view_host( i ) = v[i];
+    Kokkos::deep_copy( view, view_host );
+    return view;
+}
 
 TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( DetailsDistributedSearchTreeImpl, recv_from,
                                    DeviceType )
@@ -69,6 +82,16 @@ TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( DetailsDistributedSearchTreeImpl, recv_from,
             recv_from[count++] = procs_from[i];
     TEST_EQUALITY( count, n_imports );
     TEST_COMPARE_ARRAYS( imports, recv_from );
+
+    Kokkos::View<int *, DeviceType> import_ranks( "import_ranks" );
+    DataTransferKit::DistributedSearchTreeImpl<DeviceType>::getImportRanks(
+        distributor, import_ranks );
+    auto import_ranks_host = Kokkos::create_mirror_view( import_ranks );
+    Kokkos::deep_copy( import_ranks_host, import_ranks );
+    TEST_COMPARE_ARRAYS(
+        std::vector<int>( import_ranks_host.data(),
+                          import_ranks_host.data() + import_ranks.extent( 0 ) ),
+        recv_from );
 }
 
 TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( DetailsDistributedSearchTreeImpl,
@@ -156,6 +179,195 @@ TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( DetailsDistributedSearchTreeImpl,
     TEST_COMPARE_ARRAYS( offset_host, offset_ref );
 }
 
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( DetailsDistributedSearchTreeImpl,
+                                   map_boxes_to_ranks, DeviceType )
+{
+    // Boxes 0 and 1 belong to rank 0, 2 and 3 to rank 1, and 4 to rank 3.
+    std::vector<int> box_ranks_ = {0, 0, 1, 1, 3};
+    std::vector<int> indices_ = {1, 0, 4, 3, 2, 3, 1};
+    std::vector<int> offset_ = {0, 3, 3, 5, 7};
+    std::vector<int> indices_ref = {0, 3, 1, 1, 0};
+    std::vector<int> offset_ref = {0, 2, 2, 3, 5};
+
+    auto box_ranks = toView<int, DeviceType>( box_ranks_ );
+    auto indices = toView<int, DeviceType>( indices_ );
+    auto offset = toView<int, DeviceType>( offset_ );
+    DataTransferKit::DistributedSearchTreeImpl<DeviceType>::mapBoxesToRanks(
+        box_ranks, indices, offset );
+
+    auto indices_host = Kokkos::create_mirror_view( indices );
+    Kokkos::deep_copy( indices_host, indices );
+    TEST_COMPARE_ARRAYS( indices_host, indices_ref );
+    auto offset_host = Kokkos::create_mirror_view( offset );
+    Kokkos::deep_copy( offset_host, offset );
+    TEST_COMPARE_ARRAYS( offset_host, offset_ref );
+}
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( DetailsDistributedSearchTreeImpl,
+                                   remove_searched_ranks, DeviceType )
+{
+    std::vector<int> searched_indices_ = {2, 0, 1};
+    std::vector<int> searched_offset_ = {0, 1, 1, 2, 3};
+    std::vector<int> indices_ = {0, 2, 3, 1, 0, 1, 2, 3};
+    std::vector<int> offset_ = {0, 3, 4, 5, 8};
+    std::vector<int> indices_ref = {0, 3, 1, 2, 3};
+    std::vector<int> offset_ref = {0, 2, 3, 3, 5};
+
+    auto indices = toView<int, DeviceType>( indices_ );
+    auto offset = toView<int, DeviceType>( offset_ );
+    DataTransferKit::DistributedSearchTreeImpl<DeviceType>::
+        removeSearchedRanks( toView<int, DeviceType>( searched_indices_ ),
+                             toView<int, DeviceType>( searched_offset_ ),
+                             indices, offset );
+
+    auto indices_host = Kokkos::create_mirror_view( indices );
+    Kokkos::deep_copy( indices_host, indices );
+    TEST_COMPARE_ARRAYS( indices_host, indices_ref );
+    auto offset_host = Kokkos::create_mirror_view( offset );
+    Kokkos::deep_copy( offset_host, offset );
+    TEST_COMPARE_ARRAYS( offset_host, offset_ref );
+}
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( DetailsDistributedSearchTreeImpl,
+                                   split_queries, DeviceType )
+{
+    // Queries 0 and 3 target the calling process (rank 1) among others.
+    int const comm_rank = 1;
+    std::vector<int> indices_ = {1, 0, 0, 2, 1};
+    std::vector<int> offset_ = {0, 2, 3, 3, 5};
+    std::vector<int> remote_indices_ref = {0, 0, 2};
+    std::vector<int> remote_offset_ref = {0, 1, 2, 2, 3};
+    std::vector<int> local_ids_ref = {0, 3};
+    int const n_queries = 4;
+
+    std::vector<DataTransferKit::Details::Nearest> queries_;
+    for ( int q = 0; q < n_queries; ++q )
+        queries_.push_back(
+            DataTransferKit::Details::nearest( {{1. * q, 0., 0.}}, 1 ) );
+    auto queries =
+        toView<DataTransferKit::Details::Nearest, DeviceType>( queries_ );
+    auto indices = toView<int, DeviceType>( indices_ );
+    auto offset = toView<int, DeviceType>( offset_ );
+
+    Kokkos::View<DataTransferKit::Details::Nearest *, DeviceType> local_queries(
+        "local_queries" );
+    Kokkos::View<int *, DeviceType> local_ids( "local_ids" );
+    DataTransferKit::DistributedSearchTreeImpl<DeviceType>::splitQueries(
+        comm_rank, queries, indices, offset, local_queries, local_ids );
+
+    auto indices_host = Kokkos::create_mirror_view( indices );
+    Kokkos::deep_copy( indices_host, indices );
+    TEST_COMPARE_ARRAYS( indices_host, remote_indices_ref );
+    auto offset_host = Kokkos::create_mirror_view( offset );
+    Kokkos::deep_copy( offset_host, offset );
+    TEST_COMPARE_ARRAYS( offset_host, remote_offset_ref );
+    auto local_ids_host = Kokkos::create_mirror_view( local_ids );
+    Kokkos::deep_copy( local_ids_host, local_ids );
+    TEST_COMPARE_ARRAYS( local_ids_host, local_ids_ref );
+    auto local_queries_host = Kokkos::create_mirror_view( local_queries );
+    Kokkos::deep_copy( local_queries_host, local_queries );
+    TEST_EQUALITY( local_queries_host.extent( 0 ), local_ids_ref.size() );
+    for ( unsigned int j = 0; j < local_ids_ref.size(); ++j )
+        TEST_EQUALITY( local_queries_host( j )._query_point[0],
+                       1. * local_ids_ref[j] );
+}
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( DetailsDistributedSearchTreeImpl,
+                                   filter_results, DeviceType )
+{
+    // The candidates of a query come in runs sorted by distance, one per
+    // process.  The second query has more of them than fit in a priority
+    // queue and the third one fewer than k.
+    using DataTransferKit::Details::Nearest;
+    DataTransferKit::Point const origin = {{0., 0., 0.}};
+    std::vector<Nearest> queries_ = {
+        DataTransferKit::Details::nearest( origin, 2 ),
+        DataTransferKit::Details::nearest( origin, 300 ),
+        DataTransferKit::Details::nearest( origin, 5 )};
+    std::vector<int> indices_ = {0, 1, 2, 3};
+    std::vector<int> ranks_ = {0, 0, 1, 1};
+    std::vector<double> distances_ = {1., 3., 0.5, 2.};
+    std::vector<int> offset_ = {0, 4};
+    std::vector<int> indices_ref = {2, 0};
+    std::vector<int> ranks_ref = {1, 0};
+    std::vector<double> distances_ref = {0.5, 1.};
+    int const n = 600;
+    for ( int i = 0; i < n; ++i )
+    {
+        indices_.push_back( 10 + i );
+        ranks_.push_back( i / 200 );
+        distances_.push_back( ( i % 200 ) * 3 + i / 200 );
+    }
+    offset_.push_back( offset_.back() + n );
+    for ( int d = 0; d < 300; ++d )
+    {
+        indices_ref.push_back( 10 + ( d % 3 ) * 200 + d / 3 );
+        ranks_ref.push_back( d % 3 );
+        distances_ref.push_back( d );
+    }
+    indices_.insert( indices_.end(), {5, 6} );
+    ranks_.insert( ranks_.end(), {2, 3} );
+    distances_.insert( distances_.end(), {2., 1.} );
+    offset_.push_back( offset_.back() + 2 );
+    indices_ref.insert( indices_ref.end(), {6, 5} );
+    ranks_ref.insert( ranks_ref.end(), {3, 2} );
+    distances_ref.insert( distances_ref.end(), {1., 2.} );
+    std::vector<int> offset_ref = {0, 2, 302, 304};
+
+    auto indices = toView<int, DeviceType>( indices_ );
+    auto offset = toView<int, DeviceType>( offset_ );
+    auto ranks = toView<int, DeviceType>( ranks_ );
+    auto distances = toView<double, DeviceType>( distances_ );
+    DataTransferKit::DistributedSearchTreeImpl<DeviceType>::filterResults(
+        toView<Nearest, DeviceType>( queries_ ), distances, indices, offset,
+        ranks );
+
+    auto indices_host = Kokkos::create_mirror_view( indices );
+    Kokkos::deep_copy( indices_host, indices );
+    TEST_COMPARE_ARRAYS( indices_host, indices_ref );
+    auto offset_host = Kokkos::create_mirror_view( offset );
+    Kokkos::deep_copy( offset_host, offset );
+    TEST_COMPARE_ARRAYS( offset_host, offset_ref );
+    auto ranks_host = Kokkos::create_mirror_view( ranks );
+    Kokkos::deep_copy( ranks_host, ranks );
+    TEST_COMPARE_ARRAYS( ranks_host, ranks_ref );
+    auto distances_host = Kokkos::create_mirror_view( distances );
+    Kokkos::deep_copy( distances_host, distances );
+    TEST_COMPARE_ARRAYS( distances_host, distances_ref );
+}
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( DetailsDistributedSearchTreeImpl,
+                                   balance_loads, DeviceType )
+{
+    using Impl = DataTransferKit::DistributedSearchTreeImpl<DeviceType>;
+    using HandOver = DataTransferKit::Details::HandOver;
+    auto to_tuples = []( std::vector<HandOver> const &hand_overs ) {
+        std::vector<std::tuple<int, int, int>> tuples;
+        for ( auto const &hand_over : hand_overs )
+            tuples.emplace_back( hand_over.donor, hand_over.helper,
+                                 hand_over.n_queries );
+        return tuples;
+    };
+
+    // balanced enough
+    TEST_ASSERT( Impl::balanceLoads( {4, 5, 6}, {4, 5, 6}, 1.5 ).empty() );
+    TEST_ASSERT( Impl::balanceLoads( {0, 0}, {0, 0}, 1.5 ).empty() );
+
+    // the most loaded process hands its excess over to the idle ones
+    std::vector<std::tuple<int, int, int>> const expected = {
+        std::make_tuple( 1, 3, 10 ), std::make_tuple( 1, 2, 10 ),
+        std::make_tuple( 1, 0, 10 )};
+    TEST_ASSERT( to_tuples( Impl::balanceLoads( {0, 40, 0, 0}, {0, 30, 0, 0},
+                                                1.5 ) ) == expected );
+
+    // only the queries received from other processes are handed over, and
+    // every process helps at most one other
+    std::vector<std::tuple<int, int, int>> const expected_capped = {
+        std::make_tuple( 0, 3, 5 ), std::make_tuple( 2, 1, 13 )};
+    TEST_ASSERT( to_tuples( Impl::balanceLoads( {30, 2, 28, 0}, {5, 2, 20, 0},
+                                                1.5 ) ) == expected_capped );
+}
+
 TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( DetailsDistributedSearchTreeImpl,
                                    tpetra_fixme, DeviceType )
 {
@@ -219,6 +431,18 @@ TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( DetailsDistributedSearchTreeImpl,
                                           sort_results, DeviceType##NODE )     \
     TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( DetailsDistributedSearchTreeImpl,    \
                                           count_results, DeviceType##NODE )    \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( DetailsDistributedSearchTreeImpl,    \
+                                          map_boxes_to_ranks,                  \
+                                          DeviceType##NODE )                   \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( DetailsDistributedSearchTreeImpl,    \
+                                          remove_searched_ranks,               \
+                                          DeviceType##NODE )                   \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( DetailsDistributedSearchTreeImpl,    \
+                                          split_queries, DeviceType##NODE )    \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( DetailsDistributedSearchTreeImpl,    \
+                                          filter_results, DeviceType##NODE )   \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( DetailsDistributedSearchTreeImpl,    \
+                                          balance_loads, DeviceType##NODE )    \
     TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( DetailsDistributedSearchTreeImpl,    \
                                           tpetra_fixme, DeviceType##NODE )
 
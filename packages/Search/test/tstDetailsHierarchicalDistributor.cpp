@@ -0,0 +1,204 @@
+/****************************************************************************
+ * Copyright (c) 2012-2017 by the DataTransferKit authors                   *
+ * All rights reserved.                                                     *
+ *                                                                          *
+ * This file is part of the DataTransferKit library. DataTransferKit is     *
+ * distributed under a BSD 3-clause license. For the licensing terms see    *
+ * the LICENSE file in the top-level directory.                             *
+ ****************************************************************************/
+#include <DTK_DetailsHierarchicalDistributor.hpp>
+
+#include <Teuchos_DefaultComm.hpp>
+#include <Teuchos_UnitTestHarness.hpp>
+#include <Tpetra_Distributor.hpp>
+
+#include <vector>
+
+namespace dtk = DataTransferKit::Details;
+
+template <typename T>
+std::vector<T> toVector( Teuchos::ArrayView<T const> const &v )
+{
+    return std::vector<T>( v.getRawPtr(), v.getRawPtr() + v.size() );
+}
+
+// Nodes of two processes each.
+std::vector<int> pairsOfProcesses( int comm_size )
+{
+    std::vector<int> leaders( comm_size );
+    for ( int r = 0; r < comm_size; ++r )
+        leaders[r] = r - r % 2;
+    return leaders;
+}
+
+TEUCHOS_UNIT_TEST( DetailsHierarchicalDistributor, same_as_tpetra )
+{
+    Teuchos::RCP<const Teuchos::Comm<int>> comm =
+        Teuchos::DefaultComm<int>::getComm();
+    int const comm_rank = comm->getRank();
+    int const comm_size = comm->getSize();
+
+    // Every process sends a few items to the others, in no particular order.
+    int const n = 3 * comm_size;
+    std::vector<int> procs( n );
+    std::vector<int> exports( 2 * n );
+    for ( int i = 0; i < n; ++i )
+    {
+        procs[i] = ( comm_rank * 3 + i * i ) % comm_size;
+        exports[2 * i] = 100 * comm_rank + i;
+        exports[2 * i + 1] = -exports[2 * i];
+    }
+
+    Tpetra::Distributor reference( comm );
+    int const n_imports = reference.createFromSends(
+        Teuchos::ArrayView<int const>( procs.data(), n ) );
+    std::vector<int> imports_ref( 2 * n_imports );
+    reference.doPostsAndWaits(
+        Teuchos::ArrayView<int const>( exports.data(), exports.size() ), 2,
+        Teuchos::ArrayView<int>( imports_ref.data(), imports_ref.size() ) );
+
+    // Each item is sent back a number of times that depends on both the
+    // process that sent it and its position, so that the per-process totals
+    // differ when the counts are taken in the wrong order.
+    auto packet_count = []( int value ) -> std::size_t {
+        return ( value / 100 + 2 * ( value % 100 ) ) % 4 + 1;
+    };
+    std::vector<int> back_exports;
+    std::vector<std::size_t> back_counts( n_imports );
+    for ( int i = 0; i < n_imports; ++i )
+    {
+        back_counts[i] = packet_count( imports_ref[2 * i] );
+        back_exports.insert( back_exports.end(), back_counts[i],
+                             imports_ref[2 * i] );
+    }
+    std::vector<int> back_imports_ref( 2 * n );
+    reference.doReversePostsAndWaits(
+        Teuchos::ArrayView<int const>( imports_ref.data(), imports_ref.size() ),
+        2, Teuchos::ArrayView<int>( back_imports_ref.data(),
+                                    back_imports_ref.size() ) );
+
+    // The items sent back arrive grouped by the process they were sent to,
+    // which is not the order of the exports.
+    std::vector<std::size_t> reverse_import_counts;
+    auto const procs_to = reference.getProcsTo();
+    for ( int j = 0; j < procs_to.size(); ++j )
+        for ( int i = 0; i < n; ++i )
+            if ( procs[i] == procs_to[j] )
+                reverse_import_counts.push_back(
+                    packet_count( 100 * comm_rank + i ) );
+    std::size_t n_packets = 0;
+    for ( auto count : reverse_import_counts )
+        n_packets += count;
+    std::vector<int> variable_imports_ref( n_packets );
+    reference.doReversePostsAndWaits(
+        Teuchos::ArrayView<int const>( back_exports.data(),
+                                       back_exports.size() ),
+        Teuchos::ArrayView<std::size_t const>( back_counts.data(),
+                                               back_counts.size() ),
+        Teuchos::ArrayView<int>( variable_imports_ref.data(),
+                                 variable_imports_ref.size() ),
+        Teuchos::ArrayView<std::size_t const>( reverse_import_counts.data(),
+                                               reverse_import_counts.size() ) );
+    std::vector<int> variable_imports_expected;
+    for ( int j = 0; j < procs_to.size(); ++j )
+        for ( int i = 0; i < n; ++i )
+            if ( procs[i] == procs_to[j] )
+                variable_imports_expected.insert(
+                    variable_imports_expected.end(),
+                    packet_count( 100 * comm_rank + i ), 100 * comm_rank + i );
+    TEST_COMPARE_ARRAYS( variable_imports_ref, variable_imports_expected );
+
+    // directly, by pairs of processes, and through a single node
+    for ( auto const &leaders :
+          {std::vector<int>(), pairsOfProcesses( comm_size ),
+           std::vector<int>( comm_size, 0 )} )
+    {
+        dtk::HierarchicalDistributor distributor( comm, leaders );
+        TEST_EQUALITY( distributor.createFromSends(
+                           Teuchos::ArrayView<int const>( procs.data(), n ) ),
+                       std::size_t( n_imports ) );
+        TEST_EQUALITY( distributor.getTotalReceiveLength(),
+                       std::size_t( n_imports ) );
+        TEST_COMPARE_ARRAYS( toVector( distributor.getProcsFrom() ),
+                             toVector( reference.getProcsFrom() ) );
+        TEST_COMPARE_ARRAYS( toVector( distributor.getLengthsFrom() ),
+                             toVector( reference.getLengthsFrom() ) );
+        TEST_COMPARE_ARRAYS( toVector( distributor.getProcsTo() ),
+                             toVector( reference.getProcsTo() ) );
+        TEST_COMPARE_ARRAYS( toVector( distributor.getLengthsTo() ),
+                             toVector( reference.getLengthsTo() ) );
+
+        std::vector<int> imports( 2 * n_imports );
+        distributor.doPostsAndWaits(
+            Teuchos::ArrayView<int const>( exports.data(), exports.size() ), 2,
+            Teuchos::ArrayView<int>( imports.data(), imports.size() ) );
+        TEST_COMPARE_ARRAYS( imports, imports_ref );
+
+        std::vector<int> posted_imports( 2 * n_imports );
+        distributor.doPosts(
+            Teuchos::arcp<int const>( exports.data(), 0, exports.size(),
+                                      false ),
+            2, Teuchos::arcp<int>( posted_imports.data(), 0,
+                                   posted_imports.size(), false ) );
+        distributor.doWaits();
+        TEST_COMPARE_ARRAYS( posted_imports, imports_ref );
+
+        std::vector<int> back_imports( 2 * n );
+        distributor.doReversePostsAndWaits(
+            Teuchos::ArrayView<int const>( imports.data(), imports.size() ), 2,
+            Teuchos::ArrayView<int>( back_imports.data(),
+                                     back_imports.size() ) );
+        TEST_COMPARE_ARRAYS( back_imports, back_imports_ref );
+
+        std::vector<int> variable_imports( n_packets );
+        distributor.doReversePostsAndWaits(
+            Teuchos::ArrayView<int const>( back_exports.data(),
+                                           back_exports.size() ),
+            Teuchos::ArrayView<std::size_t const>( back_counts.data(),
+                                                   back_counts.size() ),
+            Teuchos::ArrayView<int>( variable_imports.data(),
+                                     variable_imports.size() ),
+            Teuchos::ArrayView<std::size_t const>(
+                reverse_import_counts.data(), reverse_import_counts.size() ) );
+        TEST_COMPARE_ARRAYS( variable_imports, variable_imports_ref );
+    }
+}
+
+TEUCHOS_UNIT_TEST( DetailsHierarchicalDistributor, aggregate_messages )
+{
+    Teuchos::RCP<const Teuchos::Comm<int>> comm =
+        Teuchos::DefaultComm<int>::getComm();
+    int const comm_rank = comm->getRank();
+    int const comm_size = comm->getSize();
+
+    // Every process sends an item to every process.  The messages leave and
+    // enter a node through its leader only.
+    std::vector<int> procs( comm_size );
+    for ( int r = 0; r < comm_size; ++r )
+        procs[r] = r;
+    dtk::HierarchicalDistributor distributor( comm,
+                                              pairsOfProcesses( comm_size ) );
+    distributor.createFromSends(
+        Teuchos::ArrayView<int const>( procs.data(), comm_size ) );
+    int const n_nodes = ( comm_size + 1 ) / 2;
+    bool const has_partner = ( comm_rank - comm_rank % 2 + 1 < comm_size );
+    std::size_t const n_messages =
+        ( comm_rank % 2 == 1 ? 1 : n_nodes - 1 + ( has_partner ? 1 : 0 ) );
+    TEST_EQUALITY( distributor.getNumSends(), n_messages );
+    TEST_EQUALITY( distributor.getNumReceives(), n_messages );
+}
+
+TEUCHOS_UNIT_TEST( DetailsHierarchicalDistributor, find_node_leaders )
+{
+    Teuchos::RCP<const Teuchos::Comm<int>> comm =
+        Teuchos::DefaultComm<int>::getComm();
+    int const comm_size = comm->getSize();
+
+    auto const leaders = dtk::findNodeLeaders( comm );
+    TEST_EQUALITY( leaders.size(), std::size_t( comm_size ) );
+    for ( int r = 0; r < comm_size; ++r )
+    {
+        TEST_ASSERT( leaders[r] <= r );
+        TEST_EQUALITY( leaders[leaders[r]], leaders[r] );
+    }
+}
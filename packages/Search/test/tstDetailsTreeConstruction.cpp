@@ -14,9 +14,12 @@
 #include <Teuchos_UnitTestHarness.hpp>
 
 #include <algorithm>
+#include <array>
 #include <bitset>
+#include <cstdlib>
 #include <functional>
 #include <sstream>
+#include <utility>
 #include <vector>
 
 namespace dtk = DataTransferKit::Details;
@@ -65,12 +68,51 @@ TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( DetailsBVH, morton_codes, DeviceType )
         TEST_EQUALITY( scene_host[0][2 * d + 1], 1024.0 );
     }
 
+    // the points are listed in Z-order
     Kokkos::View<unsigned int *, DeviceType> morton_codes( "morton_codes", n );
-    dtk::TreeConstruction<DeviceType>::assignMortonCodes( boxes, morton_codes,
-                                                          scene[0] );
+    TEST_ASSERT( dtk::TreeConstruction<DeviceType>::assignMortonCodes(
+        boxes, morton_codes, scene[0] ) );
     auto morton_codes_host = Kokkos::create_mirror_view( morton_codes );
     Kokkos::deep_copy( morton_codes_host, morton_codes );
     TEST_COMPARE_ARRAYS( morton_codes_host, ref );
+
+    // swap the last two points
+    std::swap( boxes[n - 2], boxes[n - 1] );
+    TEST_ASSERT( !dtk::TreeConstruction<DeviceType>::assignMortonCodes(
+        boxes, morton_codes, scene[0] ) );
+}
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( DetailsBVH, hilbert_keys, DeviceType )
+{
+    // sorting the cells of a regular grid by the keys of their centers must
+    // visit them along the Hilbert curve, i.e. consecutive cells share a face
+    for ( int m : {2, 4, 8, 16} )
+    {
+        std::vector<std::pair<unsigned int, std::array<int, 3>>> cells;
+        for ( int i = 0; i < m; ++i )
+            for ( int j = 0; j < m; ++j )
+                for ( int k = 0; k < m; ++k )
+                    cells.push_back(
+                        {dtk::TreeConstruction<DeviceType>::hilbert3D(
+                             ( i + .5 ) / m, ( j + .5 ) / m, ( k + .5 ) / m ),
+                         {{i, j, k}}} );
+        std::sort( cells.begin(), cells.end() );
+        for ( int c = 1; c < m * m * m; ++c )
+        {
+            TEST_ASSERT( cells[c - 1].first < cells[c].first );
+            int manhattan_distance = 0;
+            for ( int d = 0; d < 3; ++d )
+                manhattan_distance +=
+                    std::abs( cells[c].second[d] - cells[c - 1].second[d] );
+            TEST_EQUALITY( manhattan_distance, 1 );
+        }
+    }
+
+    // the curve starts at the origin and keys use 30 bits
+    TEST_EQUALITY( dtk::TreeConstruction<DeviceType>::hilbert3D( 0., 0., 0. ),
+                   0u );
+    TEST_ASSERT( dtk::TreeConstruction<DeviceType>::hilbert3D( 1., 0., 0. ) <
+                 ( 1u << 30 ) );
 }
 
 template <typename DeviceType>
@@ -336,6 +378,8 @@ TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( DetailsBVH, example_tree_construction,
                                           DeviceType##NODE )                   \
     TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT(                                      \
         DetailsBVH, number_of_leading_zero_bits, DeviceType##NODE )            \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( DetailsBVH, hilbert_keys,            \
+                                          DeviceType##NODE )                   \
     TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( DetailsBVH, indirect_sort,           \
                                           DeviceType##NODE )                   \
     TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( DetailsBVH, common_prefix,           \
@@ -24,6 +24,7 @@ TEUCHOS_UNIT_TEST( LinearBVH, stack )
     stack.push( 5 );
     TEST_ASSERT( !stack.empty() );
     TEST_ASSERT( stack.top() == 5 );
+    TEST_EQUALITY( stack.size(), 2 );
     // remove it
     stack.pop();
     TEST_ASSERT( !stack.empty() );
@@ -45,6 +46,7 @@ TEUCHOS_UNIT_TEST( LinearBVH, priority_queue )
     // smaller distance stays on top of the priority queue
     queue.push( 24 );
     TEST_EQUALITY( queue.top(), 33 );
+    TEST_EQUALITY( queue.size(), 2 );
     // remove highest priority element
     queue.pop();
     TEST_EQUALITY( queue.top(), 24 );
@@ -68,6 +68,26 @@ TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( DetailsUtils, last_element, DeviceType )
                 DataTransferKit::DataTransferKitException );
 }
 
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( DetailsUtils, equal, DeviceType )
+{
+    int const n = 10;
+    Kokkos::View<int *, DeviceType> v( "v", n );
+    Kokkos::View<int *, DeviceType> w( "w", n );
+    DataTransferKit::fill( v, 3 );
+    DataTransferKit::fill( w, 3 );
+    TEST_ASSERT( DataTransferKit::equal( v, w ) );
+    auto w_host = Kokkos::create_mirror_view( w );
+    Kokkos::deep_copy( w_host, w );
+    w_host( n - 1 ) = 4;
+    Kokkos::deep_copy( w, w_host );
+    TEST_ASSERT( !DataTransferKit::equal( v, w ) );
+    Kokkos::View<int *, DeviceType> u( "u", n + 1 );
+    DataTransferKit::fill( u, 3 );
+    TEST_ASSERT( !DataTransferKit::equal( v, u ) );
+    TEST_ASSERT( DataTransferKit::equal( Kokkos::View<int *, DeviceType>(),
+                                         Kokkos::View<int *, DeviceType>() ) );
+}
+
 // Include the test macros.
 #include "DataTransferKitSearch_ETIHelperMacros.h"
 
@@ -79,6 +99,8 @@ TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( DetailsUtils, last_element, DeviceType )
     TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( DetailsUtils, prefix_sum,            \
                                           DeviceType##NODE )                   \
     TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( DetailsUtils, last_element,          \
+                                          DeviceType##NODE )                   \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( DetailsUtils, equal,                 \
                                           DeviceType##NODE )
 
 // Demangle the types
@@ -16,8 +16,11 @@
 
 #include <algorithm>
 #include <bitset>
+#include <cmath>
 #include <iostream>
+#include <numeric>
 #include <random>
+#include <set>
 #include <tuple>
 
 namespace details = DataTransferKit::Details;
@@ -30,7 +33,6 @@ TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( DistributedSearchTree, hello_world,
     int const comm_rank = Teuchos::rank( *comm );
     int const comm_size = Teuchos::size( *comm );
 
-    DataTransferKit::DistributedSearchTreeImpl<DeviceType>::epsilon = 0.5;
     int const n = 4;
     Kokkos::View<DataTransferKit::Box *, DeviceType> boxes( "boxes", n );
     auto boxes_host = Kokkos::create_mirror_view( boxes );
@@ -146,6 +148,524 @@ TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( DistributedSearchTree, hello_world,
     }
 }
 
+template <typename T, typename DeviceType>
+std::vector<T> toVector( Kokkos::View<T *, DeviceType> v )
+{
+    auto v_host = Kokkos::create_mirror_view( v );
+    Kokkos::deep_copy( v_host, v );
+    return std::vector<T>( v_host.data(), v_host.data() + v_host.extent( 0 ) );
+}
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( DistributedSearchTree, query_plan,
+                                   DeviceType )
+{
+    Teuchos::RCP<const Teuchos::Comm<int>> comm =
+        Teuchos::DefaultComm<int>::getComm();
+    int const comm_rank = Teuchos::rank( *comm );
+    int const comm_size = Teuchos::size( *comm );
+
+    // Each process owns points on the segment [rank, rank + 1).
+    int const n = 4;
+    Kokkos::View<DataTransferKit::Box *, DeviceType> boxes( "boxes", n );
+    auto boxes_host = Kokkos::create_mirror_view( boxes );
+    for ( int i = 0; i < n; ++i )
+    {
+        DataTransferKit::Point point = {{(double)i / n + comm_rank, 0., 0.}};
+        DataTransferKit::Details::expand( boxes_host( i ), point );
+    }
+    Kokkos::deep_copy( boxes, boxes_host );
+    DataTransferKit::DistributedSearchTree<DeviceType> tree( comm, boxes );
+
+    int const n_queries = 3;
+    Kokkos::View<details::Within *, DeviceType> queries( "queries",
+                                                         n_queries );
+    Kokkos::View<details::Nearest *, DeviceType> nearest_queries(
+        "nearest_queries", n_queries );
+    auto queries_host = Kokkos::create_mirror_view( queries );
+    auto nearest_queries_host = Kokkos::create_mirror_view( nearest_queries );
+    auto set_queries = [&]( double shift ) {
+        for ( int q = 0; q < n_queries; ++q )
+        {
+            DataTransferKit::Point const point = {
+                {std::fmod( comm_rank + q + shift, comm_size ), 0., 0.}};
+            queries_host( q ) = details::within( point, 0.3 );
+            nearest_queries_host( q ) = details::nearest( point, 2 );
+        }
+        Kokkos::deep_copy( queries, queries_host );
+        Kokkos::deep_copy( nearest_queries, nearest_queries_host );
+    };
+
+    Kokkos::View<int *, DeviceType> indices( "indices" );
+    Kokkos::View<int *, DeviceType> offset( "offset" );
+    Kokkos::View<int *, DeviceType> ranks( "ranks" );
+    Kokkos::View<double *, DeviceType> distances( "distances" );
+    Kokkos::View<int *, DeviceType> indices_ref( "indices_ref" );
+    Kokkos::View<int *, DeviceType> offset_ref( "offset_ref" );
+    Kokkos::View<int *, DeviceType> ranks_ref( "ranks_ref" );
+    Kokkos::View<double *, DeviceType> distances_ref( "distances_ref" );
+    auto check_results = [&]() {
+        TEST_COMPARE_ARRAYS( toVector( offset ), toVector( offset_ref ) );
+        TEST_COMPARE_ARRAYS( toVector( indices ), toVector( indices_ref ) );
+        TEST_COMPARE_ARRAYS( toVector( ranks ), toVector( ranks_ref ) );
+    };
+
+    // The plan is set up by the first query and reused while the queries are
+    // sent to the same processes.
+    DataTransferKit::DistributedQueryPlan<DeviceType> plan;
+    set_queries( 0.25 );
+    tree.query( queries, indices_ref, offset_ref, ranks_ref );
+    for ( int i = 0; i < 2; ++i )
+    {
+        tree.query( queries, indices, offset, ranks, plan );
+        check_results();
+        TEST_EQUALITY( plan.numberOfSetups(), 1 );
+    }
+
+    // Queries moving within the same processes.
+    set_queries( 0.5 );
+    tree.query( queries, indices_ref, offset_ref, ranks_ref );
+    tree.query( queries, indices, offset, ranks, plan );
+    check_results();
+    TEST_EQUALITY( plan.numberOfSetups(), 1 );
+
+    // Queries moving to other processes on one of the processes only.  The
+    // plan is set up again everywhere.
+    set_queries( comm_rank == 0 ? 1.5 : 0.5 );
+    tree.query( queries, indices_ref, offset_ref, ranks_ref );
+    tree.query( queries, indices, offset, ranks, plan );
+    check_results();
+    TEST_EQUALITY( plan.numberOfSetups(), comm_size > 1 ? 2 : 1 );
+
+    // Nearest queries are forwarded in two rounds.
+    DataTransferKit::DistributedQueryPlan<DeviceType> nearest_plan;
+    for ( int i = 0; i < 2; ++i )
+    {
+        tree.query( nearest_queries, indices_ref, offset_ref, ranks_ref,
+                    distances_ref );
+        tree.query( nearest_queries, indices, offset, ranks, distances,
+                    nearest_plan );
+        check_results();
+        TEST_COMPARE_FLOATING_ARRAYS( toVector( distances ),
+                                      toVector( distances_ref ), 1e-14 );
+        TEST_EQUALITY( nearest_plan.numberOfSetups(), 2 );
+    }
+}
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( DistributedSearchTree, exact_nearest,
+                                   DeviceType )
+{
+    Teuchos::RCP<const Teuchos::Comm<int>> comm =
+        Teuchos::DefaultComm<int>::getComm();
+    int const comm_rank = Teuchos::rank( *comm );
+    int const comm_size = Teuchos::size( *comm );
+
+    // Each process owns points on the segment [rank, rank + 1).
+    int const n = 4;
+    Kokkos::View<DataTransferKit::Box *, DeviceType> boxes( "boxes", n );
+    auto boxes_host = Kokkos::create_mirror_view( boxes );
+    for ( int i = 0; i < n; ++i )
+    {
+        DataTransferKit::Point point = {{(double)i / n + comm_rank, 0., 0.}};
+        DataTransferKit::Details::expand( boxes_host( i ), point );
+    }
+    Kokkos::deep_copy( boxes, boxes_host );
+    DataTransferKit::DistributedSearchTree<DeviceType> tree( comm, boxes );
+
+    // The first query is away from every process and the nearest neighbors
+    // of the other ones are split between neighboring processes.
+    std::vector<details::Nearest> queries_ = {
+        details::nearest( {{comm_rank + 0.5, 2., 0.}}, 3 ),
+        details::nearest( {{comm_rank + 0.99, 0., 0.}}, 2 ),
+        details::nearest( {{comm_rank + 0.01, 0.1, 0.}}, 3 ),
+        details::nearest( {{comm_rank + 0.5, 0., 0.}}, n * comm_size + 1 )};
+    int const n_queries = queries_.size();
+    Kokkos::View<details::Nearest *, DeviceType> queries( "queries",
+                                                          n_queries );
+    auto queries_host = Kokkos::create_mirror_view( queries );
+    for ( int q = 0; q < n_queries; ++q )
+        queries_host( q ) = queries_[q];
+    Kokkos::deep_copy( queries, queries_host );
+
+    Kokkos::View<int *, DeviceType> indices( "indices" );
+    Kokkos::View<int *, DeviceType> offset( "offset" );
+    Kokkos::View<int *, DeviceType> ranks( "ranks" );
+    Kokkos::View<double *, DeviceType> distances( "distances" );
+    tree.query( queries, indices, offset, ranks, distances );
+    auto const indices_host = toVector( indices );
+    auto const offset_host = toVector( offset );
+    auto const ranks_host = toVector( ranks );
+    auto const distances_host = toVector( distances );
+
+    auto distance = [n]( details::Nearest const &query, int rank,
+                         int index ) {
+        DataTransferKit::Point const point = {
+            {(double)index / n + rank, 0., 0.}};
+        return details::distance( query._query_point, point );
+    };
+    for ( int q = 0; q < n_queries; ++q )
+    {
+        std::vector<double> expected;
+        for ( int r = 0; r < comm_size; ++r )
+            for ( int i = 0; i < n; ++i )
+                expected.push_back( distance( queries_[q], r, i ) );
+        std::sort( expected.begin(), expected.end() );
+        expected.resize( std::min<int>( expected.size(), queries_[q]._k ) );
+
+        std::vector<double> found;
+        for ( int i = offset_host[q]; i < offset_host[q + 1]; ++i )
+        {
+            found.push_back( distances_host[i] );
+            TEST_FLOATING_EQUALITY(
+                distance( queries_[q], ranks_host[i], indices_host[i] ),
+                distances_host[i], 1e-14 );
+        }
+        TEST_COMPARE_FLOATING_ARRAYS( found, expected, 1e-14 );
+    }
+}
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( DistributedSearchTree, repartition,
+                                   DeviceType )
+{
+    Teuchos::RCP<const Teuchos::Comm<int>> comm =
+        Teuchos::DefaultComm<int>::getComm();
+    int const comm_rank = Teuchos::rank( *comm );
+    int const comm_size = Teuchos::size( *comm );
+
+    // Points are dealt to the processes in turn so that the bounds of the
+    // processes all overlap.  The j-th point of a process is the point
+    // number j * comm_size + rank on a line.
+    int const n = 50;
+    Kokkos::View<DataTransferKit::Box *, DeviceType> boxes( "boxes", n );
+    auto boxes_host = Kokkos::create_mirror_view( boxes );
+    for ( int j = 0; j < n; ++j )
+    {
+        DataTransferKit::Point const point = {
+            {(double)( j * comm_size + comm_rank ), 0., 0.}};
+        DataTransferKit::Details::expand( boxes_host( j ), point );
+    }
+    Kokkos::deep_copy( boxes, boxes_host );
+    DataTransferKit::DistributedSearchTree<DeviceType> tree(
+        comm, boxes, 1, DataTransferKit::Partitioning::ZOrderCurve );
+
+    int const n_queries = 4;
+    Kokkos::View<details::Within *, DeviceType> queries( "queries",
+                                                         n_queries );
+    Kokkos::View<details::Nearest *, DeviceType> nearest_queries(
+        "nearest_queries", n_queries );
+    auto queries_host = Kokkos::create_mirror_view( queries );
+    auto nearest_queries_host = Kokkos::create_mirror_view( nearest_queries );
+    std::vector<double> centers( n_queries );
+    for ( int q = 0; q < n_queries; ++q )
+    {
+        centers[q] = ( comm_rank * n_queries + q ) * 7 + 3.3;
+        queries_host( q ) = details::within( {{centers[q], 0., 0.}}, 2.5 );
+        nearest_queries_host( q ) =
+            details::nearest( {{centers[q], 0., 0.}}, 3 );
+    }
+    Kokkos::deep_copy( queries, queries_host );
+    Kokkos::deep_copy( nearest_queries, nearest_queries_host );
+
+    // Results refer to the objects as they were passed to the constructor.
+    auto check_results = [&]( Kokkos::View<int *, DeviceType> indices,
+                              Kokkos::View<int *, DeviceType> offset,
+                              Kokkos::View<int *, DeviceType> ranks,
+                              double radius ) {
+        auto const indices_host = toVector( indices );
+        auto const offset_host = toVector( offset );
+        auto const ranks_host = toVector( ranks );
+        TEST_EQUALITY( offset_host.size(), n_queries + 1 );
+        for ( int q = 0; q < n_queries; ++q )
+        {
+            std::set<int> found;
+            for ( int i = offset_host[q]; i < offset_host[q + 1]; ++i )
+                found.insert( indices_host[i] * comm_size + ranks_host[i] );
+            std::set<int> expected;
+            for ( int g = 0; g < n * comm_size; ++g )
+                if ( std::abs( g - centers[q] ) <= radius )
+                    expected.insert( g );
+            TEST_ASSERT( found == expected );
+        }
+    };
+
+    Kokkos::View<int *, DeviceType> indices( "indices" );
+    Kokkos::View<int *, DeviceType> offset( "offset" );
+    Kokkos::View<int *, DeviceType> ranks( "ranks" );
+    tree.query( queries, indices, offset, ranks );
+    check_results( indices, offset, ranks, 2.5 );
+
+    // The three nearest points are within a distance of 1.5 and none of the
+    // others is.
+    Kokkos::View<double *, DeviceType> distances( "distances" );
+    tree.query( nearest_queries, indices, offset, ranks, distances );
+    check_results( indices, offset, ranks, 1.5 );
+
+    // Every process now owns a segment of the line, so a query is only
+    // searched by the one or two processes whose segments it overlaps.  The
+    // bounds of the processes all overlapped before.
+    auto total_load =
+        [&]( DataTransferKit::DistributedSearchTree<DeviceType> const &t ) {
+            DataTransferKit::DistributedQueryPlan<DeviceType> measuring_plan(
+                1e10 );
+            t.query( queries, indices, offset, ranks, measuring_plan );
+            auto const &loads = measuring_plan.queryLoads();
+            return std::accumulate( loads.begin(), loads.end(), 0 );
+        };
+    int const n_total_queries = n_queries * comm_size;
+    TEST_ASSERT( total_load( tree ) <= 2 * n_total_queries );
+    if ( comm_size > 2 )
+    {
+        DataTransferKit::DistributedSearchTree<DeviceType> as_given_tree(
+            comm, boxes );
+        TEST_ASSERT( total_load( as_given_tree ) > 2 * n_total_queries );
+    }
+}
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( DistributedSearchTree, load_balancing,
+                                   DeviceType )
+{
+    Teuchos::RCP<const Teuchos::Comm<int>> comm =
+        Teuchos::DefaultComm<int>::getComm();
+    int const comm_rank = Teuchos::rank( *comm );
+    int const comm_size = Teuchos::size( *comm );
+
+    // Each process owns points on the segment [rank, rank + 1).
+    int const n = 10;
+    Kokkos::View<DataTransferKit::Box *, DeviceType> boxes( "boxes", n );
+    auto boxes_host = Kokkos::create_mirror_view( boxes );
+    for ( int i = 0; i < n; ++i )
+    {
+        DataTransferKit::Point point = {{(double)i / n + comm_rank, 0., 0.}};
+        DataTransferKit::Details::expand( boxes_host( i ), point );
+    }
+    Kokkos::deep_copy( boxes, boxes_host );
+    DataTransferKit::DistributedSearchTree<DeviceType> tree( comm, boxes );
+
+    // All the queries target the objects of the first process.
+    int const n_queries = 10;
+    Kokkos::View<details::Within *, DeviceType> queries( "queries",
+                                                         n_queries );
+    Kokkos::View<details::Nearest *, DeviceType> nearest_queries(
+        "nearest_queries", n_queries );
+    auto queries_host = Kokkos::create_mirror_view( queries );
+    auto nearest_queries_host = Kokkos::create_mirror_view( nearest_queries );
+    for ( int q = 0; q < n_queries; ++q )
+    {
+        DataTransferKit::Point const point = {{0.05 + 0.09 * q, 0., 0.}};
+        queries_host( q ) = details::within( point, 0.1 );
+        nearest_queries_host( q ) = details::nearest( point, 3 );
+    }
+    Kokkos::deep_copy( queries, queries_host );
+    Kokkos::deep_copy( nearest_queries, nearest_queries_host );
+
+    Kokkos::View<int *, DeviceType> indices( "indices" );
+    Kokkos::View<int *, DeviceType> offset( "offset" );
+    Kokkos::View<int *, DeviceType> ranks( "ranks" );
+    Kokkos::View<double *, DeviceType> distances( "distances" );
+    Kokkos::View<int *, DeviceType> indices_ref( "indices_ref" );
+    Kokkos::View<int *, DeviceType> offset_ref( "offset_ref" );
+    Kokkos::View<int *, DeviceType> ranks_ref( "ranks_ref" );
+    Kokkos::View<double *, DeviceType> distances_ref( "distances_ref" );
+    auto check_results = [&]() {
+        TEST_COMPARE_ARRAYS( toVector( offset ), toVector( offset_ref ) );
+        TEST_COMPARE_ARRAYS( toVector( indices ), toVector( indices_ref ) );
+        TEST_COMPARE_ARRAYS( toVector( ranks ), toVector( ranks_ref ) );
+    };
+    auto count_replicas =
+        [&]( DataTransferKit::DistributedQueryPlan<DeviceType> const &plan ) {
+            int const n_replicas = plan.numberOfReplicas();
+            int n_total = 0;
+            Teuchos::reduceAll( *comm, Teuchos::REDUCE_SUM, n_replicas,
+                                Teuchos::ptr( &n_total ) );
+            return n_total;
+        };
+
+    // The loads are only measured.
+    DataTransferKit::DistributedQueryPlan<DeviceType> measuring_plan( 1e10 );
+    tree.query( queries, indices_ref, offset_ref, ranks_ref );
+    tree.query( queries, indices, offset, ranks, measuring_plan );
+    check_results();
+    std::vector<int> expected_loads( comm_size, 0 );
+    expected_loads[0] = n_queries * comm_size;
+    TEST_COMPARE_ARRAYS( measuring_plan.queryLoads(), expected_loads );
+    TEST_EQUALITY( count_replicas( measuring_plan ), 0 );
+
+    // The first process hands the queries it received over to the others.
+    // The copies of its tree are only sent once and the hand-overs are only
+    // set up once.
+    DataTransferKit::DistributedQueryPlan<DeviceType> plan( 1.5 );
+    for ( int i = 0; i < 2; ++i )
+    {
+        tree.query( queries, indices, offset, ranks, plan );
+        check_results();
+        TEST_COMPARE_ARRAYS( plan.queryLoads(), expected_loads );
+        TEST_EQUALITY( count_replicas( plan ), comm_size - 1 );
+        TEST_EQUALITY( plan.numberOfReplicas(),
+                       comm_rank > 0 && comm_size > 1 ? 1 : 0 );
+        TEST_EQUALITY( plan.numberOfSetups(), comm_size > 1 ? 2 : 1 );
+    }
+
+    // The nearest neighbors queries are balanced in each round, so that
+    // copies of the trees of other processes may be sent in the second one.
+    DataTransferKit::DistributedQueryPlan<DeviceType> nearest_plan( 1.5 );
+    tree.query( nearest_queries, indices_ref, offset_ref, ranks_ref,
+                distances_ref );
+    int n_replicas = 0;
+    for ( int i = 0; i < 2; ++i )
+    {
+        tree.query( nearest_queries, indices, offset, ranks, distances,
+                    nearest_plan );
+        check_results();
+        TEST_COMPARE_FLOATING_ARRAYS( toVector( distances ),
+                                      toVector( distances_ref ), 1e-14 );
+        TEST_ASSERT( count_replicas( nearest_plan ) >= comm_size - 1 );
+        if ( i == 0 )
+            n_replicas = count_replicas( nearest_plan );
+        TEST_EQUALITY( count_replicas( nearest_plan ), n_replicas );
+    }
+}
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( DistributedSearchTree, aggregate_by_node,
+                                   DeviceType )
+{
+    Teuchos::RCP<const Teuchos::Comm<int>> comm =
+        Teuchos::DefaultComm<int>::getComm();
+    int const comm_rank = Teuchos::rank( *comm );
+    int const comm_size = Teuchos::size( *comm );
+
+    // Each process owns points on the segment [rank, rank + 1).
+    int const n = 4;
+    Kokkos::View<DataTransferKit::Box *, DeviceType> boxes( "boxes", n );
+    auto boxes_host = Kokkos::create_mirror_view( boxes );
+    for ( int i = 0; i < n; ++i )
+    {
+        DataTransferKit::Point point = {{(double)i / n + comm_rank, 0., 0.}};
+        DataTransferKit::Details::expand( boxes_host( i ), point );
+    }
+    Kokkos::deep_copy( boxes, boxes_host );
+    DataTransferKit::DistributedSearchTree<DeviceType> tree( comm, boxes );
+
+    // The queries of every process go to all the others.
+    int const n_queries = comm_size;
+    Kokkos::View<details::Within *, DeviceType> queries( "queries",
+                                                         n_queries );
+    Kokkos::View<details::Nearest *, DeviceType> nearest_queries(
+        "nearest_queries", n_queries );
+    auto queries_host = Kokkos::create_mirror_view( queries );
+    auto nearest_queries_host = Kokkos::create_mirror_view( nearest_queries );
+    for ( int q = 0; q < n_queries; ++q )
+    {
+        DataTransferKit::Point const point = {
+            {q + 0.1 * ( comm_rank % 10 ), 0., 0.}};
+        queries_host( q ) = details::within( point, 0.3 );
+        nearest_queries_host( q ) = details::nearest( point, 3 );
+    }
+    Kokkos::deep_copy( queries, queries_host );
+    Kokkos::deep_copy( nearest_queries, nearest_queries_host );
+
+    Kokkos::View<int *, DeviceType> indices( "indices" );
+    Kokkos::View<int *, DeviceType> offset( "offset" );
+    Kokkos::View<int *, DeviceType> ranks( "ranks" );
+    Kokkos::View<double *, DeviceType> distances( "distances" );
+    Kokkos::View<int *, DeviceType> indices_ref( "indices_ref" );
+    Kokkos::View<int *, DeviceType> offset_ref( "offset_ref" );
+    Kokkos::View<int *, DeviceType> ranks_ref( "ranks_ref" );
+    Kokkos::View<double *, DeviceType> distances_ref( "distances_ref" );
+    auto check_results = [&]() {
+        TEST_COMPARE_ARRAYS( toVector( offset ), toVector( offset_ref ) );
+        TEST_COMPARE_ARRAYS( toVector( indices ), toVector( indices_ref ) );
+        TEST_COMPARE_ARRAYS( toVector( ranks ), toVector( ranks_ref ) );
+    };
+
+    // The results are the same as when the messages are sent directly,
+    // including when the plan is reused.
+    DataTransferKit::DistributedQueryPlan<DeviceType> plan( 0., true );
+    tree.query( queries, indices_ref, offset_ref, ranks_ref );
+    for ( int i = 0; i < 2; ++i )
+    {
+        tree.query( queries, indices, offset, ranks, plan );
+        check_results();
+        TEST_EQUALITY( plan.numberOfSetups(), 1 );
+    }
+
+    DataTransferKit::DistributedQueryPlan<DeviceType> nearest_plan( 0.,
+                                                                    true );
+    tree.query( nearest_queries, indices_ref, offset_ref, ranks_ref,
+                distances_ref );
+    for ( int i = 0; i < 2; ++i )
+    {
+        tree.query( nearest_queries, indices, offset, ranks, distances,
+                    nearest_plan );
+        check_results();
+        TEST_COMPARE_FLOATING_ARRAYS( toVector( distances ),
+                                      toVector( distances_ref ), 1e-14 );
+    }
+}
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( DistributedSearchTree, boxes_per_rank,
+                                   DeviceType )
+{
+    Teuchos::RCP<const Teuchos::Comm<int>> comm =
+        Teuchos::DefaultComm<int>::getComm();
+    int const comm_rank = Teuchos::rank( *comm );
+    int const comm_size = Teuchos::size( *comm );
+
+    // Each process owns two rows of points far apart from each other, the
+    // space in between is empty.
+    int const n = 16;
+    double const height = 10.;
+    Kokkos::View<DataTransferKit::Box *, DeviceType> boxes( "boxes", 2 * n );
+    auto boxes_host = Kokkos::create_mirror_view( boxes );
+    for ( int i = 0; i < n; ++i )
+        for ( int j = 0; j < 2; ++j )
+        {
+            DataTransferKit::Point const point = {
+                {comm_rank + (double)i / n, j * height, 0.}};
+            DataTransferKit::Details::expand( boxes_host( 2 * i + j ), point );
+        }
+    Kokkos::deep_copy( boxes, boxes_host );
+
+    // Queries on the rows and in between for every process.
+    int const n_queries = 3 * comm_size;
+    Kokkos::View<details::Within *, DeviceType> queries( "queries",
+                                                         n_queries );
+    auto queries_host = Kokkos::create_mirror_view( queries );
+    for ( int r = 0; r < comm_size; ++r )
+        for ( int j = 0; j < 3; ++j )
+            queries_host( 3 * r + j ) =
+                details::within( {{r + 0.5, j * height / 2, 0.}}, 0.2 );
+    Kokkos::deep_copy( queries, queries_host );
+
+    auto sorted_results = [&]( int n_boxes_per_rank ) {
+        DataTransferKit::DistributedSearchTree<DeviceType> tree(
+            comm, boxes, n_boxes_per_rank );
+        Kokkos::View<int *, DeviceType> indices( "indices" );
+        Kokkos::View<int *, DeviceType> offset( "offset" );
+        Kokkos::View<int *, DeviceType> ranks( "ranks" );
+        tree.query( queries, indices, offset, ranks );
+        auto const indices_host = toVector( indices );
+        auto const offset_host = toVector( offset );
+        auto const ranks_host = toVector( ranks );
+        std::vector<std::set<std::pair<int, int>>> results( n_queries );
+        for ( int q = 0; q < n_queries; ++q )
+            for ( int i = offset_host[q]; i < offset_host[q + 1]; ++i )
+                results[q].emplace( ranks_host[i], indices_host[i] );
+        return results;
+    };
+
+    auto const results = sorted_results( 1 );
+    for ( int r = 0; r < comm_size; ++r )
+    {
+        TEST_EQUALITY( results[3 * r].size(), 7 );
+        TEST_EQUALITY( results[3 * r + 1].size(), 0 );
+        TEST_EQUALITY( results[3 * r + 2].size(), 7 );
+        for ( int j = 0; j < 3; ++j )
+            for ( auto const &result : results[3 * r + j] )
+                TEST_EQUALITY( result.first, r );
+    }
+    for ( int n_boxes_per_rank : {2, 4, 64} )
+        TEST_ASSERT( sorted_results( n_boxes_per_rank ) == results );
+}
+
 std::vector<std::array<double, 3>>
 make_random_cloud( double const Lx, double const Ly, double const Lz,
                    int const n, double const seed )
@@ -321,7 +841,19 @@ TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( DistributedSearchTree, boost_comparison,
     TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( DistributedSearchTree, hello_world,  \
                                           DeviceType##NODE )                   \
     TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( DistributedSearchTree,               \
-                                          boost_comparison, DeviceType##NODE )
+                                          boost_comparison, DeviceType##NODE ) \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( DistributedSearchTree, query_plan,   \
+                                          DeviceType##NODE )                   \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( DistributedSearchTree,               \
+                                          exact_nearest, DeviceType##NODE )    \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( DistributedSearchTree,               \
+                                          repartition, DeviceType##NODE )      \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( DistributedSearchTree,               \
+                                          load_balancing, DeviceType##NODE )   \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( DistributedSearchTree,               \
+                                          aggregate_by_node, DeviceType##NODE )\
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( DistributedSearchTree,               \
+                                          boxes_per_rank, DeviceType##NODE )
 
 // Demangle the types
 DTK_ETI_MANGLING_TYPEDEFS()
@@ -0,0 +1,263 @@
+/****************************************************************************
+ * Copyright (c) 2012-2017 by the DataTransferKit authors                   *
+ * All rights reserved.                                                     *
+ *                                                                          *
+ * This file is part of the DataTransferKit library. DataTransferKit is     *
+ * distributed under a BSD 3-clause license. For the licensing terms see    *
+ * the LICENSE file in the top-level directory.                             *
+ ****************************************************************************/
+
+#include <DTK_DynamicBVH.hpp>
+#include <DTK_LinearBVH.hpp>
+
+#include <Teuchos_UnitTestHarness.hpp>
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace details = DataTransferKit::Details;
+
+template <typename T, typename DeviceType>
+std::vector<T> toVector( Kokkos::View<T *, DeviceType> v )
+{
+    auto v_host = Kokkos::create_mirror_view( v );
+    Kokkos::deep_copy( v_host, v );
+    return std::vector<T>( v_host.data(), v_host.data() + v_host.extent( 0 ) );
+}
+
+template <typename T, typename DeviceType>
+Kokkos::View<T *, DeviceType> toView( std::vector<T> const &v )
+{
+    int const n = v.size();
+    Kokkos::View<T *, DeviceType> view( "view", n );
+    auto view_host = Kokkos::create_mirror_view( view );
+    for ( int i = 0; i < n; ++i )
+        view_host( i ) = v[i];
+    Kokkos::deep_copy( view, view_host );
+    return view;
+}
+
+// Checks the dynamic hierarchy against a hierarchy built from scratch over
+// the objects it currently holds.
+template <typename DeviceType>
+void checkQueries( DataTransferKit::DynamicBVH<DeviceType> const &dynamic_bvh,
+                   std::map<int, DataTransferKit::Box> const &objects,
+                   bool &success, Teuchos::FancyOStream &out )
+{
+    using DataTransferKit::Box;
+    using DataTransferKit::Point;
+
+    TEST_EQUALITY( dynamic_bvh.size(), static_cast<int>( objects.size() ) );
+    std::vector<int> ids;
+    std::vector<Box> boxes;
+    for ( auto const &object : objects )
+    {
+        ids.push_back( object.first );
+        boxes.push_back( object.second );
+    }
+    DataTransferKit::BVH<DeviceType> bvh( toView<Box, DeviceType>( boxes ) );
+
+    // the SAH cost is updated incrementally
+    TEST_FLOATING_EQUALITY( dynamic_bvh.sahCost(),
+                            dynamic_bvh.bvh().sahCost(), 1e-10 );
+
+    std::default_random_engine generator( 1357 );
+    std::uniform_real_distribution<double> position( -1., 11. );
+    int const n_queries = 50;
+    int const k = std::min<int>( 4, objects.size() );
+    std::vector<details::Within> within_queries( n_queries );
+    std::vector<details::Nearest> nearest_queries( n_queries );
+    for ( int i = 0; i < n_queries; ++i )
+    {
+        Point const p = {{position( generator ), position( generator ),
+                          position( generator )}};
+        within_queries[i] = details::within( p, 1. );
+        nearest_queries[i] = details::nearest( p, k );
+    }
+
+    Kokkos::View<int *, DeviceType> indices( "indices" );
+    Kokkos::View<int *, DeviceType> offset( "offset" );
+    Kokkos::View<double *, DeviceType> distances( "distances" );
+    Kokkos::View<int *, DeviceType> indices_ref( "indices_ref" );
+    Kokkos::View<int *, DeviceType> offset_ref( "offset_ref" );
+    Kokkos::View<double *, DeviceType> distances_ref( "distances_ref" );
+
+    auto within_queries_view =
+        toView<details::Within, DeviceType>( within_queries );
+    dynamic_bvh.query( within_queries_view, indices, offset );
+    bvh.query( within_queries_view, indices_ref, offset_ref );
+    auto const offset_host = toVector( offset );
+    auto const indices_host = toVector( indices );
+    auto const indices_ref_host = toVector( indices_ref );
+    TEST_COMPARE_ARRAYS( offset_host, toVector( offset_ref ) );
+    for ( int i = 0; i < n_queries; ++i )
+    {
+        std::vector<int> found( indices_host.begin() + offset_host[i],
+                                indices_host.begin() + offset_host[i + 1] );
+        std::vector<int> expected;
+        for ( int j = offset_host[i]; j < offset_host[i + 1]; ++j )
+            expected.push_back( ids[indices_ref_host[j]] );
+        std::sort( found.begin(), found.end() );
+        std::sort( expected.begin(), expected.end() );
+        TEST_COMPARE_ARRAYS( found, expected );
+    }
+
+    auto nearest_queries_view =
+        toView<details::Nearest, DeviceType>( nearest_queries );
+    dynamic_bvh.query( nearest_queries_view, indices, offset, distances );
+    bvh.query( nearest_queries_view, indices_ref, offset_ref, distances_ref );
+    auto const distances_host = toVector( distances );
+    TEST_COMPARE_FLOATING_ARRAYS( distances_host, toVector( distances_ref ),
+                                  1e-14 );
+    auto const nearest_indices_host = toVector( indices );
+    for ( int j = 0; j < n_queries * k; ++j )
+    {
+        auto const object = objects.find( nearest_indices_host[j] );
+        TEST_ASSERT( object != objects.end() );
+        if ( object != objects.end() )
+            TEST_FLOATING_EQUALITY(
+                details::distance( nearest_queries[j / k]._query_point,
+                                   object->second ),
+                distances_host[j], 1e-14 );
+    }
+}
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( DynamicBVH, insert_and_remove, DeviceType )
+{
+    using DataTransferKit::Box;
+
+    std::default_random_engine generator( 2468 );
+    std::uniform_real_distribution<double> position( 0., 10. );
+    auto random_boxes = [&generator, &position]( int n ) {
+        std::vector<Box> boxes( n );
+        for ( auto &box : boxes )
+        {
+            double const x = position( generator );
+            double const y = position( generator );
+            double const z = position( generator );
+            box = Box( {x, x + 0.3, y, y + 0.3, z, z + 0.3} );
+        }
+        return boxes;
+    };
+
+    std::map<int, Box> objects;
+    std::vector<Box> boxes = random_boxes( 200 );
+    for ( int i = 0; i < 200; ++i )
+        objects[i] = boxes[i];
+    DataTransferKit::DynamicBVH<DeviceType> dynamic_bvh(
+        toView<Box, DeviceType>( boxes ) );
+    TEST_EQUALITY( dynamic_bvh.numberOfRebuilds(), 1 );
+    checkQueries( dynamic_bvh, objects, success, out );
+
+    Kokkos::View<int *, DeviceType> ids( "ids" );
+    for ( int step = 0; step < 10; ++step )
+    {
+        // small batches are inserted into the existing hierarchy
+        boxes = random_boxes( 30 );
+        dynamic_bvh.insert( toView<Box, DeviceType>( boxes ), ids );
+        auto const ids_host = toVector( ids );
+        for ( int i = 0; i < 30; ++i )
+        {
+            TEST_ASSERT( objects.count( ids_host[i] ) == 0 );
+            objects[ids_host[i]] = boxes[i];
+        }
+        checkQueries( dynamic_bvh, objects, success, out );
+
+        std::vector<int> removed;
+        for ( auto const &object : objects )
+            if ( ( object.first + step ) % 3 == 0 )
+                removed.push_back( object.first );
+        std::shuffle( removed.begin(), removed.end(), generator );
+        removed.resize( std::min<int>( removed.size(), 25 ) );
+        dynamic_bvh.remove( toView<int, DeviceType>( removed ) );
+        for ( int id : removed )
+            objects.erase( id );
+        checkQueries( dynamic_bvh, objects, success, out );
+    }
+
+    // remove everything, then start over from an empty hierarchy
+    std::vector<int> all_ids;
+    for ( auto const &object : objects )
+        all_ids.push_back( object.first );
+    dynamic_bvh.remove( toView<int, DeviceType>( all_ids ) );
+    objects.clear();
+    TEST_ASSERT( dynamic_bvh.empty() );
+    TEST_EQUALITY( dynamic_bvh.sahCost(), 0. );
+    for ( int n : {1, 1, 3} )
+    {
+        boxes = random_boxes( n );
+        dynamic_bvh.insert( toView<Box, DeviceType>( boxes ), ids );
+        auto const ids_host = toVector( ids );
+        for ( int i = 0; i < n; ++i )
+            objects[ids_host[i]] = boxes[i];
+        checkQueries( dynamic_bvh, objects, success, out );
+    }
+
+    // invalid ids are rejected and the hierarchy is left untouched
+    int const valid_id = objects.begin()->first;
+    for ( auto const &invalid_ids : std::vector<std::vector<int>>{
+              {-1}, {valid_id, 1000}, {valid_id, valid_id}} )
+        TEST_THROW(
+            dynamic_bvh.remove( toView<int, DeviceType>( invalid_ids ) ),
+            DataTransferKit::DataTransferKitException );
+    checkQueries( dynamic_bvh, objects, success, out );
+}
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( DynamicBVH, rebuild, DeviceType )
+{
+    using DataTransferKit::Box;
+
+    // Objects on a flat grid are moved one at a time to random positions in a
+    // cube by removing them and inserting them back.  The hierarchy that was
+    // built for the grid degrades and eventually gets rebuilt.
+    std::vector<Box> boxes;
+    for ( int i = 0; i < 10; ++i )
+        for ( int j = 0; j < 10; ++j )
+            boxes.push_back( Box( {1. * i, i + .5, 1. * j, j + .5, 0., .5} ) );
+    int const n = boxes.size();
+    DataTransferKit::DynamicBVH<DeviceType> dynamic_bvh(
+        toView<Box, DeviceType>( boxes ), 1.2 );
+
+    std::map<int, Box> objects;
+    for ( int i = 0; i < n; ++i )
+        objects[i] = boxes[i];
+    std::default_random_engine generator( 97531 );
+    std::uniform_real_distribution<double> position( 0., 9.5 );
+    Kokkos::View<int *, DeviceType> ids( "ids" );
+    for ( int i = 0; i < n; ++i )
+    {
+        std::vector<int> const removed = {i};
+        dynamic_bvh.remove( toView<int, DeviceType>( removed ) );
+        double const x = position( generator );
+        double const y = position( generator );
+        double const z = position( generator );
+        std::vector<Box> const moved = {
+            Box( {x, x + .5, y, y + .5, z, z + .5} )};
+        dynamic_bvh.insert( toView<Box, DeviceType>( moved ), ids );
+        // the id that was just freed is reused
+        int const id = toVector( ids )[0];
+        TEST_EQUALITY( id, i );
+        objects[i] = moved[0];
+    }
+    TEST_ASSERT( dynamic_bvh.numberOfRebuilds() > 1 );
+    checkQueries( dynamic_bvh, objects, success, out );
+}
+
+// Include the test macros.
+#include "DataTransferKitSearch_ETIHelperMacros.h"
+
+// Create the test group
+#define UNIT_TEST_GROUP( NODE )                                                \
+    using DeviceType##NODE = typename NODE::device_type;                       \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( DynamicBVH, insert_and_remove,       \
+                                          DeviceType##NODE )                   \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( DynamicBVH, rebuild,                 \
+                                          DeviceType##NODE )
+
+// Demangle the types
+DTK_ETI_MANGLING_TYPEDEFS()
+
+// Instantiate the tests
+DTK_INSTANTIATE_N( UNIT_TEST_GROUP )
@@ -0,0 +1,199 @@
+/****************************************************************************
+ * Copyright (c) 2012-2017 by the DataTransferKit authors                   *
+ * All rights reserved.                                                     *
+ *                                                                          *
+ * This file is part of the DataTransferKit library. DataTransferKit is     *
+ * distributed under a BSD 3-clause license. For the licensing terms see    *
+ * the LICENSE file in the top-level directory.                             *
+ ****************************************************************************/
+
+#include <DTK_KdTree.hpp>
+#include <DTK_LinearBVH.hpp>
+
+#include <Teuchos_UnitTestHarness.hpp>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace details = DataTransferKit::Details;
+
+// Sort the results of each query so that they can be compared regardless of
+// the order in which they were found.
+std::vector<int> sortedResults( std::vector<int> indices,
+                                std::vector<int> const &offset )
+{
+    for ( size_t i = 0; i + 1 < offset.size(); ++i )
+        std::sort( indices.begin() + offset[i],
+                   indices.begin() + offset[i + 1] );
+    return indices;
+}
+
+template <typename T, typename DeviceType>
+std::vector<T> toVector( Kokkos::View<T *, DeviceType> v )
+{
+    auto v_host = Kokkos::create_mirror_view( v );
+    Kokkos::deep_copy( v_host, v );
+    return std::vector<T>( v_host.data(), v_host.data() + v_host.extent( 0 ) );
+}
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( KdTree, empty_and_single_point,
+                                   DeviceType )
+{
+    DataTransferKit::KdTree<DeviceType> empty_tree(
+        Kokkos::View<DataTransferKit::Point *, DeviceType>( "points", 0 ) );
+    TEST_ASSERT( empty_tree.empty() );
+
+    Kokkos::View<DataTransferKit::Point *, DeviceType> points( "points", 1 );
+    auto points_host = Kokkos::create_mirror_view( points );
+    points_host( 0 ) = {{1., 2., 3.}};
+    Kokkos::deep_copy( points, points_host );
+    DataTransferKit::KdTree<DeviceType> tree( points );
+    TEST_EQUALITY( tree.size(), 1 );
+    auto const bounds = tree.bounds();
+    TEST_EQUALITY( bounds[0], 1. );
+    TEST_EQUALITY( bounds[3], 2. );
+    TEST_EQUALITY( bounds[5], 3. );
+
+    Kokkos::View<details::Nearest *, DeviceType> nearest_queries( "queries",
+                                                                  1 );
+    Kokkos::View<details::Within *, DeviceType> within_queries( "queries", 2 );
+    auto nearest_queries_host = Kokkos::create_mirror_view( nearest_queries );
+    auto within_queries_host = Kokkos::create_mirror_view( within_queries );
+    nearest_queries_host( 0 ) =
+        details::nearest( DataTransferKit::Point( {{1., 2., 0.}} ), 2 );
+    within_queries_host( 0 ) =
+        details::within( DataTransferKit::Point( {{1., 2., 0.}} ), 2.5 );
+    within_queries_host( 1 ) =
+        details::within( DataTransferKit::Point( {{1., 2., 0.}} ), 3.5 );
+    Kokkos::deep_copy( nearest_queries, nearest_queries_host );
+    Kokkos::deep_copy( within_queries, within_queries_host );
+
+    Kokkos::View<int *, DeviceType> indices( "indices" );
+    Kokkos::View<int *, DeviceType> offset( "offset" );
+    Kokkos::View<double *, DeviceType> distances( "distances" );
+    empty_tree.query( nearest_queries, indices, offset );
+    TEST_COMPARE_ARRAYS( toVector( indices ), std::vector<int>( {-1, -1} ) );
+    empty_tree.query( within_queries, indices, offset );
+    TEST_COMPARE_ARRAYS( toVector( offset ), std::vector<int>( {0, 0, 0} ) );
+
+    tree.query( nearest_queries, indices, offset, distances );
+    TEST_COMPARE_ARRAYS( toVector( indices ), std::vector<int>( {0, -1} ) );
+    auto const distances_host = toVector( distances );
+    TEST_EQUALITY( distances_host[0], 3. );
+    tree.query( within_queries, indices, offset );
+    TEST_COMPARE_ARRAYS( toVector( indices ), std::vector<int>( {0} ) );
+    TEST_COMPARE_ARRAYS( toVector( offset ), std::vector<int>( {0, 0, 1} ) );
+
+    // more neighbors than the priority queue of the traversal can hold
+    nearest_queries_host( 0 ) =
+        details::nearest( DataTransferKit::Point( {{1., 2., 0.}} ), 257 );
+    Kokkos::deep_copy( nearest_queries, nearest_queries_host );
+    TEST_THROW( tree.query( nearest_queries, indices, offset ),
+                DataTransferKit::DataTransferKitException );
+}
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( KdTree, compare_with_bvh, DeviceType )
+{
+    // random points with a few duplicates and a flat region
+    int const n = 1000;
+    double const L = 10.;
+    std::default_random_engine generator( 4321 );
+    std::uniform_real_distribution<double> position( 0., L );
+    Kokkos::View<DataTransferKit::Point *, DeviceType> points( "points", n );
+    Kokkos::View<DataTransferKit::Box *, DeviceType> boxes( "boxes", n );
+    auto points_host = Kokkos::create_mirror_view( points );
+    auto boxes_host = Kokkos::create_mirror_view( boxes );
+    for ( int i = 0; i < n; ++i )
+    {
+        double const x = position( generator );
+        double const y = position( generator );
+        double const z = ( i % 10 == 0 ? 0. : position( generator ) );
+        points_host( i ) = {{x, y, z}};
+        if ( i % 100 == 1 )
+            points_host( i ) = points_host( i - 1 );
+        auto const &p = points_host( i );
+        boxes_host( i ) =
+            DataTransferKit::Box( {p[0], p[0], p[1], p[1], p[2], p[2]} );
+    }
+    Kokkos::deep_copy( points, points_host );
+    Kokkos::deep_copy( boxes, boxes_host );
+
+    DataTransferKit::KdTree<DeviceType> tree( points );
+    DataTransferKit::BVH<DeviceType> bvh( boxes );
+    TEST_EQUALITY( tree.size(), n );
+    for ( int d = 0; d < 6; ++d )
+        TEST_EQUALITY( tree.bounds()[d], bvh.bounds()[d] );
+
+    int const n_queries = 100;
+    std::uniform_real_distribution<double> query_position( -1., L + 1. );
+    Kokkos::View<details::Overlap *, DeviceType> overlap_queries(
+        "overlap_queries", n_queries );
+    Kokkos::View<details::Within *, DeviceType> within_queries(
+        "within_queries", n_queries );
+    Kokkos::View<details::Nearest *, DeviceType> nearest_queries(
+        "nearest_queries", n_queries );
+    auto overlap_queries_host = Kokkos::create_mirror_view( overlap_queries );
+    auto within_queries_host = Kokkos::create_mirror_view( within_queries );
+    auto nearest_queries_host = Kokkos::create_mirror_view( nearest_queries );
+    for ( int i = 0; i < n_queries; ++i )
+    {
+        double const x = query_position( generator );
+        double const y = query_position( generator );
+        double const z = query_position( generator );
+        overlap_queries_host( i ) = details::overlap(
+            DataTransferKit::Box( {x, x + 2., y, y + 1., z - 1., z} ) );
+        within_queries_host( i ) =
+            details::within( DataTransferKit::Point( {{x, y, z}} ), 1.5 );
+        nearest_queries_host( i ) = details::nearest(
+            DataTransferKit::Point( {{x, y, z}} ), 1 + i % 10 );
+    }
+    Kokkos::deep_copy( overlap_queries, overlap_queries_host );
+    Kokkos::deep_copy( within_queries, within_queries_host );
+    Kokkos::deep_copy( nearest_queries, nearest_queries_host );
+
+    Kokkos::View<int *, DeviceType> indices( "indices" );
+    Kokkos::View<int *, DeviceType> offset( "offset" );
+    Kokkos::View<int *, DeviceType> indices_ref( "indices_ref" );
+    Kokkos::View<int *, DeviceType> offset_ref( "offset_ref" );
+
+    tree.query( overlap_queries, indices, offset );
+    bvh.query( overlap_queries, indices_ref, offset_ref );
+    TEST_COMPARE_ARRAYS( toVector( offset ), toVector( offset_ref ) );
+    TEST_COMPARE_ARRAYS(
+        sortedResults( toVector( indices ), toVector( offset ) ),
+        sortedResults( toVector( indices_ref ), toVector( offset_ref ) ) );
+
+    tree.query( within_queries, indices, offset );
+    bvh.query( within_queries, indices_ref, offset_ref );
+    TEST_COMPARE_ARRAYS( toVector( offset ), toVector( offset_ref ) );
+    TEST_COMPARE_ARRAYS(
+        sortedResults( toVector( indices ), toVector( offset ) ),
+        sortedResults( toVector( indices_ref ), toVector( offset_ref ) ) );
+
+    // distances are compared rather than indices because of the duplicates
+    Kokkos::View<double *, DeviceType> distances( "distances" );
+    Kokkos::View<double *, DeviceType> distances_ref( "distances_ref" );
+    tree.query( nearest_queries, indices, offset, distances );
+    bvh.query( nearest_queries, indices_ref, offset_ref, distances_ref );
+    TEST_COMPARE_ARRAYS( toVector( offset ), toVector( offset_ref ) );
+    TEST_COMPARE_FLOATING_ARRAYS( toVector( distances ),
+                                  toVector( distances_ref ), 1e-14 );
+}
+
+// Include the test macros.
+#include "DataTransferKitSearch_ETIHelperMacros.h"
+
+// Create the test group
+#define UNIT_TEST_GROUP( NODE )                                                \
+    using DeviceType##NODE = typename NODE::device_type;                       \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( KdTree, empty_and_single_point,      \
+                                          DeviceType##NODE )                   \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( KdTree, compare_with_bvh,            \
+                                          DeviceType##NODE )
+
+// Demangle the types
+DTK_ETI_MANGLING_TYPEDEFS()
+
+// Instantiate the tests
+DTK_INSTANTIATE_N( UNIT_TEST_GROUP )
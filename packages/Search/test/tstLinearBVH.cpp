@@ -15,9 +15,17 @@
 
 #include <algorithm>
 #include <bitset>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <random>
+#include <sstream>
+#include <string>
 #include <tuple>
+#include <vector>
 
 namespace details = DataTransferKit::Details;
 
@@ -278,6 +286,238 @@ TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( LinearBVH, empty, DeviceType )
     TEST_ASSERT( !details::TreeTraversal<DeviceType>::getRoot( empty_bvh ) );
 }
 
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( LinearBVH, tree_quality, DeviceType )
+{
+    using DataTransferKit::Box;
+    using DataTransferKit::Node;
+
+    DataTransferKit::BVH<DeviceType> empty_bvh(
+        Kokkos::View<Box *, DeviceType>( "boxes", 0 ) );
+    TEST_EQUALITY( empty_bvh.sahCost(), 0. );
+    TEST_EQUALITY( empty_bvh.leafDepth().max_depth, 0 );
+    TEST_EQUALITY( empty_bvh.siblingOverlapVolume(), 0. );
+    TEST_EQUALITY( empty_bvh.memoryUsage(), 0 );
+
+    // eight unit cubes along the x-axis that only touch each other yield a
+    // perfectly balanced hierarchy without any overlap between siblings
+    int const n = 8;
+    Kokkos::View<Box *, DeviceType> boxes( "boxes", n );
+    auto boxes_host = Kokkos::create_mirror_view( boxes );
+    for ( int i = 0; i < n; ++i )
+        boxes_host( i ) = Box( {(double)i, (double)i + 1., 0., 1., 0., 1.} );
+    Kokkos::deep_copy( boxes, boxes_host );
+    // a threshold of zero forces the construction of the hierarchy
+    DataTransferKit::BVH<DeviceType> bvh( boxes, 0 );
+    auto const depth = bvh.leafDepth();
+    TEST_EQUALITY( depth.min_depth, 3 );
+    TEST_EQUALITY( depth.max_depth, 3 );
+    TEST_EQUALITY( depth.average_depth, 3. );
+    TEST_EQUALITY( bvh.siblingOverlapVolume(), 0. );
+    // surface areas are 34 for the root, 18 for its children, 10 for their
+    // children, and 6 for the leaves
+    TEST_FLOATING_EQUALITY( bvh.sahCost(),
+                            ( 34. + 2 * 18. + 4 * 10. + 8 * 6. ) / 34.,
+                            1e-14 );
+    TEST_EQUALITY( bvh.memoryUsage(),
+                   ( 2 * n - 1 ) * sizeof( Node ) + n * sizeof( int ) );
+
+    // two overlapping boxes
+    Kokkos::realloc( boxes, 2 );
+    boxes_host = Kokkos::create_mirror_view( boxes );
+    boxes_host( 0 ) = Box( {0., 2., 0., 2., 0., 2.} );
+    boxes_host( 1 ) = Box( {1., 3., 1., 3., 1., 3.} );
+    Kokkos::deep_copy( boxes, boxes_host );
+    DataTransferKit::BVH<DeviceType> overlapping_bvh( boxes, 0 );
+    TEST_EQUALITY( overlapping_bvh.siblingOverlapVolume(), 1. );
+    TEST_EQUALITY( overlapping_bvh.leafDepth().average_depth, 1. );
+
+    // a single leaf
+    Kokkos::realloc( boxes, 1 );
+    boxes_host = Kokkos::create_mirror_view( boxes );
+    boxes_host( 0 ) = Box( {0., 2., 0., 2., 0., 2.} );
+    Kokkos::deep_copy( boxes, boxes_host );
+    DataTransferKit::BVH<DeviceType> leaf_bvh( boxes );
+    TEST_EQUALITY( leaf_bvh.sahCost(), 1. );
+    TEST_EQUALITY( leaf_bvh.leafDepth().max_depth, 0 );
+    TEST_EQUALITY( leaf_bvh.siblingOverlapVolume(), 0. );
+}
+
+#if HAVE_DTK_TRAVERSAL_STATISTICS
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( LinearBVH, traversal_statistics,
+                                   DeviceType )
+{
+    // unit boxes along the x-axis
+    int const n = 10;
+    Kokkos::View<DataTransferKit::Box *, DeviceType> boxes( "boxes", n );
+    auto boxes_host = Kokkos::create_mirror_view( boxes );
+    for ( int i = 0; i < n; ++i )
+        boxes_host( i ) = DataTransferKit::Box(
+            {(double)i, (double)i + 1., 0., 1., 0., 1.} );
+    Kokkos::deep_copy( boxes, boxes_host );
+    DataTransferKit::BVH<DeviceType> bvh( boxes, 0 );
+
+    // one query overlapping with all the boxes and one with none of them
+    Kokkos::View<details::Overlap *, DeviceType> queries( "queries", 2 );
+    auto queries_host = Kokkos::create_mirror_view( queries );
+    queries_host( 0 ) = details::Overlap(
+        DataTransferKit::Box( {-1., (double)n + 1., 0., 1., 0., 1.} ) );
+    queries_host( 1 ) =
+        details::Overlap( DataTransferKit::Box( {0., 10., 5., 6., 5., 6.} ) );
+    Kokkos::deep_copy( queries, queries_host );
+
+    Kokkos::View<int *, DeviceType> indices( "indices" );
+    Kokkos::View<int *, DeviceType> offset( "offset" );
+    details::TraversalStatistics statistics;
+    bvh.query( queries, indices, offset, statistics );
+    TEST_EQUALITY( indices.extent( 0 ), n );
+    TEST_EQUALITY( statistics.nodes_visited.count, 2 );
+    // the whole hierarchy is traversed for the first query and only the root
+    // for the second one
+    TEST_EQUALITY( statistics.nodes_visited.max, 2 * n - 1 );
+    TEST_EQUALITY( statistics.nodes_visited.min, 1 );
+    TEST_EQUALITY( statistics.leaves_tested.max, n );
+    TEST_ASSERT( statistics.max_depth.max >= 1 );
+
+    Kokkos::View<details::Nearest *, DeviceType> nearest_queries(
+        "nearest_queries", 1 );
+    auto nearest_queries_host = Kokkos::create_mirror_view( nearest_queries );
+    nearest_queries_host( 0 ) =
+        details::nearest( DataTransferKit::Point( {{0.5, 0.5, 0.5}} ), 1 );
+    Kokkos::deep_copy( nearest_queries, nearest_queries_host );
+    bvh.query( nearest_queries, indices, offset, statistics );
+    TEST_EQUALITY( indices.extent( 0 ), 1 );
+    TEST_EQUALITY( statistics.nodes_visited.count, 1 );
+    TEST_ASSERT( statistics.leaves_tested.min >= 1 );
+    TEST_ASSERT( statistics.nodes_visited.max < 2 * n - 1 );
+}
+#endif
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( LinearBVH, sorted_input, DeviceType )
+{
+    // Objects along the diagonal of the scene come in Z-order, the sort is
+    // skipped when constructing the hierarchy.  Compare with the same
+    // objects in reverse order.
+    using ExecutionSpace = typename DeviceType::execution_space;
+    int const n = 1000;
+    Kokkos::View<DataTransferKit::Box *, DeviceType> sorted_boxes(
+        "sorted_boxes", n );
+    Kokkos::View<DataTransferKit::Box *, DeviceType> reversed_boxes(
+        "reversed_boxes", n );
+    Kokkos::View<details::Overlap *, DeviceType> queries( "queries", n );
+    Kokkos::parallel_for(
+        "fill_bounding_boxes", Kokkos::RangePolicy<ExecutionSpace>( 0, n ),
+        KOKKOS_LAMBDA( int i ) {
+            double const x = i;
+            sorted_boxes( i ) = {x, x + .75, x, x + .75, x, x + .75};
+            reversed_boxes( n - 1 - i ) = sorted_boxes( i );
+            queries( i ) = details::overlap( sorted_boxes( i ) );
+        } );
+    Kokkos::fence();
+
+    for ( int threshold : {0, 2 * n} )
+    {
+        DataTransferKit::BVH<DeviceType> sorted_bvh( sorted_boxes, threshold );
+        DataTransferKit::BVH<DeviceType> reversed_bvh( reversed_boxes,
+                                                       threshold );
+        TEST_EQUALITY( sorted_bvh.sahCost(), reversed_bvh.sahCost() );
+
+        Kokkos::View<int *, DeviceType> indices( "indices" );
+        Kokkos::View<int *, DeviceType> offset( "offset" );
+        sorted_bvh.query( queries, indices, offset );
+        auto indices_host = Kokkos::create_mirror_view( indices );
+        Kokkos::deep_copy( indices_host, indices );
+        auto offset_host = Kokkos::create_mirror_view( offset );
+        Kokkos::deep_copy( offset_host, offset );
+        reversed_bvh.query( queries, indices, offset );
+        auto reversed_indices_host = Kokkos::create_mirror_view( indices );
+        Kokkos::deep_copy( reversed_indices_host, indices );
+        TEST_EQUALITY( indices_host.extent( 0 ), n );
+        TEST_EQUALITY( reversed_indices_host.extent( 0 ), n );
+        for ( int i = 0; i < n; ++i )
+        {
+            TEST_EQUALITY( offset_host( i ), i );
+            TEST_EQUALITY( indices_host( i ), i );
+            TEST_EQUALITY( reversed_indices_host( i ), n - 1 - i );
+        }
+    }
+}
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( LinearBVH, hilbert_curve, DeviceType )
+{
+    // the order of the leaves must not change the results
+    int const n = 500;
+    std::default_random_engine generator( 4321 );
+    std::uniform_real_distribution<double> position( 0., 10. );
+    Kokkos::View<DataTransferKit::Box *, DeviceType> boxes( "boxes", n );
+    auto boxes_host = Kokkos::create_mirror_view( boxes );
+    for ( int i = 0; i < n; ++i )
+    {
+        double const x = position( generator );
+        double const y = position( generator );
+        double const z = position( generator );
+        boxes_host( i ) = {x, x + .5, y, y + .5, z, z + .5};
+    }
+    Kokkos::deep_copy( boxes, boxes_host );
+
+    int const n_queries = 100;
+    Kokkos::View<details::Within *, DeviceType> within_queries(
+        "within_queries", n_queries );
+    Kokkos::View<details::Nearest *, DeviceType> nearest_queries(
+        "nearest_queries", n_queries );
+    auto within_queries_host = Kokkos::create_mirror_view( within_queries );
+    auto nearest_queries_host = Kokkos::create_mirror_view( nearest_queries );
+    for ( int i = 0; i < n_queries; ++i )
+    {
+        DataTransferKit::Point const p = {
+            {position( generator ), position( generator ),
+             position( generator )}};
+        within_queries_host( i ) = details::within( p, 1. );
+        nearest_queries_host( i ) = details::nearest( p, 5 );
+    }
+    Kokkos::deep_copy( within_queries, within_queries_host );
+    Kokkos::deep_copy( nearest_queries, nearest_queries_host );
+
+    DataTransferKit::BVH<DeviceType> morton_bvh( boxes, 0 );
+    DataTransferKit::BVH<DeviceType> hilbert_bvh(
+        boxes, 0, DataTransferKit::SpaceFillingCurve::Hilbert );
+    TEST_EQUALITY( hilbert_bvh.size(), n );
+    for ( int d = 0; d < 6; ++d )
+        TEST_EQUALITY( hilbert_bvh.bounds()[d], morton_bvh.bounds()[d] );
+
+    std::vector<std::vector<int>> within_results[2];
+    std::vector<double> nearest_distances[2];
+    int b = 0;
+    for ( auto const &bvh : {morton_bvh, hilbert_bvh} )
+    {
+        Kokkos::View<int *, DeviceType> indices( "indices" );
+        Kokkos::View<int *, DeviceType> offset( "offset" );
+        Kokkos::View<double *, DeviceType> distances( "distances" );
+        bvh.query( within_queries, indices, offset );
+        auto indices_host = Kokkos::create_mirror_view( indices );
+        Kokkos::deep_copy( indices_host, indices );
+        auto offset_host = Kokkos::create_mirror_view( offset );
+        Kokkos::deep_copy( offset_host, offset );
+        for ( int i = 0; i < n_queries; ++i )
+        {
+            std::vector<int> found( indices_host.data() + offset_host( i ),
+                                    indices_host.data() +
+                                        offset_host( i + 1 ) );
+            std::sort( found.begin(), found.end() );
+            within_results[b].push_back( found );
+        }
+        bvh.query( nearest_queries, indices, offset, distances );
+        auto distances_host = Kokkos::create_mirror_view( distances );
+        Kokkos::deep_copy( distances_host, distances );
+        nearest_distances[b].assign( distances_host.data(),
+                                     distances_host.data() +
+                                         distances_host.extent( 0 ) );
+        ++b;
+    }
+    for ( int i = 0; i < n_queries; ++i )
+        TEST_COMPARE_ARRAYS( within_results[1][i], within_results[0][i] );
+    TEST_COMPARE_ARRAYS( nearest_distances[1], nearest_distances[0] );
+}
+
 TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( LinearBVH, structured_grid, DeviceType )
 {
     double Lx = 100.0;
@@ -720,9 +960,850 @@ TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( LinearBVH, rtree, DeviceType )
     }
 }
 
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( LinearBVH, nearest_queries_warm_start,
+                                   DeviceType )
+{
+    // contruct a cloud of points (nodes of a structured grid)
+    double Lx = 10.0;
+    double Ly = 10.0;
+    double Lz = 10.0;
+    int nx = 11;
+    int ny = 11;
+    int nz = 11;
+    auto cloud = make_stuctured_cloud( Lx, Ly, Lz, nx, ny, nz );
+    int n = cloud.size();
+
+    Kokkos::View<DataTransferKit::Box *, DeviceType> bounding_boxes(
+        "bounding_boxes", n );
+    auto bounding_boxes_host = Kokkos::create_mirror_view( bounding_boxes );
+    for ( int i = 0; i < n; ++i )
+    {
+        auto const &point = cloud[i];
+        double x = std::get<0>( point );
+        double y = std::get<1>( point );
+        double z = std::get<2>( point );
+        bounding_boxes_host[i] = {
+            x, x, y, y, z, z,
+        };
+    }
+    Kokkos::deep_copy( bounding_boxes, bounding_boxes_host );
+
+    DataTransferKit::BVH<DeviceType> bvh( bounding_boxes );
+
+    // search for the nearest neighbors of random points and then move the
+    // points slightly
+    int const n_points = 100;
+    int const k = 5;
+    auto points = make_random_cloud( Lx, Ly, Lz, n_points );
+    Kokkos::View<details::Nearest *, DeviceType> queries( "queries",
+                                                          n_points );
+    auto queries_host = Kokkos::create_mirror_view( queries );
+    for ( int i = 0; i < n_points; ++i )
+        queries_host( i ) = details::nearest(
+            {{points[i][0], points[i][1], points[i][2]}}, k );
+    Kokkos::deep_copy( queries, queries_host );
+
+    Kokkos::View<int *, DeviceType> indices( "indices" );
+    Kokkos::View<int *, DeviceType> offset( "offset" );
+    bvh.query( queries, indices, offset );
+
+    for ( int i = 0; i < n_points; ++i )
+        queries_host( i ) = details::nearest(
+            {{points[i][0] + 0.1, points[i][1] - 0.2, points[i][2] + 0.3}},
+            k );
+    Kokkos::deep_copy( queries, queries_host );
+
+    // reference solution without warm start
+    Kokkos::View<int *, DeviceType> indices_ref( "indices_ref" );
+    Kokkos::View<int *, DeviceType> offset_ref( "offset_ref" );
+    Kokkos::View<double *, DeviceType> distances_ref( "distances_ref" );
+    bvh.query( queries, indices_ref, offset_ref, distances_ref );
+
+    // passing the same views for the previous and the new results is allowed
+    std::size_t const memory_usage = bvh.memoryUsage();
+    Kokkos::View<double *, DeviceType> distances( "distances" );
+    bvh.query( queries, indices, offset, distances, indices, offset );
+
+    auto offset_host = Kokkos::create_mirror_view( offset );
+    Kokkos::deep_copy( offset_host, offset );
+    auto offset_ref_host = Kokkos::create_mirror_view( offset_ref );
+    Kokkos::deep_copy( offset_ref_host, offset_ref );
+    TEST_COMPARE_ARRAYS( offset_host, offset_ref_host );
+
+    auto distances_host = Kokkos::create_mirror_view( distances );
+    Kokkos::deep_copy( distances_host, distances );
+    auto distances_ref_host = Kokkos::create_mirror_view( distances_ref );
+    Kokkos::deep_copy( distances_ref_host, distances_ref );
+    TEST_COMPARE_ARRAYS( distances_host, distances_ref_host );
+
+    // previous results that do not contain enough valid objects do not allow
+    // to prune and must still give the right answer
+    Kokkos::View<int *, DeviceType> invalid_indices( "invalid_indices",
+                                                     n_points * k );
+    DataTransferKit::fill( invalid_indices, -1 );
+    bvh.query( queries, indices, offset, distances, invalid_indices,
+               offset_ref );
+    Kokkos::deep_copy( distances_host, distances );
+    TEST_COMPARE_ARRAYS( distances_host, distances_ref_host );
+
+    // the positions of the objects among the leaves are kept after the first
+    // warm-started search
+    TEST_EQUALITY( bvh.memoryUsage(), memory_usage + n * sizeof( int ) );
+}
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( LinearBVH, brute_force, DeviceType )
+{
+    // few objects so that the hierarchy is not built by default
+    double const L = 10.;
+    int const n = 100;
+    auto cloud = make_random_cloud( L, L, L, n );
+    Kokkos::View<DataTransferKit::Box *, DeviceType> boxes( "boxes", n );
+    auto boxes_host = Kokkos::create_mirror_view( boxes );
+    for ( int i = 0; i < n; ++i )
+    {
+        double const x = cloud[i][0];
+        double const y = cloud[i][1];
+        double const z = cloud[i][2];
+        double const h = ( i % 3 == 0 ? 0. : 0.5 );
+        boxes_host( i ) = {x, x + h, y, y + h, z, z + h};
+    }
+    Kokkos::deep_copy( boxes, boxes_host );
+
+    DataTransferKit::BVH<DeviceType> brute_force_bvh( boxes );
+    DataTransferKit::BVH<DeviceType> bvh( boxes, 0 );
+    TEST_EQUALITY( brute_force_bvh.size(), n );
+    for ( int d = 0; d < 6; ++d )
+        TEST_EQUALITY( brute_force_bvh.bounds()[d], bvh.bounds()[d] );
+    TEST_EQUALITY( brute_force_bvh.sahCost(), n );
+    TEST_EQUALITY( brute_force_bvh.leafDepth().max_depth, 1 );
+    TEST_EQUALITY( brute_force_bvh.siblingOverlapVolume(), 0. );
+
+    int const n_queries = 20;
+    auto points = make_random_cloud( L, L, L, n_queries );
+    Kokkos::View<details::Overlap *, DeviceType> overlap_queries(
+        "overlap_queries", n_queries );
+    Kokkos::View<details::Within *, DeviceType> within_queries(
+        "within_queries", n_queries );
+    Kokkos::View<details::Nearest *, DeviceType> nearest_queries(
+        "nearest_queries", n_queries );
+    auto overlap_queries_host = Kokkos::create_mirror_view( overlap_queries );
+    auto within_queries_host = Kokkos::create_mirror_view( within_queries );
+    auto nearest_queries_host = Kokkos::create_mirror_view( nearest_queries );
+    for ( int i = 0; i < n_queries; ++i )
+    {
+        double const x = points[i][0];
+        double const y = points[i][1];
+        double const z = points[i][2];
+        overlap_queries_host( i ) = details::overlap(
+            DataTransferKit::Box( {x - 1., x + 1., y - 2., y, z, z + 3.} ) );
+        within_queries_host( i ) =
+            details::within( DataTransferKit::Point( {{x, y, z}} ), 2. );
+        // more neighbors than objects for the last query
+        nearest_queries_host( i ) = details::nearest(
+            DataTransferKit::Point( {{x, y, z}} ),
+            i + 1 < n_queries ? 1 + i % 7 : n + 2 );
+    }
+    Kokkos::deep_copy( overlap_queries, overlap_queries_host );
+    Kokkos::deep_copy( within_queries, within_queries_host );
+    Kokkos::deep_copy( nearest_queries, nearest_queries_host );
+
+    Kokkos::View<int *, DeviceType> indices( "indices" );
+    Kokkos::View<int *, DeviceType> offset( "offset" );
+    Kokkos::View<int *, DeviceType> indices_ref( "indices_ref" );
+    Kokkos::View<int *, DeviceType> offset_ref( "offset_ref" );
+    auto check_spatial_results = [&]() {
+        auto offset_host = Kokkos::create_mirror_view( offset );
+        auto offset_ref_host = Kokkos::create_mirror_view( offset_ref );
+        auto indices_host = Kokkos::create_mirror_view( indices );
+        auto indices_ref_host = Kokkos::create_mirror_view( indices_ref );
+        Kokkos::deep_copy( offset_host, offset );
+        Kokkos::deep_copy( offset_ref_host, offset_ref );
+        Kokkos::deep_copy( indices_host, indices );
+        Kokkos::deep_copy( indices_ref_host, indices_ref );
+        TEST_COMPARE_ARRAYS( offset_host, offset_ref_host );
+        // the order in which the objects are found differs
+        for ( int i = 0; i < n_queries; ++i )
+        {
+            std::sort( indices_host.data() + offset_host( i ),
+                       indices_host.data() + offset_host( i + 1 ) );
+            std::sort( indices_ref_host.data() + offset_host( i ),
+                       indices_ref_host.data() + offset_host( i + 1 ) );
+        }
+        TEST_COMPARE_ARRAYS( indices_host, indices_ref_host );
+    };
+
+    brute_force_bvh.query( overlap_queries, indices, offset );
+    bvh.query( overlap_queries, indices_ref, offset_ref );
+    check_spatial_results();
+
+    brute_force_bvh.query( within_queries, indices, offset );
+    bvh.query( within_queries, indices_ref, offset_ref );
+    check_spatial_results();
+
+    // nearest neighbors are sorted by distance in both cases, distances are
+    // compared rather than indices since query points may lie inside several
+    // boxes
+    Kokkos::View<double *, DeviceType> distances( "distances" );
+    Kokkos::View<double *, DeviceType> distances_ref( "distances_ref" );
+    brute_force_bvh.query( nearest_queries, indices, offset, distances );
+    bvh.query( nearest_queries, indices_ref, offset_ref, distances_ref );
+    auto offset_host = Kokkos::create_mirror_view( offset );
+    auto offset_ref_host = Kokkos::create_mirror_view( offset_ref );
+    auto distances_host = Kokkos::create_mirror_view( distances );
+    auto distances_ref_host = Kokkos::create_mirror_view( distances_ref );
+    Kokkos::deep_copy( offset_host, offset );
+    Kokkos::deep_copy( offset_ref_host, offset_ref );
+    Kokkos::deep_copy( distances_host, distances );
+    Kokkos::deep_copy( distances_ref_host, distances_ref );
+    TEST_COMPARE_ARRAYS( offset_host, offset_ref_host );
+    TEST_COMPARE_ARRAYS( distances_host, distances_ref_host );
+    // unused slots are padded with -1
+    auto indices_host = Kokkos::create_mirror_view( indices );
+    Kokkos::deep_copy( indices_host, indices );
+    TEST_EQUALITY( indices_host( offset_host( n_queries ) - 1 ), -1 );
+    TEST_ASSERT( indices_host( offset_host( n_queries - 1 ) + n - 1 ) >= 0 );
+
+    // warm start works as well
+    brute_force_bvh.query( nearest_queries, indices, offset, distances,
+                           indices, offset );
+    Kokkos::deep_copy( distances_host, distances );
+    TEST_COMPARE_ARRAYS( distances_host, distances_ref_host );
+}
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( LinearBVH, brute_force_many_neighbors,
+                                   DeviceType )
+{
+    // points on a line with ties in distance to the query point, and more
+    // neighbors requested than the nearest search collects in a single scan
+    int const n = 300;
+    Kokkos::View<DataTransferKit::Box *, DeviceType> boxes( "boxes", n );
+    auto boxes_host = Kokkos::create_mirror_view( boxes );
+    for ( int i = 0; i < n; ++i )
+    {
+        double const x = i / 2;
+        boxes_host( i ) = {x, x, 0., 0., 0., 0.};
+    }
+    Kokkos::deep_copy( boxes, boxes_host );
+    DataTransferKit::BVH<DeviceType> bvh( boxes, n );
+
+    Kokkos::View<details::Nearest *, DeviceType> queries( "queries", 1 );
+    auto queries_host = Kokkos::create_mirror_view( queries );
+    queries_host( 0 ) =
+        details::nearest( DataTransferKit::Point( {{-1., 0., 0.}} ), n );
+    Kokkos::deep_copy( queries, queries_host );
+
+    Kokkos::View<int *, DeviceType> indices( "indices" );
+    Kokkos::View<int *, DeviceType> offset( "offset" );
+    Kokkos::View<double *, DeviceType> distances( "distances" );
+    bvh.query( queries, indices, offset, distances );
+    auto indices_host = Kokkos::create_mirror_view( indices );
+    auto distances_host = Kokkos::create_mirror_view( distances );
+    Kokkos::deep_copy( indices_host, indices );
+    Kokkos::deep_copy( distances_host, distances );
+    TEST_EQUALITY( indices_host.extent( 0 ), n );
+    // ties are reported in the order of the objects
+    for ( int i = 0; i < n; ++i )
+    {
+        TEST_EQUALITY( indices_host( i ), i );
+        TEST_EQUALITY( distances_host( i ), i / 2 + 1. );
+    }
+}
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( LinearBVH, periodic, DeviceType )
+{
+    using DataTransferKit::Box;
+    using DataTransferKit::Periodicity;
+
+    double const L = 10.;
+    int const n = 200;
+    auto cloud = make_random_cloud( L, L, L, n );
+    Kokkos::View<Box *, DeviceType> boxes( "boxes", n );
+    auto boxes_host = Kokkos::create_mirror_view( boxes );
+    for ( int i = 0; i < n; ++i )
+        boxes_host( i ) = {cloud[i][0], cloud[i][0] + 0.1, cloud[i][1],
+                           cloud[i][1], cloud[i][2], cloud[i][2]};
+    Kokkos::deep_copy( boxes, boxes_host );
+    DataTransferKit::BVH<DeviceType> bvh( boxes );
+
+    // queries close to the faces of the domain
+    int const n_queries = 30;
+    auto points = make_random_cloud( L, L, L, n_queries );
+    Kokkos::View<details::Within *, DeviceType> within_queries(
+        "within_queries", n_queries );
+    Kokkos::View<details::Overlap *, DeviceType> overlap_queries(
+        "overlap_queries", n_queries );
+    Kokkos::View<details::Nearest *, DeviceType> nearest_queries(
+        "nearest_queries", n_queries );
+    auto within_queries_host = Kokkos::create_mirror_view( within_queries );
+    auto overlap_queries_host = Kokkos::create_mirror_view( overlap_queries );
+    auto nearest_queries_host = Kokkos::create_mirror_view( nearest_queries );
+    for ( int i = 0; i < n_queries; ++i )
+    {
+        double const x = ( i % 2 == 0 ? 0.1 * points[i][0] : L - 0.2 );
+        double const y = points[i][1];
+        double const z = ( i % 3 == 0 ? 0.2 : points[i][2] );
+        within_queries_host( i ) =
+            details::within( DataTransferKit::Point( {{x, y, z}} ), 1.5 );
+        overlap_queries_host( i ) = details::overlap(
+            Box( {x - 1., x + 1., y - 1., y + 1., z - 1., z + 1.} ) );
+        nearest_queries_host( i ) =
+            details::nearest( DataTransferKit::Point( {{x, y, z}} ), 5 );
+    }
+    Kokkos::deep_copy( within_queries, within_queries_host );
+    Kokkos::deep_copy( overlap_queries, overlap_queries_host );
+    Kokkos::deep_copy( nearest_queries, nearest_queries_host );
+
+    for ( auto const &periodicity :
+          {Periodicity( L, L, L ), Periodicity( L, 0., 0. ), Periodicity()} )
+    {
+        // reference: a hierarchy with explicit copies of the objects for
+        // every active image
+        std::vector<int> active_images;
+        for ( int image = 0; image < Periodicity::n_images; ++image )
+            if ( periodicity.isActive( image ) )
+                active_images.push_back( image );
+        int const n_copies = active_images.size();
+        Kokkos::View<Box *, DeviceType> copies( "copies", n * n_copies );
+        auto copies_host = Kokkos::create_mirror_view( copies );
+        for ( int c = 0; c < n_copies; ++c )
+        {
+            auto const shift = periodicity.shift( active_images[c] );
+            for ( int i = 0; i < n; ++i )
+                for ( int d = 0; d < 3; ++d )
+                {
+                    copies_host( c * n + i )[2 * d + 0] =
+                        boxes_host( i )[2 * d + 0] + shift[d];
+                    copies_host( c * n + i )[2 * d + 1] =
+                        boxes_host( i )[2 * d + 1] + shift[d];
+                }
+        }
+        Kokkos::deep_copy( copies, copies_host );
+        DataTransferKit::BVH<DeviceType> bvh_ref( copies );
+
+        Kokkos::View<int *, DeviceType> indices( "indices" );
+        Kokkos::View<int *, DeviceType> offset( "offset" );
+        Kokkos::View<int *, DeviceType> images( "images" );
+        Kokkos::View<int *, DeviceType> indices_ref( "indices_ref" );
+        Kokkos::View<int *, DeviceType> offset_ref( "offset_ref" );
+
+        // compare (image, index) pairs sorted for each query
+        auto check_spatial_results = [&]() {
+            auto offset_host = Kokkos::create_mirror_view( offset );
+            auto indices_host = Kokkos::create_mirror_view( indices );
+            auto images_host = Kokkos::create_mirror_view( images );
+            auto offset_ref_host = Kokkos::create_mirror_view( offset_ref );
+            auto indices_ref_host = Kokkos::create_mirror_view( indices_ref );
+            Kokkos::deep_copy( offset_host, offset );
+            Kokkos::deep_copy( indices_host, indices );
+            Kokkos::deep_copy( images_host, images );
+            Kokkos::deep_copy( offset_ref_host, offset_ref );
+            Kokkos::deep_copy( indices_ref_host, indices_ref );
+            TEST_COMPARE_ARRAYS( offset_host, offset_ref_host );
+            for ( int i = 0; i < n_queries; ++i )
+            {
+                std::vector<std::pair<int, int>> results;
+                std::vector<std::pair<int, int>> results_ref;
+                for ( int j = offset_host( i ); j < offset_host( i + 1 ); ++j )
+                {
+                    results.emplace_back( images_host( j ), indices_host( j ) );
+                    int const c = indices_ref_host( j ) / n;
+                    results_ref.emplace_back( active_images[c],
+                                              indices_ref_host( j ) % n );
+                }
+                std::sort( results.begin(), results.end() );
+                std::sort( results_ref.begin(), results_ref.end() );
+                TEST_ASSERT( results == results_ref );
+            }
+        };
+
+        bvh.query( within_queries, periodicity, indices, offset, images );
+        bvh_ref.query( within_queries, indices_ref, offset_ref );
+        check_spatial_results();
+
+        bvh.query( overlap_queries, periodicity, indices, offset, images );
+        bvh_ref.query( overlap_queries, indices_ref, offset_ref );
+        check_spatial_results();
+
+        Kokkos::View<double *, DeviceType> distances( "distances" );
+        Kokkos::View<double *, DeviceType> distances_ref( "distances_ref" );
+        bvh.query( nearest_queries, periodicity, indices, offset, images,
+                   distances );
+        bvh_ref.query( nearest_queries, indices_ref, offset_ref,
+                       distances_ref );
+        auto distances_host = Kokkos::create_mirror_view( distances );
+        auto distances_ref_host = Kokkos::create_mirror_view( distances_ref );
+        Kokkos::deep_copy( distances_host, distances );
+        Kokkos::deep_copy( distances_ref_host, distances_ref );
+        TEST_COMPARE_FLOATING_ARRAYS( distances_host, distances_ref_host,
+                                      1e-14 );
+
+        // the distance to the reported image is the one returned
+        auto indices_host = Kokkos::create_mirror_view( indices );
+        auto images_host = Kokkos::create_mirror_view( images );
+        Kokkos::deep_copy( indices_host, indices );
+        Kokkos::deep_copy( images_host, images );
+        for ( int i = 0; i < n_queries; ++i )
+            for ( int j = 0; j < 5; ++j )
+            {
+                int const index = indices_host( 5 * i + j );
+                auto const shift =
+                    periodicity.shift( images_host( 5 * i + j ) );
+                Box box = boxes_host( index );
+                for ( int d = 0; d < 3; ++d )
+                {
+                    box[2 * d + 0] += shift[d];
+                    box[2 * d + 1] += shift[d];
+                }
+                TEST_FLOATING_EQUALITY(
+                    details::distance(
+                        nearest_queries_host( i )._query_point, box ),
+                    distances_host( 5 * i + j ), 1e-14 );
+            }
+    }
+}
+
+KOKKOS_INLINE_FUNCTION
+double sphereDistance( DataTransferKit::Point const &center, double radius,
+                       DataTransferKit::Point const &p )
+{
+    double distance_squared = 0.;
+    for ( int d = 0; d < 3; ++d )
+        distance_squared += ( p[d] - center[d] ) * ( p[d] - center[d] );
+    double const distance = std::sqrt( distance_squared ) - radius;
+    return distance > 0. ? distance : 0.;
+}
+
+// Exact distance to spheres that are stored in the hierarchy through their
+// bounding boxes.
+template <typename DeviceType>
+struct SphereDistance
+{
+    Kokkos::View<DataTransferKit::Point *, DeviceType> centers;
+    Kokkos::View<double *, DeviceType> radii;
+
+    KOKKOS_INLINE_FUNCTION
+    double operator()( int i, DataTransferKit::Point const &p ) const
+    {
+        return sphereDistance( centers( i ), radii( i ), p );
+    }
+};
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( LinearBVH, exact_distances, DeviceType )
+{
+    using DataTransferKit::Box;
+    using DataTransferKit::Point;
+
+    // a few large spheres among many small ones so that the distances to the
+    // bounding boxes are often misleading
+    double const L = 10.;
+    int const n = 300;
+    auto cloud = make_random_cloud( L, L, L, n );
+    SphereDistance<DeviceType> geometry;
+    geometry.centers =
+        Kokkos::View<Point *, DeviceType>( "centers", n + 2 );
+    geometry.radii = Kokkos::View<double *, DeviceType>( "radii", n + 2 );
+    auto centers_host = Kokkos::create_mirror_view( geometry.centers );
+    auto radii_host = Kokkos::create_mirror_view( geometry.radii );
+    for ( int i = 0; i < n; ++i )
+    {
+        centers_host( i ) = {{cloud[i][0], cloud[i][1], cloud[i][2]}};
+        radii_host( i ) = ( i % 20 == 0 ? 2. : 0.1 );
+    }
+    // away from the others, the bounding box of the last sphere is closer to
+    // the first query point than the one before last but the sphere itself
+    // is not
+    centers_host( n ) = {{-22., 0., 0.}};
+    radii_host( n ) = 0.1;
+    centers_host( n + 1 ) = {{-23., -3., 0.}};
+    radii_host( n + 1 ) = 2.;
+    Kokkos::deep_copy( geometry.centers, centers_host );
+    Kokkos::deep_copy( geometry.radii, radii_host );
+
+    Kokkos::View<Box *, DeviceType> boxes( "boxes", n + 2 );
+    auto boxes_host = Kokkos::create_mirror_view( boxes );
+    for ( int i = 0; i < n + 2; ++i )
+    {
+        Point const &c = centers_host( i );
+        double const r = radii_host( i );
+        boxes_host( i ) = {c[0] - r, c[0] + r, c[1] - r,
+                           c[1] + r, c[2] - r, c[2] + r};
+    }
+    Kokkos::deep_copy( boxes, boxes_host );
+
+    int const k = 5;
+    int const n_queries = 40;
+    auto points = make_random_cloud( L, L, L, n_queries - 1 );
+    Kokkos::View<details::Nearest *, DeviceType> queries( "queries",
+                                                          n_queries );
+    auto queries_host = Kokkos::create_mirror_view( queries );
+    queries_host( 0 ) = details::nearest( Point( {{-20., 0., 0.}} ), k );
+    for ( int i = 1; i < n_queries; ++i )
+        queries_host( i ) = details::nearest(
+            Point( {{points[i - 1][0], points[i - 1][1], points[i - 1][2]}} ),
+            k );
+    Kokkos::deep_copy( queries, queries_host );
+
+    // reference: sort all the exact distances
+    std::vector<double> distances_ref( n_queries * k );
+    for ( int i = 0; i < n_queries; ++i )
+    {
+        std::vector<double> all_distances( n + 2 );
+        for ( int j = 0; j < n + 2; ++j )
+            all_distances[j] = sphereDistance(
+                centers_host( j ), radii_host( j ),
+                queries_host( i )._query_point );
+        std::partial_sort( all_distances.begin(), all_distances.begin() + k,
+                           all_distances.end() );
+        std::copy( all_distances.begin(), all_distances.begin() + k,
+                   distances_ref.begin() + i * k );
+    }
+
+    // with and without hierarchy
+    for ( int threshold : {0, n + 2} )
+    {
+        DataTransferKit::BVH<DeviceType> bvh( boxes, threshold );
+        Kokkos::View<int *, DeviceType> indices( "indices" );
+        Kokkos::View<int *, DeviceType> offset( "offset" );
+        Kokkos::View<double *, DeviceType> distances( "distances" );
+        bvh.query( queries, indices, offset, distances, geometry );
+
+        auto indices_host = Kokkos::create_mirror_view( indices );
+        auto distances_host = Kokkos::create_mirror_view( distances );
+        Kokkos::deep_copy( indices_host, indices );
+        Kokkos::deep_copy( distances_host, distances );
+        TEST_EQUALITY( indices_host.extent_int( 0 ), n_queries * k );
+        TEST_COMPARE_FLOATING_ARRAYS( distances_host, distances_ref, 1e-14 );
+        // the distances returned are the ones of the objects reported
+        for ( int i = 0; i < n_queries; ++i )
+            for ( int j = 0; j < k; ++j )
+            {
+                int const index = indices_host( i * k + j );
+                TEST_FLOATING_EQUALITY(
+                    sphereDistance( centers_host( index ), radii_host( index ),
+                                    queries_host( i )._query_point ),
+                    distances_host( i * k + j ), 1e-14 );
+            }
+        TEST_EQUALITY( indices_host( 0 ), n );
+
+        // the distances to the bounding boxes rank the objects differently
+        bvh.query( queries, indices, offset, distances );
+        Kokkos::deep_copy( indices_host, indices );
+        TEST_EQUALITY( indices_host( 0 ), n + 1 );
+    }
+}
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( LinearBVH, tags, DeviceType )
+{
+    using DataTransferKit::Box;
+    using DataTransferKit::Point;
+
+    // objects are split into four groups, the reference for a given mask is
+    // a hierarchy built with the matching objects only
+    double const L = 10.;
+    int const n = 400;
+    auto cloud = make_random_cloud( L, L, L, n );
+    Kokkos::View<Box *, DeviceType> boxes( "boxes", n );
+    Kokkos::View<unsigned int *, DeviceType> tags( "tags", n );
+    auto boxes_host = Kokkos::create_mirror_view( boxes );
+    auto tags_host = Kokkos::create_mirror_view( tags );
+    for ( int i = 0; i < n; ++i )
+    {
+        boxes_host( i ) = {cloud[i][0], cloud[i][0] + 0.2, cloud[i][1],
+                           cloud[i][1] + 0.2, cloud[i][2], cloud[i][2]};
+        tags_host( i ) = 1u << ( i % 4 );
+    }
+    Kokkos::deep_copy( boxes, boxes_host );
+    Kokkos::deep_copy( tags, tags_host );
+
+    int const n_queries = 50;
+    auto points = make_random_cloud( L, L, L, n_queries );
+
+    for ( unsigned int mask : {1u, 2u | 8u, 15u} )
+    {
+        std::vector<int> subset;
+        for ( int i = 0; i < n; ++i )
+            if ( tags_host( i ) & mask )
+                subset.push_back( i );
+        int const m = subset.size();
+        Kokkos::View<Box *, DeviceType> subset_boxes( "subset_boxes", m );
+        auto subset_boxes_host = Kokkos::create_mirror_view( subset_boxes );
+        for ( int j = 0; j < m; ++j )
+            subset_boxes_host( j ) = boxes_host( subset[j] );
+        Kokkos::deep_copy( subset_boxes, subset_boxes_host );
+        DataTransferKit::BVH<DeviceType> bvh_ref( subset_boxes );
+
+        Kokkos::View<details::Within *, DeviceType> within_queries(
+            "within_queries", n_queries );
+        Kokkos::View<details::Nearest *, DeviceType> nearest_queries(
+            "nearest_queries", n_queries );
+        auto within_queries_host = Kokkos::create_mirror_view( within_queries );
+        auto nearest_queries_host =
+            Kokkos::create_mirror_view( nearest_queries );
+        for ( int i = 0; i < n_queries; ++i )
+        {
+            Point const p = {{points[i][0], points[i][1], points[i][2]}};
+            within_queries_host( i ) = details::within( p, 2., mask );
+            nearest_queries_host( i ) = details::nearest( p, 4, mask );
+        }
+        Kokkos::deep_copy( within_queries, within_queries_host );
+        Kokkos::deep_copy( nearest_queries, nearest_queries_host );
+
+        // the reference ignores the masks since all its objects match
+        Kokkos::View<int *, DeviceType> indices_ref( "indices_ref" );
+        Kokkos::View<int *, DeviceType> offset_ref( "offset_ref" );
+        Kokkos::View<double *, DeviceType> distances_ref( "distances_ref" );
+        bvh_ref.query( within_queries, indices_ref, offset_ref );
+        auto within_indices_ref_host =
+            Kokkos::create_mirror_view( indices_ref );
+        auto within_offset_ref_host = Kokkos::create_mirror_view( offset_ref );
+        Kokkos::deep_copy( within_indices_ref_host, indices_ref );
+        Kokkos::deep_copy( within_offset_ref_host, offset_ref );
+        bvh_ref.query( nearest_queries, indices_ref, offset_ref,
+                       distances_ref );
+        auto distances_ref_host = Kokkos::create_mirror_view( distances_ref );
+        Kokkos::deep_copy( distances_ref_host, distances_ref );
+
+        // with and without hierarchy
+        for ( int threshold : {0, n} )
+        {
+            DataTransferKit::BVH<DeviceType> bvh( boxes, tags, threshold );
+
+            // the tags of the nodes are only stored when they are given
+            DataTransferKit::BVH<DeviceType> untagged_bvh( boxes, threshold );
+            std::size_t const n_nodes = n + ( threshold == 0 ? n - 1 : 1 );
+            TEST_EQUALITY( bvh.memoryUsage(),
+                           untagged_bvh.memoryUsage() +
+                               n_nodes * sizeof( unsigned int ) );
+
+            Kokkos::View<int *, DeviceType> indices( "indices" );
+            Kokkos::View<int *, DeviceType> offset( "offset" );
+            Kokkos::View<double *, DeviceType> distances( "distances" );
+
+            bvh.query( within_queries, indices, offset );
+            auto indices_host = Kokkos::create_mirror_view( indices );
+            auto offset_host = Kokkos::create_mirror_view( offset );
+            Kokkos::deep_copy( indices_host, indices );
+            Kokkos::deep_copy( offset_host, offset );
+            TEST_COMPARE_ARRAYS( offset_host, within_offset_ref_host );
+            for ( int i = 0; i < n_queries; ++i )
+            {
+                std::vector<int> found( indices_host.data() + offset_host( i ),
+                                        indices_host.data() +
+                                            offset_host( i + 1 ) );
+                std::vector<int> expected;
+                for ( int j = within_offset_ref_host( i );
+                      j < within_offset_ref_host( i + 1 ); ++j )
+                    expected.push_back(
+                        subset[within_indices_ref_host( j )] );
+                std::sort( found.begin(), found.end() );
+                std::sort( expected.begin(), expected.end() );
+                TEST_COMPARE_ARRAYS( found, expected );
+            }
+
+            bvh.query( nearest_queries, indices, offset, distances );
+            auto distances_host = Kokkos::create_mirror_view( distances );
+            Kokkos::deep_copy( distances_host, distances );
+            TEST_COMPARE_FLOATING_ARRAYS( distances_host, distances_ref_host,
+                                          1e-14 );
+            indices_host = Kokkos::create_mirror_view( indices );
+            Kokkos::deep_copy( indices_host, indices );
+            for ( int j = 0; j < n_queries * 4; ++j )
+                TEST_ASSERT( tags_host( indices_host( j ) ) & mask );
+
+            // objects from a search without mask must not bias the warm start
+            Kokkos::View<int *, DeviceType> previous_indices(
+                "previous_indices" );
+            Kokkos::View<int *, DeviceType> previous_offset(
+                "previous_offset" );
+            Kokkos::View<details::Nearest *, DeviceType> unmasked_queries(
+                "unmasked_queries", n_queries );
+            auto unmasked_queries_host =
+                Kokkos::create_mirror_view( unmasked_queries );
+            for ( int i = 0; i < n_queries; ++i )
+                unmasked_queries_host( i ) = details::nearest(
+                    nearest_queries_host( i )._query_point, 4 );
+            Kokkos::deep_copy( unmasked_queries, unmasked_queries_host );
+            bvh.query( unmasked_queries, previous_indices, previous_offset );
+            bvh.query( nearest_queries, indices, offset, distances,
+                       previous_indices, previous_offset );
+            Kokkos::deep_copy( distances_host, distances );
+            TEST_COMPARE_FLOATING_ARRAYS( distances_host, distances_ref_host,
+                                          1e-14 );
+        }
+    }
+}
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( LinearBVH, save_and_load, DeviceType )
+{
+    using DataTransferKit::Box;
+    using DataTransferKit::Point;
+
+    double const L = 10.;
+    int const n_queries = 40;
+    auto points = make_random_cloud( L, L, L, n_queries );
+    Kokkos::View<details::Within *, DeviceType> within_queries(
+        "within_queries", n_queries );
+    Kokkos::View<details::Nearest *, DeviceType> nearest_queries(
+        "nearest_queries", n_queries );
+    auto within_queries_host = Kokkos::create_mirror_view( within_queries );
+    auto nearest_queries_host = Kokkos::create_mirror_view( nearest_queries );
+    for ( int i = 0; i < n_queries; ++i )
+    {
+        Point const p = {{points[i][0], points[i][1], points[i][2]}};
+        within_queries_host( i ) = details::within( p, 1.5, 1u );
+        nearest_queries_host( i ) = details::nearest( p, 3 );
+    }
+    Kokkos::deep_copy( within_queries, within_queries_host );
+    Kokkos::deep_copy( nearest_queries, nearest_queries_host );
+
+    // with and without hierarchy, with a single object, and empty
+    for ( int n : {300, 50, 1, 0} )
+    {
+        auto cloud = make_random_cloud( L, L, L, n );
+        Kokkos::View<Box *, DeviceType> boxes( "boxes", n );
+        Kokkos::View<unsigned int *, DeviceType> tags( "tags", n );
+        auto boxes_host = Kokkos::create_mirror_view( boxes );
+        auto tags_host = Kokkos::create_mirror_view( tags );
+        for ( int i = 0; i < n; ++i )
+        {
+            boxes_host( i ) = {cloud[i][0], cloud[i][0] + 0.2, cloud[i][1],
+                               cloud[i][1] + 0.2, cloud[i][2], cloud[i][2]};
+            tags_host( i ) = 1u << ( i % 2 );
+        }
+        Kokkos::deep_copy( boxes, boxes_host );
+        Kokkos::deep_copy( tags, tags_host );
+        DataTransferKit::BVH<DeviceType> bvh( boxes, tags );
+
+        std::ostringstream os;
+        bvh.save( os );
+        std::string const buffer = os.str();
+        auto loaded_bvh = DataTransferKit::BVH<DeviceType>::load(
+            buffer.data(), buffer.size() );
+
+        TEST_EQUALITY( loaded_bvh.size(), bvh.size() );
+        TEST_EQUALITY( loaded_bvh.memoryUsage(), bvh.memoryUsage() );
+        for ( int d = 0; d < 6; ++d )
+            TEST_EQUALITY( loaded_bvh.bounds()[d], bvh.bounds()[d] );
+        if ( n > 0 )
+        {
+            TEST_EQUALITY( loaded_bvh.sahCost(), bvh.sahCost() );
+            TEST_EQUALITY( loaded_bvh.leafDepth().max_depth,
+                           bvh.leafDepth().max_depth );
+        }
+
+        // results are identical, including the order in which they are found
+        Kokkos::View<int *, DeviceType> indices( "indices" );
+        Kokkos::View<int *, DeviceType> offset( "offset" );
+        Kokkos::View<double *, DeviceType> distances( "distances" );
+        Kokkos::View<int *, DeviceType> indices_ref( "indices_ref" );
+        Kokkos::View<int *, DeviceType> offset_ref( "offset_ref" );
+        Kokkos::View<double *, DeviceType> distances_ref( "distances_ref" );
+        auto check_results = [&]( bool with_distances ) {
+            auto indices_host = Kokkos::create_mirror_view( indices );
+            auto offset_host = Kokkos::create_mirror_view( offset );
+            auto indices_ref_host = Kokkos::create_mirror_view( indices_ref );
+            auto offset_ref_host = Kokkos::create_mirror_view( offset_ref );
+            Kokkos::deep_copy( indices_host, indices );
+            Kokkos::deep_copy( offset_host, offset );
+            Kokkos::deep_copy( indices_ref_host, indices_ref );
+            Kokkos::deep_copy( offset_ref_host, offset_ref );
+            TEST_COMPARE_ARRAYS( indices_host, indices_ref_host );
+            TEST_COMPARE_ARRAYS( offset_host, offset_ref_host );
+            if ( with_distances )
+            {
+                auto distances_host = Kokkos::create_mirror_view( distances );
+                auto distances_ref_host =
+                    Kokkos::create_mirror_view( distances_ref );
+                Kokkos::deep_copy( distances_host, distances );
+                Kokkos::deep_copy( distances_ref_host, distances_ref );
+                TEST_COMPARE_ARRAYS( distances_host, distances_ref_host );
+            }
+        };
+        loaded_bvh.query( within_queries, indices, offset );
+        bvh.query( within_queries, indices_ref, offset_ref );
+        check_results( false );
+        loaded_bvh.query( nearest_queries, indices, offset, distances );
+        bvh.query( nearest_queries, indices_ref, offset_ref, distances_ref );
+        check_results( true );
+
+        // round trip through a file
+        std::string const filename = "tstLinearBVH_save_and_load.bin";
+        bvh.save( filename );
+        auto reloaded_bvh = DataTransferKit::BVH<DeviceType>::load( filename );
+        std::remove( filename.c_str() );
+        reloaded_bvh.query( nearest_queries, indices, offset, distances );
+        check_results( true );
+    }
+
+    // corrupted or truncated buffers are rejected
+    Kokkos::View<Box *, DeviceType> boxes( "boxes", 2 );
+    auto boxes_host = Kokkos::create_mirror_view( boxes );
+    boxes_host( 0 ) = {0., 0., 0., 0., 0., 0.};
+    boxes_host( 1 ) = {1., 1., 1., 1., 1., 1.};
+    Kokkos::deep_copy( boxes, boxes_host );
+    std::ostringstream os;
+    DataTransferKit::BVH<DeviceType>( boxes, 0 ).save( os );
+    std::string buffer = os.str();
+    TEST_THROW( DataTransferKit::BVH<DeviceType>::load( buffer.data(),
+                                                        buffer.size() - 1 ),
+                DataTransferKit::DataTransferKitException );
+    buffer[0] = 'X';
+    TEST_THROW(
+        DataTransferKit::BVH<DeviceType>::load( buffer.data(), buffer.size() ),
+        DataTransferKit::DataTransferKitException );
+
+    // so are counts and children that do not fit the arrays, and children
+    // that do not form a tree
+    auto corrupt_count = [&]( std::size_t offset, std::uint64_t count ) {
+        std::string corrupted = os.str();
+        std::memcpy( &corrupted[offset], &count, sizeof( count ) );
+        return corrupted;
+    };
+    // the tree has one internal node followed by two leaves
+    auto corrupt_child = [&]( int node, std::int32_t position ) {
+        std::string corrupted = os.str();
+        std::size_t const offset =
+            sizeof( details::SerializedTreeHeader ) +
+            node * sizeof( details::SerializedNode ) +
+            offsetof( details::SerializedNode, children );
+        std::memcpy( &corrupted[offset], &position, sizeof( position ) );
+        return corrupted;
+    };
+    std::size_t const indices_offset = sizeof( details::SerializedTreeHeader ) +
+                                       3 * sizeof( details::SerializedNode );
+    auto corrupt_index = [&]( int leaf, std::int32_t index ) {
+        std::string corrupted = os.str();
+        std::size_t const offset = indices_offset + leaf * sizeof( index );
+        std::memcpy( &corrupted[offset], &index, sizeof( index ) );
+        return corrupted;
+    };
+    std::int32_t first_index;
+    std::memcpy( &first_index, &os.str()[indices_offset],
+                 sizeof( first_index ) );
+    std::size_t const n_leaf_nodes_offset =
+        offsetof( details::SerializedTreeHeader, n_leaf_nodes );
+    for ( auto const &corrupted :
+          {corrupt_count( n_leaf_nodes_offset, std::uint64_t( 1 ) << 40 ),
+           corrupt_count( n_leaf_nodes_offset, 1000 ), corrupt_child( 0, 3 ),
+           corrupt_child( 0, -2 ), corrupt_child( 0, 0 ),
+           corrupt_child( 1, 2 ), corrupt_index( 0, 2 ),
+           corrupt_index( 0, -1 ), corrupt_index( 1, first_index )} )
+        TEST_THROW( DataTransferKit::BVH<DeviceType>::load( corrupted.data(),
+                                                            corrupted.size() ),
+                    DataTransferKit::DataTransferKitException );
+}
+
 // Include the test macros.
 #include "DataTransferKitSearch_ETIHelperMacros.h"
 
+#if HAVE_DTK_TRAVERSAL_STATISTICS
+#define TRAVERSAL_STATISTICS_TEST( NODE )                                      \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( LinearBVH, traversal_statistics,     \
+                                          DeviceType##NODE )
+#else
+#define TRAVERSAL_STATISTICS_TEST( NODE )
+#endif
+
 // Create the test group
 #define UNIT_TEST_GROUP( NODE )                                                \
     using DeviceType##NODE = typename NODE::device_type;                       \
@@ -735,9 +1816,31 @@ TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( LinearBVH, rtree, DeviceType )
     TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( LinearBVH, nearest_queries,          \
                                           DeviceType##NODE )                   \
     TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( LinearBVH, empty, DeviceType##NODE ) \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( LinearBVH, sorted_input,             \
+                                          DeviceType##NODE )                   \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( LinearBVH, hilbert_curve,            \
+                                          DeviceType##NODE )                   \
     TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( LinearBVH, structured_grid,          \
                                           DeviceType##NODE )                   \
-    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( LinearBVH, rtree, DeviceType##NODE )
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( LinearBVH, rtree, DeviceType##NODE ) \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( LinearBVH,                           \
+                                          nearest_queries_warm_start,          \
+                                          DeviceType##NODE )                   \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( LinearBVH, tree_quality,             \
+                                          DeviceType##NODE )                   \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( LinearBVH, brute_force,              \
+                                          DeviceType##NODE )                   \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( LinearBVH,                           \
+                                          brute_force_many_neighbors,          \
+                                          DeviceType##NODE )                   \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( LinearBVH, periodic,                 \
+                                          DeviceType##NODE )                   \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( LinearBVH, exact_distances,          \
+                                          DeviceType##NODE )                   \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( LinearBVH, tags, DeviceType##NODE )  \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( LinearBVH, save_and_load,            \
+                                          DeviceType##NODE )                   \
+    TRAVERSAL_STATISTICS_TEST( NODE )
 
 // Demangle the types
 DTK_ETI_MANGLING_TYPEDEFS()
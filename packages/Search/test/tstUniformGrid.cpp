@@ -0,0 +1,246 @@
+/****************************************************************************
+ * Copyright (c) 2012-2017 by the DataTransferKit authors                   *
+ * All rights reserved.                                                     *
+ *                                                                          *
+ * This file is part of the DataTransferKit library. DataTransferKit is     *
+ * distributed under a BSD 3-clause license. For the licensing terms see    *
+ * the LICENSE file in the top-level directory.                             *
+ ****************************************************************************/
+
+#include <DTK_LinearBVH.hpp>
+#include <DTK_UniformGrid.hpp>
+
+#include <Teuchos_UnitTestHarness.hpp>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace details = DataTransferKit::Details;
+
+// Sort the results of each query so that they can be compared regardless of
+// the order in which they were found.
+std::vector<int> sortedResults( std::vector<int> indices,
+                                std::vector<int> const &offset )
+{
+    for ( size_t i = 0; i + 1 < offset.size(); ++i )
+        std::sort( indices.begin() + offset[i],
+                   indices.begin() + offset[i + 1] );
+    return indices;
+}
+
+template <typename T, typename DeviceType>
+std::vector<T> toVector( Kokkos::View<T *, DeviceType> v )
+{
+    auto v_host = Kokkos::create_mirror_view( v );
+    Kokkos::deep_copy( v_host, v );
+    return std::vector<T>( v_host.data(), v_host.data() + v_host.extent( 0 ) );
+}
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( UniformGrid, empty, DeviceType )
+{
+    DataTransferKit::UniformGrid<DeviceType> grid(
+        Kokkos::View<DataTransferKit::Box *, DeviceType>( "boxes", 0 ) );
+    TEST_ASSERT( grid.empty() );
+    TEST_EQUALITY( grid.size(), 0 );
+
+    Kokkos::View<details::Overlap *, DeviceType> overlap_queries( "queries",
+                                                                  1 );
+    Kokkos::View<details::Nearest *, DeviceType> nearest_queries( "queries",
+                                                                  1 );
+    auto overlap_queries_host = Kokkos::create_mirror_view( overlap_queries );
+    auto nearest_queries_host = Kokkos::create_mirror_view( nearest_queries );
+    overlap_queries_host( 0 ) =
+        details::overlap( DataTransferKit::Box( {0., 1., 0., 1., 0., 1.} ) );
+    nearest_queries_host( 0 ) =
+        details::nearest( DataTransferKit::Point( {{0., 0., 0.}} ), 2 );
+    Kokkos::deep_copy( overlap_queries, overlap_queries_host );
+    Kokkos::deep_copy( nearest_queries, nearest_queries_host );
+
+    Kokkos::View<int *, DeviceType> indices( "indices" );
+    Kokkos::View<int *, DeviceType> offset( "offset" );
+    grid.query( overlap_queries, indices, offset );
+    TEST_EQUALITY( indices.extent( 0 ), 0 );
+    TEST_COMPARE_ARRAYS( toVector( offset ), std::vector<int>( {0, 0} ) );
+
+    // unused slots of nearest queries are padded with -1 like for the BVH
+    grid.query( nearest_queries, indices, offset );
+    TEST_COMPARE_ARRAYS( toVector( indices ), std::vector<int>( {-1, -1} ) );
+    TEST_COMPARE_ARRAYS( toVector( offset ), std::vector<int>( {0, 2} ) );
+}
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( UniformGrid, compare_with_bvh, DeviceType )
+{
+    // random boxes of various sizes, some of them degenerated to points
+    int const n = 500;
+    double const L = 10.;
+    std::default_random_engine generator( 1234 );
+    std::uniform_real_distribution<double> position( 0., L );
+    std::uniform_real_distribution<double> size( 0., 0.5 );
+    Kokkos::View<DataTransferKit::Box *, DeviceType> boxes( "boxes", n );
+    auto boxes_host = Kokkos::create_mirror_view( boxes );
+    for ( int i = 0; i < n; ++i )
+    {
+        double const x = position( generator );
+        double const y = position( generator );
+        double const z = position( generator );
+        double const h = ( i % 4 == 0 ? 0. : size( generator ) );
+        boxes_host( i ) = DataTransferKit::Box( {x, x + h, y, y + h, z, z} );
+    }
+    Kokkos::deep_copy( boxes, boxes_host );
+
+    DataTransferKit::BVH<DeviceType> bvh( boxes );
+    // default cell size as well as cells much smaller and much larger than
+    // the objects
+    for ( double cell_size : {0., 0.05, 3.} )
+    {
+        DataTransferKit::UniformGrid<DeviceType> grid( boxes, cell_size );
+        TEST_EQUALITY( grid.size(), n );
+        auto const bounds = grid.bounds();
+        auto const bvh_bounds = bvh.bounds();
+        for ( int d = 0; d < 6; ++d )
+            TEST_EQUALITY( bounds[d], bvh_bounds[d] );
+
+        // some of the queries lie outside of the grid
+        int const n_queries = 50;
+        std::uniform_real_distribution<double> query_position( -2., L + 2. );
+        Kokkos::View<details::Overlap *, DeviceType> overlap_queries(
+            "overlap_queries", n_queries );
+        Kokkos::View<details::Within *, DeviceType> within_queries(
+            "within_queries", n_queries );
+        Kokkos::View<details::Nearest *, DeviceType> nearest_queries(
+            "nearest_queries", n_queries );
+        auto overlap_queries_host =
+            Kokkos::create_mirror_view( overlap_queries );
+        auto within_queries_host = Kokkos::create_mirror_view( within_queries );
+        auto nearest_queries_host =
+            Kokkos::create_mirror_view( nearest_queries );
+        for ( int i = 0; i < n_queries; ++i )
+        {
+            double const x = query_position( generator );
+            double const y = query_position( generator );
+            double const z = query_position( generator );
+            overlap_queries_host( i ) = details::overlap(
+                DataTransferKit::Box( {x, x + 1., y, y + 2., z, z + 1.5} ) );
+            within_queries_host( i ) = details::within(
+                DataTransferKit::Point( {{x, y, z}} ), 1. );
+            nearest_queries_host( i ) = details::nearest(
+                DataTransferKit::Point( {{x, y, z}} ), 1 + i % 5 );
+        }
+        Kokkos::deep_copy( overlap_queries, overlap_queries_host );
+        Kokkos::deep_copy( within_queries, within_queries_host );
+        Kokkos::deep_copy( nearest_queries, nearest_queries_host );
+
+        Kokkos::View<int *, DeviceType> indices( "indices" );
+        Kokkos::View<int *, DeviceType> offset( "offset" );
+        Kokkos::View<int *, DeviceType> indices_ref( "indices_ref" );
+        Kokkos::View<int *, DeviceType> offset_ref( "offset_ref" );
+
+        grid.query( overlap_queries, indices, offset );
+        bvh.query( overlap_queries, indices_ref, offset_ref );
+        TEST_COMPARE_ARRAYS( toVector( offset ), toVector( offset_ref ) );
+        TEST_COMPARE_ARRAYS(
+            sortedResults( toVector( indices ), toVector( offset ) ),
+            sortedResults( toVector( indices_ref ), toVector( offset_ref ) ) );
+
+        grid.query( within_queries, indices, offset );
+        bvh.query( within_queries, indices_ref, offset_ref );
+        TEST_COMPARE_ARRAYS( toVector( offset ), toVector( offset_ref ) );
+        TEST_COMPARE_ARRAYS(
+            sortedResults( toVector( indices ), toVector( offset ) ),
+            sortedResults( toVector( indices_ref ), toVector( offset_ref ) ) );
+
+        // distances are compared rather than indices in case of ties
+        Kokkos::View<double *, DeviceType> distances( "distances" );
+        Kokkos::View<double *, DeviceType> distances_ref( "distances_ref" );
+        grid.query( nearest_queries, indices, offset, distances );
+        bvh.query( nearest_queries, indices_ref, offset_ref, distances_ref );
+        TEST_COMPARE_ARRAYS( toVector( offset ), toVector( offset_ref ) );
+        TEST_COMPARE_FLOATING_ARRAYS( toVector( distances ),
+                                      toVector( distances_ref ), 1e-14 );
+        grid.query( nearest_queries, indices_ref, offset_ref );
+        TEST_COMPARE_ARRAYS( toVector( indices ), toVector( indices_ref ) );
+    }
+}
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( UniformGrid, flat_scene, DeviceType )
+{
+    // points along a line that is aligned with the y-axis
+    int const n = 10;
+    Kokkos::View<DataTransferKit::Box *, DeviceType> boxes( "boxes", n );
+    auto boxes_host = Kokkos::create_mirror_view( boxes );
+    for ( int i = 0; i < n; ++i )
+        boxes_host( i ) =
+            DataTransferKit::Box( {1., 1., (double)i, (double)i, 2., 2.} );
+    Kokkos::deep_copy( boxes, boxes_host );
+    DataTransferKit::UniformGrid<DeviceType> grid( boxes );
+
+    Kokkos::View<details::Nearest *, DeviceType> queries( "queries", 2 );
+    auto queries_host = Kokkos::create_mirror_view( queries );
+    queries_host( 0 ) =
+        details::nearest( DataTransferKit::Point( {{0., 6.2, 0.}} ), 3 );
+    queries_host( 1 ) =
+        details::nearest( DataTransferKit::Point( {{1., -5., 2.}} ), 1 );
+    Kokkos::deep_copy( queries, queries_host );
+
+    Kokkos::View<int *, DeviceType> indices( "indices" );
+    Kokkos::View<int *, DeviceType> offset( "offset" );
+    Kokkos::View<double *, DeviceType> distances( "distances" );
+    grid.query( queries, indices, offset, distances );
+    TEST_COMPARE_ARRAYS( toVector( indices ),
+                         std::vector<int>( {6, 7, 5, 0} ) );
+    TEST_COMPARE_ARRAYS( toVector( offset ), std::vector<int>( {0, 3, 4} ) );
+    auto const distances_host = toVector( distances );
+    TEST_FLOATING_EQUALITY( distances_host[3], 5., 1e-14 );
+}
+
+TEUCHOS_UNIT_TEST_TEMPLATE_1_DECL( UniformGrid, masked_predicates, DeviceType )
+{
+    Kokkos::View<DataTransferKit::Box *, DeviceType> boxes( "boxes", 1 );
+    auto boxes_host = Kokkos::create_mirror_view( boxes );
+    boxes_host( 0 ) = DataTransferKit::Box( {0., 1., 0., 1., 0., 1.} );
+    Kokkos::deep_copy( boxes, boxes_host );
+    DataTransferKit::UniformGrid<DeviceType> grid( boxes );
+
+    // the grid does not hold tags so it cannot honor the mask
+    Kokkos::View<details::Overlap *, DeviceType> overlap_queries( "queries",
+                                                                  1 );
+    Kokkos::View<details::Nearest *, DeviceType> nearest_queries( "queries",
+                                                                  1 );
+    auto overlap_queries_host = Kokkos::create_mirror_view( overlap_queries );
+    auto nearest_queries_host = Kokkos::create_mirror_view( nearest_queries );
+    overlap_queries_host( 0 ) = details::overlap(
+        DataTransferKit::Box( {0., 1., 0., 1., 0., 1.} ), 1u );
+    nearest_queries_host( 0 ) =
+        details::nearest( DataTransferKit::Point( {{0., 0., 0.}} ), 1, 2u );
+    Kokkos::deep_copy( overlap_queries, overlap_queries_host );
+    Kokkos::deep_copy( nearest_queries, nearest_queries_host );
+
+    Kokkos::View<int *, DeviceType> indices( "indices" );
+    Kokkos::View<int *, DeviceType> offset( "offset" );
+    TEST_THROW( grid.query( overlap_queries, indices, offset ),
+                DataTransferKit::DataTransferKitException );
+    TEST_THROW( grid.query( nearest_queries, indices, offset ),
+                DataTransferKit::DataTransferKitException );
+}
+
+// Include the test macros.
+#include "DataTransferKitSearch_ETIHelperMacros.h"
+
+// Create the test group
+#define UNIT_TEST_GROUP( NODE )                                                \
+    using DeviceType##NODE = typename NODE::device_type;                       \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( UniformGrid, empty,                  \
+                                          DeviceType##NODE )                   \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( UniformGrid, compare_with_bvh,       \
+                                          DeviceType##NODE )                   \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( UniformGrid, flat_scene,             \
+                                          DeviceType##NODE )                   \
+    TEUCHOS_UNIT_TEST_TEMPLATE_1_INSTANT( UniformGrid, masked_predicates,      \
+                                          DeviceType##NODE )
+
+// Demangle the types
+DTK_ETI_MANGLING_TYPEDEFS()
+
+// Instantiate the tests
+DTK_INSTANTIATE_N( UNIT_TEST_GROUP )